@@ -0,0 +1,134 @@
+/* throughput of the turf-ipc codec, run by `make bench`.
+ *  the checksums, fork_delta by the buffer and the iovecs, and the
+ *  decoding on the heap and an arena.
+ */
+
+#include "arena.h"
+#include "ipc.h"
+
+#include <time.h>
+
+#define BENCH_ROUNDS (200000)
+
+static uint64_t bench_now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+// ops done in ns, of bytes in all
+static void bench_report(const char* name,
+                         uint64_t ns,
+                         int ops,
+                         size_t bytes) {
+  printf("%-24s %8.1f ns/op %10.1f MB/s\n", name, (double)ns / ops,
+         bytes * 1e3 / ns);
+}
+
+static volatile uint32_t m_sink;  // keeps the results
+
+static void bench_csum(void) {
+  static char data[TIPC_MSG_MAX_SIZE];
+  size_t sizes[] = {64, 1024, TIPC_MSG_MAX_SIZE};
+
+  for (size_t i = 0; i < sizeof(data); i++) {
+    data[i] = i * 7 + 3;
+  }
+  printf("crc32c on the cpu: %s\n", crc32c_hw() ? "yes" : "no");
+
+  for (int s = 0; s < 3; s++) {
+    char name[32];
+    int rounds = BENCH_ROUNDS / (sizes[s] / 64);
+    uint64_t t = bench_now_ns();
+    for (int i = 0; i < rounds; i++) {
+      m_sink += crc32(data, sizes[s]);
+    }
+    t = bench_now_ns() - t;
+    snprintf(name, sizeof(name), "crc32 %zu", sizes[s]);
+    bench_report(name, t, rounds, rounds * sizes[s]);
+
+    t = bench_now_ns();
+    for (int i = 0; i < rounds; i++) {
+      m_sink += crc32c(data, sizes[s]);
+    }
+    t = bench_now_ns() - t;
+    snprintf(name, sizeof(name), "crc32c %zu", sizes[s]);
+    bench_report(name, t, rounds, rounds * sizes[s]);
+  }
+}
+
+static void bench_codec(int csum) {
+  static char names[TIPC_FORK_BATCH_MAX][64];
+  static struct rlm_t rlm[TIPC_FORK_BATCH_MAX];
+  static struct rlm_t out[TIPC_FORK_BATCH_MAX];
+  static struct rlm_t* realms[TIPC_FORK_BATCH_MAX];
+  static struct tipc_iov v;
+  static char buf[TIPC_MSG_MAX_SIZE];
+  char mem[TIPC_FORK_BATCH_MAX * 4 * ARN_SIZE(128)];
+  struct arena a;
+  uint32_t id;
+  int i, n, len = 0;
+
+  // a full batch of clones, like the names and dirs of turfd
+  for (i = 0; i < TIPC_FORK_BATCH_MAX; i++) {
+    snprintf(names[i], sizeof(names[i]), "clone-%08d-of-the-seed", i);
+    rlm[i].cfg.name = names[i];
+    rlm[i].cfg.chroot_dir =
+        "/run/turf/workdir/sandbox/clone-00000000-of-the-seed/rootfs";
+    rlm[i].cfg.fd_stdout = "/run/turf/workdir/sandbox/clone/stdout";
+    rlm[i].cfg.fd_stderr = "/run/turf/workdir/sandbox/clone/stderr";
+    realms[i] = &rlm[i];
+  }
+  tipc_set_csum(csum);
+  printf("fork_delta of %d, by %s\n", TIPC_FORK_BATCH_MAX,
+         csum == TIPC_CSUM_CRC32C ? "crc32c" : "crc32");
+
+  uint64_t t = bench_now_ns();
+  for (i = 0; i < BENCH_ROUNDS; i++) {
+    len = tipc_enc_fork_delta(buf, sizeof(buf), 1, realms, TIPC_FORK_BATCH_MAX);
+  }
+  t = bench_now_ns() - t;
+  bench_report("  enc buffer", t, BENCH_ROUNDS, (size_t)len * BENCH_ROUNDS);
+
+  t = bench_now_ns();
+  for (i = 0; i < BENCH_ROUNDS; i++) {
+    tipc_iov_init(&v);
+    tipc_iov_fork_delta(&v, 1, realms, TIPC_FORK_BATCH_MAX);
+  }
+  t = bench_now_ns() - t;
+  bench_report("  enc iovec", t, BENCH_ROUNDS, (size_t)len * BENCH_ROUNDS);
+
+  t = bench_now_ns();
+  for (i = 0; i < BENCH_ROUNDS; i++) {
+    memset(out, 0, sizeof(out));
+    n = TIPC_FORK_BATCH_MAX;
+    tipc_dec_fork_delta(out, &n, &id, buf, len);
+    for (int j = 0; j < n; j++) {
+      rlm_free_inner(&out[j]);
+    }
+  }
+  t = bench_now_ns() - t;
+  bench_report("  dec heap", t, BENCH_ROUNDS, (size_t)len * BENCH_ROUNDS);
+
+  arn_init(&a, mem, sizeof(mem));
+  t = bench_now_ns();
+  for (i = 0; i < BENCH_ROUNDS; i++) {
+    memset(out, 0, sizeof(out));
+    for (int j = 0; j < TIPC_FORK_BATCH_MAX; j++) {
+      out[j].cfg.arena = &a;
+    }
+    n = TIPC_FORK_BATCH_MAX;
+    tipc_dec_fork_delta(out, &n, &id, buf, len);
+    arn_reset(&a);
+  }
+  t = bench_now_ns() - t;
+  bench_report("  dec arena", t, BENCH_ROUNDS, (size_t)len * BENCH_ROUNDS);
+  arn_free(&a);
+}
+
+int main(int argc, char* argv[]) {
+  bench_csum();
+  bench_codec(TIPC_CSUM_CRC32);
+  bench_codec(TIPC_CSUM_CRC32C);
+  return 0;
+}
@@ -0,0 +1,73 @@
+/* lookups of the sandbox registry of turfd, run by `make bench`.
+ *  by pid and name on the indexes, and the linear scan of the list as the
+ *  old way, for the scale.
+ */
+
+#include "turf.h"
+
+#include <time.h>
+
+#define BENCH_LINEAR_LOOPS (1000)  // enough to see the scan
+
+static uint64_t bench_now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static volatile uint32_t m_sink;  // keeps the results
+
+// register n sandboxes, and look them up
+static void bench_registry(int n) {
+  int i, j;
+  char name[32];
+  struct turf_t** tfs = (struct turf_t**)calloc(n, sizeof(struct turf_t*));
+
+  for (i = 0; i < n; i++) {
+    snprintf(name, sizeof(name), "bench-%d", i);
+    tfs[i] = (struct turf_t*)calloc(1, sizeof(struct turf_t));
+    tfs[i]->realm = rlm_new(name);
+    tfs[i]->pid_ = 1000000 + i;
+  }
+
+  uint64_t t0 = bench_now_ns();
+  for (i = 0; i < n; i++) {
+    tf_reg_add(tfs[i]);
+  }
+  uint64_t t1 = bench_now_ns();
+  for (i = 0; i < n; i++) {
+    m_sink += tf_get_realm(tfs[i]->pid_) == tfs[i];
+    m_sink += tf_find_realm(tfs[i]->name_) == tfs[i];
+  }
+  uint64_t t2 = bench_now_ns();
+
+  for (i = 0; i < BENCH_LINEAR_LOOPS; i++) {
+    const char* key = tfs[(i * 7919) % n]->name_;
+    for (j = 0; j < n; j++) {
+      if (strcmp(tfs[j]->name_, key) == 0) {
+        break;
+      }
+    }
+    m_sink += j;
+  }
+  uint64_t t3 = bench_now_ns();
+
+  printf("registry %6d: add %4.0f ns/op, lookup %4.0f ns/op, "
+         "linear lookup %8.0f ns/op\n",
+         n, (double)(t1 - t0) / n, (double)(t2 - t1) / (n * 2),
+         (double)(t3 - t2) / BENCH_LINEAR_LOOPS);
+
+  for (i = 0; i < n; i++) {
+    tf_reg_del(tfs[i]);
+    rlm_free(tfs[i]->realm);
+    free(tfs[i]);
+  }
+  free(tfs);
+}
+
+int main(int argc, char* argv[]) {
+  bench_registry(1000);
+  bench_registry(10000);
+  bench_registry(100000);
+  return 0;
+}
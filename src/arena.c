@@ -0,0 +1,148 @@
+/* bump allocator of turf
+ */
+
+#include "arena.h"
+
+// a malloc'd block, the data follows
+struct arn_block {
+  struct arn_block* next;
+  size_t size;  // of data
+};
+
+#define ARN_HDR ARN_SIZE(sizeof(struct arn_block))
+
+static void arn_use(struct arena* a, char* data, size_t size) {
+  a->cur = data;
+  a->end = data + size;
+}
+
+void _API arn_init(struct arena* a, void* buf, size_t size) {
+  memset(a, 0, sizeof(struct arena));
+  if (!buf || size < ARN_ALIGN) {
+    return;
+  }
+
+  // the caller's buf may be unaligned
+  uintptr_t p = (uintptr_t)buf;
+  size_t skip = ARN_SIZE(p) - p;
+  a->base = (char*)buf + skip;
+  a->size = (size - skip) & ~(size_t)(ARN_ALIGN - 1);
+  arn_use(a, a->base, a->size);
+}
+
+struct arena _API* arn_new(size_t size) {
+  size = ARN_SIZE(size ? size : ARN_BLOCK_SIZE);
+  char* p = (char*)malloc(ARN_SIZE(sizeof(struct arena)) + size);
+  if (!p) {
+    set_errno(ENOMEM);
+    return NULL;
+  }
+
+  struct arena* a = (struct arena*)p;
+  arn_init(a, p + ARN_SIZE(sizeof(struct arena)), size);
+  a->own = 1;
+  return a;
+}
+
+// a new block for size bytes at least, the rest of the current is left.
+static int arn_grow(struct arena* a, size_t size) {
+  size = MAX(size, ARN_BLOCK_SIZE);
+  struct arn_block* b = (struct arn_block*)malloc(ARN_HDR + size);
+  if (!b) {
+    set_errno(ENOMEM);
+    return -1;
+  }
+
+  b->size = size;
+  b->next = a->blocks;
+  a->blocks = b;
+  arn_use(a, (char*)b + ARN_HDR, size);
+  return 0;
+}
+
+void _API* arn_alloc(struct arena* a, size_t size) {
+  if (!a) {
+    void* p = malloc(size);
+    if (!p) {
+      set_errno(ENOMEM);
+    }
+    return p;
+  }
+
+  size = ARN_SIZE(size);
+  if ((size_t)(a->end - a->cur) < size && arn_grow(a, size) < 0) {
+    return NULL;
+  }
+
+  char* p = a->cur;
+  a->cur += size;
+  return p;
+}
+
+void _API* arn_calloc(struct arena* a, size_t n, size_t size) {
+  if (size && n > SIZE_MAX / size) {
+    set_errno(ENOMEM);
+    return NULL;
+  }
+
+  void* p = arn_alloc(a, n * size);
+  if (p) {
+    memset(p, 0, n * size);
+  }
+  return p;
+}
+
+char _API* arn_strdup(struct arena* a, const char* s) {
+  if (!s) {
+    return NULL;
+  }
+
+  size_t l = strlen(s) + 1;
+  char* p = (char*)arn_alloc(a, l);
+  if (p) {
+    memcpy(p, s, l);
+  }
+  return p;
+}
+
+void _API arn_reset(struct arena* a) {
+  struct arn_block* keep = a->base ? NULL : a->blocks;
+  struct arn_block* b = a->blocks;
+
+  while (b) {
+    struct arn_block* next = b->next;
+    if (b != keep) {
+      free(b);
+    }
+    b = next;
+  }
+
+  a->blocks = keep;
+  if (a->base) {
+    arn_use(a, a->base, a->size);
+  } else if (keep) {
+    keep->next = NULL;
+    arn_use(a, (char*)keep + ARN_HDR, keep->size);
+  } else {
+    arn_use(a, NULL, 0);
+  }
+}
+
+void _API arn_free(struct arena* a) {
+  if (!a) {
+    return;
+  }
+
+  struct arn_block* b = a->blocks;
+  while (b) {
+    struct arn_block* next = b->next;
+    free(b);
+    b = next;
+  }
+
+  if (a->own) {
+    free(a);  // the first block is in it
+    return;
+  }
+  memset(a, 0, sizeof(struct arena));
+}
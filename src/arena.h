@@ -0,0 +1,49 @@
+#ifndef _TURF_ARENA_H_
+#define _TURF_ARENA_H_
+
+#include "misc.h"
+
+/* bump allocator, the memory of a decoded msg or object is released
+ *  in one call instead of piece by piece.
+ *  the first block may be given by the caller, e.g. on the stack, more
+ *  blocks are malloc'd when it is full. a zeroed arena is empty and valid.
+ *  the allocators take a NULL arena for the heap, freed by free() then.
+ */
+
+#define ARN_ALIGN (16)           // of every allocation
+#define ARN_BLOCK_SIZE (4096)    // of a malloc'd block at least
+#define ARN_SIZE(n) MEM_ALIGN((size_t)(n), ARN_ALIGN)  // taken by n bytes
+
+struct arn_block;
+struct arena {
+  char* cur;  // free space of the current block
+  char* end;
+  char* base;                // the first block, not malloc'd
+  size_t size;               // of base
+  struct arn_block* blocks;  // the malloc'd ones, the newest first
+  bool own;                  // the arena is from arn_new()
+};
+
+// arena on buf of size bytes, buf may be NULL.
+void _API arn_init(struct arena* a, void* buf, size_t size);
+
+// arena and its first block of size in one malloc, 0 for ARN_BLOCK_SIZE.
+struct arena _API* arn_new(size_t size);
+
+// size bytes aligned by ARN_ALIGN, NULL with ENOMEM.
+void _API* arn_alloc(struct arena* a, size_t size);
+
+// zeroed n * size bytes
+void _API* arn_calloc(struct arena* a, size_t n, size_t size);
+
+// copy of s, NULL if s is NULL.
+char _API* arn_strdup(struct arena* a, const char* s);
+
+// release all for reuse, the first block, or the newest malloc'd one if
+// none, is kept.
+void _API arn_reset(struct arena* a);
+
+// release all, and the arena of arn_new().
+void _API arn_free(struct arena* a);
+
+#endif  // _TURF_ARENA_H_
@@ -0,0 +1,654 @@
+/* content-addressed cache of code trees
+ */
+
+#include "cache.h"
+#include "copy.h"
+#include "hmap.h"
+#include "shell.h"  // shl_path2(), shl_rmdir2()
+
+#include <pthread.h>
+#include <sys/file.h>  // flock()
+
+#define CCH_LOCK ".lock"    // flock()ed by the users and eviction
+#define CCH_MAX_DEPTH (64)  // nested dirs in digest
+#define CCH_KEY_LEN (CCH_KEY_SIZE - 1)
+#define CCH_MEMO_MAX (64 * 1024)  // keys of the files digested lately
+
+// an entry in scan
+struct cch_ent {
+  char key[CCH_KEY_SIZE];
+  struct timespec used;  // the last use
+  uint64_t size;         // bytes of the tree
+  bool busy;             // linked by a sandbox
+  bool gone;             // renamed for removal
+};
+
+// the key of a file, valid while the file is not changed.
+struct cch_memo {
+  dev_t dev;
+  ino_t ino;
+  off_t size;
+  struct timespec mtime;
+  struct timespec ctime;
+  char key[CCH_KEY_SIZE];
+};
+
+static pthread_mutex_t m_lock = PTHREAD_MUTEX_INITIALIZER;  // for counters
+static tf_hmap* m_memo;          // dev and ino to index + 1 of m_memos
+static struct cch_memo* m_memos;  // forgotten all if full
+static uint32_t m_nr_memos;
+static uint32_t m_cap_memos;
+static uint64_t m_budget = CCH_DEFAULT_BUDGET;
+static uint64_t m_hits;
+static uint64_t m_misses;
+static uint64_t m_evicted;
+
+void _API cch_set_budget(uint64_t bytes) {
+  pthread_mutex_lock(&m_lock);
+  m_budget = bytes;
+  pthread_mutex_unlock(&m_lock);
+}
+
+static int cch_name_cmp(const void* a, const void* b) {
+  return strcmp(*(char* const*)a, *(char* const*)b);
+}
+
+// the names in dir, sorted
+static char** cch_names(DIR* dir, size_t* n) {
+  struct dirent* ino;
+  size_t cap = 0;
+  char** names = NULL;
+
+  *n = 0;
+  while ((ino = readdir(dir)) != NULL) {
+    if (strcmp(ino->d_name, ".") == 0 || strcmp(ino->d_name, "..") == 0) {
+      continue;
+    }
+    if (*n == cap) {
+      cap = cap ? cap * 2 : 32;
+      char** p = (char**)realloc(names, cap * sizeof(char*));
+      if (!p) {
+        goto error;
+      }
+      names = p;
+    }
+    names[*n] = strdup(ino->d_name);
+    if (!names[*n]) {
+      goto error;
+    }
+    (*n)++;
+  }
+  qsort(names, *n, sizeof(char*), cch_name_cmp);
+  return names;
+
+error:
+  while (*n > 0) {
+    free(names[--(*n)]);
+  }
+  free(names);
+  set_errno(ENOMEM);
+  return NULL;
+}
+
+static bool cch_memo_same(const struct cch_memo* m, const struct stat* st) {
+  return m->dev == st->st_dev && m->ino == st->st_ino &&
+         m->size == st->st_size &&
+         m->mtime.tv_sec == st->st_mtim.tv_sec &&
+         m->mtime.tv_nsec == st->st_mtim.tv_nsec &&
+         m->ctime.tv_sec == st->st_ctim.tv_sec &&
+         m->ctime.tv_nsec == st->st_ctim.tv_nsec;
+}
+
+static uint64_t cch_memo_id(const struct stat* st) {
+  return ((uint64_t)st->st_dev << 40) ^ (uint64_t)st->st_ino;
+}
+
+// the key memorized, in the lock
+static struct cch_memo* cch_memo_find(const struct stat* st) {
+  uintptr_t i = m_memo ? (uintptr_t)hmap_get(m_memo, cch_memo_id(st)) : 0;
+  return i ? &m_memos[i - 1] : NULL;
+}
+
+// a slot for the file, in the lock
+static struct cch_memo* cch_memo_new(const struct stat* st) {
+  if (m_nr_memos == CCH_MEMO_MAX) {  // forget all
+    hmap_free(m_memo);
+    m_memo = NULL;
+    m_nr_memos = 0;
+  }
+  if (!m_memo && !(m_memo = hmap_new(0))) {
+    return NULL;
+  }
+
+  if (m_nr_memos == m_cap_memos) {
+    uint32_t cap = m_cap_memos ? m_cap_memos * 2 : 256;
+    struct cch_memo* p =
+        (struct cch_memo*)realloc(m_memos, cap * sizeof(struct cch_memo));
+    if (!p) {
+      return NULL;
+    }
+    m_memos = p;
+    m_cap_memos = cap;
+  }
+
+  void* idx = (void*)(uintptr_t)(m_nr_memos + 1);
+  if (hmap_put(m_memo, cch_memo_id(st), idx) < 0) {
+    return NULL;
+  }
+  return &m_memos[m_nr_memos++];
+}
+
+// the content digest of a file, memorized by the inode and times.
+static int cch_key_file(int dfd,
+                        const char* src,
+                        const struct stat* st,
+                        char key[CCH_KEY_SIZE]) {
+  struct cch_memo* m;
+
+  pthread_mutex_lock(&m_lock);
+  m = cch_memo_find(st);
+  if (m && cch_memo_same(m, st)) {
+    memcpy(key, m->key, CCH_KEY_SIZE);
+    pthread_mutex_unlock(&m_lock);
+    return 0;
+  }
+  pthread_mutex_unlock(&m_lock);
+
+  if (sha256_file(dfd, src, key) < 0) {
+    return -1;
+  }
+
+  // an ino reused, or another dev of the same id, takes the slot
+  pthread_mutex_lock(&m_lock);
+  m = cch_memo_find(st);
+  if (m || (m = cch_memo_new(st)) != NULL) {
+    m->dev = st->st_dev;
+    m->ino = st->st_ino;
+    m->size = st->st_size;
+    m->mtime = st->st_mtim;
+    m->ctime = st->st_ctim;
+    memcpy(m->key, key, CCH_KEY_SIZE);
+  }
+  pthread_mutex_unlock(&m_lock);
+  return 0;
+}
+
+/* feed the tree into the digest, in name order, a record per entry,
+ *  the name and mode, then the content key of a file, the target of a
+ *  symlink, or the records of a dir.
+ */
+static int cch_digest_dir(struct sha256_ctx* c, int dfd, int depth) {
+  int rc = -1;
+  size_t i, n = 0;
+  char rec[TURF_MAX_PATH_LEN + 128];
+  char target[TURF_MAX_PATH_LEN];
+  char key[CCH_KEY_SIZE];
+  struct stat st;
+
+  if (depth > CCH_MAX_DEPTH) {
+    close(dfd);
+    set_errno(ELOOP);
+    return -1;
+  }
+
+  DIR* dir = fdopendir(dfd);
+  if (!dir) {
+    close(dfd);
+    return -1;
+  }
+
+  char** names = cch_names(dir, &n);
+  if (!names) {
+    goto exit;
+  }
+
+  for (i = 0; i < n; i++) {
+    if (fstatat(dfd, names[i], &st, AT_SYMLINK_NOFOLLOW) < 0) {
+      goto exit;
+    }
+
+    int len =
+        snprintf(rec, sizeof(rec), "%s %o", names[i], (unsigned)st.st_mode);
+    sha256_update(c, rec, len + 1);  // '\0' ends a record
+
+    if (S_ISREG(st.st_mode)) {
+      if (cch_key_file(dfd, names[i], &st, key) < 0) {
+        goto exit;
+      }
+      sha256_update(c, key, CCH_KEY_LEN);
+    } else if (S_ISLNK(st.st_mode)) {
+      ssize_t tn = readlinkat(dfd, names[i], target, sizeof(target));
+      if (tn < 0) {
+        goto exit;
+      }
+      sha256_update(c, target, tn);
+    } else if (S_ISDIR(st.st_mode)) {
+      int sub = openat(
+          dfd, names[i], O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+      if (sub < 0 || cch_digest_dir(c, sub, depth + 1) < 0) {
+        goto exit;
+      }
+      sha256_update(c, "..", 3);  // back to the parent
+    }
+  }
+  rc = 0;
+
+exit:;
+  int err = errno;
+  for (i = 0; names && i < n; i++) {
+    free(names[i]);
+  }
+  free(names);
+  closedir(dir);
+  errno = err;
+  return rc;
+}
+
+int _API cch_key(const char* src, char key[CCH_KEY_SIZE]) {
+  struct stat st;
+  struct sha256_ctx c;
+  uint8_t digest[SHA256_SIZE];
+
+  if (!src || !key) {
+    set_errno(EINVAL);
+    return -1;
+  }
+
+  if (stat(src, &st) < 0) {
+    return -1;
+  }
+
+  if (S_ISREG(st.st_mode)) {
+    return cch_key_file(AT_FDCWD, src, &st, key);
+  }
+
+  if (!S_ISDIR(st.st_mode)) {
+    set_errno(ENOTSUP);
+    return -1;
+  }
+
+  int fd = open(src, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+  if (fd < 0) {
+    return -1;
+  }
+  sha256_init(&c);
+  if (cch_digest_dir(&c, fd, 0) < 0) {
+    return -1;
+  }
+  sha256_final(&c, digest);
+  sha256_hex(digest, key);
+  return 0;
+}
+
+// make the files in the tree read only, return the bytes of them.
+static int64_t cch_seal(int dfd, int depth) {
+  int64_t size = 0;
+  struct dirent* ino;
+  struct stat st;
+
+  if (depth > CCH_MAX_DEPTH) {
+    close(dfd);
+    set_errno(ELOOP);
+    return -1;
+  }
+
+  DIR* dir = fdopendir(dfd);
+  if (!dir) {
+    close(dfd);
+    return -1;
+  }
+
+  while (size >= 0 && (ino = readdir(dir)) != NULL) {
+    if (strcmp(ino->d_name, ".") == 0 || strcmp(ino->d_name, "..") == 0 ||
+        fstatat(dfd, ino->d_name, &st, AT_SYMLINK_NOFOLLOW) < 0) {
+      continue;
+    }
+
+    if (S_ISREG(st.st_mode)) {
+      size += st.st_size;
+      mode_t mode = st.st_mode & ACCESSPERMS & ~(S_IWUSR | S_IWGRP | S_IWOTH);
+      fchmodat(dfd, ino->d_name, mode, 0);
+    } else if (S_ISDIR(st.st_mode)) {
+      int sub = openat(
+          dfd, ino->d_name, O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+      int64_t n = sub < 0 ? -1 : cch_seal(sub, depth + 1);
+      size = n < 0 ? -1 : size + n;
+    }
+  }
+  closedir(dir);
+  return size;
+}
+
+// lock the cache between the users and eviction
+static int cch_lock(const char* cache) {
+  char path[TURF_MAX_PATH_LEN];
+
+  shl_path2(path, sizeof(path), cache, CCH_LOCK);
+  int fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+  if (fd < 0) {
+    return -1;
+  }
+
+  while (flock(fd, LOCK_EX) < 0) {
+    if (errno != EINTR) {
+      close(fd);
+      return -1;
+    }
+  }
+  return fd;
+}
+
+static void cch_unlock(int fd) {
+  close(fd);
+}
+
+// link to the entry, in the lock
+static int cch_use(const char* entry, const char* dest, const char* ref) {
+  char path[TURF_MAX_PATH_LEN];
+
+  shl_path2(path, sizeof(path), entry, "ref");
+  if (link(path, ref) < 0) {
+    return -1;
+  }
+
+  shl_path2(path, sizeof(path), entry, "tree");
+  if (symlink(path, dest) < 0) {
+    int err = errno;
+    unlink(ref);
+    errno = err;
+    return -1;
+  }
+
+  // the last use, for LRU
+  utimensat(AT_FDCWD, entry, NULL, 0);
+  return 0;
+}
+
+static int cch_copy(const char* src, const char* dest) {
+  return cpy_stage(src, dest, CPY_F_CLONE, NULL, NULL);
+}
+
+// fill a new entry at tmp
+static int cch_fill(const char* tmp, const char* src, cch_fill_fn fill) {
+  char path[TURF_MAX_PATH_LEN];
+  char size[32];
+
+  if (mkdir(tmp, 0755) < 0) {
+    return -1;
+  }
+
+  shl_path2(path, sizeof(path), tmp, "tree");
+  if ((fill ? fill : cch_copy)(src, path) < 0) {
+    return -1;
+  }
+
+  struct stat st;
+  if (lstat(path, &st) < 0) {
+    return -1;
+  }
+  int64_t bytes = st.st_size;
+  if (S_ISDIR(st.st_mode)) {
+    int fd = open(path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    bytes = fd < 0 ? -1 : cch_seal(fd, 0);
+    if (bytes < 0) {
+      return -1;
+    }
+  }
+
+  shl_path2(path, sizeof(path), tmp, "size");
+  int n = snprintf(size, sizeof(size), "%" PRId64 "\n", bytes);
+  if (write_file(path, size, n) < 0) {
+    return -1;
+  }
+
+  shl_path2(path, sizeof(path), tmp, "ref");
+  int fd = open(path, O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0444);
+  if (fd < 0) {
+    return -1;
+  }
+  close(fd);
+  return 0;
+}
+
+// remove a dir in cache
+static void cch_remove(const char* cache, const char* name) {
+  if (shl_rmdir2(cache, name) != 0) {
+    warn("remove %s/%s failed", cache, name);
+  }
+}
+
+int _API cch_link(const char* cache,
+                  const char* key,
+                  const char* src,
+                  cch_fill_fn fill,
+                  const char* dest,
+                  const char* ref) {
+  int rc;
+  int lock;
+  char entry[TURF_MAX_PATH_LEN];
+  char tmp[CCH_KEY_SIZE + 64];
+  char path[TURF_MAX_PATH_LEN];
+
+  if (!cache || !key || strlen(key) != CCH_KEY_LEN || !src || !dest || !ref) {
+    set_errno(EINVAL);
+    return -1;
+  }
+
+  if (mkdir(cache, 0755) < 0 && errno != EEXIST) {
+    return -1;
+  }
+  shl_path2(entry, sizeof(entry), cache, key);
+
+  lock = cch_lock(cache);
+  if (lock < 0) {
+    return -1;
+  }
+  rc = cch_use(entry, dest, ref);
+  cch_unlock(lock);
+
+  if (rc == 0) {
+    pthread_mutex_lock(&m_lock);
+    m_hits++;
+    pthread_mutex_unlock(&m_lock);
+    return 0;
+  }
+  if (errno != ENOENT) {
+    return -1;
+  }
+
+  // missed, filled out of the lock, the same key may be filled by others.
+  snprintf(tmp,
+           sizeof(tmp),
+           "%s.%d.%lx.tmp",
+           key,
+           (int)getpid(),
+           (unsigned long)pthread_self());
+  shl_path2(path, sizeof(path), cache, tmp);
+  if (cch_fill(path, src, fill) < 0) {
+    int err = errno;
+    cch_remove(cache, tmp);
+    errno = err;
+    return -1;
+  }
+
+  lock = cch_lock(cache);
+  if (lock < 0) {
+    cch_remove(cache, tmp);
+    return -1;
+  }
+  rc = rename(path, entry);
+  if (rc == 0 || errno == EEXIST || errno == ENOTEMPTY) {
+    rc = cch_use(entry, dest, ref);
+  }
+  int err = errno;
+  cch_unlock(lock);
+
+  // the others won
+  if (access(path, F_OK) == 0) {
+    cch_remove(cache, tmp);
+  }
+
+  pthread_mutex_lock(&m_lock);
+  m_misses++;
+  pthread_mutex_unlock(&m_lock);
+
+  if (rc < 0) {
+    errno = err;
+    return -1;
+  }
+
+  cch_evict(cache);
+  return 0;
+}
+
+static bool cch_is_key(const char* name) {
+  size_t i;
+  for (i = 0; name[i]; i++) {
+    if (!isxdigit((unsigned char)name[i])) {
+      return 0;
+    }
+  }
+  return i == CCH_KEY_LEN;
+}
+
+// list the entries in cache
+static struct cch_ent* cch_scan(const char* cache, size_t* n) {
+  DIR* dir;
+  struct dirent* ino;
+  struct stat st;
+  size_t cap = 0;
+  struct cch_ent* ents = NULL;
+  char path[TURF_MAX_PATH_LEN];
+
+  *n = 0;
+  dir = opendir(cache);
+  if (!dir) {
+    return NULL;
+  }
+
+  while ((ino = readdir(dir)) != NULL) {
+    if (!cch_is_key(ino->d_name) ||
+        fstatat(dirfd(dir), ino->d_name, &st, AT_SYMLINK_NOFOLLOW) < 0 ||
+        !S_ISDIR(st.st_mode)) {
+      continue;
+    }
+
+    if (*n == cap) {
+      cap = cap ? cap * 2 : 32;
+      struct cch_ent* p =
+          (struct cch_ent*)realloc(ents, cap * sizeof(struct cch_ent));
+      if (!p) {
+        break;
+      }
+      ents = p;
+    }
+
+    struct cch_ent* e = &ents[*n];
+    memset(e, 0, sizeof(*e));
+    memcpy(e->key, ino->d_name, CCH_KEY_SIZE);  // checked by cch_is_key()
+    e->used = st.st_mtim;
+
+    char* buf = NULL;
+    size_t size = 0;
+    shl_path3(path, sizeof(path), cache, ino->d_name, "size");
+    if (read_file(path, &buf, &size) == 0) {
+      e->size = strtoull(buf, NULL, 10);
+      free(buf);
+    }
+
+    // a filling entry has no ref yet, treated as busy.
+    shl_path3(path, sizeof(path), cache, ino->d_name, "ref");
+    e->busy = stat(path, &st) < 0 || st.st_nlink > 1;
+    (*n)++;
+  }
+  closedir(dir);
+  return ents;
+}
+
+static int cch_used_cmp(const void* a, const void* b) {
+  const struct cch_ent* x = (const struct cch_ent*)a;
+  const struct cch_ent* y = (const struct cch_ent*)b;
+  if (x->used.tv_sec != y->used.tv_sec) {
+    return x->used.tv_sec < y->used.tv_sec ? -1 : 1;
+  }
+  return x->used.tv_nsec < y->used.tv_nsec ? -1
+                                           : x->used.tv_nsec > y->used.tv_nsec;
+}
+
+int _API cch_evict(const char* cache) {
+  size_t i, n = 0;
+  int evicted = 0;
+  uint64_t total = 0;
+  char path[TURF_MAX_PATH_LEN];
+  char name[CCH_KEY_SIZE + 64];
+
+  pthread_mutex_lock(&m_lock);
+  uint64_t budget = m_budget;
+  pthread_mutex_unlock(&m_lock);
+
+  int lock = cch_lock(cache);
+  if (lock < 0) {
+    return -1;
+  }
+
+  struct cch_ent* ents = cch_scan(cache, &n);
+  for (i = 0; i < n; i++) {
+    total += ents[i].size;
+  }
+
+  // the least recently used first, renamed in the lock, removed after.
+  qsort(ents, n, sizeof(struct cch_ent), cch_used_cmp);
+  for (i = 0; i < n && total > budget; i++) {
+    if (ents[i].busy) {
+      continue;
+    }
+
+    snprintf(name, sizeof(name), "%s.%d.evict", ents[i].key, (int)getpid());
+    shl_path2(path, sizeof(path), cache, name);
+    char entry[TURF_MAX_PATH_LEN];
+    shl_path2(entry, sizeof(entry), cache, ents[i].key);
+    if (rename(entry, path) < 0) {
+      continue;
+    }
+    total -= ents[i].size;
+    ents[i].gone = 1;
+  }
+  cch_unlock(lock);
+
+  for (i = 0; i < n; i++) {
+    if (ents[i].gone) {
+      snprintf(name, sizeof(name), "%s.%d.evict", ents[i].key, (int)getpid());
+      cch_remove(cache, name);
+      evicted++;
+    }
+  }
+  free(ents);
+
+  pthread_mutex_lock(&m_lock);
+  m_evicted += evicted;
+  pthread_mutex_unlock(&m_lock);
+  return evicted;
+}
+
+void _API cch_get_stat(const char* cache, struct cch_stat* st) {
+  size_t i, n = 0;
+
+  if (!st) {
+    return;
+  }
+  memset(st, 0, sizeof(*st));
+
+  pthread_mutex_lock(&m_lock);
+  st->hits = m_hits;
+  st->misses = m_misses;
+  st->evicted = m_evicted;
+  st->budget = m_budget;
+  pthread_mutex_unlock(&m_lock);
+
+  struct cch_ent* ents = cache ? cch_scan(cache, &n) : NULL;
+  for (i = 0; i < n; i++) {
+    st->bytes += ents[i].size;
+  }
+  st->entries = n;
+  free(ents);
+}
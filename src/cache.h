@@ -0,0 +1,55 @@
+#ifndef _TURF_CACHE_H_
+#define _TURF_CACHE_H_
+
+#include "misc.h"
+#include "sha256.h"  // SHA256_HEX_SIZE
+
+/* content-addressed cache of code trees, shared by the sandboxes,
+ *  <cache>/<key>/tree   the immutable tree
+ *  <cache>/<key>/ref    hardlinked by each user, unused if nlink is 1
+ *  <cache>/<key>/size   bytes of the tree
+ *  the entry dir mtime is the last use, evicted in LRU over the budget.
+ */
+
+#define CCH_DEFAULT_BUDGET (1024ULL * 1024 * 1024)  // in bytes
+
+#define CCH_KEY_SIZE SHA256_HEX_SIZE
+
+// fill dest with the tree of src
+typedef int (*cch_fill_fn)(const char* src, const char* dest);
+
+// cache statistics
+struct cch_stat {
+  uint64_t hits;     // links to a cached tree
+  uint64_t misses;   // trees filled
+  uint64_t evicted;  // entries evicted
+  uint64_t entries;  // entries in cache
+  uint64_t bytes;    // bytes in cache
+  uint64_t budget;   // max bytes
+};
+
+// bytes to keep, the unused entries are evicted above it.
+void _API cch_set_budget(uint64_t bytes);
+
+/* the key of src, a dir is digested by the names, modes and contents of the
+ *  tree, a file by the content, memorized until its inode or times change.
+ */
+int _API cch_key(const char* src, char key[CCH_KEY_SIZE]);
+
+/* make dest a symlink to the cached tree of key, and ref a hardlink to
+ *  hold it, the tree is filled from src by fill (a copy if NULL) if missed.
+ */
+int _API cch_link(const char* cache,
+                  const char* key,
+                  const char* src,
+                  cch_fill_fn fill,
+                  const char* dest,
+                  const char* ref);
+
+// evict the unused entries in LRU until under the budget, return the number.
+int _API cch_evict(const char* cache);
+
+// read the statistics, entries and bytes are counted from cache.
+void _API cch_get_stat(const char* cache, struct cch_stat* st);
+
+#endif  // _TURF_CACHE_H_
@@ -3,6 +3,9 @@
 
 #include "cli.h"
 #include "daemon.h"
+#include "pool.h"      // WKP_MAX_THREADS
+#include "spare.h"     // SPR_MAX_SIZE
+#include "warmfork.h"  // TF_SEED_MAX_GROUP
 
 void _API cli_show_version() {
 #define TURF_V_MAJOR 0
@@ -221,12 +224,14 @@ static int cli_spec(tf_cli* cli, int argc, char* const argv[]) {
 }
 
 static int cli_create(tf_cli* cli, int argc, char* const argv[]) {
-  const char* so = "+hb:s:m:c:";
+  const char* so = "+hb:s:m:c:dC";
   const struct option lo[] = {{"help", no_argument, 0, 'h'},
                               {"bundle", required_argument, 0, 'b'},
                               {"config", required_argument, 0, 's'},
                               {"mem", required_argument, 0, 'm'},
                               {"cpu", required_argument, 0, 'c'},
+                              {"dedup", no_argument, 0, 'd'},
+                              {"cache", no_argument, 0, 'C'},
                               {0, 0, 0, 0}};
 
   const char* help =
@@ -240,13 +245,20 @@ static int cli_create(tf_cli* cli, int argc, char* const argv[]) {
       "with a specification file named 'config.json' and a code directory, the "
       "spec file\n"
       "inclues the running parameter, the code dir could be aworker\n"
-      "codebase. The name of a sandbox must be unique in turf system-wide.\n"
+      "codebase, a 'code.zip' instead is extracted once into the code cache.\n"
+      "The name of a sandbox must be unique in turf system-wide.\n"
       "\n"
       "Options:\n"
       "  -b, --bundle path        path to the root of the bundle dir\n"
       "  -s, --config json        json string of the config\n"
       "  -c, --cpu int            override limit CPU in percent\n"
-      "  -m, --mem int            override limit Memory in MBytes\n";
+      "  -m, --mem int            override limit Memory in MBytes\n"
+      "  -d, --dedup              share the code files with the other "
+      "sandboxes,\n"
+      "                           reflinked, or hardlinked read only\n"
+      "  -C, --cache              link the code to the tree cached by the "
+      "digest,\n"
+      "                           copied once for the same code\n";
 
   int opt;
   while ((opt = getopt_long(argc, argv, so, lo, NULL)) > 0) {
@@ -273,6 +285,14 @@ static int cli_create(tf_cli* cli, int argc, char* const argv[]) {
         cli->has.memlimit = 1;
         break;
 
+      case 'd':  // dedup
+        cli->has.dedup = 1;
+        break;
+
+      case 'C':  // cache
+        cli->has.cache = 1;
+        break;
+
       default:
         error("unknown cmd %d", opt);
         set_errno(EINVAL);
@@ -300,9 +320,10 @@ static int cli_create(tf_cli* cli, int argc, char* const argv[]) {
 
 // delete a turf sandbox
 static int cli_delete(tf_cli* cli, int argc, char* const argv[]) {
-  const char* so = "+hf";
+  const char* so = "+hfa";
   const struct option lo[] = {{"help", no_argument, 0, 'h'},
                               {"force", no_argument, 0, 'f'},
+                              {"async", no_argument, 0, 'a'},
                               {0, 0, 0, 0}};
 
   const char* help = "\n"
@@ -316,7 +337,9 @@ static int cli_delete(tf_cli* cli, int argc, char* const argv[]) {
                      "\n"
                      "Options:\n"
                      "  -f, --force      Force delete the sandbox if it is "
-                     "still running (SIGKILL)\n";
+                     "still running (SIGKILL)\n"
+                     "  -a, --async      Move the dirs into the trash, they "
+                     "are removed in background\n";
 
   int opt;
   while ((opt = getopt_long(argc, argv, so, lo, NULL)) > 0) {
@@ -329,6 +352,10 @@ static int cli_delete(tf_cli* cli, int argc, char* const argv[]) {
         cli->has.force = 1;
         break;
 
+      case 'a':  // async
+        cli->has.async = 1;
+        break;
+
       default:
         set_errno(EINVAL);
         return -1;
@@ -525,9 +552,10 @@ static int cli_list(tf_cli* cli, int argc, char* const argv[]) {
 }
 
 static int cli_state(tf_cli* cli, int argc, char* const argv[]) {
-  const char* so = "+f:";
+  const char* so = "+f:jh";
   const struct option lo[] = {{"help", no_argument, 0, 'h'},
-                              {"format", no_argument, 0, 'f'},
+                              {"format", required_argument, 0, 'f'},
+                              {"json", no_argument, 0, 'j'},
                               {0, 0, 0, 0}};
 
   const char* help =
@@ -537,7 +565,8 @@ static int cli_state(tf_cli* cli, int argc, char* const argv[]) {
       "Display the running state of the sandbox\n"
       "\n"
       "Options:\n"
-      "  -f, --format value   Output in table or json (default: table)\n";
+      "  -f, --format value   Output in table or json (default: table)\n"
+      "  -j, --json           Output in OCI json, same as '--format json'\n";
 
   int opt;
   while ((opt = getopt_long(argc, argv, so, lo, NULL)) > 0) {
@@ -547,7 +576,18 @@ static int cli_state(tf_cli* cli, int argc, char* const argv[]) {
         exit(0);
         break;
 
-      case 'f':  // output in json
+      case 'f':  // output format
+        if (strcmp(optarg, "json") == 0) {
+          cli->has.json = 1;
+        } else if (strcmp(optarg, "table") != 0) {
+          error("unknown format %s", optarg);
+          set_errno(EINVAL);
+          return -1;
+        }
+        break;
+
+      case 'j':  // output in json
+        cli->has.json = 1;
         break;
 
       default:
@@ -745,11 +785,17 @@ static int cli_runtime(tf_cli* cli, int argc, char* const argv[]) {
 }
 
 static int cli_daemon(tf_cli* cli, int argc, char* const argv[]) {
-  const char* so = "+D::fh";
+  const char* so = "+D::fw:n:S:p:r:qh";
   const struct option lo[] = {{"help", no_argument, 0, 'h'},
                               {"daemon", optional_argument, 0, 'D'},
                               {"host", optional_argument, 0, 'H'},
                               {"foreground", no_argument, 0, 'f'},
+                              {"flush-window", required_argument, 0, 'w'},
+                              {"workers", required_argument, 0, 'n'},
+                              {"cache-size", required_argument, 0, 'S'},
+                              {"spares", required_argument, 0, 'p'},
+                              {"seed-max", required_argument, 0, 'r'},
+                              {"shm-queue", no_argument, 0, 'q'},
                               {0, 0, 0, 0}};
 
   const char* help = "\n"
@@ -770,7 +816,21 @@ static int cli_daemon(tf_cli* cli, int argc, char* const argv[]) {
                      "of 'turf start' in runc mode for example.\n"
                      "\n"
                      "Options:\n"
-                     "  -f, --foregound      Daemon runs foreground\n";
+                     "  -f, --foregound      Daemon runs foreground\n"
+                     "  -w, --flush-window ms\n"
+                     "                       Coalesce the state writes within "
+                     "the window (default: 100)\n"
+                     "  -n, --workers n      Worker threads for create and "
+                     "delete (default: 4)\n"
+                     "  -S, --cache-size MB  Budget of the code cache "
+                     "(default: 1024)\n"
+                     "  -p, --spares n       Sandboxes made ahead for each "
+                     "runtime, taken by create (default: 0)\n"
+                     "  -r, --seed-max n     Seeds of a seed sandbox, the "
+                     "replicas spawned on demand\n"
+                     "                       (default: 1, max: 16)\n"
+                     "  -q, --shm-queue      Fork requests of the seeds go "
+                     "through shared memory\n";
 
   int opt;
   while ((opt = getopt_long(argc, argv, so, lo, NULL)) > 0) {
@@ -789,6 +849,53 @@ static int cli_daemon(tf_cli* cli, int argc, char* const argv[]) {
         cli->has.foreground = 1;
         break;
 
+      case 'w':  // flush window
+        if (cli_get_uint32(&cli->flush_window, optarg, 0) < 0) {
+          error("bad flush window");
+          return -1;
+        }
+        cli->has.flush_window = 1;
+        break;
+
+      case 'n':  // workers
+        if (cli_get_uint32(&cli->workers, optarg, 0) < 0 ||
+            cli->workers > WKP_MAX_THREADS) {
+          error("bad workers");
+          return -1;
+        }
+        cli->has.workers = 1;
+        break;
+
+      case 'S':  // cache size
+        if (cli_get_uint32(&cli->cache_size, optarg, 0) < 0) {
+          error("bad cache size");
+          return -1;
+        }
+        cli->has.cache_size = 1;
+        break;
+
+      case 'p':  // spares
+        if (cli_get_uint32(&cli->spares, optarg, 0) < 0 ||
+            cli->spares > SPR_MAX_SIZE) {
+          error("bad spares");
+          return -1;
+        }
+        cli->has.spares = 1;
+        break;
+
+      case 'r':  // seed max
+        if (cli_get_uint32(&cli->seed_max, optarg, 0) < 0 ||
+            cli->seed_max < 1 || cli->seed_max > TF_SEED_MAX_GROUP) {
+          error("bad seed max");
+          return -1;
+        }
+        cli->has.seed_max = 1;
+        break;
+
+      case 'q':  // shm queue
+        cli->has.shm_queue = 1;
+        break;
+
       case 'H':  // host
         cli->has.remote = 1;
         break;
@@ -801,8 +908,69 @@ static int cli_daemon(tf_cli* cli, int argc, char* const argv[]) {
   return 0;
 }
 
+static int cli_batch(tf_cli* cli, int argc, char* const argv[]) {
+  const char* so = "+sh";
+  const struct option lo[] = {{"help", no_argument, 0, 'h'},
+                              {"stream", no_argument, 0, 's'},
+                              {0, 0, 0, 0}};
+
+  const char* help =
+      "\n"
+      "Usage : turf -H batch [OPTIONS] [FILE]\n"
+      "\n"
+      "Send the commands in FILE (or stdin) to Daemon in one round trip\n"
+      "\n"
+      "One command per line, the same as 'turf -H COMMAND', e.g.\n"
+      "  create -b /path/to/bundle sandbox_name\n"
+      "  start sandbox_name\n"
+      "Empty lines and lines begin with '#' are skipped, quote the argument "
+      "with\n"
+      "spaces in ' or \".\n"
+      "\n"
+      "Options:\n"
+      "  -s, --stream         Keep the connection, send each line once read, "
+      "and print\n"
+      "                       each result once answered, until the end of "
+      "input\n";
+
+  int opt;
+  while ((opt = getopt_long(argc, argv, so, lo, NULL)) > 0) {
+    switch (opt) {
+      case 'h':  // help
+        puts(help);
+        exit(0);
+
+      case 's':  // stream
+        cli->has.stream = 1;
+        break;
+
+      default:
+        set_errno(EINVAL);
+        return -1;
+    };
+  }
+
+  if (optind < argc) {
+    cli->batch_path = strdup(argv[optind]);
+  }
+
+  cli->cmd = TURF_CLI_BATCH;
+  return 0;
+}
+
+static int cli_parse_command(tf_cli* cli, int c, char* const v[]);
+
+// parse a command of client
+static int cli_parse_client(tf_cli* cli, int c, char* const v[]) {
+  optind = 0;
+  if (strcmp(v[0], "run") == 0) {
+    set_errno(ENOTSUP);
+    return -1;
+  }
+  return cli_parse_command(cli, c, v);
+}
+
 static int cli_remote(tf_cli* cli, int argc, char* const argv[]) {
-  int rc = 0;
   const char* so = "+H::h";
   const struct option lo[] = {{"help", no_argument, 0, 'h'},
                               {"host", optional_argument, 0, 'H'},
@@ -821,7 +989,13 @@ static int cli_remote(tf_cli* cli, int argc, char* const argv[]) {
                      "  create               Create a sandbox\n"
                      "  start                Start a sandbox\n"
                      "  stop                 Stop a sandbox\n"
-                     "  delete               Delete a sandbox\n";
+                     "  delete               Delete a sandbox\n"
+                     "  state                Show state of a sandbox\n"
+                     "  ps                   List sandbox with state\n"
+                     "  list                 List all sandbox\n"
+                     "  info                 Show daemon information\n"
+                     "  batch                Send commands in a file, or a "
+                     "stream\n";
 
   int opt;
   while ((opt = getopt_long(argc, argv, so, lo, NULL)) > 0) {
@@ -847,35 +1021,14 @@ static int cli_remote(tf_cli* cli, int argc, char* const argv[]) {
     return -1;
   }
 
+  // parse the command locally, the daemon gets typed fields.
   int c = argc - optind;
   char* const* v = argv + optind;
-
-  char* const cmd = v[0];
-  dprint("cmd %s", cmd);
-
-  // TBD: we should check all the parameters before remote call.
-  if (strcmp(cmd, "create") == 0) {
-    cli->cmd = TURF_CLI_CREATE;
-    cli->argc = c;
-    cli->argv = (char**)v;
-  } else if (strcmp(cmd, "start") == 0) {
-    cli->cmd = TURF_CLI_START;
-    cli->argc = c;
-    cli->argv = (char**)v;
-  } else if (strcmp(cmd, "stop") == 0) {
-    cli->cmd = TURF_CLI_STOP;
-    cli->argc = c;
-    cli->argv = (char**)v;
-  } else if (strcmp(cmd, "delete") == 0) {
-    cli->cmd = TURF_CLI_REMOVE;
-    cli->argc = c;
-    cli->argv = (char**)v;
-  } else {
-    set_errno(ENOTSUP);
-    rc = -1;
+  if (strcmp(v[0], "batch") == 0) {
+    optind = 0;
+    return cli_batch(cli, c, v);
   }
-
-  return rc;
+  return cli_parse_client(cli, c, v);
 }
 
 int cli_runc(tf_cli* cli, int argc, char* const argv[]) {
@@ -921,21 +1074,10 @@ int cli_runc(tf_cli* cli, int argc, char* const argv[]) {
   return rc;
 }
 
-// cli remote entry, called by daemon
-int cli_parse_remote(tf_cli* cli, int argc, char* const argv[]) {
+// parse a C/S command, v[0] is the command.
+static int cli_parse_command(tf_cli* cli, int c, char* const v[]) {
   int rc;
-
-  if (argc < 2) {
-    error("remote comamnd error.");
-    exit(1);
-  }
-
-  optind = 0;
-  char* const cmd = argv[1];
-
-  // omit cmd begin of 'turf xxx'
-  int c = argc - 1;
-  char* const* v = argv + 1;
+  char* const cmd = v[0];
 
   if (strcmp(cmd, "create") == 0) {
     rc = cli_create(cli, c, v);
@@ -947,6 +1089,14 @@ int cli_parse_remote(tf_cli* cli, int argc, char* const argv[]) {
     rc = cli_stop(cli, c, v);
   } else if (strcmp(cmd, "delete") == 0) {
     rc = cli_delete(cli, c, v);
+  } else if (strcmp(cmd, "state") == 0) {
+    rc = cli_state(cli, c, v);
+  } else if (strcmp(cmd, "ps") == 0) {
+    rc = cli_ps(cli, c, v);
+  } else if (strcmp(cmd, "list") == 0 || strcmp(cmd, "ls") == 0) {
+    rc = cli_list(cli, c, v);
+  } else if (strcmp(cmd, "info") == 0) {
+    rc = cli_info(cli, c, v);
   } else {
     set_errno(ENOTSUP);
     error("unknown command %s", cmd);
@@ -958,6 +1108,80 @@ int cli_parse_remote(tf_cli* cli, int argc, char* const argv[]) {
   return rc;
 }
 
+// cli remote entry, argv[1] is the command.
+int cli_parse_remote(tf_cli* cli, int argc, char* const argv[]) {
+  if (argc < 2) {
+    error("remote comamnd error.");
+    exit(1);
+  }
+
+  optind = 0;
+
+  // omit cmd begin of 'turf xxx'
+  return cli_parse_command(cli, argc - 1, argv + 1);
+}
+
+// split line into argv in place, quotes keep the spaces.
+static int cli_split(char* line, char* argv[], int max) {
+  int argc = 0;
+  char* p = line;
+
+  while (*p) {
+    while (isspace((unsigned char)*p)) {
+      p++;
+    }
+    if (!*p) {
+      break;
+    }
+    if (argc == max) {
+      return -1;
+    }
+
+    char quote = 0;
+    char* d = p;
+    argv[argc++] = d;
+    for (; *p; p++) {
+      if (quote) {
+        if (*p == quote) {
+          quote = 0;
+          continue;
+        }
+      } else if (*p == '\'' || *p == '"') {
+        quote = *p;
+        continue;
+      } else if (isspace((unsigned char)*p)) {
+        p++;
+        break;
+      }
+      *d++ = *p;
+    }
+    *d = 0;
+
+    if (quote) {  // unpaired
+      return -1;
+    }
+  }
+  argv[argc] = NULL;
+  return argc;
+}
+
+int _API cli_parse_batch(tf_cli* cli, char* line) {
+  char* argv[TURF_CLI_MAX_BATCH_ARGS + 1];
+
+  if (!cli || !line) {
+    set_errno(EINVAL);
+    return -1;
+  }
+
+  int argc = cli_split(line, argv, TURF_CLI_MAX_BATCH_ARGS);
+  if (argc <= 0) {
+    set_errno(EINVAL);
+    return -1;
+  }
+
+  return cli_parse_client(cli, argc, argv);
+}
+
 // cli main entry, called by main
 int _API cli_parse(tf_cli* cli, int argc, char* const argv[]) {
   int rc;
@@ -1057,4 +1281,9 @@ void _API cli_free(tf_cli* cli) {
     free(cli->seed_sandbox_name);
     cli->seed_sandbox_name = NULL;
   }
+
+  if (cli->batch_path) {
+    free(cli->batch_path);
+    cli->batch_path = NULL;
+  }
 }
@@ -23,22 +23,36 @@ enum turf_cli_type_e {
   TURF_CLI_INFO,
   TURF_CLI_RUNTIME,
   TURF_CLI_EVENTS,
+
+  // C/S client only
+  TURF_CLI_BATCH = 30,
 };
 
 // configure parsed by cli
 struct tf_cli {
   int cmd;  // TURF_CLI_X
   struct {
-    int remote : 1;      // C/S flag
-    int foreground : 1;  // --foreground flag, C/S deamon for debug purpose
-    int cpulimit : 1;    // --cpu flag
-    int memlimit : 1;    // --mem flag
-    int kill_sig : 1;    // --kill flag
-    int force : 1;       // --force flag
-    int all : 1;         // --all flag
-    int install : 1;     // --install flag
-    int time_wait : 1;   // --time int
-    int seed : 1;        // --seed flag
+    int remote : 1;        // C/S flag
+    int foreground : 1;    // --foreground flag, C/S deamon for debug purpose
+    int cpulimit : 1;      // --cpu flag
+    int memlimit : 1;      // --mem flag
+    int kill_sig : 1;      // --kill flag
+    int force : 1;         // --force flag
+    int all : 1;           // --all flag
+    int install : 1;       // --install flag
+    int time_wait : 1;     // --time int
+    int seed : 1;          // --seed flag
+    int flush_window : 1;  // --flush-window ms
+    int workers : 1;       // --workers n
+    int json : 1;          // --json flag, output in json
+    int dedup : 1;         // --dedup flag, share the code
+    int cache : 1;         // --cache flag, link the cached code
+    int cache_size : 1;    // --cache-size MB
+    int async : 1;         // --async flag, delete by the trash
+    int spares : 1;        // --spares n
+    int seed_max : 1;      // --seed-max n
+    int shm_queue : 1;     // --shm-queue
+    int stream : 1;        // --stream, batch on a long-lived connection
   } has;
 
   // char *workdir;          // turf workdir, for multiple instance
@@ -46,7 +60,12 @@ struct tf_cli {
   uint32_t cpulimit;  // limit in cpu_time(ms), 1000ms means 100% of one core.
   uint32_t kill_sig;  // kill with the signal
 #define TURF_CLI_DEFAULT_TIME_WAIT 3
-  uint32_t time_wait;  // time to wait, in stop/kill
+  uint32_t time_wait;     // time to wait, in stop/kill
+  uint32_t flush_window;  // turfd state flush window, in ms
+  uint32_t workers;       // turfd worker threads
+  uint32_t cache_size;    // turfd code cache budget, in MB
+  uint32_t spares;        // turfd spare sandboxes of each runtime
+  uint32_t seed_max;      // turfd seeds of a group, replicas included
 
   char* sandbox_name;  // sandbox name
   char* cwd;           // hold a path to current workdir.
@@ -62,6 +81,7 @@ struct tf_cli {
   int argc;                      // user arguments
   char** argv;
   char* seed_sandbox_name;  // the seed sandbox name, warm-fork
+  char* batch_path;         // batch commands file, NULL for stdin
 };
 
 typedef struct tf_cli tf_cli;
@@ -72,6 +92,10 @@ int _API cli_parse(tf_cli* cli, int argc, char* const argv[]);
 // remote call cli parse
 int _API cli_parse_remote(tf_cli* cli, int argc, char* const argv[]);
 
+// parse a line of batch file, e.g. "start -e K=V sandbox_name"
+#define TURF_CLI_MAX_BATCH_ARGS 64
+int _API cli_parse_batch(tf_cli* cli, char* line);
+
 // show help (no exit)
 void _API cli_show_help(void);
 
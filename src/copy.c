@@ -0,0 +1,756 @@
+/* native copy of files and trees
+ */
+
+#include "copy.h"
+#include "sha256.h"
+
+#include <pthread.h>
+#if defined(__linux__)
+#include <linux/fs.h>      // FICLONE
+#include <sys/ioctl.h>     // ioctl()
+#include <sys/sendfile.h>  // sendfile()
+#endif
+
+#define CPY_BUF_SIZE (64 * 1024)
+#define CPY_MEMO_PREFIX "src-"  // farm symlinks, source file to farm name
+
+// an entry found by the walk
+struct cpy_ent {
+  char* path;  // relative to the roots
+  mode_t mode;
+  off_t size;
+};
+
+struct cpy_list {
+  struct cpy_ent* ents;
+  size_t n;
+  size_t cap;
+};
+
+// a tree in copying
+struct cpy_tree {
+  int sfd;                // source root
+  int dfd;                // dest root
+  int farm;               // farm dir, -1 if none
+  struct cpy_list files;  // regular files, copied after the walk
+  struct cpy_list dirs;   // created dirs, modes are set at last
+  struct cpy_stat st;
+  off_t total;  // bytes of files found
+
+  // shared by the threads
+  pthread_mutex_t lock;
+  size_t next;  // next file to copy
+  int err;      // the first errno
+  int flags;    // CPY_F_XXX, cleared if not supported
+};
+
+// how a file is staged
+enum cpy_how {
+  CPY_COPIED,
+  CPY_CLONED,
+  CPY_LINKED,
+  CPY_FARMED,  // new to the farm, and linked
+};
+
+static int cpy_list_add(struct cpy_list* l,
+                        const char* path,
+                        mode_t mode,
+                        off_t size) {
+  if (l->n == l->cap) {
+    size_t cap = l->cap ? l->cap * 2 : 64;
+    struct cpy_ent* ents =
+        (struct cpy_ent*)realloc(l->ents, cap * sizeof(struct cpy_ent));
+    if (!ents) {
+      set_errno(ENOMEM);
+      return -1;
+    }
+    l->ents = ents;
+    l->cap = cap;
+  }
+
+  char* p = strdup(path);
+  if (!p) {
+    set_errno(ENOMEM);
+    return -1;
+  }
+  l->ents[l->n].path = p;
+  l->ents[l->n].mode = mode;
+  l->ents[l->n].size = size;
+  l->n++;
+  return 0;
+}
+
+static void cpy_list_free(struct cpy_list* l) {
+  size_t i;
+  for (i = 0; i < l->n; i++) {
+    free(l->ents[i].path);
+  }
+  free(l->ents);
+  memset(l, 0, sizeof(*l));
+}
+
+static int cpy_write(int fd, const char* buf, size_t size) {
+  size_t done = 0;
+  while (done < size) {
+    ssize_t n = write(fd, buf + done, size - done);
+    if (n < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return -1;
+    }
+    done += n;
+  }
+  return 0;
+}
+
+// copy the data in kernel if possible, the rest by read and write.
+static int cpy_data(int in, int out, off_t size) {
+  char buf[CPY_BUF_SIZE];
+  ssize_t n;
+  off_t left = size;
+
+#if defined(__linux__)
+  // any error falls through, the next one reports it if real.
+  while (left > 0) {
+    n = copy_file_range(in, NULL, out, NULL, left, 0);
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+    if (n <= 0) {
+      break;
+    }
+    left -= n;
+  }
+
+  while (left > 0) {
+    n = sendfile(out, in, NULL, left);
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+    if (n <= 0) {
+      break;
+    }
+    left -= n;
+  }
+#endif
+
+  // not supported, or the file grew
+  while ((n = read(in, buf, sizeof(buf))) != 0) {
+    if (n < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return -1;
+    }
+    if (cpy_write(out, buf, n) < 0) {
+      return -1;
+    }
+  }
+  return 0;
+}
+
+// open the dest file, an existing one is replaced.
+static int cpy_open_dest(int dfd, const char* dpath) {
+  int flags = O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC | O_NOFOLLOW;
+
+  int out = openat(dfd, dpath, flags, 0600);
+  if (out < 0 && (errno == EACCES || errno == ELOOP || errno == ETXTBSY)) {
+    // like 'cp -f', remove and try again
+    unlinkat(dfd, dpath, 0);
+    out = openat(dfd, dpath, flags, 0600);
+  }
+  return out;
+}
+
+// copy a regular file, an existing dest is replaced.
+static int cpy_file(int sfd,
+                    const char* spath,
+                    int dfd,
+                    const char* dpath,
+                    mode_t mode,
+                    off_t size) {
+  int rc = -1;
+  int out = -1;
+  int err;
+
+  int in = openat(sfd, spath, O_RDONLY | O_CLOEXEC | O_NOFOLLOW);
+  if (in < 0) {
+    return -1;
+  }
+
+  out = cpy_open_dest(dfd, dpath);
+  if (out < 0) {
+    goto exit;
+  }
+
+  if (cpy_data(in, out, size) < 0) {
+    goto exit;
+  }
+
+  if (fchmod(out, mode & ACCESSPERMS) < 0) {
+    goto exit;
+  }
+  rc = 0;
+
+exit:
+  err = errno;
+  if (out >= 0) {
+    close(out);
+  }
+  close(in);
+  errno = err;
+  return rc;
+}
+
+// the fs can't do it, not a real error.
+static bool cpy_unsupported(int err) {
+  return err == EOPNOTSUPP || err == ENOTSUP || err == EXDEV ||
+         err == EINVAL || err == ENOTTY || err == ENOSYS;
+}
+
+// reflink a regular file, the blocks are shared until written.
+static int cpy_clone(int sfd,
+                     const char* spath,
+                     int dfd,
+                     const char* dpath,
+                     mode_t mode) {
+#if defined(FICLONE)
+  int rc = -1;
+  int out = -1;
+  int err;
+
+  int in = openat(sfd, spath, O_RDONLY | O_CLOEXEC | O_NOFOLLOW);
+  if (in < 0) {
+    return -1;
+  }
+
+  out = cpy_open_dest(dfd, dpath);
+  if (out < 0) {
+    goto exit;
+  }
+
+  if (ioctl(out, FICLONE, in) < 0) {
+    goto exit;
+  }
+
+  if (fchmod(out, mode & ACCESSPERMS) < 0) {
+    goto exit;
+  }
+  rc = 0;
+
+exit:
+  err = errno;
+  if (out >= 0) {
+    close(out);
+  }
+  close(in);
+  errno = err;
+  return rc;
+#else
+  set_errno(ENOTSUP);
+  return -1;
+#endif
+}
+
+/* name of the file in the farm, by the content and mode.
+ *  the source file seen before is not hashed again, a symlink in the farm
+ *  remembers the name by its inode, size and times.
+ */
+static int cpy_farm_name(struct cpy_tree* t,
+                         struct cpy_ent* e,
+                         mode_t mode,
+                         char* name,
+                         size_t size) {
+  char memo[128];
+  char hex[SHA256_HEX_SIZE];
+  struct stat st;
+
+  if (fstatat(t->sfd, e->path, &st, AT_SYMLINK_NOFOLLOW) < 0) {
+    return -1;
+  }
+  snprintf(memo,
+           sizeof(memo),
+           "%s%" PRIx64 "-%" PRIx64 "-%" PRIx64 "-%ld.%ld-%ld.%ld",
+           CPY_MEMO_PREFIX,
+           (uint64_t)st.st_dev,
+           (uint64_t)st.st_ino,
+           (uint64_t)st.st_size,
+           (long)st.st_mtim.tv_sec,
+           (long)st.st_mtim.tv_nsec,
+           (long)st.st_ctim.tv_sec,
+           (long)st.st_ctim.tv_nsec);
+
+  ssize_t n = readlinkat(t->farm, memo, name, size - 1);
+  if (n > 0) {
+    name[n] = 0;
+    return 0;
+  }
+
+  if (sha256_file(t->sfd, e->path, hex) < 0) {
+    return -1;
+  }
+  snprintf(name, size, "%s-%03o", hex, mode);
+
+  // taken by others if raced
+  symlinkat(name, t->farm, memo);
+  return 0;
+}
+
+// put a copy into the farm, under a temp name first.
+static int cpy_farm_put(struct cpy_tree* t,
+                        struct cpy_ent* e,
+                        const char* name,
+                        mode_t mode) {
+  char tmp[SHA256_HEX_SIZE + 64];
+
+  snprintf(tmp,
+           sizeof(tmp),
+           "%s.%d.%lx.tmp",
+           name,
+           (int)getpid(),
+           (unsigned long)pthread_self());
+  if (cpy_file(t->sfd, e->path, t->farm, tmp, mode, e->size) < 0) {
+    unlinkat(t->farm, tmp, 0);
+    return -1;
+  }
+
+  // the same content if raced, either wins.
+  if (renameat(t->farm, tmp, t->farm, name) < 0) {
+    int err = errno;
+    unlinkat(t->farm, tmp, 0);
+    errno = err;
+    return -1;
+  }
+  return 0;
+}
+
+// hardlink the file from the farm, the farm one is put if first seen.
+static int cpy_farm_link(struct cpy_tree* t,
+                         struct cpy_ent* e,
+                         bool* farmed) {
+  int i;
+  char name[SHA256_HEX_SIZE + 8];
+
+  // read only, the data is shared by all the links.
+  mode_t mode = e->mode & ACCESSPERMS & ~(S_IWUSR | S_IWGRP | S_IWOTH);
+  if (cpy_farm_name(t, e, mode, name, sizeof(name)) < 0) {
+    return -1;
+  }
+
+  // the farm one may be collected in between, try again.
+  for (i = 0; i < 3; i++) {
+    if (linkat(t->farm, name, t->dfd, e->path, 0) == 0) {
+      return 0;
+    }
+
+    if (errno == EEXIST) {
+      if (unlinkat(t->dfd, e->path, 0) < 0) {
+        return -1;
+      }
+    } else if (errno == ENOENT) {
+      if (cpy_farm_put(t, e, name, mode) < 0) {
+        return -1;
+      }
+      *farmed = 1;
+    } else {
+      return -1;
+    }
+  }
+  set_errno(EAGAIN);
+  return -1;
+}
+
+// stage a file by flags, or copy it.
+static int cpy_put(struct cpy_tree* t, struct cpy_ent* e, int flags) {
+  bool farmed = 0;
+
+  if (flags & CPY_F_CLONE) {
+    if (cpy_clone(t->sfd, e->path, t->dfd, e->path, e->mode) == 0) {
+      return CPY_CLONED;
+    }
+    if (!cpy_unsupported(errno)) {
+      return -1;
+    }
+
+    // no more tries for the tree
+    pthread_mutex_lock(&t->lock);
+    t->flags &= ~CPY_F_CLONE;
+    pthread_mutex_unlock(&t->lock);
+  }
+
+  if ((flags & CPY_F_LINK) && t->farm >= 0) {
+    if (cpy_farm_link(t, e, &farmed) == 0) {
+      return farmed ? CPY_FARMED : CPY_LINKED;
+    }
+    if (errno != EXDEV && errno != EMLINK && errno != EPERM) {
+      return -1;
+    }
+
+    // the farm is not on the same fs, or too many links.
+    if (errno == EXDEV) {
+      pthread_mutex_lock(&t->lock);
+      t->flags &= ~CPY_F_LINK;
+      pthread_mutex_unlock(&t->lock);
+    }
+  }
+
+  if (cpy_file(t->sfd, e->path, t->dfd, e->path, e->mode, e->size) < 0) {
+    return -1;
+  }
+  return CPY_COPIED;
+}
+
+// copy a symlink itself, an existing dest is replaced.
+static int cpy_link(int sfd, const char* spath, int dfd, const char* dpath) {
+  char target[TURF_MAX_PATH_LEN];
+
+  ssize_t n = readlinkat(sfd, spath, target, sizeof(target));
+  if (n < 0) {
+    return -1;
+  }
+  if (n >= (ssize_t)sizeof(target)) {
+    set_errno(ENAMETOOLONG);
+    return -1;
+  }
+  target[n] = 0;
+
+  if (symlinkat(target, dfd, dpath) == 0) {
+    return 0;
+  }
+  if (errno != EEXIST || unlinkat(dfd, dpath, 0) < 0) {
+    return -1;
+  }
+  return symlinkat(target, dfd, dpath);
+}
+
+// return 0 if created, 1 if it is a dir already.
+static int cpy_mkdir(int dfd, const char* dpath) {
+  struct stat st;
+
+  // writable until the mode is set at last
+  if (mkdirat(dfd, dpath, 0700) == 0) {
+    return 0;
+  }
+  if (errno != EEXIST) {
+    return -1;
+  }
+  if (fstatat(dfd, dpath, &st, AT_SYMLINK_NOFOLLOW) < 0) {
+    return -1;
+  }
+  if (!S_ISDIR(st.st_mode)) {
+    set_errno(ENOTDIR);
+    return -1;
+  }
+  return 1;
+}
+
+// make dirs and symlinks, and collect the files, rel is the path in walk.
+static int cpy_walk(struct cpy_tree* t, char* rel, size_t len, int depth) {
+  int rc = -1;
+  int fd;
+  DIR* dir;
+  struct dirent* ino;
+  struct stat st;
+
+  if (depth > CPY_MAX_DEPTH) {
+    set_errno(ELOOP);
+    return -1;
+  }
+
+  fd = openat(
+      t->sfd, len ? rel : ".", O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+  if (fd < 0) {
+    return -1;
+  }
+  dir = fdopendir(fd);
+  if (!dir) {
+    close(fd);
+    return -1;
+  }
+
+  while ((ino = readdir(dir)) != NULL) {
+    if (strcmp(ino->d_name, ".") == 0 || strcmp(ino->d_name, "..") == 0) {
+      continue;
+    }
+
+    size_t room = TURF_MAX_PATH_LEN - len;
+    int n = snprintf(rel + len, room, "%s%s", len ? "/" : "", ino->d_name);
+    if (n < 0 || (size_t)n >= room) {
+      set_errno(ENAMETOOLONG);
+      goto exit;
+    }
+
+    if (fstatat(fd, ino->d_name, &st, AT_SYMLINK_NOFOLLOW) < 0) {
+      goto exit;
+    }
+
+    if (S_ISDIR(st.st_mode)) {
+      int made = cpy_mkdir(t->dfd, rel);
+      if (made < 0) {
+        goto exit;
+      }
+      if (made == 0 && cpy_list_add(&t->dirs, rel, st.st_mode, 0) < 0) {
+        goto exit;
+      }
+      t->st.dirs++;
+      if (cpy_walk(t, rel, len + n, depth + 1) < 0) {
+        goto exit;
+      }
+    } else if (S_ISREG(st.st_mode)) {
+      if (cpy_list_add(&t->files, rel, st.st_mode, st.st_size) < 0) {
+        goto exit;
+      }
+      t->total += st.st_size;
+    } else if (S_ISLNK(st.st_mode)) {
+      if (cpy_link(fd, ino->d_name, t->dfd, rel) < 0) {
+        goto exit;
+      }
+      t->st.links++;
+    } else {
+      dprint("skip special file %s", rel);
+    }
+    rel[len] = 0;
+  }
+  rc = 0;
+
+exit:
+  rel[len] = 0;
+  int err = errno;
+  closedir(dir);
+  errno = err;
+  return rc;
+}
+
+// take the files one by one, on the caller and the threads.
+static void* cpy_thread(void* arg) {
+  struct cpy_tree* t = (struct cpy_tree*)arg;
+  struct cpy_stat st = {0};
+
+  while (1) {
+    pthread_mutex_lock(&t->lock);
+    if (t->err || t->next >= t->files.n) {
+      pthread_mutex_unlock(&t->lock);
+      break;
+    }
+    struct cpy_ent* e = &t->files.ents[t->next++];
+    int flags = t->flags;
+    pthread_mutex_unlock(&t->lock);
+
+    int how = cpy_put(t, e, flags);
+    if (how < 0) {
+      pthread_mutex_lock(&t->lock);
+      if (!t->err) {
+        t->err = errno ? errno : EIO;
+      }
+      pthread_mutex_unlock(&t->lock);
+      break;
+    }
+
+    st.files++;
+    st.bytes += e->size;
+    st.clones += how == CPY_CLONED;
+    st.linked += how == CPY_LINKED || how == CPY_FARMED;
+    st.farmed += how == CPY_FARMED;
+  }
+
+  pthread_mutex_lock(&t->lock);
+  t->st.files += st.files;
+  t->st.bytes += st.bytes;
+  t->st.clones += st.clones;
+  t->st.linked += st.linked;
+  t->st.farmed += st.farmed;
+  pthread_mutex_unlock(&t->lock);
+  return NULL;
+}
+
+static int cpy_tree(const char* src,
+                    const char* dest,
+                    mode_t mode,
+                    int flags,
+                    const char* farm,
+                    struct cpy_stat* st) {
+  int i;
+  int rc = -1;
+  int nthr = 0;
+  pthread_t thr[CPY_THREADS];
+  char rel[TURF_MAX_PATH_LEN] = {0};
+  struct cpy_tree t = {.sfd = -1, .dfd = -1, .farm = -1, .flags = flags};
+
+  pthread_mutex_init(&t.lock, NULL);
+
+  int made = cpy_mkdir(AT_FDCWD, dest);
+  if (made < 0) {
+    goto exit;
+  }
+  if (made == 0 && cpy_list_add(&t.dirs, ".", mode, 0) < 0) {
+    goto exit;
+  }
+  t.st.dirs++;
+
+  t.sfd = open(src, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+  t.dfd = open(dest, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+  if (t.sfd < 0 || t.dfd < 0) {
+    goto exit;
+  }
+
+  if ((flags & CPY_F_LINK) && farm) {
+    if (mkdir(farm, 0755) < 0 && errno != EEXIST) {
+      goto exit;
+    }
+    t.farm = open(farm, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (t.farm < 0) {
+      goto exit;
+    }
+  }
+
+  if (cpy_walk(&t, rel, 0, 0) < 0) {
+    goto exit;
+  }
+
+  // a big tree is copied by threads, the caller is one of them.
+  if (t.total >= CPY_PARALLEL_BYTES) {
+    for (i = 0; i < CPY_THREADS - 1 && i + 1 < (int)t.files.n; i++) {
+      if (pthread_create(&thr[nthr], NULL, cpy_thread, &t) != 0) {
+        break;
+      }
+      nthr++;
+    }
+  }
+  cpy_thread(&t);
+  for (i = 0; i < nthr; i++) {
+    pthread_join(thr[i], NULL);
+  }
+  if (t.err) {
+    set_errno(t.err);
+    goto exit;
+  }
+
+  // inner dirs first, then the top one
+  for (i = (int)t.dirs.n - 1; i >= 0; i--) {
+    struct cpy_ent* e = &t.dirs.ents[i];
+    if (fchmodat(t.dfd, e->path, e->mode & ACCESSPERMS, 0) < 0) {
+      goto exit;
+    }
+  }
+  rc = 0;
+
+exit:;
+  int err = errno;
+  if (t.sfd >= 0) {
+    close(t.sfd);
+  }
+  if (t.dfd >= 0) {
+    close(t.dfd);
+  }
+  if (t.farm >= 0) {
+    close(t.farm);
+  }
+  cpy_list_free(&t.files);
+  cpy_list_free(&t.dirs);
+  pthread_mutex_destroy(&t.lock);
+  if (st) {
+    *st = t.st;
+  }
+  errno = err;
+  return rc;
+}
+
+int _API cpy_stage(const char* src,
+                   const char* dest,
+                   int flags,
+                   const char* farm,
+                   struct cpy_stat* st) {
+  int rc;
+  struct stat sst;
+
+  if (!src || !dest) {
+    set_errno(EINVAL);
+    return -1;
+  }
+
+  if (st) {
+    memset(st, 0, sizeof(*st));
+  }
+
+  if (lstat(src, &sst) < 0) {
+    return -1;
+  }
+
+  if (S_ISDIR(sst.st_mode)) {
+    return cpy_tree(src, dest, sst.st_mode, flags, farm, st);
+  }
+
+  if (S_ISREG(sst.st_mode)) {
+    rc = cpy_file(AT_FDCWD, src, AT_FDCWD, dest, sst.st_mode, sst.st_size);
+    if (rc == 0 && st) {
+      st->files = 1;
+      st->bytes = sst.st_size;
+    }
+    return rc;
+  }
+
+  if (S_ISLNK(sst.st_mode)) {
+    rc = cpy_link(AT_FDCWD, src, AT_FDCWD, dest);
+    if (rc == 0 && st) {
+      st->links = 1;
+    }
+    return rc;
+  }
+
+  set_errno(ENOTSUP);
+  return -1;
+}
+
+int _API cpy_path(const char* src, const char* dest, struct cpy_stat* st) {
+  return cpy_stage(src, dest, 0, NULL, st);
+}
+
+int _API cpy_farm_gc(const char* farm) {
+  int n = 0;
+  DIR* dir;
+  struct dirent* ino;
+  struct stat st;
+  time_t now = time(NULL);
+  char name[SHA256_HEX_SIZE + 8];
+
+  dir = opendir(farm);
+  if (!dir) {
+    return -1;
+  }
+
+  // the files first, then the memos of them
+  while ((ino = readdir(dir)) != NULL) {
+    if (fstatat(dirfd(dir), ino->d_name, &st, AT_SYMLINK_NOFOLLOW) < 0 ||
+        !S_ISREG(st.st_mode)) {
+      continue;
+    }
+
+    // no sandbox links it, or a temp one left for an hour.
+    bool tmp = strstr(ino->d_name, ".tmp") != NULL;
+    if ((!tmp && st.st_nlink == 1) || (tmp && now - st.st_mtime > 3600)) {
+      if (unlinkat(dirfd(dir), ino->d_name, 0) == 0) {
+        n++;
+      }
+    }
+  }
+
+  rewinddir(dir);
+  while ((ino = readdir(dir)) != NULL) {
+    if (strncmp(ino->d_name, CPY_MEMO_PREFIX, strlen(CPY_MEMO_PREFIX))) {
+      continue;
+    }
+
+    ssize_t len = readlinkat(dirfd(dir), ino->d_name, name, sizeof(name) - 1);
+    if (len < 0) {
+      continue;
+    }
+    name[len] = 0;
+    if (fstatat(dirfd(dir), name, &st, AT_SYMLINK_NOFOLLOW) < 0 &&
+        errno == ENOENT) {
+      unlinkat(dirfd(dir), ino->d_name, 0);
+    }
+  }
+  closedir(dir);
+  return n;
+}
@@ -0,0 +1,48 @@
+#ifndef _TURF_COPY_H_
+#define _TURF_COPY_H_
+
+#include "misc.h"
+
+/* native copy of files and trees, without forking cp(1),
+ *  the tree is walked by *at() calls, files are copied in kernel,
+ *  big trees are copied by threads.
+ */
+
+#define CPY_THREADS (4)                        // threads of a big tree
+#define CPY_PARALLEL_BYTES (8 * 1024 * 1024)  // a tree is big above it
+#define CPY_MAX_DEPTH (64)                     // nested dirs
+
+// how the files of a tree are staged, a plain copy if none works.
+#define CPY_F_CLONE (1 << 0)  // reflink, the blocks are shared until written
+#define CPY_F_LINK (1 << 1)   // hardlink from the farm, read only
+
+// what was copied
+struct cpy_stat {
+  uint64_t files;   // regular files
+  uint64_t dirs;    // directories, the top one included
+  uint64_t links;   // symlinks
+  uint64_t bytes;   // file data
+  uint64_t clones;  // files reflinked
+  uint64_t linked;  // files hardlinked from the farm
+  uint64_t farmed;  // files new to the farm
+};
+
+/* copy src to dest, like 'cp -Rf src dest' when dest does not exist.
+ *  a tree is merged into dest if dest is a directory, modes and symlinks
+ *  are kept, other special files are skipped. st is optional.
+ */
+int _API cpy_path(const char* src, const char* dest, struct cpy_stat* st);
+
+/* like cpy_path(), the files of a tree share the data with the other copies
+ *  by flags, farm is the dir of the files named by content for CPY_F_LINK.
+ */
+int _API cpy_stage(const char* src,
+                   const char* dest,
+                   int flags,
+                   const char* farm,
+                   struct cpy_stat* st);
+
+// remove the farm files not linked anymore, return the number removed.
+int _API cpy_farm_gc(const char* farm);
+
+#endif  // _TURF_COPY_H_
@@ -8,4 +8,16 @@
 
 uint32_t _API crc32(const void* buf, size_t size);
 
+// continue crc (0 to start) with buf, crc32_update(0, b, n) is crc32(b, n).
+uint32_t _API crc32_update(uint32_t crc, const void* buf, size_t size);
+
+// crc32c (castagnoli), by the cpu instructions if supported.
+uint32_t _API crc32c(const void* buf, size_t size);
+
+// continue crc32c (0 to start) with buf
+uint32_t _API crc32c_update(uint32_t crc, const void* buf, size_t size);
+
+// crc32c() runs on the cpu instructions, sse4.2 or armv8 crc.
+bool _API crc32c_hw(void);
+
 #endif  // _TURF_CRC32_H_
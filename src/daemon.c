@@ -3,6 +3,7 @@
  */
 #include "daemon.h"
 #include "cli.h"
+#include "pool.h"
 #include "realm.h"
 #include "shell.h"
 #include "sock.h"
@@ -10,6 +11,12 @@
 
 #define DAEMON_DEFAULT_BACKLOG (1024)
 
+// pending output of a connection, requests wait above it.
+#define TFD_WBUF_HIGH (1024 * 1024)
+
+// requests of a connection on the workers or held, reading waits above it.
+#define TFD_REQS_MAX (256)
+
 static const char* sck_path = NULL;  // turf used unix socket path
 static struct sck_loop* loop;        // socket loop
 static int tfd_fd;                   // daemon listen socket fd
@@ -62,108 +69,362 @@ int register_sighandler() {
 
 /* turf daemon events
  */
-static void daemon_on_write(struct sck_loop* loop,
-                            int fd,
-                            void* data,
-                            int mask) {
-  struct msg_hdr* hdr = (struct msg_hdr*)data;
-  int rc = sck_write(fd, (char*)hdr, sizeof(*hdr));
-  if (rc != sizeof(*hdr)) {
-    warn("write failed (%d)", rc);
+// a request waits for the job on the same sandbox, copied out of rbuf.
+struct tfd_req {
+  TAILQ_ENTRY(tfd_req) in_conn;
+  uint32_t seq;
+  uint32_t size;
+  const char* name;  // in body
+  char body[];
+};
+TAILQ_HEAD(tfd_reqs, tfd_req);
+
+// a client connection, buffers are reused by the requests on it.
+struct tfd_conn {
+  int fd;
+  bool writing;                   // SCK_WRITE registered
+  bool eof;                       // peer closed, close after responses sent
+  bool paused;                    // SCK_READ removed, output or jobs pending
+  bool closed;                    // fd closed, freed when the workers are done
+  int refs;                       // requests answered later by the workers
+  uint32_t nr_held;               // requests in held
+  struct tfd_reqs held;           // requests wait for a busy sandbox, in order
+  TAILQ_ENTRY(tfd_conn) in_held;  // in m_held, if any held
+  struct msg_buf rbuf;            // received bytes, requests decoded in place
+  struct msg_buf wbuf;            // responses to send
+  tf_cli* cli;                    // client side, the request sent
+};
+
+// connections with held requests, go on when a job is done
+static TAILQ_HEAD(, tfd_conn) m_held = TAILQ_HEAD_INITIALIZER(m_held);
+
+static void daemon_conn_close(struct sck_loop* loop, struct tfd_conn* c) {
+  struct tfd_req* r;
+
+  sck_delete_event(loop, c->fd, SCK_RW);
+  close(c->fd);
+  dprint("fd %d closed", c->fd);
+
+  msg_buf_free(&c->rbuf);
+  msg_buf_free(&c->wbuf);
+
+  // never answered
+  if (c->nr_held) {
+    while ((r = TAILQ_FIRST(&c->held)) != NULL) {
+      TAILQ_REMOVE(&c->held, r, in_conn);
+      free(r);
+    }
+    c->nr_held = 0;
+    TAILQ_REMOVE(&m_held, c, in_held);
   }
-  dprint("daemon_write(%d, %d)", fd, rc);
-  rc = sck_delete_event(loop, fd, SCK_WRITE);
-  if (rc) {
-    error("delete event");
+
+  // the workers still hold it
+  if (c->refs > 0) {
+    c->closed = 1;
+    c->fd = -1;
+    return;
   }
-  free(hdr);
+  free(c);
 }
 
+static void daemon_on_write(struct sck_loop* loop,
+                            int fd,
+                            void* data,
+                            int mask);
 static void daemon_on_read(struct sck_loop* loop,
                            int fd,
                            void* data,
-                           int mask) {
-  int rc = 0;
-  struct msg_hdr hdr;
-  rc = sck_read(fd, (char*)&hdr, sizeof(hdr));
-  if (rc <= 0) {
-    warn("Client disconnected(%d)", fd);
-    goto exit;
-  } else if (rc != sizeof(hdr)) {
-    dprint("msg size mismatch (%d != %d)", (int)sizeof(hdr), rc);
-    goto exit;
-  }
+                           int mask);
+static void daemon_on_done(void* data, uint32_t seq, int rc);
 
-  if (hdr.msg_type != T_MSG_CLI_REQ) {
-    dprint("bad req (%d) from (%d)", hdr.msg_type, fd);
-    goto exit;
-  }
+// bytes of responses not sent
+static size_t daemon_conn_pending(struct tfd_conn* c) {
+  return c->wbuf.len - c->wbuf.off;
+}
 
-  if (hdr.msg_size < 1) {
-    dprint("msg size error(%d), from (%d)", hdr.msg_size, fd);
-    goto exit;
-  }
-  if (hdr.msg_size > 4096) {
-    dprint("msg size too large (%d), from (%d)", hdr.msg_size, fd);
-    goto exit;
+// send the responses, wait for SCK_WRITE if the socket is full.
+static int daemon_conn_flush(struct sck_loop* loop, struct tfd_conn* c) {
+  int rc = msg_flush(c->fd, &c->wbuf);
+  dprint("daemon_write(%d, %d)", c->fd, rc);
+  if (rc < 0) {
+    warn("write failed (%d)", errno);
+    return -1;
   }
 
-  int size = hdr.msg_size;
-  char* msg = (char*)calloc(1, size + 1);
-  rc = sck_read(fd, msg, size);
-  if (rc != size) {
-    dprint("read failed, size (%d) rc (%d)", rc, size);
-    goto exit;
+  if (rc > 0 && !c->writing) {
+    if (sck_create_event(loop, c->fd, SCK_WRITE, daemon_on_write, c)) {
+      error("create event");
+      return -1;
+    }
+    c->writing = 1;
+  } else if (rc == 0 && c->writing) {
+    if (sck_delete_event(loop, c->fd, SCK_WRITE)) {
+      error("delete event");
+    }
+    c->writing = 0;
   }
+  return 0;
+}
 
-  // TBD: size 30 hard coded
-  int argc = 0;
-  char** argv = calloc(30, sizeof(char*));
+// a request of the sandbox is held, the later ones go after it.
+static bool daemon_conn_holds(struct tfd_conn* c,
+                              const char* name,
+                              struct tfd_req* until) {
+  struct tfd_req* r;
 
-  int i;
-  argv[argc++] = "turf";
-  argv[argc++] = msg;
-  for (i = 0; i < size - 1; i++) {
-    if (msg[i] == 0) {
-      argv[argc++] = &msg[i + 1];
+  TAILQ_FOREACH(r, &c->held, in_conn) {
+    if (r == until) {
+      break;
     }
+    if (strcmp(r->name, name) == 0) {
+      return 1;
+    }
+  }
+  return 0;
+}
+
+// hold the request until the job on its sandbox is done
+static int daemon_conn_hold(struct tfd_conn* c,
+                            uint32_t seq,
+                            const char* body,
+                            uint32_t size,
+                            const char* name) {
+  struct tfd_req* r = (struct tfd_req*)malloc(sizeof(struct tfd_req) + size);
+  if (!r) {
+    set_errno(ENOMEM);
+    return -1;
   }
+  r->seq = seq;
+  r->size = size;
+  memcpy(r->body, body, size);
+  r->name = r->body + (name - body);
 
-#if 0
-  for (i = 0; i < argc; i++) {
-    dprint("%s", argv[i]);
+  if (c->nr_held++ == 0) {
+    TAILQ_INSERT_TAIL(&m_held, c, in_held);
+  }
+  TAILQ_INSERT_TAIL(&c->held, r, in_conn);
+  return 0;
+}
+
+/* answer a request, or leave it to the workers.
+ *  strings of cli point into the request, no cli_free().
+ */
+static int daemon_conn_serve(struct tfd_conn* c,
+                             uint32_t seq,
+                             tf_cli* cli,
+                             int rc) {
+  ssize_t start = msg_rsp_begin(&c->wbuf, seq);
+  if (start < 0) {
+    return -1;
   }
-#endif
 
-  tf_cli cli = {0};
-  rc = cli_parse_remote(&cli, argc, argv);
   if (rc == 0) {
-    rc = tf_action(&cli);
+    // the output is the body of response
+    tf_set_output(&c->wbuf);
+    rc = tf_action_async(cli, daemon_on_done, c, seq);
+    tf_set_output(NULL);
   } else {
-    error("remote command parse failed %d", rc);
+    error("remote command decode failed %d", rc);
   }
 
-  // free resources.
-  cli_free(&cli);
-  if (argv) {
-    free(argv);
-  }
-  if (msg) {
-    free(msg);
+  // on the workers, answered in daemon_on_done()
+  if (rc == 1) {
+    msg_rsp_cancel(&c->wbuf, start);
+    c->refs++;
+    return 0;
   }
 
   if (rc != 0) {
     rc = -errno;
   }
+  return msg_rsp_end(&c->wbuf, start, rc);
+}
+
+// answer the held requests whose sandbox is free now, in order.
+static int daemon_conn_release(struct tfd_conn* c) {
+  struct tfd_req *r, *next;
+
+  TAILQ_FOREACH_SAFE(r, &c->held, in_conn, next) {
+    if (daemon_conn_pending(c) >= TFD_WBUF_HIGH) {
+      break;
+    }
+    if (tf_busy(r->name) || daemon_conn_holds(c, r->name, r)) {
+      continue;
+    }
+
+    TAILQ_REMOVE(&c->held, r, in_conn);
+    if (--c->nr_held == 0) {
+      TAILQ_REMOVE(&m_held, c, in_held);
+    }
+
+    tf_cli cli = {0};
+    int rc = msg_dec_cli(r->body, r->size, &cli);
+    rc = daemon_conn_serve(c, r->seq, &cli, rc);
+    free(r);
+    if (rc < 0) {
+      return -1;
+    }
+  }
+  return 0;
+}
+
+/* answer the buffered requests, pause reading if the client is slow.
+ *  requests may be pipelined, a deferred request doesn't stop the ones after
+ *  it, only the ones of the same sandbox wait, so the responses may be sent
+ *  in any order.
+ */
+static int daemon_conn_process(struct sck_loop* loop, struct tfd_conn* c) {
+  int ready;
+  struct msg_hdr hdr;
+
+  if (daemon_conn_release(c) < 0) {
+    return -1;
+  }
+
+  do {
+    ready = 0;
+    while (c->refs + c->nr_held < TFD_REQS_MAX &&
+           daemon_conn_pending(c) < TFD_WBUF_HIGH &&
+           (ready = msg_peek(&c->rbuf, &hdr)) > 0) {
+      if (hdr.msg_type != T_MSG_CLI_REQ) {
+        dprint("bad req (%d) from (%d)", hdr.msg_type, c->fd);
+        return -1;
+      }
+
+      char* body = c->rbuf.data + c->rbuf.off + sizeof(hdr);
+      c->rbuf.off += sizeof(hdr) + hdr.msg_size;
+
+      tf_cli cli = {0};
+      int rc = msg_dec_cli(body, hdr.msg_size, &cli);
+      const char* name = cli.sandbox_name;
+
+      // wait for the job, or the held one of the same sandbox
+      if (rc == 0 && name &&
+          (tf_busy(name) || daemon_conn_holds(c, name, NULL))) {
+        if (daemon_conn_hold(c, hdr.msg_seq, body, hdr.msg_size, name) < 0) {
+          return -1;
+        }
+        continue;
+      }
+
+      if (daemon_conn_serve(c, hdr.msg_seq, &cli, rc) < 0) {
+        return -1;
+      }
+    }
+
+    if (ready < 0) {
+      dprint("bad msg (%d) from (%d)", errno, c->fd);
+      return -1;
+    }
+
+    if (daemon_conn_flush(loop, c) < 0) {
+      return -1;
+    }
+
+    // go on if the socket took it all
+  } while (ready > 0 && daemon_conn_pending(c) < TFD_WBUF_HIGH);
+
+  // keep the partial frame for next read
+  msg_buf_compact(&c->rbuf);
+
+  // stop reading until the responses are taken
+  bool full = c->refs + c->nr_held >= TFD_REQS_MAX ||
+              daemon_conn_pending(c) >= TFD_WBUF_HIGH;
+  if (full && !c->paused) {
+    if (!c->eof) {
+      sck_delete_event(loop, c->fd, SCK_READ);
+    }
+    c->paused = 1;
+  } else if (!full && c->paused) {
+    if (!c->eof &&
+        sck_create_event(loop, c->fd, SCK_READ, daemon_on_read, c)) {
+      error("create event");
+      return -1;
+    }
+    c->paused = 0;
+  }
+
+  // the peer is gone, and all answered
+  if (c->eof && !c->paused && c->refs == 0 && c->nr_held == 0 &&
+      daemon_conn_pending(c) == 0) {
+    return -1;
+  }
+  return 0;
+}
+
+static void daemon_on_write(struct sck_loop* loop,
+                            int fd,
+                            void* data,
+                            int mask) {
+  struct tfd_conn* c = (struct tfd_conn*)data;
+  int rc = daemon_conn_flush(loop, c);
+
+  // drained, go on with the buffered requests
+  if (rc == 0 && (c->paused || c->eof) &&
+      daemon_conn_pending(c) < TFD_WBUF_HIGH) {
+    rc = daemon_conn_process(loop, c);
+  }
+
+  if (rc < 0) {
+    daemon_conn_close(loop, c);
+  }
+}
+
+// a deferred request is done, send it and go on with the held ones.
+static void daemon_on_done(void* data, uint32_t seq, int rc) {
+  struct tfd_conn* c = (struct tfd_conn*)data;
+
+  c->refs--;
+  if (c->closed) {
+    if (c->refs == 0) {
+      free(c);
+    }
+    return;
+  }
+
+  if (msg_enc_rsp(&c->wbuf, seq, rc) < 0 || daemon_conn_process(loop, c) < 0) {
+    daemon_conn_close(loop, c);
+  }
+}
+
+// works completed on the workers, the held requests of the jobs go on.
+static void daemon_on_pool(struct sck_loop* loop,
+                           int fd,
+                           void* data,
+                           int mask) {
+  struct tfd_conn *c, *next;
+
+  wkp_complete();
+
+  TAILQ_FOREACH_SAFE(c, &m_held, in_held, next) {
+    if (daemon_conn_process(loop, c) < 0) {
+      daemon_conn_close(loop, c);
+    }
+  }
+}
 
-  {
-    struct msg_hdr* hdr = (struct msg_hdr*)calloc(1, sizeof(struct msg_hdr));
-    hdr->hdr_magic = MSG_HDR_MAGIC;
-    hdr->msg_type = T_MSG_CLI_RSP;
-    hdr->msg_code = rc;
-    hdr->msg_size = 0;
-    sck_create_event(loop, fd, SCK_WRITE, daemon_on_write, hdr);
-    // hdr will be freed in daemon_on_write().
+static void daemon_on_read(struct sck_loop* loop,
+                           int fd,
+                           void* data,
+                           int mask) {
+  struct tfd_conn* c = (struct tfd_conn*)data;
+
+  ssize_t n = msg_fill(fd, &c->rbuf);
+  if (n < 0 && errno == EAGAIN) {
+    return;
+  }
+  if (n < 0) {
+    warn("read failed (%d) from (%d)", errno, fd);
+    goto exit;
+  }
+  if (n == 0) {
+    warn("Client disconnected(%d)", fd);
+    c->eof = 1;
+    sck_delete_event(loop, fd, SCK_READ);
+  }
+
+  if (daemon_conn_process(loop, c) < 0) {
+    goto exit;
   }
 
   // good return
@@ -171,11 +432,7 @@ static void daemon_on_read(struct sck_loop* loop,
 
 exit:
   // close fd when error
-  if (fd > 0) {
-    sck_delete_event(loop, fd, SCK_RW);
-    close(fd);
-    dprint("fd %d closed", fd);
-  }
+  daemon_conn_close(loop, c);
 }
 
 static void daemon_on_accept(struct sck_loop* loop,
@@ -188,8 +445,16 @@ static void daemon_on_accept(struct sck_loop* loop,
   }
   dprint("accepted");
 
+  struct tfd_conn* c = (struct tfd_conn*)calloc(1, sizeof(struct tfd_conn));
+  if (!c) {
+    close(client_fd);
+    return;
+  }
+  c->fd = client_fd;
+  TAILQ_INIT(&c->held);
+
   int rc;
-  rc = sck_create_event(loop, client_fd, SCK_READ, daemon_on_read, NULL);
+  rc = sck_create_event(loop, client_fd, SCK_READ, daemon_on_read, c);
   assert(!rc);
 }
 
@@ -220,6 +485,9 @@ static int daemon_health_check(struct sck_loop* loop,
 
   tf_health_check();
 
+  // state persistence stats
+  tf_state_report();
+
   // return next tick in ms, or AE_NOMORE terminate the timer.
   return 1000;  // AE_NOMORE;
 }
@@ -266,12 +534,20 @@ static void daemon_signalfd() {
 #endif
 
 static int daemon_action(tf_cli* cli) {
+  // load sandbox states into memory
+  tf_daemon_init(cli);
+
   // create health_check timer
   sck_create_timer(loop, 1000, daemon_health_check, NULL);
 
 #if defined(__linux__)
-  // macos dosen't support.
-  daemon_signalfd();
+  if (rlm_pidfd_supported()) {
+    // exits are watched by pidfd, children are reaped there.
+    signal(SIGCHLD, SIG_DFL);
+  } else {
+    // macos dosen't support.
+    daemon_signalfd();
+  }
 #endif
 
   // bring up the daemon
@@ -282,11 +558,166 @@ static int daemon_action(tf_cli* cli) {
     daemon(1, 0);
   }
 
+  // the state table, writer and worker threads, after daemon() forked.
+  tf_daemon_start();
+  if (wkp_fd() >= 0) {
+    sck_create_event(loop, wkp_fd(), SCK_READ, daemon_on_pool, NULL);
+  }
+
   return 0;
 }
 
 /* client actions
  */
+static struct tfd_conn m_client = {.fd = -1};  // client connection
+static int m_client_rc;                        // exit code of client
+
+// requests of turf -H batch, pipelined on m_client
+#define CLIENT_PENDING (1)  // response code before it comes
+struct tfd_batch_cmd {
+  char* line;     // the command
+  int code;       // response code
+  bool printed;   // reported already, in stream
+  uint32_t size;  // output size
+  char* out;      // output of the command
+};
+
+struct tfd_batch {
+  uint32_t cnt;                // commands
+  uint32_t cap;                // allocated
+  uint32_t sent;               // requests sent
+  uint32_t done;               // responses received
+  struct tfd_batch_cmd* cmds;  // index by seq - 1
+};
+static struct tfd_batch m_batch;
+
+// turf -H batch --stream, commands are read from the input in the loop
+static int m_stream_fd = -1;        // input, -1 if not streaming or ended
+static int m_stream_flags;          // file flags of input, restored at end
+static struct msg_buf m_stream_in;  // partial line of input
+
+// close the connection, buffers are kept for the next.
+static void client_close(struct sck_loop* loop, struct tfd_conn* c) {
+  int rc = sck_delete_event(loop, c->fd, SCK_RW);
+  if (rc) {
+    error("delete event failed. %d", rc);
+  }
+  close(c->fd);
+  c->fd = -1;
+  c->writing = 0;
+  c->rbuf.off = c->rbuf.len = 0;
+  c->wbuf.off = c->wbuf.len = 0;
+}
+
+// print the result of a command
+static void client_batch_print(uint32_t i) {
+  struct tfd_batch_cmd* cmd = &m_batch.cmds[i];
+
+  if (cmd->code == CLIENT_PENDING) {  // no response
+    cmd->code = -ECONNRESET;
+  }
+  if (cmd->code) {
+    m_client_rc = 1;
+  }
+  printf("%u\t%d\t%s\n", i + 1, cmd->code, cmd->line);
+  if (cmd->out) {
+    fwrite(cmd->out, 1, cmd->size, stdout);
+    free(cmd->out);
+    cmd->out = NULL;
+  }
+  free(cmd->line);
+  cmd->line = NULL;
+  cmd->printed = 1;
+}
+
+// print the results in the order of commands, the ones not printed yet.
+static void client_batch_report(void) {
+  uint32_t i;
+  struct tfd_batch* b = &m_batch;
+
+  for (i = 0; i < b->cnt; i++) {
+    if (!b->cmds[i].printed) {
+      client_batch_print(i);
+    }
+  }
+
+  free(b->cmds);
+  memset(b, 0, sizeof(struct tfd_batch));
+}
+
+// the input of stream is done, or no one to answer it
+static void client_stream_end(struct sck_loop* loop) {
+  if (m_stream_fd < 0) {
+    return;
+  }
+  sck_delete_event(loop, m_stream_fd, SCK_READ);
+  if (m_stream_fd != STDIN_FILENO) {
+    close(m_stream_fd);
+  } else {
+    fcntl(m_stream_fd, F_SETFL, m_stream_flags);
+  }
+  m_stream_fd = -1;
+  msg_buf_free(&m_stream_in);
+}
+
+static void client_batch_on_read(struct sck_loop* loop,
+                                 struct tfd_conn* c,
+                                 ssize_t n) {
+  int rc;
+  struct msg_hdr hdr;
+  struct tfd_batch* b = &m_batch;
+
+  // responses may come in any order, matched by seq.
+  while ((rc = msg_peek(&c->rbuf, &hdr)) > 0) {
+    uint32_t i = hdr.msg_seq - 1;
+    char* body = c->rbuf.data + c->rbuf.off + sizeof(hdr);
+    c->rbuf.off += sizeof(hdr) + hdr.msg_size;
+    if (hdr.msg_type != T_MSG_CLI_RSP || i >= b->cnt ||
+        b->cmds[i].code != CLIENT_PENDING) {
+      warn("unexpected response, seq %u", hdr.msg_seq);
+      continue;
+    }
+
+    struct tfd_batch_cmd* cmd = &b->cmds[i];
+    cmd->code = hdr.msg_code;
+    b->done++;
+
+    // the stream shows it once answered
+    if (c->cli->has.stream) {
+      client_batch_print(i);
+      fwrite(body, 1, hdr.msg_size, stdout);
+      continue;
+    }
+
+    if (hdr.msg_size) {
+      cmd->out = (char*)malloc(hdr.msg_size);
+      if (cmd->out) {
+        memcpy(cmd->out, body, hdr.msg_size);
+        cmd->size = hdr.msg_size;
+      }
+    }
+  }
+  msg_buf_compact(&c->rbuf);
+  if (c->cli->has.stream) {
+    fflush(stdout);
+  }
+
+  // more to come, or more to send in the stream
+  if (rc == 0 && n > 0 && (b->done < b->sent || m_stream_fd >= 0)) {
+    return;
+  }
+
+  if (rc < 0) {
+    error("magic error");
+  } else if (b->done < b->sent) {
+    error("daemon disconnected, %u of %u answered", b->done, b->sent);
+  }
+
+  client_stream_end(loop);
+  client_close(loop, c);
+  client_batch_report();
+}
+
 static int client_retry_timer(struct sck_loop* loop,
                               sck_timer_id id,
                               void* clientData);
@@ -294,29 +725,55 @@ static void client_on_read(struct sck_loop* loop,
                            int fd,
                            void* clientData,
                            int mask) {
-  struct msg_hdr hdr;
+  struct msg_hdr hdr = {0};
   int rc = 0;
-  tf_cli* cli = (tf_cli*)clientData;
+  struct tfd_conn* c = (struct tfd_conn*)clientData;
+  tf_cli* cli = c->cli;
 
-  rc = sck_read(fd, (char*)&hdr, sizeof(hdr));
-  if (rc <= 0) {
-    dprint("Client disconnected");
+  ssize_t n = msg_fill(fd, &c->rbuf);
+  if (n < 0 && errno == EAGAIN) {
+    return;
+  }
+
+  if (cli->cmd == TURF_CLI_BATCH) {
+    client_batch_on_read(loop, c, n);
+    return;
+  }
+
+  rc = msg_peek(&c->rbuf, &hdr);
+  if (rc == 0 && n > 0) {  // wait for the rest
+    return;
   }
 
-  hexbuf((char*)&hdr, sizeof(hdr));
-  if (hdr.hdr_magic != MSG_HDR_MAGIC) {
+  if (rc <= 0) {
+    if (n <= 0) {
+      dprint("Client disconnected");
+    }
     error("magic error");
+    hdr.msg_code = -EPROTO;
+    hdr.msg_size = 0;
+  }
+
+  int code = hdr.msg_code;
+  info("rc=%d", code);
+
+  // output of the command
+  if (hdr.msg_size) {
+    fwrite(c->rbuf.data + c->rbuf.off + sizeof(hdr), 1, hdr.msg_size, stdout);
+    fflush(stdout);
   }
 
-  rc = hdr.msg_code;
-  info("rc=%d", rc);
+  // the response is taken, the next request uses a new connection.
+  client_close(loop, c);
+
+  rc = code;
   if (cli->cmd == TURF_CLI_STOP) {
     static int retry = 0;
 
     if (rc == -EAGAIN) {
       dprint("retry stop");
       if (retry < 3) {
-        sck_create_timer(loop, 1000, client_retry_timer, clientData);
+        sck_create_timer(loop, 1000, client_retry_timer, cli);
         retry++;
       } else {
         error("reaches maxium retries.");
@@ -327,21 +784,29 @@ static void client_on_read(struct sck_loop* loop,
       exit(rc);
     }
   }
+}
 
-  rc = sck_delete_event(loop, fd, SCK_READ);
-  if (rc) {
-    error("delete event failed. %d", rc);
+static void client_on_write(struct sck_loop* loop,
+                            int fd,
+                            void* clientData,
+                            int mask) {
+  struct tfd_conn* c = (struct tfd_conn*)clientData;
+
+  int rc = msg_flush(fd, &c->wbuf);
+  if (rc < 0) {
+    die("write");
+  }
+  if (rc == 0) {
+    sck_delete_event(loop, fd, SCK_WRITE);
+    c->writing = 0;
   }
-  close(fd);
 }
 
+// connect to turfd, send the requests in m_client.wbuf.
 static int client_connect(tf_cli* cli) {
-  int size = 0;
   int fd = 0;
   int rc = 0;
-  char buf[1024];
-  struct msg_hdr* hdr = (struct msg_hdr*)buf;
-  char* p = buf + sizeof(struct msg_hdr);
+  struct tfd_conn* c = &m_client;
 
   fd = sck_unix_socket();
   if (fd < 0) {
@@ -354,45 +819,249 @@ static int client_connect(tf_cli* cli) {
   }
   dprint("connected");
 
-  rc = sck_create_event(loop, fd, SCK_READ, client_on_read, cli);
+  c->fd = fd;
+  c->cli = cli;
+  dprint("msg_size: %d", (int)c->wbuf.len);
+
+  rc = sck_create_event(loop, fd, SCK_READ, client_on_read, c);
   if (rc) {
     error("register event failed.%d", rc);
   }
 
-  int i;
-  for (i = 0; i < cli->argc; i++) {
-    char* c = strcpy(p, cli->argv[i]);
-    dprint("%s", c);
-    p += (strlen(c) + 1);
+  // large requests go out in the loop
+  rc = sck_create_event(loop, fd, SCK_WRITE, client_on_write, c);
+  if (rc) {
+    error("register event failed.%d", rc);
   }
-  size = (p - buf - sizeof(*hdr));
-  dprint("msg_size: %d", size);
-  if (size < 0) {
-    die("overflow");
+  c->writing = 1;
+
+  return 0;
+}
+
+// add a command of batch, encoded if parsed.
+static int client_batch_add(char* line) {
+  struct tfd_batch* b = &m_batch;
+
+  if (b->cnt == b->cap) {
+    uint32_t cap = b->cap ? b->cap * 2 : 64;
+    struct tfd_batch_cmd* cmds = (struct tfd_batch_cmd*)realloc(
+        b->cmds, cap * sizeof(struct tfd_batch_cmd));
+    if (!cmds) {
+      set_errno(ENOMEM);
+      return -1;
+    }
+    b->cmds = cmds;
+    b->cap = cap;
   }
 
-  hdr->hdr_magic = MSG_HDR_MAGIC;
-  hdr->msg_type = T_MSG_CLI_REQ;
-  hdr->msg_code = 0;
-  hdr->msg_size = size;
+  struct tfd_batch_cmd* cmd = &b->cmds[b->cnt];
+  memset(cmd, 0, sizeof(struct tfd_batch_cmd));
+  cmd->line = strdup(line);
+  if (!cmd->line) {
+    set_errno(ENOMEM);
+    return -1;
+  }
 
-  rc = sck_write(fd, (char*)hdr, size + sizeof(*hdr));
-  if (rc < 0) {
-    dprint("write rc=%d", rc);
-    return rc;
+  // line is split by parse
+  tf_cli req = {0};
+  int rc = cli_parse_batch(&req, line);
+  if (rc == 0) {
+    rc = msg_enc_cli(&m_client.wbuf, b->cnt + 1, &req);
   }
+  cli_free(&req);
 
+  if (rc == 0) {
+    cmd->code = CLIENT_PENDING;
+    b->sent++;
+  } else {
+    cmd->code = -errno;
+    error("batch line %u: %s", b->cnt + 1, strerror(-cmd->code));
+  }
+  b->cnt++;
   return 0;
 }
 
+// a line of batch, blank and comment lines are skipped.
+static int client_batch_line(char* line) {
+  char* p = line;
+  while (isspace((unsigned char)*p)) {
+    p++;
+  }
+  if (*p == 0 || *p == '#') {
+    return 0;
+  }
+  return client_batch_add(p);
+}
+
+// ask turfd to send the requests added
+static void client_stream_send(struct sck_loop* loop, struct tfd_conn* c) {
+  if (c->writing || c->wbuf.off == c->wbuf.len) {
+    return;
+  }
+  if (sck_create_event(loop, c->fd, SCK_WRITE, client_on_write, c)) {
+    die("register event");
+  }
+  c->writing = 1;
+}
+
+// lines of the stream, each goes to turfd once read.
+static void client_stream_on_read(struct sck_loop* loop,
+                                  int fd,
+                                  void* data,
+                                  int mask) {
+  struct msg_buf* in = &m_stream_in;
+  struct tfd_conn* c = &m_client;
+  char* eol;
+
+  ssize_t n = msg_fill(fd, in);
+  if (n < 0 && errno == EAGAIN) {
+    return;
+  }
+  if (n < 0) {
+    warn("read input failed (%d)", errno);
+    n = 0;
+  }
+
+  // the last line may have no newline
+  if (n == 0 && in->len > in->off && msg_buf_reserve(in, 1) == 0) {
+    in->data[in->len++] = '\n';
+  }
+
+  while ((eol = memchr(in->data + in->off, '\n', in->len - in->off))) {
+    char* line = in->data + in->off;
+    uint32_t i = m_batch.cnt;
+
+    *eol = 0;
+    in->off = eol + 1 - in->data;
+    if (client_batch_line(line) < 0) {
+      error("batch line %u: %s", i + 1, strerror(errno));
+      n = 0;
+      break;
+    }
+
+    // not sent, bad line
+    if (m_batch.cnt > i && m_batch.cmds[i].code != CLIENT_PENDING) {
+      client_batch_print(i);
+    }
+  }
+  msg_buf_compact(in);
+  fflush(stdout);
+
+  if (n == 0) {
+    client_stream_end(loop);
+  }
+
+  // the end of input, and all answered
+  if (m_stream_fd < 0 && m_batch.done == m_batch.sent) {
+    client_close(loop, c);
+    client_batch_report();
+    return;
+  }
+  client_stream_send(loop, c);
+}
+
+/* turf -H batch --stream, one connection for all the lines of input,
+ *  the requests are pipelined, and the results are printed once answered.
+ */
+static int client_batch(tf_cli* cli);
+static int client_stream(tf_cli* cli) {
+  struct stat st;
+  int fd = STDIN_FILENO;
+
+  if (cli->batch_path) {
+    fd = open(cli->batch_path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+      error("open %s failed", cli->batch_path);
+      return -1;
+    }
+  }
+
+  // a file is all there, one round trip
+  if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode)) {
+    if (fd != STDIN_FILENO) {
+      close(fd);
+    }
+    cli->has.stream = 0;
+    return client_batch(cli);
+  }
+
+  m_stream_flags = fcntl(fd, F_GETFL);
+  fcntl(fd, F_SETFL, m_stream_flags | O_NONBLOCK);
+  if (sck_create_event(loop, fd, SCK_READ, client_stream_on_read, NULL)) {
+    error("register event failed.");
+    if (fd != STDIN_FILENO) {
+      close(fd);
+    }
+    return -1;
+  }
+  m_stream_fd = fd;
+
+  return client_connect(cli);
+}
+
+// turf -H batch, all requests go in one write.
+static int client_batch(tf_cli* cli) {
+  int rc = 0;
+  char* line = NULL;
+  size_t size = 0;
+  ssize_t len;
+  FILE* fp = stdin;
+
+  if (cli->has.stream) {
+    return client_stream(cli);
+  }
+
+  if (cli->batch_path) {
+    fp = fopen(cli->batch_path, "r");
+    if (!fp) {
+      error("open %s failed", cli->batch_path);
+      return -1;
+    }
+  }
+
+  while ((len = getline(&line, &size, fp)) > 0) {
+    if (line[len - 1] == '\n') {
+      line[len - 1] = 0;
+    }
+
+    rc = client_batch_line(line);
+    if (rc < 0) {
+      break;
+    }
+  }
+
+  free(line);
+  if (fp != stdin) {
+    fclose(fp);
+  }
+
+  if (rc == 0 && m_batch.sent > 0) {
+    return client_connect(cli);
+  }
+
+  // nothing to send
+  client_batch_report();
+  return rc;
+}
+
 static int client_action(tf_cli* cli) {
   int rc = 0;
+  if (cli->cmd == TURF_CLI_BATCH) {
+    return client_batch(cli);
+  }
+
   if (cli->cmd == TURF_CLI_RUN) {
     cli->cmd = TURF_CLI_CREATE;
     rc = tf_action(cli);
     if (rc) return rc;
     cli->cmd = TURF_CLI_RUN;
   }
+
+  rc = msg_enc_cli(&m_client.wbuf, 1, cli);
+  if (rc < 0) {
+    error("encode request failed.%d", errno);
+    return rc;
+  }
   return client_connect(cli);
 }
 
@@ -466,5 +1135,5 @@ int main(int argc, char* argv[]) {
 
   dprint("loop dead, turf exiting ...");
 
-  return 0;
+  return m_client_rc;
 }
@@ -0,0 +1,259 @@
+/* open addressing hash table
+ */
+
+#include "hmap.h"
+
+// splitmix64 finalizer, spread sequential ids and pids.
+static uint64_t hmap_hash_int(uint64_t key) {
+  uint64_t h = key;
+  h = (h ^ (h >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  h = (h ^ (h >> 27)) * 0x94d049bb133111ebULL;
+  h = h ^ (h >> 31);
+  return h < 2 ? h + 2 : h;
+}
+
+// FNV-1a 64
+static uint64_t hmap_hash_str(const char* key) {
+  uint64_t h = 0xcbf29ce484222325ULL;
+  while (*key) {
+    h ^= (uint8_t)*key++;
+    h *= 0x100000001b3ULL;
+  }
+  return h < 2 ? h + 2 : h;
+}
+
+static bool hmap_match(struct hmap_slot* s,
+                       uint64_t hash,
+                       uint64_t key,
+                       const char* skey) {
+  if (s->hash != hash) {
+    return 0;
+  }
+  if (skey) {
+    return s->skey && strcmp(s->skey, skey) == 0;
+  }
+  return !s->skey && s->key == key;
+}
+
+// return the slot holds the key, or NULL
+static struct hmap_slot* hmap_lookup(tf_hmap* m,
+                                     uint64_t hash,
+                                     uint64_t key,
+                                     const char* skey) {
+  size_t mask = m->_setsize - 1;
+  size_t i = hash & mask;
+
+  if (!m->slots) {
+    return NULL;
+  }
+
+  while (1) {
+    struct hmap_slot* s = &m->slots[i];
+    if (s->hash == HMAP_SLOT_EMPTY) {
+      return NULL;
+    }
+    if (hmap_match(s, hash, key, skey)) {
+      return s;
+    }
+    i = (i + 1) & mask;
+  }
+}
+
+tf_hmap _API* hmap_new(size_t init_size) {
+  int rc;
+  tf_hmap* m = (tf_hmap*)calloc(1, sizeof(tf_hmap));
+  if (!m) {
+    set_errno(ENOMEM);
+    return NULL;
+  }
+
+  m->_magic = TF_HMAP_MAGIC;
+
+  rc = hmap_resize(m, init_size);
+  if (rc < 0) {
+    hmap_free(m);
+    return NULL;
+  }
+
+  return m;
+}
+
+void _API hmap_free(tf_hmap* m) {
+  if (!m || BAD_MAGIC(m->_magic, TF_HMAP_MAGIC)) {
+    set_errno(EINVAL);
+    return;
+  }
+
+  if (m->slots) {
+    free(m->slots);
+    m->slots = NULL;
+  }
+
+  m->_magic = 0;
+  free(m);
+}
+
+// rehash all live entries into a table which fits new_size entries.
+int _API hmap_resize(tf_hmap* m, size_t new_size) {
+  size_t i;
+  size_t setsize = TF_HMAP_MIN_SIZE;
+
+  if (!m || BAD_MAGIC(m->_magic, TF_HMAP_MAGIC) || new_size < m->size) {
+    set_errno(EINVAL);
+    return -1;
+  }
+
+  // keep load factor under 3/4
+  while (setsize * 3 < new_size * 4) {
+    setsize <<= 1;
+  }
+
+  struct hmap_slot* slots =
+      (struct hmap_slot*)calloc(setsize, sizeof(struct hmap_slot));
+  if (!slots) {
+    set_errno(ENOMEM);
+    return -1;
+  }
+
+  for (i = 0; i < m->_setsize; i++) {
+    struct hmap_slot* s = &m->slots[i];
+    if (s->hash < 2) {  // empty or tomb
+      continue;
+    }
+
+    size_t j = s->hash & (setsize - 1);
+    while (slots[j].hash != HMAP_SLOT_EMPTY) {
+      j = (j + 1) & (setsize - 1);
+    }
+    slots[j] = *s;
+  }
+
+  if (m->slots) {
+    free(m->slots);
+  }
+  m->slots = slots;
+  m->_setsize = setsize;
+  m->_used = m->size;
+  return 0;
+}
+
+static int hmap_insert(tf_hmap* m,
+                       uint64_t hash,
+                       uint64_t key,
+                       const char* skey,
+                       void* val) {
+  int rc;
+
+  if (!m || BAD_MAGIC(m->_magic, TF_HMAP_MAGIC) || !val) {
+    set_errno(EINVAL);
+    return -1;
+  }
+
+  // replace
+  struct hmap_slot* s = hmap_lookup(m, hash, key, skey);
+  if (s) {
+    s->skey = skey;
+    s->val = val;
+    return 0;
+  }
+
+  // check space, tombstones are dropped while rehashing
+  if ((m->_used + 1) * 4 > m->_setsize * 3) {
+    rc = hmap_resize(m, (m->size + 1) * 2);
+    if (rc < 0) {
+      return -1;
+    }
+  }
+
+  size_t mask = m->_setsize - 1;
+  size_t i = hash & mask;
+  while (m->slots[i].hash >= 2) {
+    i = (i + 1) & mask;
+  }
+
+  s = &m->slots[i];
+  if (s->hash == HMAP_SLOT_EMPTY) {
+    m->_used++;
+  }
+  s->hash = hash;
+  s->key = key;
+  s->skey = skey;
+  s->val = val;
+  m->size++;
+  return 0;
+}
+
+static void* hmap_find(tf_hmap* m,
+                       uint64_t hash,
+                       uint64_t key,
+                       const char* skey) {
+  if (!m || BAD_MAGIC(m->_magic, TF_HMAP_MAGIC)) {
+    set_errno(EINVAL);
+    return NULL;
+  }
+
+  struct hmap_slot* s = hmap_lookup(m, hash, key, skey);
+  if (!s) {
+    set_errno(ENOENT);
+    return NULL;
+  }
+  return s->val;
+}
+
+static int hmap_remove(tf_hmap* m,
+                       uint64_t hash,
+                       uint64_t key,
+                       const char* skey) {
+  if (!m || BAD_MAGIC(m->_magic, TF_HMAP_MAGIC)) {
+    set_errno(EINVAL);
+    return -1;
+  }
+
+  struct hmap_slot* s = hmap_lookup(m, hash, key, skey);
+  if (!s) {
+    set_errno(ENOENT);
+    return -1;
+  }
+
+  s->hash = HMAP_SLOT_TOMB;
+  s->skey = NULL;
+  s->val = NULL;
+  m->size--;
+  return 0;
+}
+
+int _API hmap_put(tf_hmap* m, uint64_t key, void* val) {
+  return hmap_insert(m, hmap_hash_int(key), key, NULL, val);
+}
+
+void _API* hmap_get(tf_hmap* m, uint64_t key) {
+  return hmap_find(m, hmap_hash_int(key), key, NULL);
+}
+
+int _API hmap_del(tf_hmap* m, uint64_t key) {
+  return hmap_remove(m, hmap_hash_int(key), key, NULL);
+}
+
+int _API hmap_sput(tf_hmap* m, const char* key, void* val) {
+  if (!key) {
+    set_errno(EINVAL);
+    return -1;
+  }
+  return hmap_insert(m, hmap_hash_str(key), 0, key, val);
+}
+
+void _API* hmap_sget(tf_hmap* m, const char* key) {
+  if (!key) {
+    set_errno(EINVAL);
+    return NULL;
+  }
+  return hmap_find(m, hmap_hash_str(key), 0, key);
+}
+
+int _API hmap_sdel(tf_hmap* m, const char* key) {
+  if (!key) {
+    set_errno(EINVAL);
+    return -1;
+  }
+  return hmap_remove(m, hmap_hash_str(key), 0, key);
+}
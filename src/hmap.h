@@ -0,0 +1,55 @@
+#ifndef _TURF_HMAP_H_
+#define _TURF_HMAP_H_
+
+#include "misc.h"
+
+/* open addressing hash table (linear probing),
+ * keyed by uint64_t or by string, the values must not be NULL.
+ */
+
+#define TF_HMAP_MAGIC DEF_MAGIC('H', 'M', 'A', 'P')
+
+// the minium slots a table holds
+#define TF_HMAP_MIN_SIZE (16)
+
+// slot hash values, real hashes never fall into these
+#define HMAP_SLOT_EMPTY 0
+#define HMAP_SLOT_TOMB 1
+
+struct hmap_slot {
+  uint64_t hash;     // cached hash, or HMAP_SLOT_XXX
+  uint64_t key;      // integer key
+  const char* skey;  // string key, not owned by the table
+  void* val;         // user value
+};
+
+// hash table obj
+struct tf_hmap {
+  uint32_t _magic;  // TF_HMAP_MAGIC
+  size_t _setsize;  // total slots, power of 2
+  size_t _used;     // live and tombstone slots
+  size_t size;      // live entries
+  struct hmap_slot* slots;
+};
+typedef struct tf_hmap tf_hmap;
+
+// create a blank table
+tf_hmap _API* hmap_new(size_t init_size);
+
+// free the table (values are not touched)
+void _API hmap_free(tf_hmap* m);
+
+// resize storage to hold at least new_size entries
+int _API hmap_resize(tf_hmap* m, size_t new_size);
+
+// integer keyed ops
+int _API hmap_put(tf_hmap* m, uint64_t key, void* val);
+void _API* hmap_get(tf_hmap* m, uint64_t key);
+int _API hmap_del(tf_hmap* m, uint64_t key);
+
+// string keyed ops, the key string should live as long as the entry
+int _API hmap_sput(tf_hmap* m, const char* key, void* val);
+void _API* hmap_sget(tf_hmap* m, const char* key);
+int _API hmap_sdel(tf_hmap* m, const char* key);
+
+#endif  // _TURF_HMAP_H_
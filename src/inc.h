@@ -7,23 +7,24 @@
 #endif
 
 // POSIX headers
-// #include <inttypes.h>       // strtoumax()
-#include <assert.h>   // assert()
-#include <dirent.h>   // opendir(), readdir() ...
-#include <dlfcn.h>    // dlopen()
-#include <errno.h>    // errno
-#include <fcntl.h>    // open(), fcntl() ...
-#include <getopt.h>   // getopt_long()
-#include <sched.h>    // sched_yield()
-#include <signal.h>   // signal(), kill() ...
-#include <stdarg.h>   // va_arg(), va_start() ...
-#include <stdbool.h>  // bool
-#include <stdint.h>   // uint32_t, uint8_t ...
-#include <stdio.h>    // fopen(), printf(),  ...
-#include <stdlib.h>   // malloc(), getenv(), abort() ...
-#include <string.h>   // memcpy(), strdup(), strcmp() ...
-#include <time.h>     // clock_gettime()
-#include <unistd.h>   // fork(), access(), read() ...
+#include <assert.h>    // assert()
+#include <ctype.h>     // isspace()
+#include <dirent.h>    // opendir(), readdir() ...
+#include <dlfcn.h>     // dlopen()
+#include <errno.h>     // errno
+#include <fcntl.h>     // open(), fcntl() ...
+#include <getopt.h>    // getopt_long()
+#include <inttypes.h>  // PRIu64, strtoumax()
+#include <sched.h>     // sched_yield()
+#include <signal.h>    // signal(), kill() ...
+#include <stdarg.h>    // va_arg(), va_start() ...
+#include <stdbool.h>   // bool
+#include <stdint.h>    // uint32_t, uint8_t ...
+#include <stdio.h>     // fopen(), printf(),  ...
+#include <stdlib.h>    // malloc(), getenv(), abort() ...
+#include <string.h>    // memcpy(), strdup(), strcmp() ...
+#include <time.h>      // clock_gettime()
+#include <unistd.h>    // fork(), access(), read() ...
 
 #include <sys/mount.h>  // mount()
 #include <sys/stat.h>   // stat(), fstat(), lstat() ...
@@ -0,0 +1,456 @@
+/* raw deflate decoder
+ */
+
+#include "inflate.h"
+
+#define IFL_WINDOW (32 * 1024)     // max distance of a match
+#define IFL_BUF_SIZE (256 * 1024)  // output buffer, the window included
+#define IFL_MAX_BITS (15)          // max code length
+#define IFL_FAST_BITS (10)         // codes decoded by one lookup
+#define IFL_MAX_LCODES (286)       // literal/length codes
+#define IFL_MAX_DCODES (30)        // distance codes
+#define IFL_FIX_LCODES (288)       // literal/length codes of fixed block
+#define IFL_MAX_MATCH (258)        // longest match
+
+// canonical huffman code
+struct ifl_huff {
+  uint16_t count[IFL_MAX_BITS + 1];   // codes of each length
+  uint16_t symbol[IFL_FIX_LCODES];    // symbols in code order
+  uint16_t fast[1 << IFL_FAST_BITS];  // symbol << 4 | length, 0 if longer
+};
+
+struct ifl_state {
+  const uint8_t* in;
+  const uint8_t* end;
+  uint64_t hold;  // bits not taken yet
+  int bits;       // bits in hold
+
+  uint8_t* out;    // IFL_BUF_SIZE
+  size_t pos;      // next byte to out
+  size_t flushed;  // out[0, flushed) is in sink
+  int64_t total;   // bytes to sink
+  ifl_sink_fn sink;
+  void* arg;
+
+  struct ifl_huff lcode;
+  struct ifl_huff dcode;
+};
+
+static inline void ifl_fill(struct ifl_state* s) {
+  while (s->bits <= 56 && s->in < s->end) {
+    s->hold |= (uint64_t)*s->in++ << s->bits;
+    s->bits += 8;
+  }
+}
+
+// take n bits, -1 if run out
+static inline int ifl_bits(struct ifl_state* s, int n) {
+  if (s->bits < n) {
+    ifl_fill(s);
+    if (s->bits < n) {
+      return -1;
+    }
+  }
+
+  int v = (int)(s->hold & ((1ULL << n) - 1));
+  s->hold >>= n;
+  s->bits -= n;
+  return v;
+}
+
+// code in len bits, in the order of the stream
+static inline int ifl_reverse(int code, int len) {
+  int r = 0;
+  while (len--) {
+    r = (r << 1) | (code & 1);
+    code >>= 1;
+  }
+  return r;
+}
+
+// build the code from the lengths, -1 if over subscribed.
+static int ifl_build(struct ifl_huff* h, const uint8_t* length, int n) {
+  int i, k, sym, len, left;
+  uint16_t offs[IFL_MAX_BITS + 1];
+
+  memset(h->count, 0, sizeof(h->count));
+  memset(h->fast, 0, sizeof(h->fast));
+  for (sym = 0; sym < n; sym++) {
+    h->count[length[sym]]++;
+  }
+  if (h->count[0] == n) {  // no codes, nothing could be decoded
+    return 0;
+  }
+
+  left = 1;
+  for (len = 1; len <= IFL_MAX_BITS; len++) {
+    left <<= 1;
+    left -= h->count[len];
+    if (left < 0) {
+      return -1;
+    }
+  }
+
+  offs[1] = 0;
+  for (len = 1; len < IFL_MAX_BITS; len++) {
+    offs[len + 1] = offs[len] + h->count[len];
+  }
+  for (sym = 0; sym < n; sym++) {
+    if (length[sym]) {
+      h->symbol[offs[length[sym]]++] = sym;
+    }
+  }
+
+  // the short codes are looked up by the next bits
+  int code = 0;
+  int idx = 0;
+  for (len = 1; len <= IFL_FAST_BITS; len++) {
+    for (i = 0; i < h->count[len]; i++, code++, idx++) {
+      uint16_t e = h->symbol[idx] << 4 | len;
+      for (k = ifl_reverse(code, len); k < (1 << IFL_FAST_BITS);
+           k += 1 << len) {
+        h->fast[k] = e;
+      }
+    }
+    code <<= 1;
+  }
+  return 0;
+}
+
+// decode the long codes bit by bit
+static int ifl_decode_slow(struct ifl_state* s, const struct ifl_huff* h) {
+  int len;
+  int code = 0, first = 0, index = 0;
+  uint64_t hold = s->hold;
+
+  for (len = 1; len <= IFL_MAX_BITS && len <= s->bits; len++) {
+    code |= hold & 1;
+    hold >>= 1;
+    int count = h->count[len];
+    if (code - count < first) {
+      s->hold >>= len;
+      s->bits -= len;
+      return h->symbol[index + (code - first)];
+    }
+    index += count;
+    first += count;
+    first <<= 1;
+    code <<= 1;
+  }
+  return -1;
+}
+
+static inline int ifl_decode(struct ifl_state* s, const struct ifl_huff* h) {
+  if (s->bits < IFL_MAX_BITS) {
+    ifl_fill(s);
+  }
+
+  uint16_t e = h->fast[s->hold & ((1 << IFL_FAST_BITS) - 1)];
+  if (e && (e & 15) <= s->bits) {
+    s->hold >>= e & 15;
+    s->bits -= e & 15;
+    return e >> 4;
+  }
+  return ifl_decode_slow(s, h);
+}
+
+// hand the output to sink, the window is kept for the matches.
+static int ifl_flush(struct ifl_state* s, bool last) {
+  if (s->pos > s->flushed) {
+    if (s->sink(s->arg, s->out + s->flushed, s->pos - s->flushed) < 0) {
+      return -1;
+    }
+    s->total += s->pos - s->flushed;
+  }
+  if (last) {
+    return 0;
+  }
+
+  size_t keep = s->pos < IFL_WINDOW ? s->pos : IFL_WINDOW;
+  memmove(s->out, s->out + s->pos - keep, keep);
+  s->pos = s->flushed = keep;
+  return 0;
+}
+
+static int ifl_stored(struct ifl_state* s) {
+  // to the byte boundary
+  s->hold >>= s->bits & 7;
+  s->bits -= s->bits & 7;
+
+  int len = ifl_bits(s, 16);
+  int nlen = ifl_bits(s, 16);
+  if (len < 0 || nlen < 0 || len != (~nlen & 0xffff)) {
+    set_errno(EBADMSG);
+    return -1;
+  }
+
+  // the bytes in hold first, then straight from the input
+  while (len > 0 && s->bits >= 8) {
+    if (s->pos == IFL_BUF_SIZE && ifl_flush(s, 0) < 0) {
+      return -1;
+    }
+    s->out[s->pos++] = s->hold & 0xff;
+    s->hold >>= 8;
+    s->bits -= 8;
+    len--;
+  }
+
+  if (s->end - s->in < len) {
+    set_errno(EBADMSG);
+    return -1;
+  }
+  while (len > 0) {
+    if (s->pos == IFL_BUF_SIZE && ifl_flush(s, 0) < 0) {
+      return -1;
+    }
+    size_t n = IFL_BUF_SIZE - s->pos;
+    n = n < (size_t)len ? n : (size_t)len;
+    memcpy(s->out + s->pos, s->in, n);
+    s->in += n;
+    s->pos += n;
+    len -= n;
+  }
+  return 0;
+}
+
+// decode the literals and matches of a block
+static int ifl_codes(struct ifl_state* s) {
+  static const uint16_t lbase[29] = {
+      3,  4,  5,  6,  7,  8,  9,  10, 11,  13,  15,  17,  19,  23, 27,
+      31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258};
+  static const uint8_t lext[29] = {0, 0, 0, 0, 0, 0, 0, 0, 1, 1,
+                                   1, 1, 2, 2, 2, 2, 3, 3, 3, 3,
+                                   4, 4, 4, 4, 5, 5, 5, 5, 0};
+  static const uint16_t dbase[30] = {
+      1,    2,    3,    4,    5,    7,    9,    13,    17,    25,
+      33,   49,   65,   97,   129,  193,  257,  385,   513,   769,
+      1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577};
+  static const uint8_t dext[30] = {0, 0, 0,  0,  1,  1,  2,  2,  3,  3,
+                                   4, 4, 5,  5,  6,  6,  7,  7,  8,  8,
+                                   9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
+
+  while (1) {
+    // room for the longest match
+    if (s->pos + IFL_MAX_MATCH > IFL_BUF_SIZE && ifl_flush(s, 0) < 0) {
+      return -1;
+    }
+
+    int sym = ifl_decode(s, &s->lcode);
+    if (sym < 0) {
+      goto bad;
+    }
+    if (sym < 256) {
+      s->out[s->pos++] = sym;
+      continue;
+    }
+    if (sym == 256) {  // end of block
+      return 0;
+    }
+
+    sym -= 257;
+    if (sym >= 29) {
+      goto bad;
+    }
+    int ext = ifl_bits(s, lext[sym]);
+    if (ext < 0) {
+      goto bad;
+    }
+    size_t len = lbase[sym] + ext;
+
+    sym = ifl_decode(s, &s->dcode);
+    if (sym < 0 || sym >= 30) {
+      goto bad;
+    }
+    ext = ifl_bits(s, dext[sym]);
+    if (ext < 0) {
+      goto bad;
+    }
+    size_t dist = dbase[sym] + ext;
+    if (dist > s->pos) {
+      goto bad;
+    }
+
+    uint8_t* to = s->out + s->pos;
+    const uint8_t* from = to - dist;
+    s->pos += len;
+    if (dist >= len) {
+      memcpy(to, from, len);
+    } else {  // overlapped, repeats the last dist bytes
+      while (len--) {
+        *to++ = *from++;
+      }
+    }
+  }
+
+bad:
+  set_errno(EBADMSG);
+  return -1;
+}
+
+static int ifl_fixed(struct ifl_state* s) {
+  int i;
+  uint8_t lengths[IFL_FIX_LCODES];
+
+  for (i = 0; i < 144; i++) {
+    lengths[i] = 8;
+  }
+  for (; i < 256; i++) {
+    lengths[i] = 9;
+  }
+  for (; i < 280; i++) {
+    lengths[i] = 7;
+  }
+  for (; i < IFL_FIX_LCODES; i++) {
+    lengths[i] = 8;
+  }
+  ifl_build(&s->lcode, lengths, IFL_FIX_LCODES);
+
+  for (i = 0; i < IFL_MAX_DCODES; i++) {
+    lengths[i] = 5;
+  }
+  ifl_build(&s->dcode, lengths, IFL_MAX_DCODES);
+  return ifl_codes(s);
+}
+
+static int ifl_dynamic(struct ifl_state* s) {
+  static const uint8_t order[19] = {
+      16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15};
+  int i;
+  uint8_t lengths[IFL_MAX_LCODES + IFL_MAX_DCODES];
+
+  int nlen = ifl_bits(s, 5) + 257;
+  int ndist = ifl_bits(s, 5) + 1;
+  int ncode = ifl_bits(s, 4) + 4;
+  if (nlen < 257 || ndist < 1 || ncode < 4 || nlen > IFL_MAX_LCODES ||
+      ndist > IFL_MAX_DCODES) {
+    goto bad;
+  }
+
+  // the code of the code lengths
+  memset(lengths, 0, 19);
+  for (i = 0; i < ncode; i++) {
+    int len = ifl_bits(s, 3);
+    if (len < 0) {
+      goto bad;
+    }
+    lengths[order[i]] = len;
+  }
+  if (ifl_build(&s->lcode, lengths, 19) < 0) {
+    goto bad;
+  }
+
+  i = 0;
+  while (i < nlen + ndist) {
+    int sym = ifl_decode(s, &s->lcode);
+    if (sym < 0) {
+      goto bad;
+    }
+    if (sym < 16) {
+      lengths[i++] = sym;
+      continue;
+    }
+
+    int len = 0;
+    int ext, rep;
+    if (sym == 16) {  // repeats the last length
+      if (i == 0) {
+        goto bad;
+      }
+      len = lengths[i - 1];
+      ext = ifl_bits(s, 2);
+      rep = 3 + ext;
+    } else if (sym == 17) {  // zeros
+      ext = ifl_bits(s, 3);
+      rep = 3 + ext;
+    } else {
+      ext = ifl_bits(s, 7);
+      rep = 11 + ext;
+    }
+    if (ext < 0 || i + rep > nlen + ndist) {
+      goto bad;
+    }
+    while (rep--) {
+      lengths[i++] = len;
+    }
+  }
+
+  // no end of block
+  if (lengths[256] == 0) {
+    goto bad;
+  }
+  if (ifl_build(&s->lcode, lengths, nlen) < 0 ||
+      ifl_build(&s->dcode, lengths + nlen, ndist) < 0) {
+    goto bad;
+  }
+  return ifl_codes(s);
+
+bad:
+  set_errno(EBADMSG);
+  return -1;
+}
+
+int64_t _API ifl_inflate(const void* in,
+                         size_t size,
+                         ifl_sink_fn sink,
+                         void* arg) {
+  int rc = -1;
+  int64_t total = -1;
+  int last;
+
+  if ((!in && size) || !sink) {
+    set_errno(EINVAL);
+    return -1;
+  }
+
+  struct ifl_state* s = (struct ifl_state*)calloc(1, sizeof(*s));
+  if (!s) {
+    set_errno(ENOMEM);
+    return -1;
+  }
+  s->out = (uint8_t*)malloc(IFL_BUF_SIZE);
+  if (!s->out) {
+    set_errno(ENOMEM);
+    goto exit;
+  }
+  s->in = (const uint8_t*)in;
+  s->end = s->in + size;
+  s->sink = sink;
+  s->arg = arg;
+
+  do {
+    last = ifl_bits(s, 1);
+    int type = ifl_bits(s, 2);
+    if (last < 0 || type < 0) {
+      set_errno(EBADMSG);
+      goto exit;
+    }
+
+    switch (type) {
+      case 0:
+        rc = ifl_stored(s);
+        break;
+      case 1:
+        rc = ifl_fixed(s);
+        break;
+      case 2:
+        rc = ifl_dynamic(s);
+        break;
+      default:
+        set_errno(EBADMSG);
+        rc = -1;
+    }
+    if (rc < 0) {
+      goto exit;
+    }
+  } while (!last);
+
+  if (ifl_flush(s, 1) < 0) {
+    goto exit;
+  }
+  total = s->total;
+
+exit:
+  free(s->out);
+  free(s);
+  return total;
+}
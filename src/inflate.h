@@ -0,0 +1,19 @@
+#ifndef _TURF_INFLATE_H_
+#define _TURF_INFLATE_H_
+
+#include "misc.h"
+
+/* raw deflate (RFC 1951) decoder, the output is handed to a sink in pieces
+ *  through a sliding window, the whole stream is never held in memory.
+ */
+
+// takes a piece of the output, returns < 0 to stop.
+typedef int (*ifl_sink_fn)(void* arg, const void* buf, size_t size);
+
+// inflate in to sink, return the bytes out, or -1 (EBADMSG if corrupted).
+int64_t _API ifl_inflate(const void* in,
+                         size_t size,
+                         ifl_sink_fn sink,
+                         void* arg);
+
+#endif  // _TURF_INFLATE_H_
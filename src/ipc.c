@@ -1,7 +1,20 @@
 
 #define _GNU_SOURCE
 #include "ipc.h"
-#include <string.h>  // strdup()
+#include <string.h>   // strdup()
+#include <sys/uio.h>  // readv()
+
+static int m_csum = TIPC_CSUM_CRC32;  // of the msgs encoded
+
+static uint32_t tipc_csum_update(int csum,
+                                 uint32_t crc,
+                                 const void* buf,
+                                 size_t size) {
+  if (csum == TIPC_CSUM_CRC32C) {
+    return crc32c_update(crc, buf, size);
+  }
+  return crc32_update(crc, buf, size);
+}
 
 /*
  * DON'T use MSG macros outside the ipc.c source.
@@ -66,16 +79,20 @@
   _left -= sizeof(struct tipc_hdr);                                            \
   _hdr->magic = TIPC_HDR_MAGIC;                                                \
   _hdr->type = (t);                                                            \
-  _hdr->padding = 0;                                                           \
+  _hdr->csum = m_csum;                                                         \
   _hdr->length = 0;                                                            \
   _hdr->checksum = 0;
 
-// calc crc32 value for mas, include the header but skip magic and checksum.
-#define _MSG_CRC() crc32(&_hdr->type, (_hdr->length - 12))
+// calc checksum for msg, include the header but skip magic and checksum.
+#define _MSG_CRC()                                                             \
+  tipc_csum_update(_hdr->csum, 0, &_hdr->type, (_hdr->length - 12))
 
 // update msg header (length and checksum)
 #define CALC_HDR()                                                             \
   _VA_ENC();                                                                   \
+  if (_cur - _start > TIPC_MSG_MAX_SIZE) {                                     \
+    _ERROR_BREAK(EMSGSIZE);                                                    \
+  }                                                                            \
   _hdr->length = (_cur - _start);                                              \
   _hdr->checksum = _MSG_CRC();
 
@@ -85,7 +102,7 @@
   struct tipc_hdr* _hdr = (struct tipc_hdr*)_cur;                              \
   _cur += sizeof(struct tipc_hdr);                                             \
   _left -= sizeof(struct tipc_hdr);                                            \
-  if (_hdr->checksum != _MSG_CRC()) {                                          \
+  if (_hdr->csum >= TIPC_CSUM_MAX || _hdr->checksum != _MSG_CRC()) {           \
     _ERROR_BREAK(EBADMSG);                                                     \
   }
 
@@ -136,14 +153,14 @@
     if (_has) {                                                                \
       size_t _l = strlen(x) + 1;                                               \
       _CHECK_SIZE((_l));                                                       \
-      strcpy(_cur, x);                                                         \
+      memcpy(_cur, x, _l);                                                     \
       _cur += _l;                                                              \
       _left -= _l;                                                             \
     }                                                                          \
   }
 
-// get string from buffer, terminated with '\0'
-#define GET_STR(x)                                                             \
+// get string from buffer, terminated with '\0', into arena (a) or the heap
+#define GET_STR(x, a)                                                          \
   {                                                                            \
     int _has = 0;                                                              \
     GET_1(_has);                                                               \
@@ -151,12 +168,40 @@
       _VA_DEC();                                                               \
       size_t _l = strlen(_cur) + 1;                                            \
       _CHECK_SIZE((_l));                                                       \
-      x = strdup(_cur);                                                        \
+      x = arn_strdup((a), _cur);                                               \
       _cur += _l;                                                              \
       _left -= _l;                                                             \
     }                                                                          \
   }
 
+// put realm (r) by the static encoder fn, see tipc_put_cfg()
+#define PUT_BY(fn, r)                                                          \
+  {                                                                            \
+    _VA_ENC();                                                                 \
+    int _n = fn(_cur, _left, (r));                                             \
+    if (_n < 0) {                                                              \
+      _ERROR_BREAK(EMSGSIZE);                                                  \
+    }                                                                          \
+    _cur += _n;                                                                \
+    _left -= _n;                                                               \
+  }
+
+// get realm (r) by the static decoder fn, see tipc_get_cfg()
+#define GET_BY(fn, r)                                                          \
+  {                                                                            \
+    _VA_DEC();                                                                 \
+    int _n = fn((r), _cur, _left);                                             \
+    if (_n < 0) {                                                              \
+      _ERROR_BREAK(EBADMSG);                                                   \
+    }                                                                          \
+    _cur += _n;                                                                \
+    _left -= _n;                                                               \
+  }
+
+// the cfg of realm (r)
+#define PUT_CFG(r) PUT_BY(tipc_put_cfg, r)
+#define GET_CFG(r) GET_BY(tipc_get_cfg, r)
+
 // get MSG_ENC/DEC error code, 0(OK), -1(errno for reason)
 #define MSG_EC() _ec
 
@@ -178,6 +223,22 @@ const char* tipc_msg_type(int type) {
     case TIPC_MSG_FORK_RSP:
       return "fork_rsp";
       break;
+
+    case TIPC_MSG_FORK_REQ_BATCH:
+      return "fork_req_batch";
+      break;
+
+    case TIPC_MSG_FORK_RSP_BATCH:
+      return "fork_rsp_batch";
+      break;
+
+    case TIPC_MSG_FORK_TMPL:
+      return "fork_tmpl";
+      break;
+
+    case TIPC_MSG_FORK_DELTA:
+      return "fork_delta";
+      break;
   }
 
   return "unknown";
@@ -185,23 +246,55 @@ const char* tipc_msg_type(int type) {
 
 #define HDR_LEN (sizeof(struct tipc_hdr))
 
+int _API tipc_set_csum(int csum) {
+  if (csum < 0 || csum >= TIPC_CSUM_MAX) {
+    set_errno(EINVAL);
+    return -1;
+  }
+
+  int last = m_csum;
+  m_csum = csum;
+  return last;
+}
+
+// read nsize bytes, the rest of a msg is on the way.
+static int tipc_read_full(int fd, char* buff, size_t nsize) {
+  size_t got = 0;
+
+  while (got < nsize) {
+    ssize_t rc = read(fd, buff + got, nsize - got);
+    if (rc < 0 && (errno == EINTR || (got > 0 && errno == EAGAIN))) {
+      continue;
+    }
+    if (rc < 0) {
+      return -1;
+    }
+    if (rc == 0) {
+      set_errno(EPIPE);
+      return -1;
+    }
+    got += rc;
+  }
+  return got;
+}
+
 int _API tipc_read(int fd, TIPC_DecodeCB* cb, void* data) {
-  char msg[4096];
+  char msg[TIPC_MSG_MAX_SIZE];
   struct tipc_hdr* hdr = (struct tipc_hdr*)msg;
   int rc;
-  rc = read(fd, msg, HDR_LEN);
+  rc = tipc_read_full(fd, msg, HDR_LEN);
   if (rc < 0) {
     return rc;
   }
   info("%s rc=%d", __func__, rc);
 
-  if (hdr->magic != TIPC_HDR_MAGIC) {
+  if (hdr->magic != TIPC_HDR_MAGIC || hdr->length < HDR_LEN) {
     set_errno(EBADMSG);
     error("IPC: codec error %d in %s:%d", errno, __func__, __LINE__);
     return -1;
   }
 
-  rc = read(fd, msg + HDR_LEN, hdr->length - HDR_LEN);
+  rc = tipc_read_full(fd, msg + HDR_LEN, hdr->length - HDR_LEN);
   if (rc < 0) {
     return rc;
   }
@@ -209,6 +302,142 @@ int _API tipc_read(int fd, TIPC_DecodeCB* cb, void* data) {
   return tipc_decode(msg, hdr->length, cb, data);
 }
 
+#define RING_MASK (TIPC_EP_RING_SIZE - 1)
+
+void _API tipc_ep_init(struct tipc_ep* ep, int fd) {
+  memset(ep, 0, sizeof(struct tipc_ep));
+  ep->fd = fd;
+}
+
+void _API tipc_ep_free(struct tipc_ep* ep) {
+  if (!ep) {
+    return;
+  }
+  free(ep->ring);
+  free(ep->frame);
+  tipc_ep_init(ep, -1);
+}
+
+// copy size bytes at the read position out, the ring may wrap.
+static void tipc_ep_copy(struct tipc_ep* ep, char* dest, size_t size) {
+  size_t off = ep->rd & RING_MASK;
+  size_t first = TIPC_EP_RING_SIZE - off;
+
+  if (first >= size) {
+    memcpy(dest, ep->ring + off, size);
+  } else {
+    memcpy(dest, ep->ring + off, first);
+    memcpy(dest + first, ep->ring, size - first);
+  }
+}
+
+/* the msg at the read position,
+ *  return its length if whole, 0 if needs more bytes, or -1 if broken.
+ */
+static int tipc_ep_peek(struct tipc_ep* ep, char** msg) {
+  struct tipc_hdr hdr;
+  size_t avail = ep->wr - ep->rd;
+
+  if (avail < HDR_LEN) {
+    return 0;
+  }
+
+  tipc_ep_copy(ep, (char*)&hdr, HDR_LEN);
+  if (hdr.magic != TIPC_HDR_MAGIC || hdr.length < HDR_LEN) {
+    set_errno(EBADMSG);
+    error("IPC: codec error %d in %s:%d", errno, __func__, __LINE__);
+    return -1;
+  }
+  if (avail < hdr.length) {
+    return 0;
+  }
+
+  size_t off = ep->rd & RING_MASK;
+  if (off + hdr.length <= TIPC_EP_RING_SIZE) {
+    *msg = ep->ring + off;
+    return hdr.length;
+  }
+
+  if (!ep->frame) {
+    ep->frame = (char*)malloc(TIPC_MSG_MAX_SIZE);
+    if (!ep->frame) {
+      set_errno(ENOMEM);
+      return -1;
+    }
+  }
+  tipc_ep_copy(ep, ep->frame, hdr.length);
+  *msg = ep->frame;
+  return hdr.length;
+}
+
+int _API tipc_ep_read(struct tipc_ep* ep, TIPC_DecodeCB* cb, void* data) {
+  bool got = 0;
+  int n = 0;
+
+  if (!ep || !cb) {
+    set_errno(EINVAL);
+    return -1;
+  }
+
+  if (!ep->ring) {
+    ep->ring = (char*)malloc(TIPC_EP_RING_SIZE);
+    if (!ep->ring) {
+      set_errno(ENOMEM);
+      return -1;
+    }
+  }
+
+  while (1) {
+    // the whole ones first, no read if any
+    char* msg;
+    int size;
+    while ((size = tipc_ep_peek(ep, &msg)) > 0) {
+      ep->rd += size;
+      n++;
+      int rc = tipc_decode(msg, size, cb, data);
+      if (rc < 0) {
+        return rc;
+      }
+    }
+    if (size < 0) {
+      return -1;
+    }
+    if (n > 0) {
+      return n;
+    }
+
+    // free space, at most two pieces
+    size_t len = TIPC_EP_RING_SIZE - (ep->wr - ep->rd);
+    size_t off = ep->wr & RING_MASK;
+    struct iovec iov[2];
+    iov[0].iov_base = ep->ring + off;
+    iov[0].iov_len = MIN(len, TIPC_EP_RING_SIZE - off);
+    iov[1].iov_base = ep->ring;
+    iov[1].iov_len = len - iov[0].iov_len;
+
+    ssize_t l = readv(ep->fd, iov, iov[1].iov_len ? 2 : 1);
+    if (l < 0 && errno == EINTR) {
+      continue;
+    }
+    if (l < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+      if (got) {
+        return 0;  // partial, for the next
+      }
+      set_errno(EAGAIN);
+      return -1;
+    }
+    if (l < 0) {
+      return -1;
+    }
+    if (l == 0) {
+      set_errno(EPIPE);
+      return -1;
+    }
+    ep->wr += l;
+    got = 1;
+  }
+}
+
 int _API tipc_decode(char* buff, size_t nsize, TIPC_DecodeCB* cb, void* data) {
   struct tipc_hdr* msg_hdr;
 
@@ -216,6 +445,11 @@ int _API tipc_decode(char* buff, size_t nsize, TIPC_DecodeCB* cb, void* data) {
     set_errno(EINVAL);
     return -1;
   }
+  // the checksum covers the length in the header, it must be the size
+  if (nsize < HDR_LEN || ((struct tipc_hdr*)buff)->length != nsize) {
+    set_errno(EBADMSG);
+    return -1;
+  }
 
   MSG_DEC(buff, nsize) {
     CHECK_MSG();
@@ -233,8 +467,11 @@ int _API tipc_decode(char* buff, size_t nsize, TIPC_DecodeCB* cb, void* data) {
 
 // seed process informs turfd, he's ready for seed.
 int _API tipc_enc_seed_ready(char* buff, size_t nsize) {
+  uint8_t csums = (1 << TIPC_CSUM_CRC32) | (1 << TIPC_CSUM_CRC32C);
+
   MSG_ENC(buff, nsize) {
     PUT_HDR(TIPC_MSG_SEED_READY);
+    PUT_1(csums);
 
     CALC_HDR();
   }
@@ -242,19 +479,24 @@ int _API tipc_enc_seed_ready(char* buff, size_t nsize) {
   return MSG_LEN();
 }
 
-int _API tipc_dec_seed_ready(char* buff, size_t nsize) {
+int _API tipc_dec_seed_ready(char* buff, size_t nsize, uint32_t* csums) {
+  uint8_t mask = 1 << TIPC_CSUM_CRC32;  // an old seed has no body
+
   MSG_DEC(buff, nsize) {
     CHECK_HDR(TIPC_MSG_SEED_READY);
+    if (MSG_HDR()->length > HDR_LEN) {
+      GET_1(mask);
+    }
+  }
+  if (csums) {
+    *csums = mask;
   }
   return MSG_LEN();
 }
 
-/*
- * the msg used by turfd, send to seed process for clone request.
- */
-int _API tipc_enc_fork_req(char* buff, size_t nsize, struct rlm_t* realm) {
+// the cfg of a realm to fork, without msg header.
+static int tipc_put_cfg(char* buff, size_t nsize, struct rlm_t* realm) {
   MSG_ENC(buff, nsize) {
-    PUT_HDR(TIPC_MSG_FORK_REQ);
     PUT_4(realm->cfg.flags);
     PUT_4(realm->cfg.mode);
 
@@ -282,24 +524,23 @@ int _API tipc_enc_fork_req(char* buff, size_t nsize, struct rlm_t* realm) {
     dprint("stdout: %s, _cur(%p)", realm->cfg.fd_stdout, _cur);
     PUT_STR(realm->cfg.fd_stderr);
     dprint("stderr: %s, _cur(%p)", realm->cfg.fd_stderr, _cur);
-
-    CALC_HDR();
   }
   return MSG_LEN();
 }
 
-int _API tipc_dec_fork_req(struct rlm_t* realm, char* buff, size_t nsize) {
+static int tipc_get_cfg(struct rlm_t* realm, char* buff, size_t nsize) {
+  struct arena* a = realm->cfg.arena;  // the heap if NULL
+
   MSG_DEC(buff, nsize) {
-    CHECK_HDR(TIPC_MSG_FORK_REQ);
     GET_4(realm->cfg.flags);
     GET_4(realm->cfg.mode);
 
     // arguments
     GET_4(realm->cfg.argc);
     if (realm->cfg.argc > 0) {
-      char** argv = (char**)calloc(realm->cfg.argc + 1, sizeof(char*));
+      char** argv = (char**)arn_calloc(a, realm->cfg.argc + 1, sizeof(char*));
       for (int i = 0; i < realm->cfg.argc; i++) {
-        GET_STR(argv[i]);
+        GET_STR(argv[i], a);
       }
       realm->cfg.argv = argv;
     }
@@ -307,30 +548,50 @@ int _API tipc_dec_fork_req(struct rlm_t* realm, char* buff, size_t nsize) {
     int env_size;
     GET_4(env_size);
     if (env_size > 0) {
-      char** env = (char**)calloc(env_size + 1, sizeof(char*));
+      char** env = (char**)arn_calloc(a, env_size + 1, sizeof(char*));
       for (int i = 0; i < env_size; i++) {
-        GET_STR(env[i]);
+        GET_STR(env[i], a);
       }
       realm->cfg.env = env;
     }
 
-    GET_STR(realm->cfg.binary);
-    GET_STR(realm->cfg.name);
+    GET_STR(realm->cfg.binary, a);
+    GET_STR(realm->cfg.name, a);
 
     GET_4(realm->cfg.uid);
     GET_4(realm->cfg.gid);
     warn("uid, gid: %d, %d", realm->cfg.uid, realm->cfg.gid);
 
-    GET_STR(realm->cfg.chroot_dir);
+    GET_STR(realm->cfg.chroot_dir, a);
     dprint("chroot: %s, _cur(%p)", realm->cfg.chroot_dir, _cur);
-    GET_STR(realm->cfg.fd_stdout);
+    GET_STR(realm->cfg.fd_stdout, a);
     dprint("stdout: %s, _cur(%p)", realm->cfg.fd_stdout, _cur);
-    GET_STR(realm->cfg.fd_stderr);
+    GET_STR(realm->cfg.fd_stderr, a);
     dprint("stderr: %s, _cur(%p)", realm->cfg.fd_stderr, _cur);
   }
   return MSG_LEN();
 }
 
+/*
+ * the msg used by turfd, send to seed process for clone request.
+ */
+int _API tipc_enc_fork_req(char* buff, size_t nsize, struct rlm_t* realm) {
+  MSG_ENC(buff, nsize) {
+    PUT_HDR(TIPC_MSG_FORK_REQ);
+    PUT_CFG(realm);
+    CALC_HDR();
+  }
+  return MSG_LEN();
+}
+
+int _API tipc_dec_fork_req(struct rlm_t* realm, char* buff, size_t nsize) {
+  MSG_DEC(buff, nsize) {
+    CHECK_HDR(TIPC_MSG_FORK_REQ);
+    GET_CFG(realm);
+  }
+  return MSG_LEN();
+}
+
 /*
  * the msg is used by seed process informing turfd fork results.
  */
@@ -346,11 +607,468 @@ int _API tipc_enc_fork_rsp(char* buff, size_t nsize, struct rlm_t* realm) {
 }
 
 int _API tipc_dec_fork_rsp(struct rlm_t* realm, char* buff, size_t nsize) {
+  struct arena* a = realm->cfg.arena;  // the heap if NULL
+
   MSG_DEC(buff, nsize) {
     CHECK_HDR(TIPC_MSG_FORK_RSP);
     GET_4(realm->st.child_pid);
-    GET_STR(realm->cfg.name);
+    GET_STR(realm->cfg.name, a);
+  }
+
+  return MSG_LEN();
+}
+
+/*
+ * the batched fork_req, the realms are forked in a row by the seed process.
+ */
+int _API tipc_enc_fork_req_batch(char* buff,
+                                 size_t nsize,
+                                 struct rlm_t** realms,
+                                 int count) {
+  if (count <= 0 || count > TIPC_FORK_BATCH_MAX) {
+    set_errno(EINVAL);
+    return -1;
+  }
+
+  MSG_ENC(buff, nsize) {
+    PUT_HDR(TIPC_MSG_FORK_REQ_BATCH);
+    PUT_4(count);
+    for (int i = 0; i < count; i++) {
+      PUT_CFG(realms[i]);
+    }
+    if (MSG_EC() < 0) {
+      break;
+    }
+    CALC_HDR();
+  }
+  return MSG_LEN();
+}
+
+int _API tipc_dec_fork_req_batch(struct rlm_t* realms,
+                                 int* count,
+                                 char* buff,
+                                 size_t nsize) {
+  int n = 0;
+
+  MSG_DEC(buff, nsize) {
+    CHECK_HDR(TIPC_MSG_FORK_REQ_BATCH);
+    GET_4(n);
+    if (n <= 0 || n > *count) {
+      _ERROR_BREAK(EBADMSG);
+    }
+    for (int i = 0; i < n; i++) {
+      GET_CFG(&realms[i]);
+    }
+  }
+  *count = MSG_EC() < 0 ? 0 : n;
+  return MSG_LEN();
+}
+
+/*
+ * the results of a batched fork_req, in the order of the request.
+ */
+int _API tipc_enc_fork_rsp_batch(char* buff,
+                                 size_t nsize,
+                                 struct rlm_t* realms,
+                                 int count) {
+  if (count <= 0 || count > TIPC_FORK_BATCH_MAX) {
+    set_errno(EINVAL);
+    return -1;
+  }
+
+  MSG_ENC(buff, nsize) {
+    PUT_HDR(TIPC_MSG_FORK_RSP_BATCH);
+    PUT_4(count);
+    for (int i = 0; i < count; i++) {
+      PUT_4(realms[i].st.child_pid);
+      PUT_STR(realms[i].cfg.name);
+    }
+    if (MSG_EC() < 0) {
+      break;
+    }
+    CALC_HDR();
+  }
+  return MSG_LEN();
+}
+
+int _API tipc_dec_fork_rsp_batch(struct rlm_t* realms,
+                                 int* count,
+                                 char* buff,
+                                 size_t nsize) {
+  int n = 0;
+
+  MSG_DEC(buff, nsize) {
+    CHECK_HDR(TIPC_MSG_FORK_RSP_BATCH);
+    GET_4(n);
+    if (n <= 0 || n > *count) {
+      _ERROR_BREAK(EBADMSG);
+    }
+    for (int i = 0; i < n; i++) {
+      GET_4(realms[i].st.child_pid);
+      GET_STR(realms[i].cfg.name, realms[i].cfg.arena);
+    }
+  }
+  *count = MSG_EC() < 0 ? 0 : n;
+  return MSG_LEN();
+}
+
+// the cfg of a template, see tipc_enc_fork_tmpl().
+static int tipc_put_tmpl(char* buff, size_t nsize, struct rlm_t* realm) {
+  MSG_ENC(buff, nsize) {
+    PUT_4(realm->cfg.flags);
+    PUT_4(realm->cfg.mode);
+
+    PUT_4(realm->cfg.argc);
+    for (int i = 0; i < realm->cfg.argc; i++) {
+      PUT_STR(realm->cfg.argv[i]);
+    }
+
+    int env_size = sssize(realm->cfg.env);
+    PUT_4(env_size);
+    for (int i = 0; i < env_size; i++) {
+      PUT_STR(realm->cfg.env[i]);
+    }
+
+    PUT_STR(realm->cfg.binary);
+    PUT_4(realm->cfg.uid);
+    PUT_4(realm->cfg.gid);
+  }
+  return MSG_LEN();
+}
+
+static int tipc_get_tmpl(struct rlm_t* realm, char* buff, size_t nsize) {
+  struct arena* a = realm->cfg.arena;  // the heap if NULL
+
+  MSG_DEC(buff, nsize) {
+    GET_4(realm->cfg.flags);
+    GET_4(realm->cfg.mode);
+
+    GET_4(realm->cfg.argc);
+    if (realm->cfg.argc > 0) {
+      char** argv = (char**)arn_calloc(a, realm->cfg.argc + 1, sizeof(char*));
+      for (int i = 0; i < realm->cfg.argc; i++) {
+        GET_STR(argv[i], a);
+      }
+      realm->cfg.argv = argv;
+    }
+
+    int env_size;
+    GET_4(env_size);
+    if (env_size > 0) {
+      char** env = (char**)arn_calloc(a, env_size + 1, sizeof(char*));
+      for (int i = 0; i < env_size; i++) {
+        GET_STR(env[i], a);
+      }
+      realm->cfg.env = env;
+    }
+
+    GET_STR(realm->cfg.binary, a);
+    GET_4(realm->cfg.uid);
+    GET_4(realm->cfg.gid);
+  }
+  return MSG_LEN();
+}
+
+// the cfg out of the template
+static int tipc_put_delta(char* buff, size_t nsize, struct rlm_t* realm) {
+  MSG_ENC(buff, nsize) {
+    PUT_STR(realm->cfg.name);
+    PUT_STR(realm->cfg.chroot_dir);
+    PUT_STR(realm->cfg.fd_stdout);
+    PUT_STR(realm->cfg.fd_stderr);
+  }
+  return MSG_LEN();
+}
+
+static int tipc_get_delta(struct rlm_t* realm, char* buff, size_t nsize) {
+  struct arena* a = realm->cfg.arena;  // the heap if NULL
+
+  MSG_DEC(buff, nsize) {
+    GET_STR(realm->cfg.name, a);
+    GET_STR(realm->cfg.chroot_dir, a);
+    GET_STR(realm->cfg.fd_stdout, a);
+    GET_STR(realm->cfg.fd_stderr, a);
+  }
+  return MSG_LEN();
+}
+
+/*
+ * the template of clones, turfd registers it once to the seed process.
+ */
+int _API tipc_enc_fork_tmpl(char* buff,
+                            size_t nsize,
+                            uint32_t id,
+                            struct rlm_t* realm) {
+  MSG_ENC(buff, nsize) {
+    PUT_HDR(TIPC_MSG_FORK_TMPL);
+    PUT_4(id);
+    PUT_BY(tipc_put_tmpl, realm);
+    CALC_HDR();
+  }
+  return MSG_LEN();
+}
+
+int _API tipc_dec_fork_tmpl(struct rlm_t* realm,
+                            uint32_t* id,
+                            char* buff,
+                            size_t nsize) {
+  MSG_DEC(buff, nsize) {
+    CHECK_HDR(TIPC_MSG_FORK_TMPL);
+    GET_4(*id);
+    GET_BY(tipc_get_tmpl, realm);
+  }
+  return MSG_LEN();
+}
+
+/*
+ * the fork_req of clones by template, the rest of cfg is in the template.
+ */
+int _API tipc_enc_fork_delta(char* buff,
+                             size_t nsize,
+                             uint32_t id,
+                             struct rlm_t** realms,
+                             int count) {
+  if (count <= 0 || count > TIPC_FORK_BATCH_MAX) {
+    set_errno(EINVAL);
+    return -1;
   }
 
+  MSG_ENC(buff, nsize) {
+    PUT_HDR(TIPC_MSG_FORK_DELTA);
+    PUT_4(id);
+    PUT_4(count);
+    for (int i = 0; i < count; i++) {
+      PUT_BY(tipc_put_delta, realms[i]);
+    }
+    if (MSG_EC() < 0) {
+      break;
+    }
+    CALC_HDR();
+  }
   return MSG_LEN();
 }
+
+int _API tipc_dec_fork_delta(struct rlm_t* realms,
+                             int* count,
+                             uint32_t* id,
+                             char* buff,
+                             size_t nsize) {
+  int n = 0;
+
+  MSG_DEC(buff, nsize) {
+    CHECK_HDR(TIPC_MSG_FORK_DELTA);
+    GET_4(*id);
+    GET_4(n);
+    if (n <= 0 || n > *count) {
+      _ERROR_BREAK(EBADMSG);
+    }
+    for (int i = 0; i < n; i++) {
+      GET_BY(tipc_get_delta, &realms[i]);
+    }
+  }
+  *count = MSG_EC() < 0 ? 0 : n;
+  return MSG_LEN();
+}
+
+/*
+ * the vectored msgs, the same bytes as the encoders above.
+ */
+void _API tipc_iov_init(struct tipc_iov* v) {
+  v->cnt = 0;
+  v->len = 0;
+  v->used = 0;
+}
+
+// refer size bytes at p, in a new iovec.
+static int tipc_iov_ref(struct tipc_iov* v, const void* p, size_t size) {
+  if (v->cnt >= TIPC_IOV_MAX) {
+    set_errno(EMSGSIZE);
+    return -1;
+  }
+
+  v->iov[v->cnt].iov_base = (void*)p;
+  v->iov[v->cnt].iov_len = size;
+  v->cnt++;
+  v->len += size;
+  return 0;
+}
+
+// size bytes of the scratch, joined to the last iovec if it ends there.
+static char* tipc_iov_room(struct tipc_iov* v, size_t size) {
+  if (v->used + size > TIPC_IOV_SCRATCH) {
+    set_errno(EMSGSIZE);
+    return NULL;
+  }
+
+  char* dst = v->scratch + v->used;
+  struct iovec* last = v->cnt > 0 ? &v->iov[v->cnt - 1] : NULL;
+  if (last && (char*)last->iov_base + last->iov_len == dst) {
+    last->iov_len += size;
+    v->len += size;
+  } else if (tipc_iov_ref(v, dst, size) < 0) {
+    return NULL;
+  }
+  v->used += size;
+  return dst;
+}
+
+static char* tipc_iov_copy(struct tipc_iov* v, const void* p, size_t size) {
+  char* dst = tipc_iov_room(v, size);
+  if (dst) {
+    memcpy(dst, p, size);
+  }
+  return dst;
+}
+
+// as PUT_STR()
+static int tipc_iov_str(struct tipc_iov* v, const char* s) {
+  size_t l = s ? strlen(s) + 1 : 0;
+  char* dst;
+
+  // the has byte, and the short string with it
+  if (l > TIPC_IOV_COPY_MAX) {
+    if (!(dst = tipc_iov_room(v, 1))) {
+      return -1;
+    }
+    *dst = 1;
+    return tipc_iov_ref(v, s, l);
+  }
+  if (!(dst = tipc_iov_room(v, 1 + l))) {
+    return -1;
+  }
+  *dst = (s != NULL);
+  if (l > 0) {
+    memcpy(dst + 1, s, l);
+  }
+  return 0;
+}
+
+int _API tipc_iov_add(struct tipc_iov* v, char* buff, size_t len) {
+  if (!v || !buff) {
+    set_errno(EINVAL);
+    return -1;
+  }
+  return tipc_iov_ref(v, buff, len);
+}
+
+// as the strings of tipc_iov_fork_delta()
+static bool tipc_iov_long(const char* s) {
+  return s && strlen(s) >= TIPC_IOV_COPY_MAX;
+}
+
+bool _API tipc_iov_worth(struct rlm_t** realms, int count) {
+  for (int i = 0; i < count; i++) {
+    struct rlm_cfg* cfg = &realms[i]->cfg;
+    if (tipc_iov_long(cfg->name) || tipc_iov_long(cfg->chroot_dir) ||
+        tipc_iov_long(cfg->fd_stdout) || tipc_iov_long(cfg->fd_stderr)) {
+      return 1;
+    }
+  }
+  return 0;
+}
+
+int _API tipc_iov_fork_delta(struct tipc_iov* v,
+                             uint32_t id,
+                             struct rlm_t** realms,
+                             int count) {
+  if (!v || count <= 0 || count > TIPC_FORK_BATCH_MAX) {
+    set_errno(EINVAL);
+    return -1;
+  }
+
+  // for the rollback, the last iovec may be joined.
+  int cnt = v->cnt;
+  size_t len = v->len;
+  size_t used = v->used;
+  size_t tail = cnt > 0 ? v->iov[cnt - 1].iov_len : 0;
+
+  struct tipc_hdr h = {
+      .magic = TIPC_HDR_MAGIC, .type = TIPC_MSG_FORK_DELTA, .csum = m_csum};
+  struct tipc_hdr* hdr = (struct tipc_hdr*)tipc_iov_copy(v, &h, HDR_LEN);
+  if (!hdr || !tipc_iov_copy(v, &id, 4) || !tipc_iov_copy(v, &count, 4)) {
+    goto error;
+  }
+  for (int i = 0; i < count; i++) {
+    struct rlm_cfg* cfg = &realms[i]->cfg;
+    if (tipc_iov_str(v, cfg->name) < 0 ||
+        tipc_iov_str(v, cfg->chroot_dir) < 0 ||
+        tipc_iov_str(v, cfg->fd_stdout) < 0 ||
+        tipc_iov_str(v, cfg->fd_stderr) < 0) {
+      goto error;
+    }
+  }
+
+  size_t size = v->len - len;
+  if (size > TIPC_MSG_MAX_SIZE) {
+    set_errno(EMSGSIZE);
+    goto error;
+  }
+  hdr->length = size;
+
+  // as _MSG_CRC(), from the type to the end, through the iovecs.
+  // the header is the first copied, the last iovec grew if joined.
+  int first = (cnt > 0 && v->iov[cnt - 1].iov_len != tail) ? cnt - 1 : cnt;
+  size_t off = (char*)&hdr->type - (char*)v->iov[first].iov_base;
+  uint32_t crc = 0;
+  for (int i = first; i < v->cnt; i++, off = 0) {
+    crc = tipc_csum_update(hdr->csum, crc, (char*)v->iov[i].iov_base + off,
+                           v->iov[i].iov_len - off);
+  }
+  hdr->checksum = crc;
+  return size;
+
+error:
+  v->cnt = cnt;
+  v->len = len;
+  v->used = used;
+  if (cnt > 0) {
+    v->iov[cnt - 1].iov_len = tail;
+  }
+  return -1;
+}
+
+int _API tipc_iov_write(struct tipc_iov* v, int fd) {
+  struct iovec* iov = v->iov;
+  int cnt = v->cnt;
+  size_t left = v->len;
+
+  while (left > 0) {
+    ssize_t l = writev(fd, iov, cnt);
+    if (l < 0 && errno == EINTR) {
+      continue;
+    }
+    if (l < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+      // the rest is left, a frame written in part must be finished.
+      memmove(v->iov, iov, cnt * sizeof(struct iovec));
+      v->cnt = cnt;
+      v->len = left;
+      set_errno(EAGAIN);
+      return -1;
+    }
+    if (l <= 0) {
+      return -1;
+    }
+
+    // the rest of a partial write
+    left -= l;
+    while (cnt > 0 && (size_t)l >= iov->iov_len) {
+      l -= iov->iov_len;
+      iov++;
+      cnt--;
+    }
+    if (cnt > 0) {
+      iov->iov_base = (char*)iov->iov_base + l;
+      iov->iov_len -= l;
+    }
+  }
+  return 0;
+}
+
+void _API tipc_iov_gather(struct tipc_iov* v, char* buff) {
+  int i;
+
+  for (i = 0; i < v->cnt; i++) {
+    memcpy(buff, v->iov[i].iov_base, v->iov[i].iov_len);
+    buff += v->iov[i].iov_len;
+  }
+}
@@ -2,22 +2,55 @@
 #define _TURF_IPC_H_
 
 #include <errno.h>
+#include <sys/uio.h>  // struct iovec
 #include "crc32.h"
 #include "misc.h"
 #include "realm.h"
 
-// represent an turf-ipc endpoint
+// ring of an endpoint, holds two max msgs at least, power of 2
+#define TIPC_EP_RING_SIZE (128 * 1024)
+
+/* represent an turf-ipc endpoint,
+ *  the bytes read are kept in the ring, until the msgs are whole.
+ */
 struct tipc_ep {
-  int fd;  // socket fd
+  int fd;       // socket fd
+  char* ring;   // TIPC_EP_RING_SIZE, allocated on the first read
+  char* frame;  // a msg wrapped at the ring end is copied here
+  uint32_t rd;  // read position, free running
+  uint32_t wr;  // write position, free running
 };
 
 enum tipc_msg_type {
   TIPC_MSG_SEED_READY,
   TIPC_MSG_FORK_REQ,
   TIPC_MSG_FORK_RSP,
+  TIPC_MSG_FORK_REQ_BATCH,
+  TIPC_MSG_FORK_RSP_BATCH,
+  TIPC_MSG_FORK_TMPL,
+  TIPC_MSG_FORK_DELTA,
   TIPC_MSG_MAX,
 };
 
+/* checksum of a msg, the encoder sets it in the header, and the decoder
+ *  takes the one of the header. the peer tells which it supports in
+ *  seed_ready, the old ones know only crc32, which is ZERO.
+ */
+enum tipc_csum {
+  TIPC_CSUM_CRC32,
+  TIPC_CSUM_CRC32C,  // by sse4.2 or armv8 crc if the cpu supports
+  TIPC_CSUM_MAX,
+};
+
+// the length in header is 16 bits
+#define TIPC_MSG_MAX_SIZE (UINT16_MAX)
+
+// realms in a batched fork msg
+#define TIPC_FORK_BATCH_MAX (16)
+
+// templates kept by a seed, the slot of a template is its id modulo this
+#define TIPC_FORK_TMPL_MAX (4)
+
 #pragma pack(push)
 #pragma pack(1)
 
@@ -25,9 +58,9 @@ enum tipc_msg_type {
 struct tipc_hdr {
 #define TIPC_HDR_MAGIC (0xffffffffffffffffULL)
   uint64_t magic;     // TIPC_HDR_MAGIC
-  uint32_t checksum;  // crc32, without magic and checksum
+  uint32_t checksum;  // by csum, without magic and checksum
   uint8_t type;       // TIPC_MSG_TYPE
-  uint8_t padding;    // must be ZERO
+  uint8_t csum;       // TIPC_CSUM_XXX
   uint16_t length;    // whole msg length, including header
 };                    // 16 bytes
 
@@ -35,16 +68,40 @@ struct tipc_hdr {
 
 const char* tipc_msg_type(int type);
 
+// the checksum of the msgs encoded after, return the last one.
+int _API tipc_set_csum(int csum);
+
 // callback for TIPC msg decoder
 typedef int(TIPC_DecodeCB)(int type, char* buff, size_t nsize, void* data);
+// read one msg from a blocking fd, see tipc_ep_read() for a stream.
 int _API tipc_read(int fd, TIPC_DecodeCB* cb, void* data);
 int _API tipc_decode(char* buff, size_t nsize, TIPC_DecodeCB* cb, void* data);
 
-// TIPC_MSG_SEED_READY
+// endpoint on fd, no read yet
+void _API tipc_ep_init(struct tipc_ep* ep, int fd);
+
+// release the ring, the fd is not closed.
+void _API tipc_ep_free(struct tipc_ep* ep);
+
+/* read fd once, and decode every whole msg in the ring by cb,
+ *  a partial msg is kept for the next read, a blocking fd waits for it.
+ *  return msgs decoded, or -1 on error (EAGAIN if no data, EPIPE if peer
+ *  closed, EBADMSG if the stream is broken).
+ *  a negative rc of cb stops the decoding and is returned, the msgs after
+ *  are decoded in the next call.
+ */
+int _API tipc_ep_read(struct tipc_ep* ep, TIPC_DecodeCB* cb, void* data);
+
+/* TIPC_MSG_SEED_READY, carries the mask of the checksums the seed
+ *  supports, (1 << TIPC_CSUM_XXX), crc32 only from an old one.
+ */
 int _API tipc_enc_seed_ready(char* buff, size_t nsize);
-int _API tipc_dec_seed_ready(char* buff, size_t nsize);
+int _API tipc_dec_seed_ready(char* buff, size_t nsize, uint32_t* csums);
 
-// TIPC_MSG_FORK_REQ
+/* TIPC_MSG_FORK_REQ,
+ *  the decoders of realms put the strings in realm->cfg.arena if set,
+ *  or the heap.
+ */
 int _API tipc_enc_fork_req(char* buff, size_t nsize, struct rlm_t* realm);
 int _API tipc_dec_fork_req(struct rlm_t* realm, char* buff, size_t nsize);
 
@@ -52,4 +109,96 @@ int _API tipc_dec_fork_req(struct rlm_t* realm, char* buff, size_t nsize);
 int _API tipc_enc_fork_rsp(char* buff, size_t nsize, struct rlm_t* realm);
 int _API tipc_dec_fork_rsp(struct rlm_t* realm, char* buff, size_t nsize);
 
+/* TIPC_MSG_FORK_REQ_BATCH, count realms forked in a row by the seed.
+ *  the decoder takes the capacity of realms in count, and gives the number.
+ */
+int _API tipc_enc_fork_req_batch(char* buff,
+                                 size_t nsize,
+                                 struct rlm_t** realms,
+                                 int count);
+int _API tipc_dec_fork_req_batch(struct rlm_t* realms,
+                                 int* count,
+                                 char* buff,
+                                 size_t nsize);
+
+// TIPC_MSG_FORK_RSP_BATCH, the results of a batched fork_req
+int _API tipc_enc_fork_rsp_batch(char* buff,
+                                 size_t nsize,
+                                 struct rlm_t* realms,
+                                 int count);
+int _API tipc_dec_fork_rsp_batch(struct rlm_t* realms,
+                                 int* count,
+                                 char* buff,
+                                 size_t nsize);
+
+/* TIPC_MSG_FORK_TMPL, registers the cfg shared by the clones of a seed,
+ *  all but name, chroot_dir, fd_stdout and fd_stderr, as template id.
+ *  a template of the same id is registered again in place.
+ */
+int _API tipc_enc_fork_tmpl(char* buff,
+                            size_t nsize,
+                            uint32_t id,
+                            struct rlm_t* realm);
+int _API tipc_dec_fork_tmpl(struct rlm_t* realm,
+                            uint32_t* id,
+                            char* buff,
+                            size_t nsize);
+
+/* TIPC_MSG_FORK_DELTA, count realms of template id forked in a row,
+ *  carries only the cfg out of the template, answered like fork_req_batch.
+ */
+int _API tipc_enc_fork_delta(char* buff,
+                             size_t nsize,
+                             uint32_t id,
+                             struct rlm_t** realms,
+                             int count);
+int _API tipc_dec_fork_delta(struct rlm_t* realms,
+                             int* count,
+                             uint32_t* id,
+                             char* buff,
+                             size_t nsize);
+
+/* vectored msgs, written in one writev(),
+ *  the strings longer than TIPC_IOV_COPY_MAX are referred in place instead
+ *  of copied, they must be kept until written.
+ */
+#define TIPC_IOV_MAX (256)       // iovecs of the msgs
+#define TIPC_IOV_SCRATCH (8192)  // the headers, ints and short strings
+#define TIPC_IOV_COPY_MAX (64)   // strings copied to the scratch
+
+struct tipc_iov {
+  struct iovec iov[TIPC_IOV_MAX];
+  int cnt;      // iovecs used
+  size_t len;   // bytes of all msgs
+  size_t used;  // of scratch
+  char scratch[TIPC_IOV_SCRATCH];
+};
+
+// no msgs yet
+void _API tipc_iov_init(struct tipc_iov* v);
+
+// append a msg encoded in buff, kept until written.
+int _API tipc_iov_add(struct tipc_iov* v, char* buff, size_t len);
+
+/* a string of the fork_delta is long enough to be referred in place,
+ *  the buffer encoder is quicker otherwise.
+ */
+bool _API tipc_iov_worth(struct rlm_t** realms, int count);
+
+/* append TIPC_MSG_FORK_DELTA, the same bytes as tipc_enc_fork_delta(),
+ *  -1 with EMSGSIZE if v is full, v is left as before then.
+ */
+int _API tipc_iov_fork_delta(struct tipc_iov* v,
+                             uint32_t id,
+                             struct rlm_t** realms,
+                             int count);
+
+/* write all msgs of v, -1 if not all written. v is used up, or holds the
+ *  rest not written if EAGAIN, see tipc_iov_gather().
+ */
+int _API tipc_iov_write(struct tipc_iov* v, int fd);
+
+// copy the v->len bytes of v to buff
+void _API tipc_iov_gather(struct tipc_iov* v, char* buff);
+
 #endif  // _TURF_IPC_H_
@@ -175,6 +175,62 @@ exit:
   return rc;
 }
 
+int _API write_file_atomic(const char* path, const char* buf, size_t size) {
+  int rc = -1;
+  int fd = -1;
+  size_t done = 0;
+  char tmp[TURF_MAX_PATH_LEN];
+
+  if (!path || !buf) {
+    set_errno(EINVAL);
+    return -1;
+  }
+
+  // temp file in the same dir, different writers never share it.
+  rc = snprintf(tmp, sizeof(tmp), "%s.%d.tmp", path, (int)getpid());
+  if (rc < 0 || rc >= (int)sizeof(tmp)) {
+    set_errno(ENAMETOOLONG);
+    return -1;
+  }
+
+  fd = open(tmp, O_CREAT | O_TRUNC | O_WRONLY | O_CLOEXEC, 0644);
+  if (fd < 0) {
+    return -1;
+  }
+
+  while (done < size) {
+    ssize_t n = write(fd, buf + done, size - done);
+    if (n < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      goto error;
+    }
+    done += n;
+  }
+
+  // data reaches disk before the name does
+  if (fsync(fd) < 0) {
+    goto error;
+  }
+  close(fd);
+  fd = -1;
+
+  if (rename(tmp, path) < 0) {
+    goto error;
+  }
+  return 0;
+
+error:
+  rc = errno;
+  if (fd >= 0) {
+    close(fd);
+  }
+  unlink(tmp);
+  set_errno(rc);
+  return -1;
+}
+
 int _API proc_write(const char* path, const char* str, size_t len) {
   int f = open(path, O_WRONLY | O_CLOEXEC);
 
@@ -235,6 +235,9 @@ int _API read_file(const char* path, char** pbuf, size_t* psize);
 // write file
 int _API write_file(const char* path, const char* buf, size_t size);
 
+// write file through a temp file and rename(), never leaves a torn file.
+int _API write_file_atomic(const char* path, const char* buf, size_t size);
+
 // get pid max, based on proc
 int _API proc_pid_max(int* pid_max);
 
@@ -0,0 +1,439 @@
+/* turf C/S protocol, framing and codec
+ */
+
+#include "msg.h"
+
+// read chunk of msg_fill()
+#define MSG_READ_CHUNK (4096)
+
+// room tried first by msg_buf_vprintf()
+#define MSG_PRINTF_HINT (256)
+
+int _API msg_buf_reserve(struct msg_buf* b, size_t more) {
+  if (!b) {
+    set_errno(EINVAL);
+    return -1;
+  }
+
+  if (b->cap - b->len >= more) {
+    return 0;
+  }
+
+  // reuse the consumed head first
+  msg_buf_compact(b);
+  if (b->cap - b->len >= more) {
+    return 0;
+  }
+
+  size_t cap = b->cap ? b->cap : MSG_READ_CHUNK;
+  while (cap - b->len < more) {
+    cap <<= 1;
+  }
+
+  char* data = (char*)realloc(b->data, cap);
+  if (!data) {
+    set_errno(ENOMEM);
+    return -1;
+  }
+  b->data = data;
+  b->cap = cap;
+  return 0;
+}
+
+void _API msg_buf_compact(struct msg_buf* b) {
+  if (!b || b->off == 0) {
+    return;
+  }
+
+  if (b->off < b->len) {
+    memmove(b->data, b->data + b->off, b->len - b->off);
+  }
+  b->len -= b->off;
+  b->off = 0;
+}
+
+void _API msg_buf_free(struct msg_buf* b) {
+  if (!b) {
+    return;
+  }
+
+  if (b->data) {
+    free(b->data);
+  }
+  memset(b, 0, sizeof(struct msg_buf));
+}
+
+static int msg_put(struct msg_buf* b,
+                   uint16_t tag,
+                   const void* val,
+                   uint32_t len) {
+  struct msg_tlv t = {.tag = tag, .len = len};
+
+  if (msg_buf_reserve(b, sizeof(t) + len) < 0) {
+    return -1;
+  }
+
+  memcpy(b->data + b->len, &t, sizeof(t));
+  memcpy(b->data + b->len + sizeof(t), val, len);
+  b->len += sizeof(t) + len;
+  return 0;
+}
+
+static int msg_put_u32(struct msg_buf* b, uint16_t tag, uint32_t val) {
+  return msg_put(b, tag, &val, sizeof(val));
+}
+
+static int msg_put_str(struct msg_buf* b, uint16_t tag, const char* str) {
+  if (!str) {
+    return 0;
+  }
+  return msg_put(b, tag, str, strlen(str) + 1);
+}
+
+static int msg_put_hdr(struct msg_buf* b,
+                       uint16_t type,
+                       uint32_t seq,
+                       int code) {
+  struct msg_hdr h = {0};
+
+  if (msg_buf_reserve(b, sizeof(h)) < 0) {
+    return -1;
+  }
+
+  h.hdr_magic = MSG_HDR_MAGIC;
+  h.msg_type = type;
+  h.msg_code = code;
+  h.msg_seq = seq;
+  memcpy(b->data + b->len, &h, sizeof(h));
+  b->len += sizeof(h);
+  return 0;
+}
+
+int _API msg_enc_cli(struct msg_buf* b, uint32_t seq, const tf_cli* cli) {
+  int i;
+  int rc = 0;
+  uint32_t flags = 0;
+
+  if (!b || !cli) {
+    set_errno(EINVAL);
+    return -1;
+  }
+
+  // relative to off, reserve may compact
+  size_t start = b->len - b->off;
+  if (msg_put_hdr(b, T_MSG_CLI_REQ, seq, 0) < 0) {
+    return -1;
+  }
+
+  flags |= cli->has.force ? MSG_F_FORCE : 0;
+  flags |= cli->has.all ? MSG_F_ALL : 0;
+  flags |= cli->has.install ? MSG_F_INSTALL : 0;
+  flags |= cli->has.seed ? MSG_F_SEED : 0;
+  flags |= cli->has.json ? MSG_F_JSON : 0;
+  flags |= cli->has.dedup ? MSG_F_DEDUP : 0;
+  flags |= cli->has.cache ? MSG_F_CACHE : 0;
+  flags |= cli->has.async ? MSG_F_ASYNC : 0;
+
+  rc |= msg_put_u32(b, MSG_TAG_CMD, cli->cmd);
+  rc |= msg_put_u32(b, MSG_TAG_FLAGS, flags);
+  rc |= msg_put_str(b, MSG_TAG_NAME, cli->sandbox_name);
+  rc |= msg_put_str(b, MSG_TAG_BUNDLE, cli->bundle_path);
+  rc |= msg_put_str(b, MSG_TAG_CONFIG, cli->config_json);
+  rc |= msg_put_str(b, MSG_TAG_SPEC, cli->spec_path);
+  rc |= msg_put_str(b, MSG_TAG_CWD, cli->cwd);
+  rc |= msg_put_str(b, MSG_TAG_STDOUT, cli->file_stdout);
+  rc |= msg_put_str(b, MSG_TAG_STDERR, cli->file_stderr);
+  rc |= msg_put_str(b, MSG_TAG_RUNTIME, cli->runtime_name);
+  rc |= msg_put_str(b, MSG_TAG_SEED, cli->seed_sandbox_name);
+  for (i = 0; i < cli->env_cnt && i < TURF_CLI_MAX_ENV; i++) {
+    rc |= msg_put_str(b, MSG_TAG_ENV, cli->envs[i]);
+  }
+  if (cli->has.memlimit) {
+    rc |= msg_put_u32(b, MSG_TAG_MEMLIMIT, cli->memlimit);
+  }
+  if (cli->has.cpulimit) {
+    rc |= msg_put_u32(b, MSG_TAG_CPULIMIT, cli->cpulimit);
+  }
+  if (cli->has.kill_sig) {
+    rc |= msg_put_u32(b, MSG_TAG_KILL_SIG, cli->kill_sig);
+  }
+  if (cli->has.time_wait) {
+    rc |= msg_put_u32(b, MSG_TAG_TIME_WAIT, cli->time_wait);
+  }
+
+  char* h = b->data + b->off + start;
+  size_t size = b->data + b->len - h - sizeof(struct msg_hdr);
+  if (rc < 0 || size > MSG_MAX_SIZE) {
+    b->len = h - b->data;  // drop the partial frame
+    set_errno(rc < 0 ? ENOMEM : E2BIG);
+    return -1;
+  }
+
+  // patch the body size
+  uint32_t msg_size = size;
+  memcpy(h + offsetof(struct msg_hdr, msg_size), &msg_size, sizeof(msg_size));
+  return 0;
+}
+
+int _API msg_enc_rsp(struct msg_buf* b, uint32_t seq, int code) {
+  if (!b) {
+    set_errno(EINVAL);
+    return -1;
+  }
+  return msg_put_hdr(b, T_MSG_CLI_RSP, seq, code);
+}
+
+ssize_t _API msg_rsp_begin(struct msg_buf* b, uint32_t seq) {
+  if (!b) {
+    set_errno(EINVAL);
+    return -1;
+  }
+
+  size_t start = b->len - b->off;
+  if (msg_put_hdr(b, T_MSG_CLI_RSP, seq, 0) < 0) {
+    return -1;
+  }
+  return start;
+}
+
+int _API msg_rsp_end(struct msg_buf* b, size_t start, int code) {
+  struct msg_hdr* h = (struct msg_hdr*)(b->data + b->off + start);
+  size_t size = b->data + b->len - (char*)h - sizeof(struct msg_hdr);
+
+  // too much output, drop it
+  if (size > MSG_MAX_SIZE) {
+    b->len -= size;
+    size = 0;
+    code = -E2BIG;
+  }
+
+  h->msg_code = code;
+  h->msg_size = size;
+  return 0;
+}
+
+void _API msg_rsp_cancel(struct msg_buf* b, size_t start) {
+  b->len = b->off + start;
+}
+
+int _API msg_buf_vprintf(struct msg_buf* b, const char* fmt, va_list ap) {
+  va_list aq;
+
+  if (msg_buf_reserve(b, MSG_PRINTF_HINT) < 0) {
+    return -1;
+  }
+
+  va_copy(aq, ap);
+  int n = vsnprintf(b->data + b->len, b->cap - b->len, fmt, aq);
+  va_end(aq);
+  if (n < 0) {
+    return -1;
+  }
+
+  // longer than the room, again
+  if ((size_t)n >= b->cap - b->len) {
+    if (msg_buf_reserve(b, n + 1) < 0) {
+      return -1;
+    }
+    vsnprintf(b->data + b->len, b->cap - b->len, fmt, ap);
+  }
+
+  b->len += n;
+  return n;
+}
+
+int _API msg_peek(struct msg_buf* b, struct msg_hdr* hdr) {
+  if (!b || !hdr) {
+    set_errno(EINVAL);
+    return -1;
+  }
+
+  if (b->len - b->off < sizeof(struct msg_hdr)) {
+    return 0;
+  }
+
+  memcpy(hdr, b->data + b->off, sizeof(struct msg_hdr));
+  if (hdr->hdr_magic != MSG_HDR_MAGIC) {
+    set_errno(EBADMSG);
+    return -1;
+  }
+  if (hdr->msg_size > MSG_MAX_SIZE) {
+    set_errno(E2BIG);
+    return -1;
+  }
+
+  return b->len - b->off >= sizeof(struct msg_hdr) + hdr->msg_size;
+}
+
+static int msg_get_u32(const char* val, uint32_t len, uint32_t* out) {
+  if (len != sizeof(uint32_t)) {
+    return -1;
+  }
+  memcpy(out, val, sizeof(uint32_t));
+  return 0;
+}
+
+static int msg_get_str(char* val, uint32_t len, char** out) {
+  if (len == 0 || val[len - 1] != 0) {
+    return -1;
+  }
+  *out = val;
+  return 0;
+}
+
+int _API msg_dec_cli(char* body, uint32_t size, tf_cli* cli) {
+  int rc = 0;
+  uint32_t flags = 0;
+  uint32_t off = 0;
+
+  if (!body || !cli) {
+    set_errno(EINVAL);
+    return -1;
+  }
+
+  while (rc == 0 && off < size) {
+    struct msg_tlv t;
+    if (size - off < sizeof(t)) {
+      rc = -1;
+      break;
+    }
+    memcpy(&t, body + off, sizeof(t));
+    off += sizeof(t);
+    if (t.len > size - off) {
+      rc = -1;
+      break;
+    }
+
+    char* val = body + off;
+    off += t.len;
+
+    switch (t.tag) {
+      case MSG_TAG_CMD:
+        rc = msg_get_u32(val, t.len, (uint32_t*)&cli->cmd);
+        break;
+      case MSG_TAG_FLAGS:
+        rc = msg_get_u32(val, t.len, &flags);
+        break;
+      case MSG_TAG_NAME:
+        rc = msg_get_str(val, t.len, &cli->sandbox_name);
+        break;
+      case MSG_TAG_BUNDLE:
+        rc = msg_get_str(val, t.len, &cli->bundle_path);
+        break;
+      case MSG_TAG_CONFIG:
+        rc = msg_get_str(val, t.len, &cli->config_json);
+        break;
+      case MSG_TAG_SPEC:
+        rc = msg_get_str(val, t.len, &cli->spec_path);
+        break;
+      case MSG_TAG_CWD:
+        rc = msg_get_str(val, t.len, &cli->cwd);
+        break;
+      case MSG_TAG_STDOUT:
+        rc = msg_get_str(val, t.len, &cli->file_stdout);
+        break;
+      case MSG_TAG_STDERR:
+        rc = msg_get_str(val, t.len, &cli->file_stderr);
+        break;
+      case MSG_TAG_RUNTIME:
+        rc = msg_get_str(val, t.len, &cli->runtime_name);
+        break;
+      case MSG_TAG_SEED:
+        rc = msg_get_str(val, t.len, &cli->seed_sandbox_name);
+        break;
+      case MSG_TAG_ENV:
+        if (cli->env_cnt >= TURF_CLI_MAX_ENV) {
+          rc = -1;
+          break;
+        }
+        rc = msg_get_str(val, t.len, &cli->envs[cli->env_cnt++]);
+        break;
+      case MSG_TAG_MEMLIMIT:
+        rc = msg_get_u32(val, t.len, &cli->memlimit);
+        cli->has.memlimit = 1;
+        break;
+      case MSG_TAG_CPULIMIT:
+        rc = msg_get_u32(val, t.len, &cli->cpulimit);
+        cli->has.cpulimit = 1;
+        break;
+      case MSG_TAG_KILL_SIG:
+        rc = msg_get_u32(val, t.len, &cli->kill_sig);
+        cli->has.kill_sig = 1;
+        break;
+      case MSG_TAG_TIME_WAIT:
+        rc = msg_get_u32(val, t.len, &cli->time_wait);
+        cli->has.time_wait = 1;
+        break;
+      default:  // unknown field from newer client, skip it.
+        break;
+    }
+  }
+
+  if (rc < 0 || !cli->cmd) {
+    set_errno(EBADMSG);
+    return -1;
+  }
+
+  cli->has.force = !!(flags & MSG_F_FORCE);
+  cli->has.all = !!(flags & MSG_F_ALL);
+  cli->has.install = !!(flags & MSG_F_INSTALL);
+  cli->has.seed = !!(flags & MSG_F_SEED);
+  cli->has.json = !!(flags & MSG_F_JSON);
+  cli->has.dedup = !!(flags & MSG_F_DEDUP);
+  cli->has.cache = !!(flags & MSG_F_CACHE);
+  cli->has.async = !!(flags & MSG_F_ASYNC);
+  cli->has.remote = 1;
+  return 0;
+}
+
+ssize_t _API msg_fill(int fd, struct msg_buf* b) {
+  ssize_t total = 0;
+
+  while (1) {
+    if (msg_buf_reserve(b, MSG_READ_CHUNK) < 0) {
+      return -1;
+    }
+
+    ssize_t n = read(fd, b->data + b->len, b->cap - b->len);
+    if (n > 0) {
+      b->len += n;
+      total += n;
+      continue;
+    }
+
+    if (n == 0) {  // peer closed
+      return total;
+    }
+    if (errno == EINTR) {
+      continue;
+    }
+    if (errno == EAGAIN || errno == EWOULDBLOCK) {
+      if (total > 0) {
+        return total;
+      }
+      set_errno(EAGAIN);
+    }
+    return -1;
+  }
+}
+
+int _API msg_flush(int fd, struct msg_buf* b) {
+  while (b->off < b->len) {
+    ssize_t n = write(fd, b->data + b->off, b->len - b->off);
+    if (n < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      if (errno == EAGAIN || errno == EWOULDBLOCK) {
+        return 1;
+      }
+      return -1;
+    }
+    b->off += n;
+  }
+
+  // all sent, rewind
+  b->off = 0;
+  b->len = 0;
+  return 0;
+}
@@ -0,0 +1,123 @@
+#ifndef _TURF_MSG_H_
+#define _TURF_MSG_H_
+
+#include "cli.h"  // struct tf_cli
+
+/* turf C/S protocol,
+ *  a request is a msg_hdr frame followed by a body of TLV fields,
+ *  a response body is the output of the command (state, ps ...).
+ *  frames can be pipelined on one connection, matched by msg_seq.
+ */
+
+#define TFD_MSG_VER 0x02
+#define MSG_HDR_MAGIC DEF_MAGIC('T', 'F', 'D', TFD_MSG_VER)
+
+// the max body size of a frame
+#define MSG_MAX_SIZE (TURF_MAX_FILE_SIZE)
+
+// message types
+#define T_MSG_CLI_REQ 1
+#define T_MSG_CLI_RSP 2
+
+struct msg_hdr {
+  uint32_t hdr_magic;  // MSG_HDR_MAGIC with intf version.
+  uint16_t msg_type;   // message type
+  int16_t msg_code;    // message code, -errno of the request in response
+  uint32_t msg_seq;    // request sequence, echoed by the response
+  uint32_t msg_size;   // body size, without header
+};
+
+// a field in body, the value follows
+struct msg_tlv {
+  uint16_t tag;  // MSG_TAG_XXX
+  uint16_t _reserved;
+  uint32_t len;  // value length, strings are with the '\0'
+};
+
+// request fields, map to struct tf_cli
+enum msg_tag_e {
+  MSG_TAG_CMD = 1,    // u32, TURF_CLI_XXX
+  MSG_TAG_FLAGS,      // u32, MSG_F_XXX
+  MSG_TAG_NAME,       // str, sandbox_name
+  MSG_TAG_BUNDLE,     // str, bundle_path
+  MSG_TAG_CONFIG,     // str, config_json
+  MSG_TAG_SPEC,       // str, spec_path
+  MSG_TAG_CWD,        // str, cwd
+  MSG_TAG_STDOUT,     // str, file_stdout
+  MSG_TAG_STDERR,     // str, file_stderr
+  MSG_TAG_RUNTIME,    // str, runtime_name
+  MSG_TAG_SEED,       // str, seed_sandbox_name
+  MSG_TAG_ENV,        // str, one of envs, repeatable
+  MSG_TAG_MEMLIMIT,   // u32
+  MSG_TAG_CPULIMIT,   // u32
+  MSG_TAG_KILL_SIG,   // u32
+  MSG_TAG_TIME_WAIT,  // u32
+};
+
+// MSG_TAG_FLAGS
+#define MSG_F_FORCE (1 << 0)
+#define MSG_F_ALL (1 << 1)
+#define MSG_F_INSTALL (1 << 2)
+#define MSG_F_SEED (1 << 3)
+#define MSG_F_JSON (1 << 4)
+#define MSG_F_DEDUP (1 << 5)
+#define MSG_F_CACHE (1 << 6)
+#define MSG_F_ASYNC (1 << 7)
+
+// byte buffer, reused by the messages of a connection
+struct msg_buf {
+  char* data;
+  size_t off;  // consumed
+  size_t len;  // filled
+  size_t cap;  // allocated
+};
+
+// make room for more bytes at the tail
+int _API msg_buf_reserve(struct msg_buf* b, size_t more);
+
+// move the unconsumed bytes to the front
+void _API msg_buf_compact(struct msg_buf* b);
+
+// release the storage
+void _API msg_buf_free(struct msg_buf* b);
+
+// append a request frame of cli
+int _API msg_enc_cli(struct msg_buf* b, uint32_t seq, const tf_cli* cli);
+
+// append a response frame without body
+int _API msg_enc_rsp(struct msg_buf* b, uint32_t seq, int code);
+
+/* append a response header, the body is appended after,
+ *  return the start to msg_rsp_end(), it stays valid after compact.
+ */
+ssize_t _API msg_rsp_begin(struct msg_buf* b, uint32_t seq);
+
+// patch the response with body size and code
+int _API msg_rsp_end(struct msg_buf* b, size_t start, int code);
+
+// drop the response from start, it is answered later.
+void _API msg_rsp_cancel(struct msg_buf* b, size_t start);
+
+// append formatted text
+int _API msg_buf_vprintf(struct msg_buf* b, const char* fmt, va_list ap);
+
+/* check the frame at the head of b,
+ *  return 1 if a whole frame is ready, 0 if needs more bytes,
+ *  or -1 if the frame is bad.
+ */
+int _API msg_peek(struct msg_buf* b, struct msg_hdr* hdr);
+
+/* decode request body into cli,
+ *  the strings point into body, cli must not be cli_free()d.
+ */
+int _API msg_dec_cli(char* body, uint32_t size, tf_cli* cli);
+
+/* read all available bytes into b,
+ *  return bytes read, 0 on peer closed, -1 on error (EAGAIN if no data).
+ */
+ssize_t _API msg_fill(int fd, struct msg_buf* b);
+
+// write b out, return 0 if all sent, 1 if pending, -1 on error.
+int _API msg_flush(int fd, struct msg_buf* b);
+
+#endif  // _TURF_MSG_H_
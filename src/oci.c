@@ -4,6 +4,7 @@
 
 #include "oci.h"
 #include "cjson/cJSON.h"
+#include "crc32.h"
 #include "realm.h"  // rlm_state_str()
 
 /*
@@ -69,10 +70,16 @@ struct oci_spec _API* oci_spec_loads(const char* json) {
     goto exit;
   }
 
-  cfg = (struct oci_spec*)calloc(1, sizeof(struct oci_spec));
+  // the spec and its strings in one arena, freed at once
+  struct arena* a = arn_new(0);
+  cfg = a ? (struct oci_spec*)arn_calloc(a, 1, sizeof(struct oci_spec)) : NULL;
   if (!cfg) {
+    arn_free(a);
     goto exit;
   }
+  cfg->arena = a;
+  cfg->size = strlen(json);
+  cfg->crc = crc32c(json, cfg->size);
 
   // parse process
   {
@@ -122,7 +129,7 @@ struct oci_spec _API* oci_spec_loads(const char* json) {
     if (root) {
       k = cJSON_GetObjectItem(root, "path");
       if (k) {
-        cfg->root.path = strdup(k->valuestring);
+        cfg->root.path = arn_strdup(a, k->valuestring);
         cfg->root.has.path = 1;
       }
       k = cJSON_GetObjectItem(root, "readonly");
@@ -184,19 +191,19 @@ struct oci_spec _API* oci_spec_loads(const char* json) {
     if (turf) {
       k = cJSON_GetObjectItem(turf, "os");
       if (k) {
-        cfg->turf.os = strdup(k->valuestring);
+        cfg->turf.os = arn_strdup(a, k->valuestring);
         cfg->turf.has.os = 1;
       }
 
       k = cJSON_GetObjectItem(turf, "runtime");
       if (k) {
-        cfg->turf.runtime = strdup(k->valuestring);
+        cfg->turf.runtime = arn_strdup(a, k->valuestring);
         cfg->turf.has.runtime = 1;
       }
 
       k = cJSON_GetObjectItem(turf, "code");
       if (k) {
-        cfg->turf.code = strdup(k->valuestring);
+        cfg->turf.code = arn_strdup(a, k->valuestring);
         cfg->turf.has.code = 1;
       }
 
@@ -592,60 +599,38 @@ void oci_spec_free(struct oci_spec* cfg) {
     env_free(cfg->process.env);
   }
 
-  if (cfg->has.linuxs) {
-    // no string
-  }
-
-  if (cfg->has.root) {
-    if (cfg->root.has.path && cfg->root.path) {
-      free(cfg->root.path);
-      cfg->root.path = NULL;
-    }
-  }
-
-  if (cfg->has.turf) {
-    if (cfg->turf.has.os && cfg->turf.os) {
-      free(cfg->turf.os);
-      cfg->turf.os = NULL;
-    }
-    if (cfg->turf.has.runtime && cfg->turf.runtime) {
-      free(cfg->turf.runtime);
-      cfg->turf.runtime = NULL;
-    }
-    if (cfg->turf.has.code && cfg->turf.code) {
-      free(cfg->turf.code);
-      cfg->turf.code = NULL;
-    }
-  }
-
-  free(cfg);
+  // the strings are in the arena
+  arn_free(cfg->arena);
 }
 
 struct oci_state _API* oci_state_create(const char* name, const char* bundle) {
+  // the state and its strings in one malloc
+  size_t size = ARN_SIZE(sizeof(struct oci_state)) +
+                ARN_SIZE(strlen(name) + 1) + ARN_SIZE(strlen(bundle) + 1);
+  struct arena* a = arn_new(size);
   struct oci_state* state =
-      (struct oci_state*)calloc(1, sizeof(struct oci_state));
+      a ? (struct oci_state*)arn_calloc(a, 1, sizeof(struct oci_state)) : NULL;
   if (!state) {
+    arn_free(a);
     return NULL;
   }
 
-  state->id = strdup(name);
-  state->bundle = strdup(bundle);
+  state->arena = a;
+  state->id = arn_strdup(a, name);
+  state->bundle = arn_strdup(a, bundle);
 
   return state;
 }
 
-struct oci_state _API* oci_state_load(const char* path) {
-  int rc = -1;
-  char* json = NULL;
-  size_t json_size = 0;
+struct oci_state _API* oci_state_loads(const char* json) {
   cJSON* j = NULL;  // hold the json
   cJSON* k = NULL;  // tmp for leaf/key
   bool success = 0;
   struct oci_state* state = NULL;
 
-  rc = read_file(path, &json, &json_size);
-  if (rc < 0) {
-    goto exit;
+  if (!json) {
+    set_errno(EINVAL);
+    return NULL;
   }
 
   j = cJSON_Parse(json);
@@ -653,14 +638,18 @@ struct oci_state _API* oci_state_load(const char* path) {
     goto exit;
   }
 
-  state = (struct oci_state*)calloc(1, sizeof(struct oci_state));
+  struct arena* a = arn_new(0);
+  state = a ? (struct oci_state*)arn_calloc(a, 1, sizeof(struct oci_state))
+            : NULL;
   if (!state) {
+    arn_free(a);
     goto exit;
   }
+  state->arena = a;
 
   k = cJSON_GetObjectItem(j, "id");
   if (k) {
-    state->id = strdup(k->valuestring);
+    state->id = arn_strdup(a, k->valuestring);
   }
 
   k = cJSON_GetObjectItem(j, "state");
@@ -680,7 +669,7 @@ struct oci_state _API* oci_state_load(const char* path) {
 
   k = cJSON_GetObjectItem(j, "bundle");
   if (k) {
-    state->bundle = strdup(k->valuestring);
+    state->bundle = arn_strdup(a, k->valuestring);
   }
 
   k = cJSON_GetObjectItem(j, "created");
@@ -729,9 +718,6 @@ exit:
   if (j) {
     cJSON_Delete(j);
   }
-  if (json) {
-    free(json);
-  }
 
   // good return
   if (success) {
@@ -740,19 +726,232 @@ exit:
 
   // error return
   if (state) {
-    free(state);
+    oci_state_free(state);
   }
   return NULL;
 }
 
-int _API oci_state_save(struct oci_state* state, const char* path) {
-  int rc = -1;
+static void oci_tv_pack(int64_t* v, const struct timeval* tv) {
+  v[0] = tv->tv_sec;
+  v[1] = tv->tv_usec;
+}
+
+static void oci_tv_unpack(struct timeval* tv, const int64_t* v) {
+  tv->tv_sec = v[0];
+  tv->tv_usec = v[1];
+}
+
+int _API oci_state_pack(struct oci_state* state, struct oci_state_rec* rec) {
+  if (!state || !rec) {
+    set_errno(EINVAL);
+    return -1;
+  }
+
+  if ((state->id && strlen(state->id) >= sizeof(rec->id)) ||
+      (state->bundle && strlen(state->bundle) >= sizeof(rec->bundle))) {
+    set_errno(ENAMETOOLONG);
+    return -1;
+  }
+
+  memset(rec, 0, sizeof(struct oci_state_rec));
+  rec->magic = OCI_STATE_REC_MAGIC;
+  rec->version = OCI_STATE_REC_VER;
+  rec->size = sizeof(struct oci_state_rec);
+
+  rec->state = state->state;
+  rec->status = state->status;
+  rec->pid = state->pid;
+  oci_tv_pack(rec->created, &state->created);
+  oci_tv_pack(rec->stopped, &state->stopped);
+
+  if (state->has.exit_code) {
+    rec->has |= OCI_STATE_HAS_EXIT_CODE;
+    rec->exit_code = state->exit_code;
+  }
+
+  if (state->has.rusage) {
+    const struct rusage* ru = &state->rusage;
+    rec->has |= OCI_STATE_HAS_RUSAGE;
+    oci_tv_pack(rec->rusage.utime, &ru->ru_utime);
+    oci_tv_pack(rec->rusage.stime, &ru->ru_stime);
+    rec->rusage.maxrss = ru->ru_maxrss;
+    rec->rusage.minflt = ru->ru_minflt;
+    rec->rusage.majflt = ru->ru_majflt;
+    rec->rusage.inblock = ru->ru_inblock;
+    rec->rusage.oublock = ru->ru_oublock;
+    rec->rusage.nvcsw = ru->ru_nvcsw;
+    rec->rusage.nivcsw = ru->ru_nivcsw;
+  }
+
+  if (state->has.stat) {
+    const tf_stat* st = &state->stat;
+    rec->has |= OCI_STATE_HAS_STAT;
+    rec->stat.rchar = st->rchar;
+    rec->stat.wchar = st->wchar;
+    rec->stat.syscr = st->syscr;
+    rec->stat.syscw = st->syscw;
+    rec->stat.read_bytes = st->read_bytes;
+    rec->stat.write_bytes = st->write_bytes;
+    rec->stat.cancelled_write_bytes = st->cancelled_write_bytes;
+    rec->stat.min_flt = st->min_flt;
+    rec->stat.maj_flt = st->maj_flt;
+    rec->stat.cmin_flt = st->cmin_flt;
+    rec->stat.cmaj_flt = st->cmaj_flt;
+    rec->stat.stime = st->stime;
+    rec->stat.utime = st->utime;
+    rec->stat.cstime = st->cstime;
+    rec->stat.cutime = st->cutime;
+    rec->stat.vsize = st->vsize;
+    rec->stat.rss = st->rss;
+    rec->stat.num_threads = st->num_threads;
+  }
+
+  if (state->id) {
+    strcpy(rec->id, state->id);
+  }
+  if (state->bundle) {
+    strcpy(rec->bundle, state->bundle);
+  }
+
+  rec->crc = crc32(rec, sizeof(struct oci_state_rec));
+  return 0;
+}
+
+struct oci_state _API* oci_state_unpack(const void* buf, size_t size) {
+  struct oci_state_rec rec;
+  struct oci_state* state = NULL;
+
+  if (!buf || size != sizeof(struct oci_state_rec)) {
+    set_errno(EINVAL);
+    return NULL;
+  }
+
+  // buf may be unaligned or mapped, work on a copy.
+  memcpy(&rec, buf, sizeof(rec));
+  if (rec.magic != OCI_STATE_REC_MAGIC || rec.version != OCI_STATE_REC_VER ||
+      rec.size != sizeof(rec)) {
+    set_errno(EINVAL);
+    return NULL;
+  }
+
+  uint32_t crc = rec.crc;
+  rec.crc = 0;
+  if (crc32(&rec, sizeof(rec)) != crc) {
+    set_errno(EBADMSG);
+    return NULL;
+  }
+
+  // not trust the strings
+  rec.id[sizeof(rec.id) - 1] = 0;
+  rec.bundle[sizeof(rec.bundle) - 1] = 0;
+
+  state = oci_state_create(rec.id, rec.bundle);
+  if (!state || !state->id || !state->bundle) {
+    oci_state_free(state);
+    set_errno(ENOMEM);
+    return NULL;
+  }
+
+  state->state = rec.state;
+  state->status = rec.status;
+  state->pid = rec.pid;
+  oci_tv_unpack(&state->created, rec.created);
+  oci_tv_unpack(&state->stopped, rec.stopped);
+
+  if (rec.has & OCI_STATE_HAS_EXIT_CODE) {
+    state->exit_code = rec.exit_code;
+    state->has.exit_code = 1;
+  }
+
+  if (rec.has & OCI_STATE_HAS_RUSAGE) {
+    struct rusage* ru = &state->rusage;
+    oci_tv_unpack(&ru->ru_utime, rec.rusage.utime);
+    oci_tv_unpack(&ru->ru_stime, rec.rusage.stime);
+    ru->ru_maxrss = rec.rusage.maxrss;
+    ru->ru_minflt = rec.rusage.minflt;
+    ru->ru_majflt = rec.rusage.majflt;
+    ru->ru_inblock = rec.rusage.inblock;
+    ru->ru_oublock = rec.rusage.oublock;
+    ru->ru_nvcsw = rec.rusage.nvcsw;
+    ru->ru_nivcsw = rec.rusage.nivcsw;
+    state->has.rusage = 1;
+  }
+
+  if (rec.has & OCI_STATE_HAS_STAT) {
+    tf_stat* st = &state->stat;
+    st->rchar = rec.stat.rchar;
+    st->wchar = rec.stat.wchar;
+    st->syscr = rec.stat.syscr;
+    st->syscw = rec.stat.syscw;
+    st->read_bytes = rec.stat.read_bytes;
+    st->write_bytes = rec.stat.write_bytes;
+    st->cancelled_write_bytes = rec.stat.cancelled_write_bytes;
+    st->min_flt = rec.stat.min_flt;
+    st->maj_flt = rec.stat.maj_flt;
+    st->cmin_flt = rec.stat.cmin_flt;
+    st->cmaj_flt = rec.stat.cmaj_flt;
+    st->stime = rec.stat.stime;
+    st->utime = rec.stat.utime;
+    st->cstime = rec.stat.cstime;
+    st->cutime = rec.stat.cutime;
+    st->vsize = rec.stat.vsize;
+    st->rss = rec.stat.rss;
+    st->num_threads = rec.stat.num_threads;
+    state->has.stat = 1;
+  }
+
+  return state;
+}
+
+// load state from file, the binary record or json written by older turf.
+struct oci_state _API* oci_state_load(const char* path) {
+  int fd;
+  ssize_t size;
+  struct oci_state_rec rec;
+  struct oci_state* state = NULL;
+
+  fd = open(path, O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    return NULL;
+  }
+
+  do {
+    size = read(fd, &rec, sizeof(rec));
+  } while (size < 0 && errno == EINTR);
+  close(fd);
+
+  if (size < 0) {
+    return NULL;
+  }
+
+  if (size >= (ssize_t)sizeof(rec.magic) && rec.magic == OCI_STATE_REC_MAGIC) {
+    return oci_state_unpack(&rec, size);
+  }
+
+  // json
+  char* json = NULL;
+  size_t json_size = 0;
+  if (read_file(path, &json, &json_size) < 0) {
+    return NULL;
+  }
+  state = oci_state_loads(json);
+  free(json);
+  return state;
+}
+
+// save oci_state to string, should free() after use.
+int _API oci_state_saves(struct oci_state* state, char** out) {
   cJSON* j = NULL;
   char* json = NULL;
   bool success = 0;
   char* time_created = NULL;
   char* time_stopped = NULL;
 
+  if (!state || !out) {
+    set_errno(EINVAL);
+    return -1;
+  }
+
   j = cJSON_CreateObject();
   if (!j) {
     goto exit;
@@ -834,20 +1033,13 @@ int _API oci_state_save(struct oci_state* state, const char* path) {
     goto exit;
   }
 
-  rc = write_file(path, json, strlen(json));
-  if (rc < 0) {
-    goto exit;
-  }
-
+  *out = json;
   success = 1;
 
 exit:
   if (j) {
     cJSON_Delete(j);
   }
-  if (json) {
-    free(json);
-  }
   if (time_created) {
     free(time_created);
   }
@@ -857,20 +1049,22 @@ exit:
   return success ? 0 : -1;
 }
 
-void _API oci_state_free(struct oci_state* state) {
-  if (!state) {
-    return;
-  }
+// save oci_state to file in binary, the file is replaced atomically.
+int _API oci_state_save(struct oci_state* state, const char* path) {
+  struct oci_state_rec rec;
 
-  if (state->id) {
-    free(state->id);
-    state->id = NULL;
+  if (oci_state_pack(state, &rec) < 0) {
+    return -1;
   }
 
-  if (state->bundle) {
-    free(state->bundle);
-    state->bundle = NULL;
+  return write_file_atomic(path, (const char*)&rec, sizeof(rec));
+}
+
+void _API oci_state_free(struct oci_state* state) {
+  if (!state) {
+    return;
   }
 
-  free(state);
+  // the strings are in the arena
+  arn_free(state->arena);
 }
@@ -1,6 +1,7 @@
 #ifndef _TURF_OCI_H_
 #define _TURF_OCI_H_
 
+#include "arena.h"
 #include "misc.h"
 #include "stat.h"
 
@@ -96,6 +97,11 @@ struct oci_spec {
   struct oci_spec_root root;
   struct oci_spec_linux linuxs;  // fix compile under gcc-5
   struct oci_spec_turf turf;
+
+  struct arena* arena;  // holds the spec and its strings, but arg and env
+
+  uint32_t crc;   // crc32c of the json loaded from, 0 if not loaded
+  uint32_t size;  // of the json loaded from
 };
 
 /*
@@ -129,6 +135,71 @@ struct oci_state {
   int exit_code;
   struct rusage rusage;
   tf_stat stat;
+
+  struct arena* arena;  // holds the state and its strings
+};
+
+/* binary state record,
+ *  the default on-disk format of state file, fixed layout in native endian,
+ *  the record can be read or mmap'd and copied without parsing.
+ */
+#define OCI_STATE_REC_MAGIC DEF_MAGIC('T', 'F', 'S', 'T')
+#define OCI_STATE_REC_VER (1)
+
+// oci_state_rec.has
+#define OCI_STATE_HAS_EXIT_CODE (1 << 0)
+#define OCI_STATE_HAS_RUSAGE (1 << 1)
+#define OCI_STATE_HAS_STAT (1 << 2)
+
+struct oci_state_rec {
+  uint32_t magic;    // OCI_STATE_REC_MAGIC
+  uint16_t version;  // OCI_STATE_REC_VER
+  uint16_t size;     // sizeof(struct oci_state_rec)
+  uint32_t crc;      // crc32 of the record, counted with crc = 0
+  uint32_t has;      // OCI_STATE_HAS_XXX
+  uint32_t state;    // RLM_STATE_XXX
+  uint32_t status;   // OOM, CPU_OVERLOAD, KILLED ...
+  int32_t pid;
+  int32_t exit_code;
+  int64_t created[2];  // tv_sec, tv_usec
+  int64_t stopped[2];  // tv_sec, tv_usec
+
+  struct {
+    int64_t utime[2];  // tv_sec, tv_usec
+    int64_t stime[2];  // tv_sec, tv_usec
+    int64_t maxrss;
+    int64_t minflt;
+    int64_t majflt;
+    int64_t inblock;
+    int64_t oublock;
+    int64_t nvcsw;
+    int64_t nivcsw;
+  } rusage;
+
+  struct {
+    uint64_t rchar;
+    uint64_t wchar;
+    uint64_t syscr;
+    uint64_t syscw;
+    uint64_t read_bytes;
+    uint64_t write_bytes;
+    uint64_t cancelled_write_bytes;
+    uint64_t min_flt;
+    uint64_t maj_flt;
+    uint64_t cmin_flt;
+    uint64_t cmaj_flt;
+    uint64_t stime;
+    uint64_t utime;
+    uint64_t cstime;
+    uint64_t cutime;
+    uint64_t vsize;
+    uint64_t rss;
+    int32_t num_threads;
+    int32_t _reserved;
+  } stat;
+
+  char id[TURF_SBX_MAX_LEN + 2];   // sandbox name, '\0' terminated
+  char bundle[TURF_MAX_PATH_LEN];  // path to bundle dir, '\0' terminated
 };
 
 // export api
@@ -146,10 +217,18 @@ void _API oci_spec_free(struct oci_spec* cfg);
 
 // create a state
 struct oci_state _API* oci_state_create(const char* id, const char* bundle);
-// load state from file
+// load state from file, in binary or json
 struct oci_state _API* oci_state_load(const char* path);
-// save state to file
+// load state from json string
+struct oci_state _API* oci_state_loads(const char* json);
+// save state to json string, for OCI compatible output
+int _API oci_state_saves(struct oci_state* state, char** out);
+// save state to file in binary
 int _API oci_state_save(struct oci_state* state, const char* path);
+// pack state into the binary record
+int _API oci_state_pack(struct oci_state* state, struct oci_state_rec* rec);
+// unpack state from the binary record, the record is verified.
+struct oci_state _API* oci_state_unpack(const void* buf, size_t size);
 // free state object
 void _API oci_state_free(struct oci_state* state);
 
@@ -0,0 +1,263 @@
+/* worker pool for the blocking work
+ */
+
+#include "pool.h"
+
+#include <pthread.h>
+#if defined(__linux__)
+#include <sys/eventfd.h>  // eventfd()
+#endif
+
+// a submitted work
+struct wkp_work {
+  TAILQ_ENTRY(wkp_work) in_queue;
+  wkp_work_fn work;
+  wkp_done_fn done;
+  void* arg;
+  int rc;          // result of work
+  int err;         // errno of work
+  uint64_t since;  // submitted, in us
+};
+TAILQ_HEAD(wkp_queue, wkp_work);
+
+static pthread_t m_threads[WKP_MAX_THREADS];
+static pthread_mutex_t m_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t m_cond = PTHREAD_COND_INITIALIZER;  // queued or stop
+
+static struct wkp_queue m_queue = TAILQ_HEAD_INITIALIZER(m_queue);
+static struct wkp_queue m_done = TAILQ_HEAD_INITIALIZER(m_done);
+static int m_fds[2] = {-1, -1};  // completion fd, [0] read, [1] write
+static bool m_running;           // workers are running
+static bool m_stopping;          // workers should exit
+static struct wkp_stat m_stat;
+
+static uint64_t wkp_now_us(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static int wkp_open_fd(void) {
+#if defined(__linux__)
+  int fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  if (fd < 0) {
+    return -1;
+  }
+  m_fds[0] = m_fds[1] = fd;
+#else
+  if (pipe(m_fds) < 0) {
+    return -1;
+  }
+  fcntl(m_fds[0], F_SETFL, O_NONBLOCK);
+  fcntl(m_fds[1], F_SETFL, O_NONBLOCK);
+#endif
+  return 0;
+}
+
+static void wkp_close_fd(void) {
+  if (m_fds[1] >= 0 && m_fds[1] != m_fds[0]) {
+    close(m_fds[1]);
+  }
+  if (m_fds[0] >= 0) {
+    close(m_fds[0]);
+  }
+  m_fds[0] = m_fds[1] = -1;
+}
+
+// wake up the loop
+static void wkp_notify(void) {
+  uint64_t one = 1;
+  ssize_t rc = write(m_fds[1], &one, sizeof(one));
+  (void)rc;  // full is fine, the loop is woken already
+}
+
+static void* wkp_thread(void* arg) {
+  struct wkp_work* w;
+
+  pthread_mutex_lock(&m_lock);
+  while (1) {
+    while (TAILQ_EMPTY(&m_queue) && !m_stopping) {
+      pthread_cond_wait(&m_cond, &m_lock);
+    }
+    if (TAILQ_EMPTY(&m_queue)) {
+      break;  // stopping
+    }
+
+    w = TAILQ_FIRST(&m_queue);
+    TAILQ_REMOVE(&m_queue, w, in_queue);
+    m_stat.queued--;
+    m_stat.running++;
+    pthread_mutex_unlock(&m_lock);
+
+    errno = 0;
+    w->rc = w->work(w->arg);
+    w->err = errno;
+
+    pthread_mutex_lock(&m_lock);
+    m_stat.running--;
+    bool wake = TAILQ_EMPTY(&m_done);
+    TAILQ_INSERT_TAIL(&m_done, w, in_queue);
+    if (wake) {
+      wkp_notify();
+    }
+  }
+  pthread_mutex_unlock(&m_lock);
+  return NULL;
+}
+
+int _API wkp_start(int threads) {
+  int i;
+  int rc = 0;
+
+  if (m_running) {
+    return 0;
+  }
+
+  if (threads <= 0) {
+    threads = WKP_DEFAULT_THREADS;
+  } else if (threads > WKP_MAX_THREADS) {
+    threads = WKP_MAX_THREADS;
+  }
+
+  if (wkp_open_fd() < 0) {
+    return -1;
+  }
+
+  m_stopping = 0;
+  for (i = 0; i < threads; i++) {
+    rc = pthread_create(&m_threads[i], NULL, wkp_thread, NULL);
+    if (rc != 0) {
+      break;
+    }
+  }
+
+  // no worker at all
+  if (i == 0) {
+    wkp_close_fd();
+    set_errno(rc);
+    return -1;
+  }
+
+  m_stat.threads = i;
+  m_running = 1;
+  return 0;
+}
+
+void _API wkp_stop(void) {
+  uint32_t i;
+
+  if (!m_running) {
+    return;
+  }
+
+  pthread_mutex_lock(&m_lock);
+  m_stopping = 1;
+  pthread_cond_broadcast(&m_cond);
+  pthread_mutex_unlock(&m_lock);
+
+  for (i = 0; i < m_stat.threads; i++) {
+    pthread_join(m_threads[i], NULL);
+  }
+  m_stat.threads = 0;
+  m_running = 0;
+
+  wkp_complete();
+  wkp_close_fd();
+}
+
+int _API wkp_fd(void) {
+  return m_running ? m_fds[0] : -1;
+}
+
+// the work is done, on the loop thread.
+static void wkp_finish(struct wkp_work* w) {
+  uint64_t lat = wkp_now_us() - w->since;
+
+  pthread_mutex_lock(&m_lock);
+  m_stat.completed++;
+  m_stat.last_us = lat;
+  if (lat > m_stat.max_us) {
+    m_stat.max_us = lat;
+  }
+  pthread_mutex_unlock(&m_lock);
+
+  if (w->done) {
+    w->done(w->arg, w->rc, w->err);
+  }
+  free(w);
+}
+
+int _API wkp_submit(wkp_work_fn work, wkp_done_fn done, void* arg) {
+  if (!work) {
+    set_errno(EINVAL);
+    return -1;
+  }
+
+  struct wkp_work* w = (struct wkp_work*)calloc(1, sizeof(struct wkp_work));
+  if (!w) {
+    set_errno(ENOMEM);
+    return -1;
+  }
+  w->work = work;
+  w->done = done;
+  w->arg = arg;
+  w->since = wkp_now_us();
+
+  // without workers, run in place
+  if (!m_running) {
+    m_stat.submitted++;
+    errno = 0;
+    w->rc = work(arg);
+    w->err = errno;
+    wkp_finish(w);
+    return 0;
+  }
+
+  pthread_mutex_lock(&m_lock);
+  TAILQ_INSERT_TAIL(&m_queue, w, in_queue);
+  m_stat.submitted++;
+  m_stat.queued++;
+  if (m_stat.queued > m_stat.max_queued) {
+    m_stat.max_queued = m_stat.queued;
+  }
+  pthread_cond_signal(&m_cond);
+  pthread_mutex_unlock(&m_lock);
+  return 0;
+}
+
+int _API wkp_complete(void) {
+  int n = 0;
+  uint64_t cnt;
+  struct wkp_work* w;
+  struct wkp_queue done;
+
+  if (m_fds[0] < 0) {
+    return 0;
+  }
+
+  // clear the wake-up before taking the works
+  while (read(m_fds[0], &cnt, sizeof(cnt)) > 0) {
+  }
+
+  TAILQ_INIT(&done);
+  pthread_mutex_lock(&m_lock);
+  TAILQ_CONCAT(&done, &m_done, in_queue);
+  pthread_mutex_unlock(&m_lock);
+
+  while ((w = TAILQ_FIRST(&done)) != NULL) {
+    TAILQ_REMOVE(&done, w, in_queue);
+    wkp_finish(w);
+    n++;
+  }
+  return n;
+}
+
+void _API wkp_get_stat(struct wkp_stat* st) {
+  if (!st) {
+    return;
+  }
+
+  pthread_mutex_lock(&m_lock);
+  *st = m_stat;
+  pthread_mutex_unlock(&m_lock);
+}
@@ -0,0 +1,50 @@
+#ifndef _TURF_POOL_H_
+#define _TURF_POOL_H_
+
+#include "misc.h"
+
+/* worker pool for the blocking work of turfd,
+ *  a work runs on one of the worker threads, and its done callback runs
+ *  on the loop thread, woken by the completion fd (eventfd).
+ */
+
+#define WKP_DEFAULT_THREADS (4)
+#define WKP_MAX_THREADS (64)
+
+// run on a worker, return the result, errno is taken with it.
+typedef int (*wkp_work_fn)(void* arg);
+
+// run on the loop thread, err is the errno of work.
+typedef void (*wkp_done_fn)(void* arg, int rc, int err);
+
+// pool statistics
+struct wkp_stat {
+  uint32_t threads;     // worker threads
+  uint32_t queued;      // works waiting for a worker
+  uint32_t running;     // works on the workers
+  uint32_t max_queued;  // the max queue depth seen
+  uint64_t submitted;   // works submitted
+  uint64_t completed;   // done callbacks called
+  uint64_t last_us;     // latency of the last work, from submit to done
+  uint64_t max_us;      // the max latency
+};
+
+// start the workers
+int _API wkp_start(int threads);
+
+// finish the queued works, stop the workers, and call the done callbacks.
+void _API wkp_stop(void);
+
+// the fd readable when works completed, -1 if not started.
+int _API wkp_fd(void);
+
+// submit a work, run inline if the pool is not started.
+int _API wkp_submit(wkp_work_fn work, wkp_done_fn done, void* arg);
+
+// call done callbacks of the completed works, return the number.
+int _API wkp_complete(void);
+
+// read the statistics
+void _API wkp_get_stat(struct wkp_stat* st);
+
+#endif  // _TURF_POOL_H_
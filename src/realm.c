@@ -224,7 +224,15 @@ int _API rlm_wait(struct rlm_t* r, int* exit_code, struct rusage* ru) {
 
 // kill a realm.
 int _API rlm_kill(struct rlm_t* r, int sig) {
-  int rc = kill(r->st.child_pid, sig);
+  int rc;
+
+#if defined(__NR_pidfd_send_signal)
+  // pidfd can not hit a reused pid.
+  if (r->st.pidfd > 0) {
+    rc = syscall(__NR_pidfd_send_signal, r->st.pidfd, sig, NULL, 0);
+  } else
+#endif
+    rc = kill(r->st.child_pid, sig);
 
   // stopping state
   if (sig == SIGKILL || sig == SIGTERM) {
@@ -298,6 +306,14 @@ static int rlm_free_mounts(struct rlm_t* r) {
   return -1;
 }
 
+// a string of cfg, kept if in an arena
+static void rlm_free_str(struct rlm_t* r, char** s) {
+  if (!r->cfg.arena) {
+    free(*s);
+  }
+  *s = NULL;
+}
+
 // free the realm back to system.
 void _API rlm_free_inner(struct rlm_t* r) {
   if (!r) {
@@ -305,47 +321,39 @@ void _API rlm_free_inner(struct rlm_t* r) {
     return;
   }
 
-  // free cfg
+  // free cfg, the one in an arena goes with it.
+  bool heap = !r->cfg.arena;
   if (r->cfg.env) {
-    ssfree(r->cfg.env);
+    if (heap) {
+      ssfree(r->cfg.env);
+    }
     r->cfg.env = NULL;
   }
 
   if (r->cfg.argv) {
-    ssfree(r->cfg.argv);
+    if (heap) {
+      ssfree(r->cfg.argv);
+    }
     r->cfg.argv = NULL;
   }
   r->cfg.argc = 0;
 
-  if (r->cfg.binary) {
-    free(r->cfg.binary);
-    r->cfg.binary = NULL;
-  }
-
-  if (r->cfg.chroot_dir) {
-    free(r->cfg.chroot_dir);
-    r->cfg.chroot_dir = NULL;
-  }
-
-  if (r->cfg.fd_stdout) {
-    free(r->cfg.fd_stdout);
-    r->cfg.fd_stdout = NULL;
-  }
-
-  if (r->cfg.fd_stderr) {
-    free(r->cfg.fd_stderr);
-    r->cfg.fd_stderr = NULL;
-  }
-
-  if (r->cfg.name) {
-    free(r->cfg.name);
-    r->cfg.name = NULL;
-  }
+  rlm_free_str(r, &r->cfg.binary);
+  rlm_free_str(r, &r->cfg.chroot_dir);
+  rlm_free_str(r, &r->cfg.fd_stdout);
+  rlm_free_str(r, &r->cfg.fd_stderr);
+  rlm_free_str(r, &r->cfg.name);
+  r->cfg.arena = NULL;
 
   if (!SLIST_EMPTY(&r->cfg.mounts)) {
     rlm_free_mounts(r);
   }
 
+  if (r->st.pidfd > 0) {
+    close(r->st.pidfd);
+    r->st.pidfd = 0;
+  }
+
   r->st.state = 0;
 }
 
@@ -367,6 +375,65 @@ int _API rlm_socketpair(struct rlm_t* r, int sv[2]) {
   return 0;
 }
 
+// keep the fd open in the sandbox, the caller owns it.
+int _API rlm_keep_fd(struct rlm_t* r, int fd) {
+  if (!r || fd < 0) {
+    set_errno(EINVAL);
+    return -1;
+  }
+  if (r->cfg.nr_keep_fds == RLM_MAX_KEEP_FDS) {
+    set_errno(ENOSPC);
+    return -1;
+  }
+  r->cfg.keep_fds[r->cfg.nr_keep_fds++] = fd;
+  return 0;
+}
+
+/* open a pidfd refers to the child, the pidfd gets readable when child exits.
+ * return the pidfd, or -1 with ENOSYS on old kernel.
+ */
+int _API rlm_pidfd(struct rlm_t* r) {
+  if (r->st.child_pid <= 0) {
+    set_errno(ECHILD);
+    return -1;
+  }
+
+  if (r->st.pidfd > 0) {
+    return r->st.pidfd;
+  }
+
+#if defined(__NR_pidfd_open)
+  int fd = syscall(__NR_pidfd_open, r->st.child_pid, 0);
+  if (fd < 0) {
+    return -1;
+  }
+
+  // pidfd is always close-on-exec
+  r->st.pidfd = fd;
+  return fd;
+#else
+  set_errno(ENOSYS);
+  return -1;
+#endif
+}
+
+// return true if kernel supports pidfd
+bool _API rlm_pidfd_supported(void) {
+#if defined(__NR_pidfd_open)
+  static int supported = -1;
+  if (supported < 0) {
+    int fd = syscall(__NR_pidfd_open, getpid(), 0);
+    supported = (fd >= 0);
+    if (fd >= 0) {
+      close(fd);
+    }
+  }
+  return supported;
+#else
+  return false;
+#endif
+}
+
 // read the realm's resource usage
 int _API rlm_rusage(struct rlm_t* r) {
   return -1;
@@ -1,6 +1,7 @@
 #ifndef _TURF_REALM_H_
 #define _TURF_REALM_H_
 
+#include "arena.h"
 #include "misc.h"
 
 #define RLM_DEF_UID 36767
@@ -8,6 +9,8 @@
 #define RLM_DEF_CAPB 0x0
 #define RLM_DEF_CGROUP_DIR "/sys/fs/cgroup"
 
+#define RLM_MAX_KEEP_FDS 4  // fds inherited by the child, besides sv[1]
+
 #define RLM_MODE_FALLBACK 0  // without any priviliage
 #define RLM_MODE_SYSADMIN 1  // full cap_sysadmin support
 
@@ -70,11 +73,17 @@ struct rlm_cfg {
   char* fd_stderr;  // stderr redirect
 
   int sv[2];  // socketpair
+
+  int keep_fds[RLM_MAX_KEEP_FDS];  // more fds inherited by the child
+  int nr_keep_fds;
+
+  struct arena* arena;  // the strings are in it if set, owned by the caller
 };
 
 // realm states
 struct rlm_st {
   pid_t child_pid;          // child pid
+  int pidfd;                // pidfd of the child, 0 if not opened
   uint32_t state;           // RLM_STATE_XXX, running, stopped ...
   uint32_t status;          // RLM_STATUS_XXX, OOM, killed ...
   struct timeval tv_start;  // start time
@@ -116,6 +125,8 @@ int _API rlm_handle_exit(struct rlm_t* r,
 const char _API* rlm_state_str(int state);    // return state string
 uint32_t _API rlm_state(const char* str);     // state string to enum
 int _API rlm_fork(struct rlm_t* r);           // fork the rlm
+int _API rlm_pidfd(struct rlm_t* r);          // open pidfd of the child
+bool _API rlm_pidfd_supported(void);          // kernel supports pidfd
 
 // adjust the realm
 int _API rlm_setuid(struct rlm_t* r, uid_t uid);
@@ -133,5 +144,6 @@ int _API rlm_env(struct rlm_t* r, char** env);
 int _API rlm_arg(struct rlm_t* r, int argc, char* argv[]);
 int _API rlm_binary(struct rlm_t* r, char* path);
 int _API rlm_socketpair(struct rlm_t* r, int sv[2]);
+int _API rlm_keep_fd(struct rlm_t* r, int fd);
 
 #endif  //_TURF_REALM_H_
@@ -145,6 +145,9 @@ static int fallback_run(struct rlm_t* t) {
       // keep_fds[k++] = t->cfg.sv[0];
       keep_fds[k++] = t->cfg.sv[1];
     }
+    for (int i = 0; i < t->cfg.nr_keep_fds; i++) {
+      keep_fds[k++] = t->cfg.keep_fds[i];
+    }
 
     close_fds(keep_fds, k);
   }
@@ -299,7 +302,7 @@ static int fallback_fork(struct rlm_t* t) {
 #if 0
     // close fds
     {
-        int keep_fds[128]; // reserved max
+        int keep_fds[128];  // reserved max
         int k = 0;
 
         // stdin, out, err
@@ -0,0 +1,175 @@
+/* sha256, FIPS 180-4
+ */
+#include "sha256.h"
+
+static const uint32_t sha256_k[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1,
+    0x923f82a4, 0xab1c5ed5, 0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3,
+    0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174, 0xe49b69c1, 0xefbe4786,
+    0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147,
+    0x06ca6351, 0x14292967, 0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13,
+    0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85, 0xa2bfe8a1, 0xa81a664b,
+    0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a,
+    0x5b9cca4f, 0x682e6ff3, 0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208,
+    0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2};
+
+#define ROR(x, n) (((x) >> (n)) | ((x) << (32 - (n))))
+
+static void sha256_block(struct sha256_ctx* c, const uint8_t* p) {
+  int i;
+  uint32_t w[64];
+  uint32_t a, b, d, e, f, g, h, cc, t1, t2;
+
+  for (i = 0; i < 16; i++) {
+    w[i] = (uint32_t)p[i * 4] << 24 | (uint32_t)p[i * 4 + 1] << 16 |
+           (uint32_t)p[i * 4 + 2] << 8 | (uint32_t)p[i * 4 + 3];
+  }
+  for (i = 16; i < 64; i++) {
+    uint32_t s0 = ROR(w[i - 15], 7) ^ ROR(w[i - 15], 18) ^ (w[i - 15] >> 3);
+    uint32_t s1 = ROR(w[i - 2], 17) ^ ROR(w[i - 2], 19) ^ (w[i - 2] >> 10);
+    w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+  }
+
+  a = c->h[0];
+  b = c->h[1];
+  cc = c->h[2];
+  d = c->h[3];
+  e = c->h[4];
+  f = c->h[5];
+  g = c->h[6];
+  h = c->h[7];
+
+  for (i = 0; i < 64; i++) {
+    t1 = h + (ROR(e, 6) ^ ROR(e, 11) ^ ROR(e, 25)) + ((e & f) ^ (~e & g)) +
+         sha256_k[i] + w[i];
+    t2 = (ROR(a, 2) ^ ROR(a, 13) ^ ROR(a, 22)) +
+         ((a & b) ^ (a & cc) ^ (b & cc));
+    h = g;
+    g = f;
+    f = e;
+    e = d + t1;
+    d = cc;
+    cc = b;
+    b = a;
+    a = t1 + t2;
+  }
+
+  c->h[0] += a;
+  c->h[1] += b;
+  c->h[2] += cc;
+  c->h[3] += d;
+  c->h[4] += e;
+  c->h[5] += f;
+  c->h[6] += g;
+  c->h[7] += h;
+}
+
+void _API sha256_init(struct sha256_ctx* c) {
+  static const uint32_t h0[8] = {0x6a09e667,
+                                 0xbb67ae85,
+                                 0x3c6ef372,
+                                 0xa54ff53a,
+                                 0x510e527f,
+                                 0x9b05688c,
+                                 0x1f83d9ab,
+                                 0x5be0cd19};
+  memcpy(c->h, h0, sizeof(h0));
+  c->len = 0;
+  c->n = 0;
+}
+
+void _API sha256_update(struct sha256_ctx* c, const void* data, size_t size) {
+  const uint8_t* p = (const uint8_t*)data;
+
+  c->len += size;
+  if (c->n) {
+    size_t take = 64 - c->n < size ? 64 - c->n : size;
+    memcpy(c->buf + c->n, p, take);
+    c->n += take;
+    p += take;
+    size -= take;
+    if (c->n < 64) {
+      return;
+    }
+    sha256_block(c, c->buf);
+    c->n = 0;
+  }
+
+  while (size >= 64) {
+    sha256_block(c, p);
+    p += 64;
+    size -= 64;
+  }
+
+  memcpy(c->buf, p, size);
+  c->n = size;
+}
+
+void _API sha256_final(struct sha256_ctx* c, uint8_t out[SHA256_SIZE]) {
+  int i;
+  uint64_t bits = c->len * 8;
+
+  // 0x80, zeros, then the length in bits
+  c->buf[c->n++] = 0x80;
+  if (c->n > 56) {
+    memset(c->buf + c->n, 0, 64 - c->n);
+    sha256_block(c, c->buf);
+    c->n = 0;
+  }
+  memset(c->buf + c->n, 0, 56 - c->n);
+  for (i = 0; i < 8; i++) {
+    c->buf[56 + i] = bits >> (56 - i * 8);
+  }
+  sha256_block(c, c->buf);
+
+  for (i = 0; i < 8; i++) {
+    out[i * 4] = c->h[i] >> 24;
+    out[i * 4 + 1] = c->h[i] >> 16;
+    out[i * 4 + 2] = c->h[i] >> 8;
+    out[i * 4 + 3] = c->h[i];
+  }
+}
+
+void _API sha256_hex(const uint8_t digest[SHA256_SIZE],
+                     char out[SHA256_HEX_SIZE]) {
+  static const char hex[] = "0123456789abcdef";
+  int i;
+  for (i = 0; i < SHA256_SIZE; i++) {
+    out[i * 2] = hex[digest[i] >> 4];
+    out[i * 2 + 1] = hex[digest[i] & 0xf];
+  }
+  out[SHA256_SIZE * 2] = 0;
+}
+
+int _API sha256_file(int dirfd, const char* path, char hex[SHA256_HEX_SIZE]) {
+  char buf[64 * 1024];
+  uint8_t digest[SHA256_SIZE];
+  struct sha256_ctx ctx;
+  ssize_t n;
+
+  int fd = openat(dirfd, path, O_RDONLY | O_CLOEXEC | O_NOFOLLOW);
+  if (fd < 0) {
+    return -1;
+  }
+
+  sha256_init(&ctx);
+  while ((n = read(fd, buf, sizeof(buf))) != 0) {
+    if (n < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      int err = errno;
+      close(fd);
+      errno = err;
+      return -1;
+    }
+    sha256_update(&ctx, buf, n);
+  }
+  close(fd);
+
+  sha256_final(&ctx, digest);
+  sha256_hex(digest, hex);
+  return 0;
+}
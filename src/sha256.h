@@ -0,0 +1,30 @@
+#ifndef _TURF_SHA256_H_
+#define _TURF_SHA256_H_
+
+#include <stdint.h>
+#include <unistd.h>
+
+#include "misc.h"
+
+#define SHA256_SIZE (32)                       // digest in bytes
+#define SHA256_HEX_SIZE (SHA256_SIZE * 2 + 1)  // hex string, '\0' included
+
+struct sha256_ctx {
+  uint32_t h[8];
+  uint64_t len;  // bytes hashed
+  uint8_t buf[64];
+  size_t n;  // bytes in buf
+};
+
+void _API sha256_init(struct sha256_ctx* c);
+void _API sha256_update(struct sha256_ctx* c, const void* data, size_t size);
+void _API sha256_final(struct sha256_ctx* c, uint8_t out[SHA256_SIZE]);
+
+// digest in lower case hex
+void _API sha256_hex(const uint8_t digest[SHA256_SIZE],
+                     char out[SHA256_HEX_SIZE]);
+
+// digest of the file content, path is relative to dirfd.
+int _API sha256_file(int dirfd, const char* path, char hex[SHA256_HEX_SIZE]);
+
+#endif  // _TURF_SHA256_H_
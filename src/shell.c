@@ -2,6 +2,7 @@
  *   environ, file access ... etc
  */
 #include "shell.h"
+#include "copy.h"
 
 // static const char *m_workdir = NULL;
 
@@ -82,6 +83,46 @@ const char _API* tfd_path_sock() {
   return p;
 }
 
+const char _API* tfd_path_stbl() {
+  static char* p = NULL;
+  if (!p) {
+    xasprintf(&p, "%s/%s", tfd_path(), "state.tbl");
+  }
+  return p;
+}
+
+const char _API* tfd_path_farm() {
+  static char* p = NULL;
+  if (!p) {
+    xasprintf(&p, "%s/%s", tfd_path(), "farm");
+  }
+  return p;
+}
+
+const char _API* tfd_path_cache() {
+  static char* p = NULL;
+  if (!p) {
+    xasprintf(&p, "%s/%s", tfd_path(), "cache");
+  }
+  return p;
+}
+
+const char _API* tfd_path_trash() {
+  static char* p = NULL;
+  if (!p) {
+    xasprintf(&p, "%s/%s", tfd_path(), "trash");
+  }
+  return p;
+}
+
+const char _API* tfd_path_spare() {
+  static char* p = NULL;
+  if (!p) {
+    xasprintf(&p, "%s/%s", tfd_path(), "spare");
+  }
+  return p;
+}
+
 const char _API* tfd_path_libturf() {
   static char* p = NULL;
 
@@ -213,23 +254,240 @@ int _API shl_path4(char* buf,
 }
 
 int _API shl_cp(const char* src, const char* dest, const char* name) {
-  char cmd[TURF_MAX_CMD_LEN];
+  char path[TURF_MAX_PATH_LEN];
   if (name) {  // with filename
-    snprintf(cmd, sizeof(cmd), "cp -Rf '%s' '%s/%s'", src, dest, name);
-  } else {
-    snprintf(cmd, sizeof(cmd), "cp -Rf '%s' '%s'", src, dest);
+    snprintf(path, sizeof(path), "%s/%s", dest, name);
+    dest = path;
   }
-  return system(cmd);
+  return cpy_path(src, dest, NULL);
 }
 
 int _API shl_rmdir2(const char* parent, const char* dir) {
-  char cmd[TURF_MAX_CMD_LEN];
+  char path[TURF_MAX_PATH_LEN];
 
   // TBD: very dangerous op.
   if ((strlen(parent) + strlen(dir)) < 10) {
     return -1;
   }
 
-  snprintf(cmd, sizeof(cmd), "rm -r '%s/%s'", parent, dir);
-  return system(cmd);
+  snprintf(path, sizeof(path), "%s/%s", parent, dir);
+  return shl_rmtree(path);
+}
+
+// a dir in removing, the files go at once, the subdirs one by one.
+struct shl_rm_level {
+  char** dirs;  // subdirs to remove
+  size_t n;
+  size_t cap;
+  size_t next;  // the one in removing is dirs[next - 1]
+  dev_t dev;    // the dir itself, checked when back from a subdir
+  ino_t ino;
+};
+
+static void shl_rm_free(struct shl_rm_level* l) {
+  size_t i;
+  for (i = 0; i < l->n; i++) {
+    free(l->dirs[i]);
+  }
+  free(l->dirs);
+  memset(l, 0, sizeof(*l));
+}
+
+// unlink in fd, the dir is made writable if denied.
+static int shl_rm_unlink(int fd, const char* name, int flags) {
+  if (unlinkat(fd, name, flags) == 0 || errno == ENOENT) {
+    return 0;
+  }
+  if ((errno != EACCES && errno != EPERM) || fchmod(fd, S_IRWXU) < 0) {
+    return -1;
+  }
+  if (unlinkat(fd, name, flags) == 0 || errno == ENOENT) {
+    return 0;
+  }
+  return -1;
+}
+
+// open the subdir on the same filesystem, made readable if denied.
+static int shl_rm_open(int fd, const char* name, dev_t dev) {
+  struct stat st;
+  int flags = O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC;
+
+  int sub = openat(fd, name, flags);
+  if (sub < 0 && errno == EACCES && fchmodat(fd, name, S_IRWXU, 0) == 0) {
+    sub = openat(fd, name, flags);
+  }
+  if (sub < 0) {
+    return -1;
+  }
+
+  if (fstat(sub, &st) < 0 || st.st_dev != dev) {
+    close(sub);
+    set_errno(EXDEV);
+    return -1;
+  }
+  return sub;
+}
+
+// unlink the files in fd, and list the subdirs.
+static int shl_rm_scan(int fd, struct shl_rm_level* l) {
+  struct dirent* ino;
+  struct stat st;
+
+  int dfd = dup(fd);
+  DIR* dir = dfd < 0 ? NULL : fdopendir(dfd);
+  if (!dir) {
+    if (dfd >= 0) {
+      close(dfd);
+    }
+    return -1;
+  }
+
+  int rc = 0;
+  while (rc == 0 && (ino = readdir(dir)) != NULL) {
+    const char* name = ino->d_name;
+    if (strcmp(name, ".") == 0 || strcmp(name, "..") == 0) {
+      continue;
+    }
+
+    bool is_dir = ino->d_type == DT_DIR;
+    if (ino->d_type == DT_UNKNOWN) {
+      is_dir = fstatat(fd, name, &st, AT_SYMLINK_NOFOLLOW) == 0 &&
+               S_ISDIR(st.st_mode);
+    }
+    if (!is_dir) {
+      rc = shl_rm_unlink(fd, name, 0);
+      continue;
+    }
+
+    if (l->n == l->cap) {
+      size_t cap = l->cap ? l->cap * 2 : 16;
+      char** p = (char**)realloc(l->dirs, cap * sizeof(char*));
+      if (!p) {
+        set_errno(ENOMEM);
+        rc = -1;
+        break;
+      }
+      l->dirs = p;
+      l->cap = cap;
+    }
+    l->dirs[l->n] = strdup(name);
+    if (!l->dirs[l->n]) {
+      set_errno(ENOMEM);
+      rc = -1;
+      break;
+    }
+    l->n++;
+  }
+
+  int err = errno;
+  closedir(dir);
+  errno = err;
+  return rc;
+}
+
+int _API shl_rmtree(const char* path) {
+  int fd;
+  int rc = -1;
+  size_t depth = 0, cap = 0;
+  struct shl_rm_level* levels = NULL;
+  struct stat st;
+
+  if (!path) {
+    set_errno(EINVAL);
+    return -1;
+  }
+  if (lstat(path, &st) < 0) {
+    return errno == ENOENT ? 0 : -1;
+  }
+  if (!S_ISDIR(st.st_mode)) {
+    return unlink(path);
+  }
+
+  fd = open(path, O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+  if (fd < 0) {
+    return -1;
+  }
+
+  /* down into the subdirs, and back by "..", no fd is held per level.
+   *  a dir moved meanwhile leads ".." elsewhere, the walk stops (ESTALE).
+   */
+  do {
+    if (depth == cap) {
+      cap = cap ? cap * 2 : 16;
+      struct shl_rm_level* p = (struct shl_rm_level*)realloc(
+          levels, cap * sizeof(struct shl_rm_level));
+      if (!p) {
+        set_errno(ENOMEM);
+        goto exit;
+      }
+      levels = p;
+    }
+    memset(&levels[depth], 0, sizeof(struct shl_rm_level));
+    if (fstat(fd, &st) < 0) {
+      goto exit;
+    }
+    levels[depth].dev = st.st_dev;
+    levels[depth].ino = st.st_ino;
+    if (shl_rm_scan(fd, &levels[depth++]) < 0) {
+      goto exit;
+    }
+
+    while (depth > 0) {
+      struct shl_rm_level* l = &levels[depth - 1];
+      if (l->next < l->n) {
+        int sub = shl_rm_open(fd, l->dirs[l->next++], levels[0].dev);
+        if (sub < 0 && errno == ENOENT) {
+          continue;
+        }
+        if (sub < 0) {
+          goto exit;
+        }
+        close(fd);
+        fd = sub;
+        break;
+      }
+
+      // empty now, removed from the parent
+      shl_rm_free(l);
+      if (--depth == 0) {
+        break;
+      }
+      int up = openat(fd, "..", O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+      if (up < 0) {
+        goto exit;
+      }
+      close(fd);
+      fd = up;
+      l = &levels[depth - 1];
+      if (fstat(fd, &st) < 0) {
+        goto exit;
+      }
+      if (st.st_dev != l->dev || st.st_ino != l->ino) {
+        set_errno(ESTALE);
+        goto exit;
+      }
+      if (shl_rm_unlink(fd, l->dirs[l->next - 1], AT_REMOVEDIR) < 0) {
+        goto exit;
+      }
+    }
+  } while (depth > 0);
+
+  close(fd);
+  fd = -1;
+  if (rmdir(path) < 0 && errno != ENOENT) {
+    goto exit;
+  }
+  rc = 0;
+
+exit:;
+  int err = errno;
+  if (fd >= 0) {
+    close(fd);
+  }
+  while (depth > 0) {
+    shl_rm_free(&levels[--depth]);
+  }
+  free(levels);
+  errno = err;
+  return rc;
 }
@@ -13,6 +13,11 @@ const char _API* tfd_path_sandbox();
 const char _API* tfd_path_runtime();
 const char _API* tfd_path_overlay();
 const char _API* tfd_path_sock();
+const char _API* tfd_path_stbl();
+const char _API* tfd_path_farm();
+const char _API* tfd_path_cache();
+const char _API* tfd_path_trash();
+const char _API* tfd_path_spare();
 const char _API* tfd_path_libturf();
 
 // shell operations
@@ -44,4 +49,9 @@ int _API shl_path4(char* buf,
 int _API shl_cp(const char* src, const char* dest, const char* name);
 int _API shl_rmdir2(const char* parent, const char* dir);
 
+/* remove path like 'rm -rf', natively by unlinkat() walking the tree with
+ *  one fd, the tree is never left to another filesystem.
+ */
+int _API shl_rmtree(const char* path);
+
 #endif  // _TURF_SHELL_H_
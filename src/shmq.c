@@ -0,0 +1,254 @@
+/* shared memory queues of turfd and the warmfork seeds
+ */
+
+#include "shmq.h"
+#include "ipc.h"  // struct tipc_hdr
+
+#if defined(__linux__)
+#include <sys/eventfd.h>  // eventfd()
+#include <sys/mman.h>     // mmap(), memfd_create()
+
+#define SHQ_MASK (SHQ_SIZE - 1)
+#define SHQ_HDR (8)             // len of record, and a padding
+#define SHQ_WRAP (0xffffffffU)  // the rest to the end is skipped
+#define SHQ_REC(len) (SHQ_HDR + MEM_ALIGN((len), 8))
+#define SHQ_MAP_SIZE (2 * (sizeof(struct shq_ctl) + SHQ_SIZE))
+
+// both queues in the mapping, ctl before data
+static void shq_pair_layout(struct shq_pair* p) {
+  char* cur = p->base;
+
+  p->req.ctl = (struct shq_ctl*)cur;
+  p->req.data = cur + sizeof(struct shq_ctl);
+  cur += sizeof(struct shq_ctl) + SHQ_SIZE;
+  p->rsp.ctl = (struct shq_ctl*)cur;
+  p->rsp.data = cur + sizeof(struct shq_ctl);
+}
+
+static int shq_pair_map(struct shq_pair* p) {
+  void* base = mmap(
+      NULL, SHQ_MAP_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, p->memfd, 0);
+  if (base == MAP_FAILED) {
+    return -1;
+  }
+  p->base = (char*)base;
+  shq_pair_layout(p);
+  return 0;
+}
+
+int _API shq_pair_create(struct shq_pair* p) {
+  if (!p) {
+    set_errno(EINVAL);
+    return -1;
+  }
+
+  // not CLOEXEC, the seed inherits them.
+  memset(p, 0, sizeof(struct shq_pair));
+  p->req.efd = p->rsp.efd = -1;
+  p->memfd = memfd_create("turf-shq", 0);
+  if (p->memfd < 0 || ftruncate(p->memfd, SHQ_MAP_SIZE) < 0 ||
+      shq_pair_map(p) < 0) {
+    goto error;
+  }
+
+  p->req.efd = eventfd(0, EFD_NONBLOCK);
+  p->rsp.efd = eventfd(0, EFD_NONBLOCK);
+  if (p->req.efd < 0 || p->rsp.efd < 0) {
+    goto error;
+  }
+  return 0;
+
+error:
+  shq_pair_close(p);
+  return -1;
+}
+
+int _API shq_pair_open(struct shq_pair* p, const char* spec) {
+  if (!p || !spec) {
+    set_errno(EINVAL);
+    return -1;
+  }
+
+  memset(p, 0, sizeof(struct shq_pair));
+  if (sscanf(spec, "%d,%d,%d", &p->memfd, &p->req.efd, &p->rsp.efd) != 3 ||
+      p->memfd < 0 || p->req.efd < 0 || p->rsp.efd < 0) {
+    set_errno(EINVAL);
+    return -1;
+  }
+
+  struct stat st;
+  if (fstat(p->memfd, &st) < 0 || st.st_size != (off_t)SHQ_MAP_SIZE) {
+    set_errno(EINVAL);
+    return -1;
+  }
+  return shq_pair_map(p);
+}
+
+int _API shq_pair_spec(struct shq_pair* p, char* buf, size_t size) {
+  if (!p || !buf) {
+    set_errno(EINVAL);
+    return -1;
+  }
+  return snprintf(buf, size, "%d,%d,%d", p->memfd, p->req.efd, p->rsp.efd);
+}
+
+void _API shq_pair_close(struct shq_pair* p) {
+  if (!p) {
+    return;
+  }
+
+  if (p->base) {
+    munmap(p->base, SHQ_MAP_SIZE);
+  }
+  if (p->memfd >= 0) {
+    close(p->memfd);
+  }
+  if (p->req.efd >= 0) {
+    close(p->req.efd);
+  }
+  if (p->rsp.efd >= 0) {
+    close(p->rsp.efd);
+  }
+  memset(p, 0, sizeof(struct shq_pair));
+  p->memfd = p->req.efd = p->rsp.efd = -1;
+}
+
+char _API* shq_reserve(struct shq* q, uint32_t len) {
+  if (SHQ_REC(len) > SHQ_SIZE / 2) {
+    set_errno(EMSGSIZE);
+    return NULL;
+  }
+
+  uint32_t head = q->ctl->head;  // own
+  uint32_t tail = __atomic_load_n(&q->ctl->tail, __ATOMIC_ACQUIRE);
+  uint32_t room = SHQ_SIZE - (head - tail);
+  uint32_t off = head & SHQ_MASK;
+  uint32_t skip = SHQ_SIZE - off;
+
+  // a record never wraps, the rest is skipped
+  if (SHQ_REC(len) <= skip) {
+    skip = 0;
+  }
+  if (skip + SHQ_REC(len) > room) {
+    set_errno(EAGAIN);
+    return NULL;
+  }
+
+  if (skip) {
+    *(uint32_t*)(q->data + off) = SHQ_WRAP;
+  }
+  q->resv = head + skip;
+  return q->data + (q->resv & SHQ_MASK) + SHQ_HDR;
+}
+
+int _API shq_commit(struct shq* q, uint32_t len) {
+  uint32_t head = q->ctl->head;
+  *(uint32_t*)(q->data + (q->resv & SHQ_MASK)) = len;
+
+  /* seq_cst pairs with shq_peek(), either the consumer sees the new head,
+   *  or we see it has drained all, and ring it.
+   */
+  __atomic_store_n(&q->ctl->head, q->resv + SHQ_REC(len), __ATOMIC_SEQ_CST);
+  uint32_t tail = __atomic_load_n(&q->ctl->tail, __ATOMIC_SEQ_CST);
+  if (tail != head) {
+    return 0;  // busy in draining
+  }
+
+  uint64_t one = 1;
+  if (write(q->efd, &one, sizeof(one)) < 0 && errno != EAGAIN) {
+    return -1;
+  }
+  return 0;
+}
+
+char _API* shq_peek(struct shq* q, uint32_t* len) {
+  uint32_t tail = q->ctl->tail;  // own
+
+  while (1) {
+    uint32_t head = __atomic_load_n(&q->ctl->head, __ATOMIC_SEQ_CST);
+    uint32_t used = head - tail;
+    if (used == 0) {
+      set_errno(EAGAIN);
+      return NULL;
+    }
+
+    // the head and the record are written by the peer, nothing trusted
+    uint32_t off = tail & SHQ_MASK;
+    uint32_t l = *(volatile uint32_t*)(q->data + off);
+    if (used > SHQ_SIZE) {
+      goto broken;
+    }
+    if (l == SHQ_WRAP) {
+      if (SHQ_SIZE - off > used) {
+        goto broken;
+      }
+      tail += SHQ_SIZE - off;
+      __atomic_store_n(&q->ctl->tail, tail, __ATOMIC_SEQ_CST);
+      continue;
+    }
+    if (l < sizeof(struct tipc_hdr) || l > TIPC_MSG_MAX_SIZE ||
+        SHQ_HDR + l > SHQ_SIZE - off || SHQ_REC(l) > used) {
+      goto broken;
+    }
+
+    q->take = SHQ_REC(l);
+    *len = l;
+    return q->data + off + SHQ_HDR;
+  }
+
+broken:
+  set_errno(EBADMSG);
+  return NULL;
+}
+
+void _API shq_consume(struct shq* q) {
+  uint32_t tail = q->ctl->tail;
+  __atomic_store_n(&q->ctl->tail, tail + q->take, __ATOMIC_SEQ_CST);
+  q->take = 0;
+}
+
+void _API shq_clear(struct shq* q) {
+  uint64_t n;
+  while (read(q->efd, &n, sizeof(n)) < 0 && errno == EINTR) {
+  }
+}
+
+#else  // the seeds are linux only
+
+int _API shq_pair_create(struct shq_pair* p) {
+  set_errno(ENOTSUP);
+  return -1;
+}
+
+int _API shq_pair_open(struct shq_pair* p, const char* spec) {
+  set_errno(ENOTSUP);
+  return -1;
+}
+
+int _API shq_pair_spec(struct shq_pair* p, char* buf, size_t size) {
+  set_errno(ENOTSUP);
+  return -1;
+}
+
+void _API shq_pair_close(struct shq_pair* p) {}
+
+char _API* shq_reserve(struct shq* q, uint32_t len) {
+  set_errno(ENOTSUP);
+  return NULL;
+}
+
+int _API shq_commit(struct shq* q, uint32_t len) {
+  set_errno(ENOTSUP);
+  return -1;
+}
+
+char _API* shq_peek(struct shq* q, uint32_t* len) {
+  set_errno(EAGAIN);
+  return NULL;
+}
+
+void _API shq_consume(struct shq* q) {}
+
+void _API shq_clear(struct shq* q) {}
+
+#endif  // __linux__
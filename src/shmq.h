@@ -0,0 +1,74 @@
+#ifndef _TURF_SHMQ_H_
+#define _TURF_SHMQ_H_
+
+#include "misc.h"
+
+/* single producer single consumer queues in shared memory,
+ *  a pair of them on a memfd carries the msgs of turfd and a warmfork seed.
+ *  a record is written and read in place, the eventfd of the queue rings
+ *  the consumer when the queue turns non-empty.
+ */
+
+#define SHQ_SIZE (256 * 1024)  // data of a queue, power of 2
+#define SHQ_ENV "TURFPHD_SHQ"  // "<memfd>,<req efd>,<rsp efd>" for the seed
+
+// the head of a queue in the shared memory, on its own cache lines
+struct shq_ctl {
+  uint32_t head;  // written by the producer
+  char pad0[60];
+  uint32_t tail;  // written by the consumer
+  char pad1[60];
+};
+
+// a queue, mapped by both sides
+struct shq {
+  struct shq_ctl* ctl;
+  char* data;     // SHQ_SIZE bytes
+  uint32_t resv;  // position of the record reserved, producer only
+  uint32_t take;  // size of the record peeked, consumer only
+  int efd;        // doorbell of the consumer
+};
+
+// req from turfd to the seed, rsp from the seed to turfd.
+struct shq_pair {
+  int memfd;
+  char* base;  // the mapping of memfd
+  struct shq req;
+  struct shq rsp;
+};
+
+// new pair on a memfd, the fds are inherited by the seed.
+int _API shq_pair_create(struct shq_pair* p);
+
+// map the pair of spec, which is from shq_pair_spec().
+int _API shq_pair_open(struct shq_pair* p, const char* spec);
+
+// the spec of pair, for SHQ_ENV
+int _API shq_pair_spec(struct shq_pair* p, char* buf, size_t size);
+
+// unmap and close the fds
+void _API shq_pair_close(struct shq_pair* p);
+
+/* room for a record of len bytes at most, written in place,
+ *  NULL with EAGAIN if the queue is full, or EMSGSIZE if len is too big.
+ */
+char _API* shq_reserve(struct shq* q, uint32_t len);
+
+/* publish the record reserved with its real len, the consumer is rung
+ *  if it may be waiting. -1 if the ring failed, the record is published.
+ */
+int _API shq_commit(struct shq* q, uint32_t len);
+
+/* the record at the tail, a tipc msg checked in the bounds of the queue.
+ *  NULL with EAGAIN if empty, or EBADMSG if the peer broke the queue.
+ *  the record stays writable by the peer, copy it before trusting.
+ */
+char _API* shq_peek(struct shq* q, uint32_t* len);
+
+// release the record of shq_peek(), by the size checked there
+void _API shq_consume(struct shq* q);
+
+// reset the doorbell, call before the draining.
+void _API shq_clear(struct shq* q);
+
+#endif  // _TURF_SHMQ_H_
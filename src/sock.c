@@ -2,6 +2,7 @@
  */
 
 #include "sock.h"
+#include "hmap.h"
 
 /* using EPOLL implementation for linux platform.
  * and SELECT for other platform, like macos.
@@ -401,20 +402,91 @@ static int sck_poll(struct sck_loop* loop, struct timeval* tvp) {
 }
 #endif
 
-static int64_t sck_calc_pop_time(struct sck_loop* loop) {
-  struct sck_evtimer* te = NULL;
-  struct sck_evtimer* earliest = NULL;
+/* timers are kept in a binary min-heap ordered by the pop time,
+ * the earliest timer is always at timers[0].
+ */
+static void sck_heap_set(struct sck_loop* loop,
+                         int idx,
+                         struct sck_evtimer* te) {
+  loop->timers[idx] = te;
+  te->heap_idx = idx;
+}
+
+static void sck_heap_up(struct sck_loop* loop, int idx) {
+  struct sck_evtimer* te = loop->timers[idx];
+  while (idx > 0) {
+    int parent = (idx - 1) / 2;
+    if (loop->timers[parent]->when <= te->when) {
+      break;
+    }
+    sck_heap_set(loop, idx, loop->timers[parent]);
+    idx = parent;
+  }
+  sck_heap_set(loop, idx, te);
+}
 
-  if (TAILQ_EMPTY(&loop->timer_head)) {
-    return -1;
+static void sck_heap_down(struct sck_loop* loop, int idx) {
+  struct sck_evtimer* te = loop->timers[idx];
+  while (1) {
+    int child = idx * 2 + 1;
+    if (child >= loop->timer_cnt) {
+      break;
+    }
+    if (child + 1 < loop->timer_cnt &&
+        loop->timers[child + 1]->when < loop->timers[child]->when) {
+      child++;
+    }
+    if (te->when <= loop->timers[child]->when) {
+      break;
+    }
+    sck_heap_set(loop, idx, loop->timers[child]);
+    idx = child;
   }
+  sck_heap_set(loop, idx, te);
+}
 
-  TAILQ_FOREACH(te, &loop->timer_head, in_list) {
-    if (!earliest || (te->when < earliest->when)) {
-      earliest = te;
+static int sck_heap_push(struct sck_loop* loop, struct sck_evtimer* te) {
+  if (loop->timer_cnt == loop->timer_setsize) {
+    int setsize = loop->timer_setsize ? loop->timer_setsize * 2 : 64;
+    struct sck_evtimer** timers = (struct sck_evtimer**)realloc(
+        loop->timers, setsize * sizeof(struct sck_evtimer*));
+    if (!timers) {
+      set_errno(ENOMEM);
+      return -1;
     }
+    loop->timers = timers;
+    loop->timer_setsize = setsize;
   }
 
+  sck_heap_set(loop, loop->timer_cnt++, te);
+  sck_heap_up(loop, te->heap_idx);
+  return 0;
+}
+
+// remove te from heap
+static void sck_heap_remove(struct sck_loop* loop, struct sck_evtimer* te) {
+  int idx = te->heap_idx;
+  struct sck_evtimer* last = loop->timers[--loop->timer_cnt];
+
+  te->heap_idx = -1;
+  if (last == te) {
+    return;
+  }
+
+  sck_heap_set(loop, idx, last);
+  if (idx > 0 && loop->timers[(idx - 1) / 2]->when > last->when) {
+    sck_heap_up(loop, idx);
+  } else {
+    sck_heap_down(loop, idx);
+  }
+}
+
+static int64_t sck_calc_pop_time(struct sck_loop* loop) {
+  if (loop->timer_cnt == 0) {
+    return -1;
+  }
+
+  struct sck_evtimer* earliest = loop->timers[0];
   sck_tick now = get_tick_us();
   if (now >= earliest->when) {
     return 0;
@@ -425,50 +497,54 @@ static int64_t sck_calc_pop_time(struct sck_loop* loop) {
 
 static int sck_process_timers(struct sck_loop* loop) {
   int processed = 0;
-  struct sck_evtimer *te = NULL, *te_save = NULL;
+  struct sck_evtimer* te = NULL;
+  struct sck_evtimer* fired = NULL;
+  struct sck_evtimer** tail = &fired;
 
-  sck_timer_id cur_id = loop->timer_id_next - 1;
   sck_tick now = get_tick_us();
 
-  TAILQ_FOREACH_SAFE(te, &loop->timer_head, in_list, te_save) {
-    // process deleted timer
-    if (te->id == SCK_ID_DELETED) {
-      if (te->refcnt) {  // in reference
-        dprint("refcnt %d", te->refcnt);
-        continue;
-      }
+  /* pop all expired timers out of the heap first,
+   * the timers created or re-armed in timer_proc() wait for next round.
+   */
+  while (loop->timer_cnt > 0 && loop->timers[0]->when <= now) {
+    te = loop->timers[0];
+    sck_heap_remove(loop, te);
+    te->next_fired = NULL;
+    *tail = te;
+    tail = &te->next_fired;
+  }
+
+  while (fired) {
+    te = fired;
+    fired = te->next_fired;
 
-      // free the timer
-      TAILQ_REMOVE(&loop->timer_head, te, in_list);
+    // deleted by previous timer_proc()
+    if (te->id == SCK_ID_DELETED) {
       free(te);
-      dprint("free %ld", te->id);
       continue;
     }
 
-    // skip iteration timers, what we created in timer_proc()
-    if (te->id > cur_id) {
+    int rc = te->timer_proc(loop, te->id, te->userdata);
+    processed++;
+
+    // deleted by itself
+    if (te->id == SCK_ID_DELETED) {
+      free(te);
       continue;
     }
 
-    // now we pop expired timer
-    if (te->when <= now) {
-      sck_timer_id id = te->id;
-
-      te->refcnt++;
-      int rc = te->timer_proc(loop, id, te->userdata);
-      te->refcnt--;
-
-      processed++;
-
-      /* perid timer based on the return code(in ms in future).
-       */
-      now = get_tick_us();
-      if (rc >= 0) {
-        te->when = now + (rc * 1000);
-      } else {
-        te->id = SCK_ID_DELETED;
+    /* perid timer based on the return code(in ms in future).
+     */
+    if (rc >= 0) {
+      te->when = get_tick_us() + (rc * 1000);
+      if (sck_heap_push(loop, te) == 0) {
+        continue;
       }
+      error("timer %ld re-arm failed", te->id);
     }
+
+    hmap_del(loop->timer_ids, te->id);
+    free(te);
   }
 
   return processed;
@@ -533,7 +609,11 @@ struct sck_loop _API* sck_loop_create(int setsize) {
 
   loop->setsize = setsize;
   loop->maxfd = -1;
-  TAILQ_INIT(&loop->timer_head);
+
+  loop->timer_ids = hmap_new(0);
+  if (!loop->timer_ids) {
+    goto error;
+  }
 
   loop->events = (struct sck_evfile*)calloc(setsize, sizeof(struct sck_evfile));
   if (!loop->events) {
@@ -561,6 +641,10 @@ error:
     if (loop->fired) {
       free(loop->fired);
     }
+    if (loop->timer_ids) {
+      hmap_free(loop->timer_ids);
+    }
+    free(loop);
   }
   return NULL;
 }
@@ -568,7 +652,7 @@ error:
 // return true if loop is not empty.
 bool sck_loop_alive(struct sck_loop* loop) {
   int i;
-  if (!TAILQ_EMPTY(&loop->timer_head)) {
+  if (loop->timer_cnt > 0) {
     return 1;
   }
   for (i = loop->maxfd; i >= 0; i--) {
@@ -650,6 +734,7 @@ sck_timer_id sck_create_timer(struct sck_loop* loop,
                               sck_tick ms,
                               sck_timer_callback* proc,
                               void* userdata) {
+  int rc;
   sck_tick tick = get_tick_us();
   struct sck_evtimer* te =
       (struct sck_evtimer*)calloc(1, sizeof(struct sck_evtimer));
@@ -661,21 +746,43 @@ sck_timer_id sck_create_timer(struct sck_loop* loop,
   te->when = tick + (ms * 1000);
   te->timer_proc = proc;
   te->userdata = userdata;
-  TAILQ_INSERT_TAIL(&loop->timer_head, te, in_list);
+
+  rc = hmap_put(loop->timer_ids, te->id, te);
+  if (rc < 0) {
+    goto error;
+  }
+
+  rc = sck_heap_push(loop, te);
+  if (rc < 0) {
+    hmap_del(loop->timer_ids, te->id);
+    goto error;
+  }
   return te->id;
+
+error:
+  free(te);
+  return -1;
 }
 
 // delete timer
 int sck_delete_timer(struct sck_loop* loop, sck_timer_id id) {
-  struct sck_evtimer* te = NULL;
-  TAILQ_FOREACH(te, &loop->timer_head, in_list) {
-    if (te->id == id) {  // flag it to be freed
-      te->id = SCK_ID_DELETED;
-      return 0;
-    }
+  struct sck_evtimer* te = hmap_get(loop->timer_ids, id);
+  if (!te) {
+    set_errno(ENOENT);
+    return -1;
   }
-  set_errno(ENOENT);
-  return -1;
+
+  hmap_del(loop->timer_ids, id);
+
+  // in the expired batch, flag it to be freed
+  if (te->heap_idx < 0) {
+    te->id = SCK_ID_DELETED;
+    return 0;
+  }
+
+  sck_heap_remove(loop, te);
+  free(te);
+  return 0;
 }
 
 int _API sck_read(int fd, char* buf, int count) {
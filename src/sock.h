@@ -16,6 +16,7 @@ typedef uint64_t sck_timer_id;  // unified timer id
 
 struct sck_loop;
 struct sck_poll_state;
+struct tf_hmap;
 
 #define SCK_TYPE_UNIX 1
 #define SCK_TYPE_TCP 2
@@ -46,10 +47,10 @@ struct sck_evfile {
 };
 
 struct sck_evtimer {
-  TAILQ_ENTRY(sck_evtimer) in_list;
   sck_timer_id id;  // birth tick
   sck_tick when;    // pop time
-  int refcnt;       // recursive reference count
+  int heap_idx;     // index in the timer heap, -1 if it is firing
+  struct sck_evtimer* next_fired;  // link of the expired batch
   sck_timer_callback* timer_proc;
   void* userdata;
 };
@@ -59,7 +60,10 @@ struct sck_loop {
   int setsize;
 
   struct sck_evfile* events;  // holds registered file events.
-  TAILQ_HEAD(sck_evtimer_list, sck_evtimer) timer_head;  // holds all timers
+  struct sck_evtimer** timers;  // binary min-heap ordered by when
+  int timer_cnt;                 // timers in the heap
+  int timer_setsize;             // heap capacity
+  struct tf_hmap* timer_ids;     // timer id to sck_evtimer
   sck_timer_id timer_id_next;
 
   struct sck_poll_state* poll_state;  // holds the poll states
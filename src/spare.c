@@ -0,0 +1,305 @@
+/* spare sandboxes of turfd
+ */
+
+#include "spare.h"
+#include "pool.h"   // wkp_submit()
+#include "shell.h"  // shl_rmtree()
+
+#include <pthread.h>
+
+// spares of a runtime
+struct spr_runtime {
+  char* name;
+  uint32_t ids[SPR_MAX_SIZE];  // the ready ones, taken from the end
+  uint32_t ready;
+  uint32_t refilling;
+};
+
+// a spare being made on the workers
+struct spr_job {
+  uint32_t gen;  // dropped if the spares are freed since
+  int rt;        // index of m_runtimes
+  uint32_t id;
+  uint64_t since;
+  char path[TURF_MAX_PATH_LEN];  // <root>/<runtime>/<id>
+};
+
+static pthread_mutex_t m_lock = PTHREAD_MUTEX_INITIALIZER;
+static char* m_root;
+static uint32_t m_size;
+static uint32_t m_gen;  // bumped by spr_free()
+static uint32_t m_next_id;
+static struct spr_runtime m_runtimes[SPR_MAX_RUNTIMES];
+static int m_nr_runtimes;
+static struct spr_stat m_stat;
+
+static uint64_t spr_now_us(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static void spr_path(char* buf, size_t size, int rt, uint32_t id) {
+  snprintf(buf, size, "%s/%s/%u", m_root, m_runtimes[rt].name, id);
+}
+
+// index of runtime, added if new
+static int spr_find(const char* runtime, bool add) {
+  int i;
+
+  for (i = 0; i < m_nr_runtimes; i++) {
+    if (strcmp(m_runtimes[i].name, runtime) == 0) {
+      return i;
+    }
+  }
+  if (!add) {
+    set_errno(ENOENT);
+    return -1;
+  }
+  if (m_nr_runtimes == SPR_MAX_RUNTIMES) {
+    set_errno(ENOSPC);
+    return -1;
+  }
+
+  char* name = strdup(runtime);
+  if (!name) {
+    set_errno(ENOMEM);
+    return -1;
+  }
+  shl_mkdir2(m_root, name);
+
+  memset(&m_runtimes[i], 0, sizeof(struct spr_runtime));
+  m_runtimes[i].name = name;
+  m_nr_runtimes++;
+  return i;
+}
+
+// on a worker, the same layout as a created sandbox
+static int spr_make(void* arg) {
+  struct spr_job* job = (struct spr_job*)arg;
+
+  if (shl_mkdir(job->path) < 0 || shl_mkdir2(job->path, "sandbox") < 0 ||
+      shl_mkdir2(job->path, "overlay") < 0 ||
+      shl_mkdir3(job->path, "overlay", "work") < 0 ||
+      shl_mkdir3(job->path, "overlay", "data") < 0) {
+    return -1;
+  }
+  return 0;
+}
+
+// on the loop, the spare is ready
+static void spr_made(void* arg, int rc, int err) {
+  struct spr_job* job = (struct spr_job*)arg;
+  uint64_t lat = spr_now_us() - job->since;
+  bool drop = 1;
+
+  pthread_mutex_lock(&m_lock);
+  if (job->gen == m_gen) {
+    struct spr_runtime* r = &m_runtimes[job->rt];
+    r->refilling--;
+    if (rc < 0) {
+      m_stat.failed++;
+    } else {
+      r->ids[r->ready++] = job->id;
+      m_stat.refilled++;
+      m_stat.last_us = lat;
+      if (lat > m_stat.max_us) {
+        m_stat.max_us = lat;
+      }
+      drop = 0;
+    }
+  }
+  pthread_mutex_unlock(&m_lock);
+
+  if (rc < 0) {
+    errno = err;
+    pwarn("make spare %s failed", job->path);
+  }
+  if (drop) {
+    shl_rmtree(job->path);
+  }
+  free(job);
+}
+
+int _API spr_init(const char* root, uint32_t size) {
+  if (!root) {
+    set_errno(EINVAL);
+    return -1;
+  }
+
+  spr_free();
+
+  // the spares of an earlier turfd are unknown
+  size = size > SPR_MAX_SIZE ? SPR_MAX_SIZE : size;
+  if (shl_rmtree(root) < 0 || (size && shl_mkdir(root) < 0)) {
+    return -1;
+  }
+
+  char* p = strdup(root);
+  if (!p) {
+    set_errno(ENOMEM);
+    return -1;
+  }
+
+  pthread_mutex_lock(&m_lock);
+  memset(&m_stat, 0, sizeof(m_stat));
+  m_root = p;
+  m_size = size;
+  pthread_mutex_unlock(&m_lock);
+  return 0;
+}
+
+void _API spr_free(void) {
+  char path[TURF_MAX_PATH_LEN];
+  struct spr_runtime rts[SPR_MAX_RUNTIMES];
+  int i, n;
+  uint32_t j;
+
+  // taken out in the lock, removed after
+  pthread_mutex_lock(&m_lock);
+  n = m_nr_runtimes;
+  memcpy(rts, m_runtimes, n * sizeof(struct spr_runtime));
+  memset(m_runtimes, 0, n * sizeof(struct spr_runtime));
+  m_nr_runtimes = 0;
+  m_gen++;
+
+  char* root = m_root;
+  m_root = NULL;
+  m_size = 0;
+  pthread_mutex_unlock(&m_lock);
+
+  for (i = 0; i < n; i++) {
+    for (j = 0; j < rts[i].ready; j++) {
+      snprintf(path,
+               sizeof(path),
+               "%s/%s/%u",
+               root,
+               rts[i].name,
+               rts[i].ids[j]);
+      shl_rmtree(path);
+    }
+    free(rts[i].name);
+  }
+  free(root);
+}
+
+int _API spr_fill(const char* runtime) {
+  struct spr_job* jobs[SPR_MAX_SIZE];
+  int i, n = 0;
+
+  if (!runtime) {
+    set_errno(EINVAL);
+    return -1;
+  }
+
+  pthread_mutex_lock(&m_lock);
+  int rt = m_size ? spr_find(runtime, true) : -1;
+  bool bad = m_size && rt < 0;
+  while (rt >= 0 && m_runtimes[rt].ready + m_runtimes[rt].refilling < m_size) {
+    struct spr_job* job = (struct spr_job*)calloc(1, sizeof(struct spr_job));
+    if (!job) {
+      set_errno(ENOMEM);
+      bad = 1;
+      break;
+    }
+    job->gen = m_gen;
+    job->rt = rt;
+    job->id = m_next_id++;
+    job->since = spr_now_us();
+    spr_path(job->path, sizeof(job->path), rt, job->id);
+    m_runtimes[rt].refilling++;
+    jobs[n++] = job;
+  }
+  pthread_mutex_unlock(&m_lock);
+
+  // out of the lock, spr_made() is called inline without the workers.
+  for (i = 0; i < n; i++) {
+    if (wkp_submit(spr_make, spr_made, jobs[i]) < 0) {
+      spr_made(jobs[i], -1, errno);
+      bad = 1;
+    }
+  }
+  return bad ? -1 : 0;
+}
+
+int _API spr_take(const char* runtime,
+                  const char* sandbox,
+                  const char* overlay) {
+  char path[TURF_MAX_PATH_LEN];
+  char src[TURF_MAX_PATH_LEN];
+
+  if (!runtime || !sandbox || !overlay) {
+    set_errno(EINVAL);
+    return -1;
+  }
+
+  pthread_mutex_lock(&m_lock);
+  if (!m_size) {
+    pthread_mutex_unlock(&m_lock);
+    set_errno(ENOENT);
+    return -1;
+  }
+
+  int rt = spr_find(runtime, false);
+  if (rt < 0 || m_runtimes[rt].ready == 0) {
+    m_stat.misses++;
+    pthread_mutex_unlock(&m_lock);
+    spr_fill(runtime);
+    set_errno(ENOENT);
+    return -1;
+  }
+
+  struct spr_runtime* r = &m_runtimes[rt];
+  spr_path(path, sizeof(path), rt, r->ids[--r->ready]);
+  pthread_mutex_unlock(&m_lock);
+
+  // both or none
+  shl_path2(src, sizeof(src), path, "sandbox");
+  if (rename(src, sandbox) < 0) {
+    goto error;
+  }
+  shl_path2(src, sizeof(src), path, "overlay");
+  if (rename(src, overlay) < 0) {
+    int err = errno;
+    shl_path2(src, sizeof(src), path, "sandbox");
+    rename(sandbox, src);
+    errno = err;
+    goto error;
+  }
+  rmdir(path);
+
+  pthread_mutex_lock(&m_lock);
+  m_stat.hits++;
+  pthread_mutex_unlock(&m_lock);
+  spr_fill(runtime);
+  return 0;
+
+error:
+  pwarn("take spare %s failed", path);
+  shl_rmtree(path);
+  pthread_mutex_lock(&m_lock);
+  m_stat.failed++;
+  pthread_mutex_unlock(&m_lock);
+  spr_fill(runtime);
+  return -1;
+}
+
+void _API spr_get_stat(struct spr_stat* st) {
+  int i;
+
+  if (!st) {
+    return;
+  }
+
+  pthread_mutex_lock(&m_lock);
+  *st = m_stat;
+  st->size = m_size;
+  st->runtimes = m_nr_runtimes;
+  st->ready = 0;
+  st->refilling = 0;
+  for (i = 0; i < m_nr_runtimes; i++) {
+    st->ready += m_runtimes[i].ready;
+    st->refilling += m_runtimes[i].refilling;
+  }
+  pthread_mutex_unlock(&m_lock);
+}
@@ -0,0 +1,48 @@
+#ifndef _TURF_SPARE_H_
+#define _TURF_SPARE_H_
+
+#include "misc.h"
+
+/* spare sandboxes of turfd,
+ *  a spare is a sandbox dir and an overlay dir with work and data in it,
+ *  made ahead on the workers, size of them are kept for each runtime.
+ *  a create takes one by rename, and the runtime is refilled in background.
+ */
+
+#define SPR_MAX_SIZE (64)      // spares of a runtime
+#define SPR_MAX_RUNTIMES (32)  // runtimes kept spares
+
+// spare statistics
+struct spr_stat {
+  uint32_t size;       // spares kept for each runtime, 0 if disabled
+  uint32_t runtimes;   // runtimes having spares
+  uint32_t ready;      // spares ready to take
+  uint32_t refilling;  // spares being made
+  uint64_t hits;       // creates took a spare
+  uint64_t misses;     // creates found no spare
+  uint64_t refilled;   // spares made
+  uint64_t failed;     // spares failed to make or take
+  uint64_t last_us;    // latency of the last refill, from submit to ready
+  uint64_t max_us;     // the max latency
+};
+
+// keep size spares for each runtime in root, the leftovers are removed,
+// and the statistics are reset.
+int _API spr_init(const char* root, uint32_t size);
+
+// drop the ready spares, the refilling ones are dropped when done.
+void _API spr_free(void);
+
+// refill the spares of runtime up to size
+int _API spr_fill(const char* runtime);
+
+/* move a spare of runtime to the sandbox and overlay dirs, which must not
+ *  exist. -1 with ENOENT if no spare ready, the runtime is filled then.
+ */
+int _API spr_take(const char* runtime, const char* sandbox,
+                  const char* overlay);
+
+// read the statistics
+void _API spr_get_stat(struct spr_stat* st);
+
+#endif  // _TURF_SPARE_H_
@@ -152,6 +152,58 @@ int proc_stat(pid_t pid, tf_stat* stat) {
 #undef BUF_MAX
 }
 
+// get the memory sharing from procfs
+int _API pid_smaps(pid_t pid, tf_stat* stat) {
+#define BUF_MAX 2048
+  char buf[BUF_MAX];
+  char key[32];
+  char* save = NULL;
+  size_t len = 0;
+  ssize_t rc = 0;
+
+  if (!stat || pid <= 0) {
+    set_errno(EINVAL);
+    return -1;
+  }
+
+  snprintf(buf, BUF_MAX, PID_SMAPS_ROLLUP, pid);
+  int fd = open(buf, O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    return -1;
+  }
+  while (len < BUF_MAX - 1 &&
+         (rc = read(fd, buf + len, BUF_MAX - 1 - len)) > 0) {
+    len += rc;
+  }
+  close(fd);
+  if (rc < 0) {
+    return -1;
+  }
+  buf[len] = 0;
+
+  // "Pss:   1234 kB", after the line of the address range
+  stat->pss = stat->shared_clean = stat->shared_dirty = 0;
+  stat->private_dirty = 0;
+  char* p = strtok_r(buf, "\n", &save);
+  for (; p; p = strtok_r(NULL, "\n", &save)) {
+    unsigned long kb;
+    if (sscanf(p, "%31[^:]: %lu kB", key, &kb) != 2) {
+      continue;
+    }
+    if (strcmp(key, "Pss") == 0) {
+      stat->pss = kb;
+    } else if (strcmp(key, "Shared_Clean") == 0) {
+      stat->shared_clean = kb;
+    } else if (strcmp(key, "Shared_Dirty") == 0) {
+      stat->shared_dirty = kb;
+    } else if (strcmp(key, "Private_Dirty") == 0) {
+      stat->private_dirty = kb;
+    }
+  }
+  return 0;
+#undef BUF_MAX
+}
+
 // get the pid's stat
 int _API pid_stat(pid_t pid, tf_stat* stat) {
   int rc;
@@ -180,6 +232,12 @@ int _API pid_stat(pid_t pid, tf_stat* stat) {
     // fall through
   }
 
+  rc = pid_smaps(pid, stat);
+  if (rc < 0 && errno != ENOENT) {
+    pwarn("proc.smaps.pid %d failed", pid);
+    // fall through
+  }
+
   return 0;
 }
 
@@ -207,7 +265,11 @@ void _API dump_stat(tf_stat* stat) {
          "syswr: %llu\n"
          "read_bytes: %llu\n"
          "write_bytes: %llu\n"
-         "cancelled_write_bytes: %llu\n",
+         "cancelled_write_bytes: %llu\n"
+         "pss: %lu\n"
+         "shared_clean: %lu\n"
+         "shared_dirty: %lu\n"
+         "private_dirty: %lu\n",
          stat->pid,
          stat->ppid,
          stat->pgid,
@@ -229,5 +291,9 @@ void _API dump_stat(tf_stat* stat) {
          stat->syscw,
          stat->read_bytes,
          stat->write_bytes,
-         stat->cancelled_write_bytes);
+         stat->cancelled_write_bytes,
+         stat->pss,
+         stat->shared_clean,
+         stat->shared_dirty,
+         stat->private_dirty);
 }
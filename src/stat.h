@@ -5,6 +5,7 @@
 
 #define PID_IO "/proc/%d/io"
 #define PID_STAT "/proc/%d/stat"
+#define PID_SMAPS_ROLLUP "/proc/%d/smaps_rollup"
 
 struct tf_stat {
   /*
@@ -149,10 +150,25 @@ struct tf_stat {
   unsigned long rss;    // physical memory size, in KBs
 
   int num_threads;  // number of threads
+
+  /*
+  /proc/#pid/smaps_rollup, the sums of all mappings, since linux 4.14.
+  a page mapped by n processes counts 1/n in Pss. the heap of a warmfork
+  seed is Shared_Dirty in its clones until a side writes it, the page is
+  copied to the writer's Private_Dirty then. the code and the files not
+  written are Shared_Clean.
+  */
+  unsigned long pss;            // proportional set size, in KBs
+  unsigned long shared_clean;   // shared, never written, in KBs
+  unsigned long shared_dirty;   // shared, written before shared, in KBs
+  unsigned long private_dirty;  // written by this process only, in KBs
 };
 
 typedef struct tf_stat tf_stat;
 
 int _API pid_stat(pid_t pid, tf_stat* stat);
 
+// the smaps_rollup part of pid_stat(), -1 with ENOENT on old kernels.
+int _API pid_smaps(pid_t pid, tf_stat* stat);
+
 #endif  // _TURF_STAT_H_
@@ -0,0 +1,298 @@
+/* sandbox state table, mapped shared by turfd and the readers
+ */
+
+#include "stbl.h"
+
+#include <sys/mman.h>  // mmap()
+
+#define STB_READ_RETRY (1000)
+
+static size_t stb_file_size(uint32_t nslots) {
+  return sizeof(struct stb_hdr) + (size_t)nslots * sizeof(struct stb_slot);
+}
+
+static int stb_map(struct stb_table* t, size_t size) {
+  int prot = t->writer ? PROT_READ | PROT_WRITE : PROT_READ;
+  void* base = mmap(NULL, size, prot, MAP_SHARED, t->fd, 0);
+  if (base == MAP_FAILED) {
+    return -1;
+  }
+
+  if (t->hdr) {
+    munmap(t->hdr, t->map_size);
+  }
+  t->hdr = (struct stb_hdr*)base;
+  t->slots = (struct stb_slot*)((char*)base + sizeof(struct stb_hdr));
+  t->map_size = size;
+  t->nslots = (size - sizeof(struct stb_hdr)) / sizeof(struct stb_slot);
+  return 0;
+}
+
+// writer: double the slots, readers see the new ones after reopen.
+static int stb_grow(struct stb_table* t) {
+  uint32_t n = t->nslots * 2;
+  size_t size = stb_file_size(n);
+
+  if (ftruncate(t->fd, size) < 0) {
+    return -1;
+  }
+  if (stb_map(t, size) < 0) {
+    return -1;
+  }
+
+  t->hdr->nslots = n;
+  return 0;
+}
+
+struct stb_table _API* stb_create(const char* path) {
+  int rc;
+  char tmp[TURF_MAX_PATH_LEN];
+  size_t size = stb_file_size(STB_INIT_SLOTS);
+  struct stb_table* t = NULL;
+
+  if (!path) {
+    set_errno(EINVAL);
+    return NULL;
+  }
+
+  t = (struct stb_table*)calloc(1, sizeof(struct stb_table));
+  if (!t) {
+    set_errno(ENOMEM);
+    return NULL;
+  }
+  t->_magic = TF_STBL_MAGIC;
+  t->writer = 1;
+
+  // build in a temp file, readers never see a blank header.
+  snprintf(tmp, sizeof(tmp), "%s.%d.tmp", path, getpid());
+  t->fd = open(tmp, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+  if (t->fd < 0) {
+    goto error;
+  }
+
+  if (ftruncate(t->fd, size) < 0 || stb_map(t, size) < 0) {
+    goto error;
+  }
+
+  t->hdr->version = STB_VER;
+  t->hdr->hdr_size = sizeof(struct stb_hdr);
+  t->hdr->slot_size = sizeof(struct stb_slot);
+  t->hdr->nslots = t->nslots;
+  t->hdr->owner = getpid();
+  t->hdr->magic = STB_MAGIC;
+
+  if (rename(tmp, path) < 0) {
+    goto error;
+  }
+  return t;
+
+error:
+  rc = errno;
+  unlink(tmp);
+  stb_close(t);
+  set_errno(rc);
+  return NULL;
+}
+
+struct stb_table _API* stb_open(const char* path) {
+  int rc;
+  struct stat st;
+  struct stb_table* t = NULL;
+
+  if (!path) {
+    set_errno(EINVAL);
+    return NULL;
+  }
+
+  t = (struct stb_table*)calloc(1, sizeof(struct stb_table));
+  if (!t) {
+    set_errno(ENOMEM);
+    return NULL;
+  }
+  t->_magic = TF_STBL_MAGIC;
+
+  t->fd = open(path, O_RDONLY | O_CLOEXEC);
+  if (t->fd < 0) {
+    goto error;
+  }
+
+  if (fstat(t->fd, &st) < 0) {
+    goto error;
+  }
+  if ((size_t)st.st_size < stb_file_size(1)) {
+    set_errno(EINVAL);
+    goto error;
+  }
+
+  if (stb_map(t, st.st_size) < 0) {
+    goto error;
+  }
+
+  struct stb_hdr* h = t->hdr;
+  if (h->magic != STB_MAGIC || h->version != STB_VER ||
+      h->hdr_size != sizeof(struct stb_hdr) ||
+      h->slot_size != sizeof(struct stb_slot)) {
+    set_errno(EINVAL);
+    goto error;
+  }
+
+  // the table is stale without its writer
+  if (h->owner <= 0 || (kill(h->owner, 0) < 0 && errno != EPERM)) {
+    set_errno(ESRCH);
+    goto error;
+  }
+
+  if (h->nslots < t->nslots) {
+    t->nslots = h->nslots;
+  }
+  return t;
+
+error:
+  rc = errno;
+  stb_close(t);
+  set_errno(rc);
+  return NULL;
+}
+
+void _API stb_close(struct stb_table* t) {
+  if (!t || BAD_MAGIC(t->_magic, TF_STBL_MAGIC)) {
+    set_errno(EINVAL);
+    return;
+  }
+
+  if (t->hdr) {
+    munmap(t->hdr, t->map_size);
+    t->hdr = NULL;
+  }
+  if (t->fd >= 0) {
+    close(t->fd);
+    t->fd = -1;
+  }
+
+  t->_magic = 0;
+  free(t);
+}
+
+int _API stb_alloc(struct stb_table* t) {
+  uint32_t i;
+
+  if (!t || BAD_MAGIC(t->_magic, TF_STBL_MAGIC) || !t->writer) {
+    set_errno(EINVAL);
+    return -1;
+  }
+
+  for (i = 0; i < t->nslots; i++) {
+    uint32_t idx = (t->next_free + i) % t->nslots;
+    if (t->slots[idx].rec.magic == 0) {
+      t->next_free = idx + 1;
+      return idx;
+    }
+  }
+
+  // full
+  i = t->nslots;
+  if (stb_grow(t) < 0) {
+    return -1;
+  }
+  t->next_free = i + 1;
+  return i;
+}
+
+int _API stb_update(struct stb_table* t,
+                    int idx,
+                    const struct oci_state_rec* rec) {
+  if (!t || BAD_MAGIC(t->_magic, TF_STBL_MAGIC) || !t->writer || !rec ||
+      idx < 0 || (uint32_t)idx >= t->nslots) {
+    set_errno(EINVAL);
+    return -1;
+  }
+
+  struct stb_slot* s = &t->slots[idx];
+  uint32_t seq = s->seq;
+
+  __atomic_store_n(&s->seq, seq + 1, __ATOMIC_RELAXED);
+  __atomic_thread_fence(__ATOMIC_RELEASE);
+  memcpy(&s->rec, rec, sizeof(struct oci_state_rec));
+  __atomic_store_n(&s->seq, seq + 2, __ATOMIC_RELEASE);
+  return 0;
+}
+
+void _API stb_release(struct stb_table* t, int idx) {
+  if (!t || BAD_MAGIC(t->_magic, TF_STBL_MAGIC) || !t->writer || idx < 0 ||
+      (uint32_t)idx >= t->nslots) {
+    set_errno(EINVAL);
+    return;
+  }
+
+  struct stb_slot* s = &t->slots[idx];
+  uint32_t seq = s->seq;
+
+  __atomic_store_n(&s->seq, seq + 1, __ATOMIC_RELAXED);
+  __atomic_thread_fence(__ATOMIC_RELEASE);
+  memset(&s->rec, 0, sizeof(struct oci_state_rec));
+  __atomic_store_n(&s->seq, seq + 2, __ATOMIC_RELEASE);
+
+  if ((uint32_t)idx < t->next_free) {
+    t->next_free = idx;
+  }
+}
+
+int _API stb_read(struct stb_table* t, int idx, struct oci_state_rec* rec) {
+  int i;
+
+  if (!t || BAD_MAGIC(t->_magic, TF_STBL_MAGIC) || !rec || idx < 0 ||
+      (uint32_t)idx >= t->nslots) {
+    set_errno(EINVAL);
+    return -1;
+  }
+
+  struct stb_slot* s = &t->slots[idx];
+  for (i = 0; i < STB_READ_RETRY; i++) {
+    uint32_t seq = __atomic_load_n(&s->seq, __ATOMIC_ACQUIRE);
+    if (seq & 1) {  // writer is updating
+      sched_yield();
+      continue;
+    }
+
+    memcpy(rec, &s->rec, sizeof(struct oci_state_rec));
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    if (__atomic_load_n(&s->seq, __ATOMIC_RELAXED) != seq) {
+      continue;  // torn
+    }
+
+    if (rec->magic == 0) {
+      set_errno(ENOENT);
+      return -1;
+    }
+    return 0;
+  }
+
+  set_errno(EAGAIN);
+  return -1;
+}
+
+int _API stb_find(struct stb_table* t,
+                  const char* name,
+                  struct oci_state_rec* rec) {
+  uint32_t i;
+
+  if (!t || BAD_MAGIC(t->_magic, TF_STBL_MAGIC) || !name || !rec) {
+    set_errno(EINVAL);
+    return -1;
+  }
+
+  for (i = 0; i < t->nslots; i++) {
+    // a racy peek to skip, confirmed by stb_read()
+    struct oci_state_rec* r = &t->slots[i].rec;
+    if (r->magic == 0 || strncmp(r->id, name, sizeof(r->id)) != 0) {
+      continue;
+    }
+
+    if (stb_read(t, i, rec) == 0 && strcmp(rec->id, name) == 0) {
+      return i;
+    }
+  }
+
+  set_errno(ENOENT);
+  return -1;
+}
@@ -0,0 +1,78 @@
+#ifndef _TURF_STBL_H_
+#define _TURF_STBL_H_
+
+#include "misc.h"
+#include "oci.h"  // struct oci_state_rec
+
+/* sandbox state table,
+ *  a file mapped shared by turfd, one fixed-size slot per sandbox.
+ *  turfd is the only writer, the readers (turf ps, list, state) map it
+ *  read-only and go without locks, each slot is guarded by a seqlock.
+ */
+
+#define STB_MAGIC DEF_MAGIC('S', 'T', 'B', 'L')
+#define STB_VER (1)
+
+// the slots a new table has, doubled when full
+#define STB_INIT_SLOTS (1024)
+
+// table header, in the first page
+struct stb_hdr {
+  uint32_t magic;      // STB_MAGIC
+  uint16_t version;    // STB_VER
+  uint16_t hdr_size;   // sizeof(struct stb_hdr)
+  uint32_t slot_size;  // sizeof(struct stb_slot)
+  uint32_t nslots;     // total slots
+  int32_t owner;       // pid of the writer (turfd)
+  uint32_t _reserved[11];
+};
+
+// a slot, rec.magic is 0 if the slot is free.
+struct stb_slot {
+  uint32_t seq;  // odd while the writer is updating
+  uint32_t _reserved;
+  struct oci_state_rec rec;
+};
+
+// table obj
+#define TF_STBL_MAGIC DEF_MAGIC('S', 'T', 'B', 'O')
+struct stb_table {
+  uint32_t _magic;         // TF_STBL_MAGIC
+  int fd;                  // the table file
+  bool writer;             // opened by stb_create()
+  size_t map_size;         // bytes mapped
+  uint32_t nslots;         // slots mapped
+  uint32_t next_free;      // search hint of stb_alloc()
+  struct stb_hdr* hdr;     // mapped base
+  struct stb_slot* slots;  // slots after header
+};
+
+// create the table as the writer, the old one is dropped.
+struct stb_table _API* stb_create(const char* path);
+
+// open the table read-only, fails with ESRCH if the writer is gone.
+struct stb_table _API* stb_open(const char* path);
+
+// unmap and close
+void _API stb_close(struct stb_table* t);
+
+// writer: take a free slot, return the index.
+int _API stb_alloc(struct stb_table* t);
+
+// writer: update the slot with the record
+int _API stb_update(struct stb_table* t,
+                    int idx,
+                    const struct oci_state_rec* rec);
+
+// writer: free the slot
+void _API stb_release(struct stb_table* t, int idx);
+
+// reader: copy a consistent record out, ENOENT if the slot is free.
+int _API stb_read(struct stb_table* t, int idx, struct oci_state_rec* rec);
+
+// reader: find the slot by sandbox name
+int _API stb_find(struct stb_table* t,
+                  const char* name,
+                  struct oci_state_rec* rec);
+
+#endif  // _TURF_STBL_H_
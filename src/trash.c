@@ -0,0 +1,351 @@
+/* trash of the deleted dirs
+ */
+
+#include "trash.h"
+#include "shell.h"  // shl_rmtree()
+
+#include <pthread.h>
+#include <sys/syscall.h>  // __NR_setpriority
+
+#define TRS_CLAIMED ".claimed"  // dirs claimed, "<pid>-<name>"
+#define TRS_NICE (10)           // the reaper yields to the sandboxes
+
+static pthread_t m_thread;
+static pthread_mutex_t m_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t m_cond = PTHREAD_COND_INITIALIZER;  // put or stop
+static pthread_cond_t m_idle = PTHREAD_COND_INITIALIZER;  // trash emptied
+
+static char* m_trash;           // the trash of the reaper thread
+static trs_reaped_fn m_reaped;  // called after emptied
+static bool m_running;          // thread is running
+static bool m_stopping;         // thread should exit
+static bool m_kicked;           // put since the last reap
+static bool m_busy;             // thread is reaping
+static uint32_t m_seq;          // names the dirs put
+static struct trs_stat m_stat;
+
+// lower the priority of the calling thread, 0 is PRIO_PROCESS.
+// sys/resource.h is not used, it clashes with the rusage in linux.h.
+static void trs_nice(void) {
+  syscall(__NR_setpriority, 0, syscall(__NR_gettid), TRS_NICE);
+}
+
+static uint64_t trs_now_us(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+/* the reaper claimed name in TRS_CLAIMED, 0 if unknown.
+ *  the claims are apart from the dirs put, whose names are the sandboxes'.
+ */
+static pid_t trs_owner(const char* name, const char** base) {
+  char* end;
+
+  *base = name;
+  long pid = strtol(name, &end, 10);
+  if (pid <= 0 || *end != '-') {
+    return 0;
+  }
+  *base = end + 1;
+  return (pid_t)pid;
+}
+
+/* remove a dir in trash, or in its TRS_CLAIMED if claimed,
+ *  0 if claimed by another live reaper.
+ */
+static int trs_remove(const char* trash, const char* name, bool claimed) {
+  char dir[TURF_MAX_PATH_LEN];
+  char path[TURF_MAX_PATH_LEN];
+  char claim[TURF_MAX_PATH_LEN];
+  const char* base = name;
+  pid_t self = getpid();
+  pid_t owner = 0;
+
+  if (claimed) {
+    owner = trs_owner(name, &base);
+  }
+  if (owner > 0 && owner != self && kill(owner, 0) == 0) {
+    return 0;
+  }
+
+  // claimed by rename, only one of the reapers wins.
+  shl_path2(dir, sizeof(dir), trash, TRS_CLAIMED);
+  shl_path2(path, sizeof(path), claimed ? dir : trash, name);
+  snprintf(
+      claim, sizeof(claim), "%s/%s/%d-%s", trash, TRS_CLAIMED, self, base);
+  if (owner != self && mkdir(dir, 0700) < 0 && errno != EEXIST) {
+    return -1;
+  }
+  if (owner != self && rename(path, claim) < 0) {
+    return errno == ENOENT ? 0 : -1;
+  }
+
+  uint64_t start = trs_now_us();
+  int rc = shl_rmtree(claim);
+  uint64_t lat = trs_now_us() - start;
+
+  pthread_mutex_lock(&m_lock);
+  if (rc < 0) {
+    m_stat.failed++;
+  } else {
+    m_stat.reaped++;
+  }
+  m_stat.last_us = lat;
+  if (lat > m_stat.max_us) {
+    m_stat.max_us = lat;
+  }
+  pthread_mutex_unlock(&m_lock);
+
+  if (rc < 0) {
+    pwarn("remove %s failed", claim);
+    return -1;
+  }
+  return 1;
+}
+
+// remove the dirs in trash, or the claims left in its TRS_CLAIMED.
+static int trs_reap_dir(const char* trash, bool claimed) {
+  char path[TURF_MAX_PATH_LEN];
+  size_t i, n = 0, cap = 0;
+  char** names = NULL;
+  struct dirent* ino;
+  int reaped = 0;
+
+  if (claimed) {
+    shl_path2(path, sizeof(path), trash, TRS_CLAIMED);
+  }
+  DIR* dir = opendir(claimed ? path : trash);
+  if (!dir) {
+    return errno == ENOENT ? 0 : -1;
+  }
+
+  // listed first, the names change in claiming.
+  while ((ino = readdir(dir)) != NULL) {
+    if (strcmp(ino->d_name, ".") == 0 || strcmp(ino->d_name, "..") == 0 ||
+        strcmp(ino->d_name, TRS_CLAIMED) == 0) {
+      continue;
+    }
+    if (n == cap) {
+      cap = cap ? cap * 2 : 16;
+      char** p = (char**)realloc(names, cap * sizeof(char*));
+      if (!p) {
+        break;
+      }
+      names = p;
+    }
+    names[n] = strdup(ino->d_name);
+    if (!names[n]) {
+      break;
+    }
+    n++;
+  }
+  closedir(dir);
+
+  for (i = 0; i < n; i++) {
+    if (trs_remove(trash, names[i], claimed) > 0) {
+      reaped++;
+    }
+    free(names[i]);
+  }
+  free(names);
+  return reaped;
+}
+
+int _API trs_reap(const char* trash) {
+  if (!trash) {
+    set_errno(EINVAL);
+    return -1;
+  }
+
+  // the leftovers of dead reapers first
+  int n = trs_reap_dir(trash, true);
+  int m = trs_reap_dir(trash, false);
+  if (n < 0 || m < 0) {
+    return -1;
+  }
+  return n + m;
+}
+
+static void* trs_thread(void* arg) {
+  trs_nice();
+
+  pthread_mutex_lock(&m_lock);
+  while (1) {
+    while (!m_kicked && !m_stopping) {
+      pthread_cond_wait(&m_cond, &m_lock);
+    }
+    if (!m_kicked) {
+      break;  // stopping, and nothing left
+    }
+
+    m_kicked = 0;
+    m_busy = 1;
+    pthread_mutex_unlock(&m_lock);
+
+    trs_reap(m_trash);
+    if (m_reaped) {
+      m_reaped();
+    }
+
+    pthread_mutex_lock(&m_lock);
+    m_busy = 0;
+    if (!m_kicked) {
+      pthread_cond_broadcast(&m_idle);
+    }
+  }
+  pthread_mutex_unlock(&m_lock);
+  return NULL;
+}
+
+int _API trs_start(const char* trash, trs_reaped_fn reaped) {
+  int rc;
+
+  if (m_running) {
+    return 0;
+  }
+  if (!trash) {
+    set_errno(EINVAL);
+    return -1;
+  }
+  if (mkdir(trash, 0700) < 0 && errno != EEXIST) {
+    return -1;
+  }
+
+  m_trash = strdup(trash);
+  if (!m_trash) {
+    set_errno(ENOMEM);
+    return -1;
+  }
+  m_reaped = reaped;
+  m_stopping = 0;
+  m_kicked = 1;  // the leftovers
+
+  rc = pthread_create(&m_thread, NULL, trs_thread, NULL);
+  if (rc != 0) {
+    free(m_trash);
+    m_trash = NULL;
+    set_errno(rc);
+    return -1;
+  }
+
+  m_running = 1;
+  return 0;
+}
+
+void _API trs_stop(void) {
+  if (!m_running) {
+    return;
+  }
+
+  pthread_mutex_lock(&m_lock);
+  m_stopping = 1;
+  pthread_cond_signal(&m_cond);
+  pthread_mutex_unlock(&m_lock);
+
+  pthread_join(m_thread, NULL);
+  m_running = 0;
+  free(m_trash);
+  m_trash = NULL;
+}
+
+bool _API trs_running(void) {
+  return m_running;
+}
+
+int _API trs_put(const char* trash, const char* parent, const char* name) {
+  char src[TURF_MAX_PATH_LEN];
+  char dest[TURF_MAX_PATH_LEN];
+
+  if (!trash || !parent || !name) {
+    set_errno(EINVAL);
+    return -1;
+  }
+
+  pthread_mutex_lock(&m_lock);
+  uint32_t seq = m_seq++;
+  pthread_mutex_unlock(&m_lock);
+
+  // unique in trash, for the same name deleted again
+  shl_path2(src, sizeof(src), parent, name);
+  snprintf(
+      dest, sizeof(dest), "%s/%s.%d.%u", trash, name, (int)getpid(), seq);
+  if (rename(src, dest) < 0) {
+    return -1;
+  }
+
+  pthread_mutex_lock(&m_lock);
+  m_stat.trashed++;
+  m_kicked = 1;
+  pthread_cond_signal(&m_cond);
+  pthread_mutex_unlock(&m_lock);
+  return 0;
+}
+
+int _API trs_spawn(const char* trash, trs_reaped_fn reaped) {
+  int status;
+
+  pid_t pid = fork();
+  if (pid < 0) {
+    return -1;
+  }
+
+  if (pid == 0) {
+    // the grandchild is adopted by init, no zombie left to the caller.
+    if (fork() == 0) {
+      setsid();
+      trs_nice();
+      trs_reap(trash);
+      if (reaped) {
+        reaped();
+      }
+    }
+    _exit(0);
+  }
+
+  while (waitpid(pid, &status, 0) < 0 && errno == EINTR) {
+  }
+  return 0;
+}
+
+int _API trs_sync(void) {
+  pthread_mutex_lock(&m_lock);
+  while (m_running && (m_kicked || m_busy)) {
+    pthread_cond_wait(&m_idle, &m_lock);
+  }
+  pthread_mutex_unlock(&m_lock);
+  return 0;
+}
+
+// the dirs in path, the hidden ones are not counted.
+static uint32_t trs_count(const char* path) {
+  struct dirent* ino;
+  uint32_t n = 0;
+
+  DIR* dir = opendir(path);
+  while (dir && (ino = readdir(dir)) != NULL) {
+    n += ino->d_name[0] != '.';
+  }
+  if (dir) {
+    closedir(dir);
+  }
+  return n;
+}
+
+void _API trs_get_stat(struct trs_stat* st) {
+  char path[TURF_MAX_PATH_LEN];
+
+  if (!st) {
+    return;
+  }
+
+  pthread_mutex_lock(&m_lock);
+  *st = m_stat;
+  pthread_mutex_unlock(&m_lock);
+
+  st->pending = 0;
+  if (m_trash) {
+    shl_path2(path, sizeof(path), m_trash, TRS_CLAIMED);
+    st->pending = trs_count(m_trash) + trs_count(path);
+  }
+}
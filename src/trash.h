@@ -0,0 +1,50 @@
+#ifndef _TURF_TRASH_H_
+#define _TURF_TRASH_H_
+
+#include "misc.h"
+
+/* trash of the deleted dirs,
+ *  a dir is renamed into the trash at once, and removed by a reaper off the
+ *  delete path, a thread in turfd, or a detached process otherwise.
+ *  the dirs claimed by a dead reaper are taken over by the next one, a claim
+ *  lives in the hidden subdir ".claimed" of the trash.
+ */
+
+// called after the reaper emptied the trash
+typedef void (*trs_reaped_fn)(void);
+
+// trash statistics
+struct trs_stat {
+  uint64_t trashed;  // dirs renamed into the trash
+  uint64_t reaped;   // dirs removed
+  uint64_t failed;   // dirs failed to remove
+  uint32_t pending;  // dirs in the trash, not removed yet
+  uint64_t last_us;  // time to remove the last dir
+  uint64_t max_us;   // the max time to remove a dir
+};
+
+// start the reaper thread on trash, the leftovers are reaped first.
+int _API trs_start(const char* trash, trs_reaped_fn reaped);
+
+// stop the reaper thread, after the trash is emptied.
+void _API trs_stop(void);
+
+// the reaper thread is running
+bool _API trs_running(void);
+
+// move parent/name into trash, the reaper thread is waked if running.
+int _API trs_put(const char* trash, const char* parent, const char* name);
+
+// remove all in trash now, return the number of dirs removed.
+int _API trs_reap(const char* trash);
+
+// reap trash in a detached process, the caller does not wait for it.
+int _API trs_spawn(const char* trash, trs_reaped_fn reaped);
+
+// wait until the reaper thread emptied the trash
+int _API trs_sync(void);
+
+// read the statistics
+void _API trs_get_stat(struct trs_stat* st);
+
+#endif  // _TURF_TRASH_H_
@@ -2,27 +2,157 @@
  */
 
 #include "turf.h"
+#include "cache.h"
+#include "copy.h"
+#include "hmap.h"
 #include "ipc.h"  // tipc_read
+#include "msg.h"  // struct msg_buf
 #include "oci.h"
+#include "pool.h"
 #include "realm.h"
 #include "shell.h"
 #include "sock.h"  // socketpair
+#include "spare.h"
 #include "spec.h"
 #include "stat.h"
+#include "stbl.h"
+#include "trash.h"
+#include "writer.h"
+#include "zip.h"
 
 // holds all pids the turf created (running realms).
 static LIST_HEAD(list_pid, turf_t) m_pids = LIST_HEAD_INITIALIZER(null);
+static tf_hmap* m_pid_idx;   // index of m_pids by pid
+static tf_hmap* m_name_idx;  // index of m_pids by name
 
 /* APIs for non-runc func
  */
 
+// holds the dirty states, turfd flushes them in batch.
+static TAILQ_HEAD(list_dirty, turf_t) m_dirty = TAILQ_HEAD_INITIALIZER(m_dirty);
+static bool m_flush_pending;  // flush timer is armed
+static bool m_daemon;         // running as turfd, states are in memory
+static uint32_t m_flush_ms = TF_STATE_FLUSH_MS;  // coalescing window
+static struct stb_table* m_stbl;  // shared state table, for the readers
+static struct msg_buf* m_out;     // output of remote request, or stdout
+static uint32_t m_workers;        // worker threads, 0 for default
+static uint32_t m_spares;         // spare sandboxes of each runtime
+static uint32_t m_seed_max = 1;   // seeds of a group, replicas included
+static bool m_forkq_pending;      // fork timer is armed
+static bool m_shm_queue;          // seeds talk through shared memory
+static tf_hmap* m_busy;           // sandboxies with a job on the workers
+static bool m_gc_due;             // deleted some, the shared code to collect
+static uint64_t m_gc_last;        // the last collected, in us
+
+// the seeds having fork requests queued
+static TAILQ_HEAD(list_forkq, turf_t) m_forkq = TAILQ_HEAD_INITIALIZER(m_forkq);
+
+// seed groups statistics
+static struct {
+  uint64_t forks;      // fork requests sent
+  uint64_t msgs;       // fork msgs carried them, batched or not
+  uint64_t shm_msgs;   // fork msgs through the shared memory
+  uint64_t tmpls;      // templates registered to the seeds
+  uint64_t spawned;    // replicas spawned
+  uint64_t respawned;  // replicas spawned for the dead ones
+  uint64_t retired;    // replicas retired for idle
+  uint32_t replicas;   // replicas alive
+} m_seed_stat;
+
+// the seed groups, see tf_seed_pick()
+static void tf_seed_lost(struct turf_t* tf);
+static void tf_seed_scale(struct turf_t* stf);
+static void tf_seed_drop(struct turf_t* tf, struct turf_t* stf);
+static struct turf_t* tf_seed_pick(struct turf_t* stf);
+
+static uint64_t tf_now_ms(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+// stop watching the realm's events
+static void tf_detach(struct turf_t* tf) {
+  struct rlm_t* r = tf->realm;
+  struct sck_loop* loop = sck_default_loop();
+
+  if (!r) {
+    return;
+  }
+
+  // stop watching the exit
+  if (r->st.pidfd > 0) {
+    sck_delete_event(loop, r->st.pidfd, SCK_READ);
+    close(r->st.pidfd);
+    r->st.pidfd = 0;
+  }
+
+  // seed's socketpair
+  if (r->cfg.flags.socketpair) {
+    sck_delete_event(loop, r->cfg.sv[0], SCK_RW);
+    close(r->cfg.sv[0]);
+    close(r->cfg.sv[1]);
+    r->cfg.sv[0] = r->cfg.sv[1] = -1;
+    r->cfg.flags.socketpair = 0;
+    tipc_ep_free(&tf->seed.endpoint);
+    msg_buf_free(&tf->seed.out);
+    tf->seed.writing = 0;
+  }
+
+  // the fork requests have no seed to go
+  tf_seed_drop(tf, NULL);
+
+  // registered in the seed process, gone with it
+  memset(tf->seed.tmpls, 0, sizeof(tf->seed.tmpls));
+
+  if (tf->seed.shq) {
+    sck_delete_event(loop, tf->seed.shq->rsp.efd, SCK_READ);
+    shq_pair_close(tf->seed.shq);
+    free(tf->seed.shq);
+    tf->seed.shq = NULL;
+  }
+}
+
 // free a turf_t object and it's resources
 static void tf_free(struct turf_t* tf) {
   if (!tf) {
     return;
   }
 
+  if (tf->dirty) {
+    TAILQ_REMOVE(&m_dirty, tf, in_dirty);
+    tf->dirty = 0;
+  }
+
+  if (m_stbl && tf->slot >= 0) {
+    stb_release(m_stbl, tf->slot);
+    tf->slot = -1;
+  }
+
+  if (tf->o_state) {
+    oci_state_free(tf->o_state);
+    tf->o_state = NULL;
+  }
+
+  if (tf->i_spec) {
+    oci_spec_free(tf->i_spec);
+    tf->i_spec = NULL;
+  }
+
+  tf_seed_drop(tf, NULL);
+
+  // the replicas go with the seed sandbox
+  while (tf->seed.nr_replicas > 0) {
+    struct turf_t* r = tf->seed.replicas[--tf->seed.nr_replicas];
+    rlm_kill(r->realm, SIGKILL);
+    tf_free(r);
+  }
+  if (tf->seed.primary) {
+    m_seed_stat.replicas--;
+  }
+
   if (tf->realm) {
+    tf_detach(tf);
     rlm_free(tf->realm);
     tf->realm = NULL;
   }
@@ -37,6 +167,7 @@ static struct turf_t* tf_new(const char* name) {
     set_errno(ENOMEM);
     return NULL;
   }
+  tf->slot = -1;
 
   tf->realm = rlm_new(name);
   if (!tf->realm) {
@@ -53,35 +184,471 @@ error:
   return NULL;
 }
 
+/* sandbox registry
+ */
+
+// add the sandbox into registry
+int _API tf_reg_add(struct turf_t* tf) {
+  int rc;
+
+  if (!m_pid_idx) {
+    m_pid_idx = hmap_new(0);
+    m_name_idx = hmap_new(0);
+    if (!m_pid_idx || !m_name_idx) {
+      return -1;
+    }
+  }
+
+  rc = hmap_sput(m_name_idx, tf->name_, tf);
+  if (rc < 0) {
+    return -1;
+  }
+
+  if (tf->pid_ > 0) {
+    rc = hmap_put(m_pid_idx, tf->pid_, tf);
+    if (rc < 0) {
+      hmap_sdel(m_name_idx, tf->name_);
+      return -1;
+    }
+  }
+
+  LIST_INSERT_HEAD(&m_pids, tf, in_list);
+  return 0;
+}
+
+// remove the sandbox from registry
+void _API tf_reg_del(struct turf_t* tf) {
+  // the index may be taken by a newer one of the same name or pid.
+  if (hmap_sget(m_name_idx, tf->name_) == tf) {
+    hmap_sdel(m_name_idx, tf->name_);
+  }
+  if (tf->pid_ > 0 && hmap_get(m_pid_idx, tf->pid_) == tf) {
+    hmap_del(m_pid_idx, tf->pid_);
+  }
+
+  LIST_REMOVE(tf, in_list);
+}
+
+// update the pid of a registered sandbox
+int _API tf_reg_set_pid(struct turf_t* tf, pid_t pid) {
+  if (tf->pid_ > 0 && hmap_get(m_pid_idx, tf->pid_) == tf) {
+    hmap_del(m_pid_idx, tf->pid_);
+  }
+
+  tf->pid_ = pid;
+  if (pid > 0) {
+    return hmap_put(m_pid_idx, pid, tf);
+  }
+  return 0;
+}
+
 // get realm form pid
-static struct turf_t* tf_get_realm(pid_t pid) {
-  struct turf_t* t;
-  LIST_FOREACH(t, &m_pids, in_list) {
-    if (t->pid_ == pid) {
-      return t;
+struct turf_t _API* tf_get_realm(pid_t pid) {
+  if (!m_pid_idx) {
+    return NULL;
+  }
+  return (struct turf_t*)hmap_get(m_pid_idx, pid);
+}
+
+// get realm form name
+struct turf_t _API* tf_find_realm(const char* name) {
+  if (!m_name_idx) {
+    return NULL;
+  }
+  return (struct turf_t*)hmap_sget(m_name_idx, name);
+}
+
+/* sandbox states,
+ *  turfd holds the states in turf_t, and flushes the dirty ones in batch,
+ *  runc mode goes to the state file directly.
+ */
+
+// flush all dirty states, the files are written by the writer thread.
+int _API tf_state_flush(bool sync) {
+  int cnt = 0;
+  struct turf_t* tf;
+  char dest[TURF_MAX_PATH_LEN];
+
+  while ((tf = TAILQ_FIRST(&m_dirty)) != NULL) {
+    TAILQ_REMOVE(&m_dirty, tf, in_dirty);
+    tf->dirty = 0;
+
+    if (!tf->o_state) {
+      continue;
+    }
+
+    struct oci_state_rec* rec =
+        (struct oci_state_rec*)malloc(sizeof(struct oci_state_rec));
+    if (!rec || oci_state_pack(tf->o_state, rec) < 0) {
+      pwarn("pack state %s failed", tf->name_);
+      free(rec);
+      continue;
     }
+
+    shl_path3(dest, sizeof(dest), tfd_path_sandbox(), tf->name_, "state");
+    if (wrt_submit(dest, (char*)rec, sizeof(struct oci_state_rec)) < 0) {
+      pwarn("save state %s failed", dest);
+      continue;
+    }
+    cnt++;
   }
-  return NULL;
+
+  if (sync) {
+    wrt_sync();
+  }
+  return cnt;
+}
+
+static int tf_state_on_flush(struct sck_loop* loop,
+                             sck_timer_id id,
+                             void* data) {
+  m_flush_pending = 0;
+  int cnt = tf_state_flush(0);
+  dprint("%d states flushed", cnt);
+  return -1;
+}
+
+// log the state persistence, only when there are new writes.
+void _API tf_state_report(void) {
+  static uint64_t last_submitted;
+  struct wrt_stat st;
+
+  wrt_get_stat(&st);
+  if (st.submitted == last_submitted) {
+    return;
+  }
+  last_submitted = st.submitted;
+
+  info("state flush: written %" PRIu64 ", coalesced %" PRIu64
+       ", skipped %" PRIu64 ", failed %" PRIu64
+       ", depth %u/%u, latency %" PRIu64 "/%" PRIu64 "us",
+       st.written,
+       st.coalesced,
+       st.skipped,
+       st.failed,
+       st.depth,
+       st.max_depth,
+       st.last_us,
+       st.max_us);
 }
 
-static struct turf_t* tf_find_realm(const char* name) {
-  struct turf_t* t;
-  LIST_FOREACH(t, &m_pids, in_list) {
-    if (strcmp(t->name_, name) == 0) {
-      return t;
+// load the state of sandbox, turfd reads from memory.
+static struct oci_state* tf_state_load(const char* name) {
+  char dest[TURF_MAX_PATH_LEN];
+  struct turf_t* tf = NULL;
+
+  if (m_daemon) {
+    tf = tf_find_realm(name);
+    if (tf && tf->o_state) {
+      return tf->o_state;
     }
   }
-  return NULL;
+
+  shl_path3(dest, sizeof(dest), tfd_path_sandbox(), name, "state");
+  struct oci_state* state = oci_state_load(dest);
+  if (!state || !m_daemon) {
+    return state;
+  }
+
+  // cache miss, created out of turfd
+  if (!tf) {
+    tf = tf_new(name);
+    if (!tf || tf_reg_add(tf) < 0) {
+      tf_free(tf);
+      oci_state_free(state);
+      return NULL;
+    }
+  }
+  tf->o_state = state;
+  return state;
+}
+
+// publish the state into the state table, no syscall on the way.
+static void tf_slot_update(struct turf_t* tf) {
+  struct oci_state_rec rec;
+  struct oci_state st = {0};
+
+  if (!m_stbl) {
+    return;
+  }
+
+  if (tf->o_state) {
+    st = *tf->o_state;
+  }
+  if (!st.id) {
+    st.id = tf->name_;
+  }
+
+  // the last stat sampled by turfd
+  if (tf->pid_ > 0 && !st.has.stat) {
+    st.stat = tf->stat;
+    st.has.stat = 1;
+  }
+
+  if (tf->slot < 0) {
+    tf->slot = stb_alloc(m_stbl);
+    if (tf->slot < 0) {
+      pwarn("no slot for %s", tf->name_);
+      return;
+    }
+  }
+
+  if (oci_state_pack(&st, &rec) == 0) {
+    stb_update(m_stbl, tf->slot, &rec);
+  }
+}
+
+// load the state for reading, from turfd's state table if it is up.
+static struct oci_state* tf_state_peek(const char* name) {
+  struct oci_state_rec rec;
+  struct oci_state* state = NULL;
+
+  if (!m_daemon) {
+    struct stb_table* t = stb_open(tfd_path_stbl());
+    if (t) {
+      if (stb_find(t, name, &rec) >= 0) {
+        state = oci_state_unpack(&rec, sizeof(rec));
+      }
+      stb_close(t);
+    }
+    if (state) {
+      return state;
+    }
+  }
+
+  return tf_state_load(name);
+}
+
+// save the state of sandbox, turfd defers the write.
+static int tf_state_save(const char* name, struct oci_state* state) {
+  char dest[TURF_MAX_PATH_LEN];
+
+  if (!m_daemon) {
+    shl_path3(dest, sizeof(dest), tfd_path_sandbox(), name, "state");
+    return oci_state_save(state, dest);
+  }
+
+  struct turf_t* tf = tf_find_realm(name);
+  if (!tf || tf->o_state != state) {
+    set_errno(ENOENT);
+    return -1;
+  }
+
+  // readers see it at once, the file comes later.
+  tf_slot_update(tf);
+
+  if (!tf->dirty) {
+    TAILQ_INSERT_TAIL(&m_dirty, tf, in_dirty);
+    tf->dirty = 1;
+  }
+
+  if (!m_flush_pending) {
+    sck_create_timer(sck_default_loop(), m_flush_ms, tf_state_on_flush, NULL);
+    m_flush_pending = 1;
+  }
+  return 0;
+}
+
+// release the state from tf_state_load()
+static void tf_state_free(struct oci_state* state) {
+  if (m_daemon) {
+    return;  // held by turf_t
+  }
+  oci_state_free(state);
+}
+
+// turf_t holds the new state, and saves it later.
+static int tf_state_attach(struct turf_t* tf, struct oci_state* state) {
+  if (tf->o_state && tf->o_state != state) {
+    oci_state_free(tf->o_state);
+  }
+  tf->o_state = state;
+  return tf_state_save(tf->name_, state);
+}
+
+// renew the realm of an exited sandbox, the state is kept.
+static int tf_renew(struct turf_t* tf) {
+  struct rlm_t* r = rlm_new(tf->name_);
+  if (!r) {
+    return -1;
+  }
+
+  tf_reg_del(tf);
+  tf_detach(tf);
+  rlm_free(tf->realm);
+  tf->realm = r;
+
+  tf->status = 0;
+  tf->cont_mem_ovl = 0;
+  tf->cont_cpu_ovl = 0;
+  tf->last_cpu_used = 0;
+  memset(&tf->last_cpu_time, 0, sizeof(tf->last_cpu_time));
+  memset(&tf->stat, 0, sizeof(tf->stat));
+
+  return tf_reg_add(tf);
+}
+
+// the sandbox is gone, turfd keeps it for the state.
+static void tf_exited(struct turf_t* tf) {
+  uint32_t i;
+
+  // the replicas of a seed exit with it
+  for (i = 0; i < tf->seed.nr_replicas; i++) {
+    struct turf_t* r = tf->seed.replicas[i];
+    r->seed.retired = 1;
+    rlm_kill(r->realm, SIGKILL);
+  }
+
+  tf_detach(tf);
+  tf_reg_set_pid(tf, 0);
+}
+
+// load all the sandboxies into memory
+int _API tf_daemon_init(struct tf_cli* cfg) {
+  DIR* dir;
+  struct dirent* ino;
+
+  m_daemon = 1;
+  if (cfg && cfg->has.flush_window) {
+    m_flush_ms = cfg->flush_window;
+  }
+  if (cfg && cfg->has.workers) {
+    m_workers = cfg->workers;
+  }
+  if (cfg && cfg->has.cache_size) {
+    cch_set_budget((uint64_t)cfg->cache_size * 1024 * 1024);
+  }
+  if (cfg && cfg->has.spares) {
+    m_spares = cfg->spares;
+  }
+  if (cfg && cfg->has.seed_max) {
+    m_seed_max = cfg->seed_max;
+  }
+  if (cfg && cfg->has.shm_queue) {
+    m_shm_queue = 1;
+  }
+
+  dir = opendir(tfd_path_sandbox());
+  if (!dir) {
+    return -1;
+  }
+
+  while ((ino = readdir(dir)) != NULL) {
+    if (!(ino->d_type & DT_DIR) || strcmp(ino->d_name, ".") == 0 ||
+        strcmp(ino->d_name, "..") == 0) {
+      continue;
+    }
+
+    struct turf_t* tf = tf_new(ino->d_name);
+    if (!tf || tf_reg_add(tf) < 0) {
+      tf_free(tf);
+      continue;
+    }
+    tf_state_load(ino->d_name);
+  }
+  closedir(dir);
+
+  info("%d sandboxies loaded", m_name_idx ? (int)m_name_idx->size : 0);
+  return 0;
+}
+
+// the shared code not used anymore
+static void tf_gc_code(void) {
+  if (shl_exist2(tfd_path(), "farm")) {
+    cpy_farm_gc(tfd_path_farm());
+  }
+  if (shl_exist2(tfd_path(), "cache")) {
+    cch_evict(tfd_path_cache());
+  }
+}
+
+static int tf_gc_work(void* arg) {
+  tf_gc_code();
+  return 0;
+}
+
+// collect after deletes on a worker, not more than once in TF_GC_INTERVAL_MS
+static void tf_gc_check(void) {
+  uint64_t now = get_tick_us();
+
+  if (now - m_gc_last < (uint64_t)TF_GC_INTERVAL_MS * 1000 ||
+      !__atomic_exchange_n(&m_gc_due, 0, __ATOMIC_RELAXED)) {
+    return;
+  }
+  m_gc_last = now;
+  if (wkp_fd() < 0 || wkp_submit(tf_gc_work, NULL, NULL) < 0) {
+    tf_gc_code();
+  }
+}
+
+// make the spares of all runtimes ahead
+static void tf_spare_start(void) {
+  DIR* dir;
+  struct dirent* ino;
+
+  if (spr_init(tfd_path_spare(), m_spares) < 0) {
+    pwarn("init spares failed");
+    return;
+  }
+  if (!m_spares || !(dir = opendir(tfd_path_runtime()))) {
+    return;
+  }
+  while ((ino = readdir(dir)) != NULL) {
+    if ((ino->d_type & DT_DIR) && strcmp(ino->d_name, ".") &&
+        strcmp(ino->d_name, "..")) {
+      spr_fill(ino->d_name);
+    }
+  }
+  closedir(dir);
+}
+
+// bring up the state table and writer, after turfd daemonized.
+int _API tf_daemon_start(void) {
+  struct turf_t* tf;
+
+  m_stbl = stb_create(tfd_path_stbl());
+  if (!m_stbl) {
+    pwarn("create state table failed, readers go to the files");
+  } else {
+    LIST_FOREACH(tf, &m_pids, in_list) {
+      tf_slot_update(tf);
+    }
+  }
+
+  // the paths are cached on first use, resolve before the workers race.
+  tfd_path_sandbox();
+  tfd_path_overlay();
+  tfd_path_runtime();
+  tfd_path_farm();
+  tfd_path_cache();
+  tfd_path_trash();
+  tfd_path_spare();
+  if (wkp_start(m_workers) < 0) {
+    pwarn("start workers failed, create and delete run inline");
+  }
+  tf_spare_start();
+  if (trs_start(tfd_path_trash(), tf_gc_code) < 0) {
+    pwarn("start reaper failed, the trash is reaped by processes");
+  }
+
+  if (wrt_start() < 0) {
+    pwarn("start state writer failed, states are written inline");
+    return -1;
+  }
+  return 0;
 }
 
 // return true if oom
 static bool tf_chk_oom(struct turf_t* tf, tf_stat* stat) {
+  // by pss, a clone is charged a part of the pages shared with its seed.
+  unsigned long mem = stat->pss ? stat->pss : stat->rss;
+
   dprint("pid:%d, mem:%ld, limit:%d, cont:%d",
          tf->realm->st.child_pid,
-         stat->rss,
+         mem,
          tf->realm->cfg.memlimit,
          tf->cont_mem_ovl);
-  if (tf->realm->cfg.memlimit > 0 && stat->rss > tf->realm->cfg.memlimit) {
+  if (tf->realm->cfg.memlimit > 0 && mem > tf->realm->cfg.memlimit) {
     tf->status |= RLM_STATUS_MEM_OVL;
     tf->cont_mem_ovl++;
     if (tf->cont_mem_ovl > 3) {
@@ -134,6 +701,43 @@ static bool tf_chk_cpu_overload(struct turf_t* tf, tf_stat* stat) {
   return false;
 }
 
+// save the exit state of the sandbox
+// exit_code is NULL if unknown, e.g. a clone is not our child.
+static int tf_handle_exit(struct turf_t* tf,
+                          struct rusage* ru,
+                          const int* exit_code) {
+  const char* name = tf->realm->cfg.name;
+
+  struct oci_state* state = tf_state_load(name);
+  if (!state) {
+    error("state for sandbox not found.");
+    return -1;
+  }
+
+  state->state = RLM_STATE_STOPPED;  // stop
+  state->status = tf->status;        // oom, cpu_ovl, killed ...
+
+  // save exit code
+  state->has.exit_code = (exit_code != NULL);
+  state->exit_code = exit_code ? *exit_code : 0;
+
+  // save rusage
+  if (ru) {
+    state->rusage = *ru;
+    state->has.rusage = 1;
+  }
+
+  // save last stat
+  state->stat = tf->stat;
+  state->has.stat = 1;
+
+  tf_state_save(name, state);
+  tf_state_free(state);
+
+  tf->status |= RLM_STATUS_EXITED;
+  return 0;
+}
+
 // check all pids health
 int _API tf_health_check(void) {
   int rc;
@@ -149,219 +753,994 @@ int _API tf_health_check(void) {
       continue;
     }
 
+    // pidfd is not available for it, and no SIGCHLD reaping either.
+    if (tf->realm->st.pidfd <= 0 && rlm_pidfd_supported()) {
+      int exit_code;
+      struct rusage ru;
+      if (wait4(tf->pid_, &exit_code, WNOHANG, &ru) > 0) {
+        tf_handle_exit(tf, &ru, &exit_code);
+      }
+    }
+
     if (tf->status & RLM_STATUS_EXITED) {
-      LIST_REMOVE(tf, in_list);
-      tf_free(tf);
+      tf_exited(tf);
       continue;
     }
 
-    // get state
-    rc = pid_stat(tf->pid_, &stat);
+    /* exit is watched by pidfd, the last stat is taken on exit,
+     * so only sandboxies with limits need to be sampled.
+     */
+    if (tf->realm->st.pidfd > 0 && tf->realm->cfg.memlimit == 0 &&
+        tf->realm->cfg.cpulimit == 0) {
+      continue;
+    }
+
+    // get state
+    rc = pid_stat(tf->pid_, &stat);
     if (rc < 0) {
       pwarn("pid_stat(%d) failed.", tf->pid_);
       continue;
     }
 
-    // check mem usage
-    if (tf_chk_oom(tf, &stat)) {
-      warn("%d reaches the mem limit", tf->pid_);
-      rlm_kill(tf->realm, SIGKILL);
-      tf->status |= RLM_STATUS_KILL;
-    }
+    // check mem usage
+    if (tf_chk_oom(tf, &stat)) {
+      warn("%d reaches the mem limit", tf->pid_);
+      rlm_kill(tf->realm, SIGKILL);
+      tf->status |= RLM_STATUS_KILL;
+    }
+
+    // check cpu usage
+    if (tf_chk_cpu_overload(tf, &stat)) {
+      warn("%d reaches the cpu limit", tf->pid_);
+      rlm_kill(tf->realm, SIGKILL);
+      tf->status |= RLM_STATUS_KILL;
+    }
+
+    tf->stat = stat;
+    tf_slot_update(tf);
+  }
+
+  LIST_FOREACH(tf, &m_pids, in_list) {
+    if (tf->seed.nr_replicas > 0) {
+      tf_seed_scale(tf);
+    }
+  }
+
+  tf_gc_check();
+  return 0;
+}
+
+// handle child exit signal
+int _API tf_child_exit(pid_t child, struct rusage* ru, int exit_code) {
+  struct turf_t* tf = tf_get_realm(child);
+  if (tf) {
+    return tf_handle_exit(tf, ru, &exit_code);
+  }
+  return 0;
+}
+
+// callback on pidfd readable, the sandbox exited.
+static void tf_on_pidfd(struct sck_loop* loop, int fd, void* data, int mask) {
+  int exit_code = 0;
+  struct rusage ru;
+  struct turf_t* tf = (struct turf_t*)data;
+
+  // the last stat, still readable before reaping
+  tf_stat stat = {0};
+  if (pid_stat(tf->pid_, &stat) == 0) {
+    tf->stat = stat;
+  }
+
+  pid_t p = wait4(tf->pid_, &exit_code, WNOHANG, &ru);
+  if (p == 0) {
+    return;  // not yet
+  }
+
+  // a replica has no state
+  if (tf->seed.primary) {
+    tf_seed_lost(tf);
+    return;
+  }
+
+  warn("pidfd: pid=%d, status=%x", tf->pid_, exit_code);
+  if (p < 0) {
+    // not our child, no rusage nor exit code
+    pwarn("wait4(%d) failed", tf->pid_);
+    tf_handle_exit(tf, NULL, NULL);
+  } else {
+    rusage_dump(&ru);
+    tf_handle_exit(tf, &ru, &exit_code);
+  }
+
+  tf_exited(tf);
+}
+
+// watch the sandbox exit through pidfd
+static int tf_watch_exit(struct turf_t* tf) {
+  int fd = rlm_pidfd(tf->realm);
+  if (fd < 0) {
+    pwarn("pidfd(%d) failed", tf->pid_);
+    return -1;
+  }
+
+  return sck_create_event(sck_default_loop(), fd, SCK_READ, tf_on_pidfd, tf);
+}
+
+// exit all pids
+int _API tf_exit_all() {
+  set_errno(ENOTSUP);
+  return -1;
+}
+
+static int tf_cfg_update_spec(struct tf_cli* cfg, struct oci_spec* spec) {
+  if (!cfg || !spec) {
+    set_errno(EINVAL);
+    return -1;
+  }
+
+  // Megabytes to bytes
+  if (cfg->has.memlimit) {
+    spec->linuxs.resources.mem_limit = ((int64_t)cfg->memlimit) * 1024 * 1024;
+    spec->linuxs.resources.has.mem_limit = 1;
+
+    spec->linuxs.has.resources = 1;
+    spec->has.linuxs = 1;
+  }
+
+  // cpu period sets to 1second
+  if (cfg->has.cpulimit) {
+    spec->linuxs.resources.cpu_period = 1000000;
+    spec->linuxs.resources.cpu_quota = cfg->cpulimit * 10000;
+    spec->linuxs.resources.has.cpu_period = 1;
+    spec->linuxs.resources.has.cpu_quota = 1;
+
+    spec->linuxs.has.resources = 1;
+    spec->has.linuxs = 1;
+  }
+
+  return 0;
+}
+
+static char* last_used_runtime;
+static char* last_used_arg;
+static char* last_used_runtime_binary;
+
+int _API tf_find_binary(char** binary, const char* runtime, const char* arg) {
+  if (last_used_runtime && strcmp(last_used_runtime, runtime) == 0 &&
+      strcmp(last_used_arg, arg) == 0) {
+    *binary = strdup(last_used_runtime_binary);
+    return 0;
+  }
+
+  if (last_used_runtime) {
+    free(last_used_runtime);
+    free(last_used_arg);
+    free(last_used_runtime_binary);
+    last_used_runtime = NULL;
+    last_used_arg = NULL;
+    last_used_runtime_binary = NULL;
+  }
+
+  int i;
+  if (arg[0] == '/') {  // realpath
+    *binary = strdup(arg);
+    // TBD: check exists.
+    return 0;
+  }
+  const char* paths[] = {".", "bin", "sbin", "usr/bin", "usr/sbin"};
+  for (i = 0; i < (sizeof(paths) / sizeof(char*)); i++) {
+    if (shl_exist4(tfd_path_runtime(), runtime, paths[i], arg)) {
+      xasprintf(
+          binary, "%s/%s/%s/%s", tfd_path_runtime(), runtime, paths[i], arg);
+      dprint("binary: %s", *binary);
+      last_used_runtime = strdup(runtime);
+      last_used_arg = strdup(arg);
+      last_used_runtime_binary = strdup(*binary);
+      return 0;
+    }
+  }
+
+  set_errno(ENOENT);
+  return -1;
+}
+
+/* the key of the fork template of a clone, from the spec and the flags it
+ *  is made of. the json is the same for the clones of a bundle, the binary
+ *  is found in the runtime dir.
+ */
+static uint64_t tf_tmpl_key(struct oci_spec* spec, struct rlm_t* rlm) {
+  struct rlm_cfg* cfg = &rlm->cfg;
+  uint32_t crc = crc32c_update(spec->crc, &cfg->flags, sizeof(cfg->flags));
+  crc = crc32c_update(crc, cfg->binary, strlen(cfg->binary));
+  return (uint64_t)crc << 32 | spec->size;
+}
+
+// the template slot of key, or -1 if new.
+static int tf_seed_tmpl_find(struct turf_t* tf, uint64_t key) {
+  int i;
+
+  for (i = 0; i < TIPC_FORK_TMPL_MAX; i++) {
+    struct tf_seed_tmpl* t = &tf->seed.tmpls[i];
+    if (t->id && t->key == key) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+// a new template takes the slot of its id, which drops the oldest one.
+static int tf_seed_tmpl_add(struct turf_t* tf, uint64_t key) {
+  uint32_t id = ++tf->seed.tmpl_seq;
+  int i = id % TIPC_FORK_TMPL_MAX;
+  tf->seed.tmpls[i].id = id;
+  tf->seed.tmpls[i].key = key;
+  tf->seed.tmpls[i].via = 0;
+  return i;
+}
+
+// publish a msg in the shared memory
+static void tf_seed_commit(struct turf_t* tf, struct shq* q, int len) {
+  if (shq_commit(q, len) < 0) {
+    pwarn("ring seed %s failed", tf->name_);
+  }
+}
+
+// the rest of msgs written when the seed reads
+static void tf_seed_on_write(struct sck_loop* loop,
+                             int fd,
+                             void* clientData,
+                             int mask) {
+  struct turf_t* tf = (struct turf_t*)clientData;
+
+  int rc = msg_flush(fd, &tf->seed.out);
+  if (rc < 0) {
+    pwarn("seed %s: write failed", tf->name_);
+  }
+  if (rc != 1) {
+    sck_delete_event(loop, fd, SCK_WRITE);
+    tf->seed.writing = 0;
+  }
+}
+
+/* write the msgs of v to seed, after the rest of the former ones. the bytes
+ *  the socket is full for are kept, a frame is never sent in part.
+ */
+static int tf_seed_write(struct turf_t* tf, struct tipc_iov* v) {
+  struct msg_buf* b = &tf->seed.out;
+  int fd = tf->realm->cfg.sv[0];
+
+  if (b->off == b->len && tipc_iov_write(v, fd) == 0) {
+    return 0;
+  }
+  if (b->off == b->len && errno != EAGAIN) {
+    return -1;
+  }
+
+  if (msg_buf_reserve(b, v->len) < 0) {
+    // a frame may be cut, the seed could never read on.
+    error("seed %s: no memory for the rest of msgs", tf->name_);
+    rlm_kill(tf->realm, SIGKILL);
+    return -1;
+  }
+  tipc_iov_gather(v, b->data + b->len);
+  b->len += v->len;
+
+  if (!tf->seed.writing) {
+    if (sck_create_event(
+            sck_default_loop(), fd, SCK_WRITE, tf_seed_on_write, tf) < 0) {
+      error("seed %s: watch write failed", tf->name_);
+      rlm_kill(tf->realm, SIGKILL);
+      return -1;
+    }
+    tf->seed.writing = 1;
+  }
+  return 0;
+}
+
+/* send the clones of template t in a fork_delta, the template goes first
+ *  through a channel not registered yet. each msg takes size bytes of buf
+ *  at most.
+ */
+static int tf_seed_send(struct turf_t* tf,
+                        struct tf_seed_tmpl* t,
+                        struct rlm_t** rlms,
+                        uint32_t n,
+                        char* buf,
+                        size_t size) {
+  struct shq* q = tf->seed.shq ? &tf->seed.shq->req : NULL;
+  struct tipc_iov v;
+  char* msg;
+  int len;
+
+  // the seed is gone
+  if (!tf->realm->cfg.flags.socketpair) {
+    set_errno(EPIPE);
+    tf->seed.inflight -= n;
+    return -1;
+  }
+
+  // in place of the shared memory, the socket if it is full.
+  if (q && !(t->via & TF_SEED_VIA_SHQ) && (msg = shq_reserve(q, size))) {
+    len = tipc_enc_fork_tmpl(msg, size, t->id, rlms[0]);
+    if (len >= 0) {
+      tf_seed_commit(tf, q, len);
+      t->via |= TF_SEED_VIA_SHQ;
+      m_seed_stat.tmpls++;
+    }
+  }
+  if (q && (t->via & TF_SEED_VIA_SHQ) && (msg = shq_reserve(q, size))) {
+    len = tipc_enc_fork_delta(msg, size, t->id, rlms, n);
+    if (len >= 0) {
+      tf_seed_commit(tf, q, len);
+      m_seed_stat.msgs++;
+      m_seed_stat.shm_msgs++;
+      return 0;
+    }
+  }
+
+  /* in one write with the template, the long strings are not copied.
+   *  the short ones are quicker to copy in buf, after the template.
+   */
+  int off = 0;
+  tipc_iov_init(&v);
+  if (!(t->via & TF_SEED_VIA_SOCK)) {
+    off = tipc_enc_fork_tmpl(buf, size, t->id, rlms[0]);
+  }
+  if (off < 0) {
+    len = -1;
+  } else if (tipc_iov_worth(rlms, n)) {
+    if (off > 0) {
+      tipc_iov_add(&v, buf, off);  // the first one, never full
+    }
+    len = tipc_iov_fork_delta(&v, t->id, rlms, n);
+  } else {
+    len = tipc_enc_fork_delta(buf + off, size - off, t->id, rlms, n);
+    if (len >= 0) {
+      tipc_iov_add(&v, buf, off + len);
+    }
+  }
+  dprint("tipc msg size: %d, %u forks", off + len, n);
+
+  if (len < 0 || tf_seed_write(tf, &v) < 0) {
+    error("send fork_delta of %u failed", n);
+    tf->seed.inflight -= n;
+    return -1;
+  }
+  if (off > 0) {
+    t->via |= TF_SEED_VIA_SOCK;
+    m_seed_stat.tmpls++;
+  }
+  m_seed_stat.msgs++;
+  return 0;
+}
+
+// a clone never forked, stopped to be deleted.
+static void tf_clone_stopped(struct turf_t* tf) {
+  tf->realm->st.state = RLM_STATE_STOPPED;
+
+  struct oci_state* state = tf_state_load(tf->name_);
+  if (state) {
+    state->pid = 0;
+    state->state = RLM_STATE_STOPPED;
+    tf_state_save(tf->name_, state);
+    tf_state_free(state);
+  }
+}
+
+/* send a run of n clones by tf_seed_send(), the names are kept in seed
+ *  until forked. the clones are stopped if not sent.
+ */
+static void tf_seed_sent(struct turf_t* tf,
+                         struct tf_seed_tmpl* t,
+                         struct rlm_t** rlms,
+                         char** names,
+                         uint32_t n,
+                         char* buf) {
+  struct tf_seed* s = &tf->seed;
+  uint32_t i;
+
+  if (s->nr_sent + n > s->cap_sent) {
+    uint32_t cap = MAX(s->cap_sent * 2, s->nr_sent + n);
+    char** p = (char**)realloc(s->sent, cap * sizeof(char*));
+    if (p) {
+      s->sent = p;
+      s->cap_sent = cap;
+    }
+  }
+
+  int rc = tf_seed_send(tf, t, rlms, n, buf, TIPC_MSG_MAX_SIZE);
+  for (i = 0; i < n; i++) {
+    if (rc == 0 && s->nr_sent < s->cap_sent) {
+      s->sent[s->nr_sent++] = names[i];
+      continue;
+    }
+    struct turf_t* c = rc < 0 ? tf_find_realm(names[i]) : NULL;
+    if (c && c->realm) {
+      tf_clone_stopped(c);
+    }
+    free(names[i]);  // untracked if no memory, left to the FORK_RSP
+  }
+}
+
+/* send the queued fork requests of seed, a msg for each run of clones of
+ *  the same template.
+ */
+static int tf_seed_flush(struct turf_t* tf) {
+  char buf[TIPC_MSG_MAX_SIZE];
+  struct rlm_t* rlms[TIPC_FORK_BATCH_MAX];
+  char* names[TIPC_FORK_BATCH_MAX];
+  uint32_t i, n = 0;
+  int t = -1;
+
+  // the msgs are checked by the best the seed supports
+  tipc_set_csum(tf->seed.csum);
+
+  for (i = 0; i < tf->seed.nr_queued; i++) {
+    char* name = tf->seed.queued[i];
+    struct turf_t* c = tf_find_realm(name);
+
+    // deleted since queued
+    if (!c || !c->realm) {
+      tf->seed.inflight--;
+      free(name);
+      continue;
+    }
+
+    // the run goes first, a new template may take its slot.
+    int ct = tf_seed_tmpl_find(tf, c->seed.tmpl_key);
+    if (n > 0 && ct != t) {
+      tf_seed_sent(tf, &tf->seed.tmpls[t], rlms, names, n, buf);
+      n = 0;
+    }
+    if (ct < 0) {
+      ct = tf_seed_tmpl_add(tf, c->seed.tmpl_key);
+    }
+    t = ct;
+    names[n] = name;
+    rlms[n++] = c->realm;
+  }
+  if (n > 0) {
+    tf_seed_sent(tf, &tf->seed.tmpls[t], rlms, names, n, buf);
+  }
+  tf->seed.nr_queued = 0;
+  TAILQ_REMOVE(&m_forkq, tf, in_forkq);
+
+  if (tf->seed.inflight == 0) {
+    tf->seed.idle_since = tf_now_ms();
+  }
+  return 0;
+}
+
+static int tf_seed_on_flush(struct sck_loop* loop,
+                            sck_timer_id id,
+                            void* data) {
+  struct turf_t* tf;
+
+  m_forkq_pending = 0;
+  while ((tf = TAILQ_FIRST(&m_forkq)) != NULL) {
+    tf_seed_flush(tf);
+  }
+  return -1;
+}
+
+/* queue a fork request to seed, the ones in a loop round go in a batch,
+ *  the seed forks them in a row and answers once.
+ */
+static int tf_seed_fork_req(struct turf_t* tf, struct rlm_t* r) {
+  char* name = strdup(r->cfg.name);
+  if (!name) {
+    set_errno(ENOMEM);
+    return -1;
+  }
+
+  if (tf->seed.nr_queued == 0) {
+    TAILQ_INSERT_TAIL(&m_forkq, tf, in_forkq);
+  }
+  tf->seed.queued[tf->seed.nr_queued++] = name;
+  tf->seed.inflight++;
+  m_seed_stat.forks++;
+
+  if (tf->seed.nr_queued == TIPC_FORK_BATCH_MAX) {
+    return tf_seed_flush(tf);
+  }
+  if (!m_forkq_pending) {
+    sck_create_timer(sck_default_loop(), 0, tf_seed_on_flush, NULL);
+    m_forkq_pending = 1;
+  }
+  return 0;
+}
+
+// a clone forked by seed, r holds the name and pid.
+static void tf_seed_forked(struct turf_t* seed, struct rlm_t* r) {
+  struct tf_seed* s = &seed->seed;
+  uint32_t i;
+
+  if (s->inflight > 0 && --s->inflight == 0) {
+    s->idle_since = tf_now_ms();
+  }
+  for (i = 0; r->cfg.name && i < s->nr_sent; i++) {
+    if (strcmp(s->sent[i], r->cfg.name) == 0) {
+      free(s->sent[i]);
+      s->sent[i] = s->sent[--s->nr_sent];
+      break;
+    }
+  }
+
+  struct turf_t* tf = r->cfg.name ? tf_find_realm(r->cfg.name) : NULL;
+  if (!tf) {
+    error("tf %s not found.", r->cfg.name);
+    return;
+  }
+  dprint("%s: rlm %p %d running", __func__, tf, r->st.child_pid);
+  if (r->st.child_pid > 0) {
+    tf_reg_set_pid(tf, r->st.child_pid);
+    tf->seed.forked_by = seed->pid_;
+    tf->realm->st.state = RLM_STATE_RUNNING;
+    tf_watch_exit(tf);
+  } else {
+    error("seed %s: fork %s failed", seed->name_, tf->name_);
+    tf->realm->st.state = RLM_STATE_STOPPED;
+  }
+
+  struct oci_state* state = tf_state_load(tf->name_);
+  if (state) {
+    state->pid = tf->realm->st.child_pid;  // forkwait
+    state->state = tf->realm->st.state;    // forkwait
+    tf_state_save(tf->name_, state);
+    tf_state_free(state);
+    state = NULL;
+  }
+}
+
+/* the fork requests of a seed lost, the queued ones go to another seed of
+ *  group stf if any. the sent ones may be forked already, they are stopped.
+ */
+static void tf_seed_drop(struct turf_t* tf, struct turf_t* stf) {
+  struct tf_seed* s = &tf->seed;
+
+  if (s->nr_queued > 0) {
+    TAILQ_REMOVE(&m_forkq, tf, in_forkq);
+  }
+  while (s->nr_queued > 0) {
+    char* name = s->queued[--s->nr_queued];
+    struct turf_t* c = tf_find_realm(name);
+    if (c && c->realm && c->pid_ <= 0) {
+      struct turf_t* to = stf ? tf_seed_pick(stf) : NULL;
+      if (!to || tf_seed_fork_req(to, c->realm) < 0) {
+        warn("seed %s: clone %s dropped", tf->name_, name);
+        tf_clone_stopped(c);
+      }
+    }
+    free(name);
+  }
+
+  while (s->nr_sent > 0) {
+    char* name = s->sent[--s->nr_sent];
+    struct turf_t* c = tf_find_realm(name);
+    if (c && c->realm && c->pid_ <= 0) {
+      warn("seed %s: clone %s lost", tf->name_, name);
+      tf_clone_stopped(c);
+    }
+    free(name);
+  }
+  free(s->sent);
+  s->sent = NULL;
+  s->cap_sent = 0;
+  s->inflight = 0;
+}
+
+// received seed msg
+static int tf_seed_msg(int type, char* buff, size_t size, void* data) {
+  dprint("%s: %s", __func__, tipc_msg_type(type));
+  switch (type) {
+    case TIPC_MSG_SEED_READY: {
+      struct turf_t* tf = (struct turf_t*)data;
+      uint32_t csums = 0;
+      tf->realm->st.state = RLM_STATE_FORKWAIT;
+      if (tipc_dec_seed_ready(buff, size, &csums) >= 0 &&
+          (csums & (1 << TIPC_CSUM_CRC32C))) {
+        tf->seed.csum = TIPC_CSUM_CRC32C;
+      }
+      if (tf->seed.primary) {
+        break;  // a replica has no state
+      }
+      struct oci_state* state = tf_state_load(tf->name_);
+      if (state) {
+        state->state = tf->realm->st.state;  // forkwait
+        tf_state_save(tf->name_, state);
+        tf_state_free(state);
+        state = NULL;
+      }
+    } break;
+
+    case TIPC_MSG_FORK_RSP: {
+      char mem[TURF_SBX_MAX_LEN + 2 * ARN_ALIGN];
+      struct arena a;
+      struct rlm_t r = {0};
+
+      // the name only, on the stack
+      arn_init(&a, mem, sizeof(mem));
+      r.cfg.arena = &a;
+      tipc_dec_fork_rsp(&r, buff, size);
+      tf_seed_forked((struct turf_t*)data, &r);
+      arn_free(&a);
+    } break;
+
+    case TIPC_MSG_FORK_RSP_BATCH: {
+      char mem[TIPC_FORK_BATCH_MAX * ARN_SIZE(TURF_SBX_MAX_LEN + 1)];
+      struct rlm_t rlms[TIPC_FORK_BATCH_MAX];
+      struct arena a;
+      int i, n = TIPC_FORK_BATCH_MAX;
+
+      arn_init(&a, mem, sizeof(mem));
+      memset(rlms, 0, sizeof(rlms));
+      for (i = 0; i < TIPC_FORK_BATCH_MAX; i++) {
+        rlms[i].cfg.arena = &a;
+      }
+      tipc_dec_fork_rsp_batch(rlms, &n, buff, size);
+      for (i = 0; i < n; i++) {
+        tf_seed_forked((struct turf_t*)data, &rlms[i]);
+      }
+      arn_free(&a);
+    } break;
+  }
+  return 0;
+}
+
+static void tf_seed_on_read(struct sck_loop* loop,
+                            int fd,
+                            void* clientData,
+                            int mask) {
+  struct turf_t* tf = (struct turf_t*)clientData;
+
+  int rc = tipc_ep_read(&tf->seed.endpoint, tf_seed_msg, tf);
+  info("%s rc=%d", __func__, rc);
+
+  // the exit is watched by pidfd
+  if (rc < 0 && errno != EAGAIN) {
+    warn("seed %s: ipc closed (%d)", tf->name_, errno);
+    sck_delete_event(loop, fd, SCK_READ);
+  }
+}
 
-    // check cpu usage
-    if (tf_chk_cpu_overload(tf, &stat)) {
-      warn("%d reaches the cpu limit", tf->pid_);
-      rlm_kill(tf->realm, SIGKILL);
-      tf->status |= RLM_STATUS_KILL;
+// the msgs from seed in the shared memory
+static void tf_seed_on_shq(struct sck_loop* loop,
+                           int fd,
+                           void* clientData,
+                           int mask) {
+  struct turf_t* tf = (struct turf_t*)clientData;
+  struct shq* q = &tf->seed.shq->rsp;
+  char buf[TIPC_MSG_MAX_SIZE];
+  uint32_t len;
+  char* msg;
+
+  // the seed may rewrite a record in place, decode a private copy of it.
+  shq_clear(q);
+  while ((msg = shq_peek(q, &len)) != NULL) {
+    memcpy(buf, msg, len);
+    shq_consume(q);
+    if (tipc_decode(buf, len, tf_seed_msg, tf) < 0) {
+      warn("seed %s: bad msg in shq (%d)", tf->name_, errno);
     }
+  }
+  if (errno == EBADMSG) {
+    warn("seed %s: shq broken", tf->name_);
+    sck_delete_event(loop, fd, SCK_READ);
+  }
+}
 
-    tf->stat = stat;
+// the shared memory queues of seed, passed next to TURFPHD_FD.
+static int tf_seed_shq(struct turf_t* tf, struct oci_spec* spec) {
+  struct shq_pair* p = (struct shq_pair*)calloc(1, sizeof(struct shq_pair));
+  char sz[64];
+
+  if (!p || shq_pair_create(p) < 0) {
+    free(p);
+    return -1;
   }
+  if (rlm_keep_fd(tf->realm, p->memfd) < 0 ||
+      rlm_keep_fd(tf->realm, p->req.efd) < 0 ||
+      rlm_keep_fd(tf->realm, p->rsp.efd) < 0 ||
+      sck_create_event(
+          sck_default_loop(), p->rsp.efd, SCK_READ, tf_seed_on_shq, tf) < 0) {
+    shq_pair_close(p);
+    free(p);
+    return -1;
+  }
+
+  shq_pair_spec(p, sz, sizeof(sz));
+  env_set(spec->process.env, SHQ_ENV, sz);
+  tf->seed.shq = p;
   return 0;
 }
 
-// handle child exit signal
-int _API tf_child_exit(pid_t child, struct rusage* ru, int exit_code) {
+// setup the realm by spec, a seed gets the socketpair to turfd.
+// the realm of spec, turfd makes it at create for the start.
+static int tf_realm_prepare(struct turf_t* tf, struct oci_spec* spec) {
   char dest[TURF_MAX_PATH_LEN];
-  struct turf_t* tf = tf_get_realm(child);
-  if (tf) {
-    // LIST_REMOVE(tf, in_list);
-    const char* name = tf->realm->cfg.name;
+  struct rlm_t* rlm = tf->realm;
+  const char* name = rlm->cfg.name;
 
-    shl_path3(dest, sizeof(dest), tfd_path_sandbox(), name, "state");
-    struct oci_state* state = oci_state_load(dest);
-    if (!state) {
-      error("state for sandbox not found.");
+  shl_path3(dest, sizeof(dest), tfd_path_overlay(), name, spec->turf.code);
+  rlm_chroot(rlm, dest);
+
+  rlm_arg(rlm, spec->process.arg->argc, spec->process.arg->argv);
+
+  // warm-fork seed process
+  if (spec->turf.has.is_seed && spec->turf.is_seed) {
+    // makeup socket pair for the seed sandbox
+    int sv[2];
+    if (sck_pair_unix_socket(sv) < 0) {
+      error("socketpair for seed %s failed", name);
       return -1;
     }
+    rlm_socketpair(rlm, sv);
+    tipc_ep_init(&tf->seed.endpoint, sv[0]);
+    dprint("seed %s sv[%d,%d]\n", name, sv[0], sv[1]);
 
-    state->state = RLM_STATE_STOPPED;  // stop
-    state->status = tf->status;        // oom, cpu_ovl, killed ...
+    struct sck_loop* loop = sck_default_loop();
+    sck_create_event(loop, sv[0], SCK_READ, tf_seed_on_read, tf);
 
-    // save exit code
-    state->exit_code = exit_code;
-    state->has.exit_code = 1;
+    // env
+    char sz[16];
+    snprintf(sz, 16, "%d", sv[1]);
+    env_set(spec->process.env, "LD_PRELOAD", tfd_path_libturf());
+    env_set(spec->process.env, "TURFPHD_FD", sz);
 
-    // save rusage
-    state->rusage = *ru;
-    state->has.rusage = 1;
+    // the socket is still used, for seed_ready and when the queue is full.
+    if (m_shm_queue && tf_seed_shq(tf, spec) < 0) {
+      pwarn("shared memory queues for seed %s failed", name);
+    }
+  }
 
-    // save last stat
-    state->stat = tf->stat;
-    state->has.stat = 1;
+  // environ
+  char** env = spec->process.env->environ;
+  rlm_env(rlm, env);
 
-    oci_state_save(state, dest);
-    oci_state_free(state);
+  char* bin = NULL;
+  int rc =
+      tf_find_binary(&bin, spec->turf.runtime, spec->process.arg->argv[0]);
+  if (rc < 0) {
+    error("binary not found");
+    return -1;
+  }
+  rlm->cfg.binary = bin;  // spec->process.argv[0];
 
-    tf->status |= RLM_STATUS_EXITED;
-    // rlm_free(tf->realm);
-    // tf->realm = NULL;
+  // mem limit
+  if (spec->linuxs.resources.has.mem_limit) {
+    rlm_limit_mem(rlm, spec->linuxs.resources.mem_limit / 1024);
+  }
+
+  // cpu limit
+  if (spec->linuxs.resources.has.cpu_quota &&
+      spec->linuxs.resources.has.cpu_period &&
+      spec->linuxs.resources.cpu_period > 0) {
+    uint32_t ms = spec->linuxs.resources.cpu_quota /
+                  (spec->linuxs.resources.cpu_period / 1000);
+    rlm_limit_cpu(rlm, ms);
+  }
+
+  if (spec->process.has.terminal && spec->process.terminal) {
+    rlm->cfg.flags.terminal = 1;
   }
   return 0;
 }
 
-// exit all pids
-int _API tf_exit_all() {
-  set_errno(ENOTSUP);
-  return -1;
-}
+// the realm of spec and the start options
+static int tf_realm_setup(struct turf_t* tf,
+                          struct tf_cli* cfg,
+                          struct oci_spec* spec) {
+  struct rlm_t* rlm = tf->realm;
 
-static int tf_cfg_update_spec(struct tf_cli* cfg, struct oci_spec* spec) {
-  if (!cfg || !spec) {
-    set_errno(EINVAL);
+  // made at create, the options only
+  if (!tf->prepared && tf_realm_prepare(tf, spec) < 0) {
     return -1;
   }
+  tf->prepared = 0;
 
-  // Megabytes to bytes
-  if (cfg->has.memlimit) {
-    spec->linuxs.resources.mem_limit = ((int64_t)cfg->memlimit) * 1024 * 1024;
-    spec->linuxs.resources.has.mem_limit = 1;
-
-    spec->linuxs.has.resources = 1;
-    spec->has.linuxs = 1;
+  if (cfg && cfg->file_stdout) {
+    dprint("stdout: %s", cfg->file_stdout);
+    rlm->cfg.fd_stdout = strdup(cfg->file_stdout);
+    rlm->cfg.flags.fd_stdout = 1;
   }
 
-  // cpu period sets to 1second
-  if (cfg->has.cpulimit) {
-    spec->linuxs.resources.cpu_period = 1000000;
-    spec->linuxs.resources.cpu_quota = cfg->cpulimit * 10000;
-    spec->linuxs.resources.has.cpu_period = 1;
-    spec->linuxs.resources.has.cpu_quota = 1;
-
-    spec->linuxs.has.resources = 1;
-    spec->has.linuxs = 1;
+  if (cfg && cfg->file_stderr) {
+    dprint("stderr: %s", cfg->file_stderr);
+    rlm->cfg.fd_stderr = strdup(cfg->file_stderr);
+    rlm->cfg.flags.fd_stderr = 1;
   }
 
+  tf->seed.tmpl_key = tf_tmpl_key(spec, rlm);
   return 0;
 }
 
-static char* last_used_runtime;
-static char* last_used_arg;
-static char* last_used_runtime_binary;
+/* seed groups,
+ *  a seed sandbox forks alone until it is busy, then turfd spawns replicas
+ *  of it from the same spec, up to m_seed_max seeds. the fork requests go
+ *  to the least loaded seed. a dead replica is respawned, an idle one is
+ *  retired, and all go with the seed sandbox.
+ */
 
-int _API tf_find_binary(char** binary, const char* runtime, const char* arg) {
-  if (last_used_runtime && strcmp(last_used_runtime, runtime) == 0 &&
-      strcmp(last_used_arg, arg) == 0) {
-    *binary = strdup(last_used_runtime_binary);
-    return 0;
+static bool tf_seed_ready(struct turf_t* tf) {
+  return tf->pid_ > 0 && tf->realm->st.state == RLM_STATE_FORKWAIT;
+}
+
+// spawn a replica of the seed sandbox
+static int tf_seed_spawn(struct turf_t* stf) {
+  char path[TURF_MAX_PATH_LEN];
+  struct oci_spec* spec = NULL;
+  struct turf_t* tf = NULL;
+
+  if (stf->seed.nr_replicas + 1 >= m_seed_max) {
+    set_errno(ENOSPC);
+    return -1;
   }
 
-  if (last_used_runtime) {
-    free(last_used_runtime);
-    free(last_used_arg);
-    free(last_used_runtime_binary);
+  shl_path3(path, sizeof(path), tfd_path_sandbox(), stf->name_, "config.json");
+  spec = oci_spec_load(path);
+  if (!spec) {
+    set_errno(ENOENT);
+    goto error;
   }
 
-  int i;
-  if (arg[0] == '/') {  // realpath
-    *binary = strdup(arg);
-    // TBD: check exists.
-    return 0;
+  tf = tf_new(stf->name_);
+  if (!tf || tf_realm_setup(tf, NULL, spec) < 0) {
+    goto error;
   }
-  const char* paths[] = {".", "bin", "sbin", "usr/bin", "usr/sbin"};
-  for (i = 0; i < (sizeof(paths) / sizeof(char*)); i++) {
-    if (shl_exist4(tfd_path_runtime(), runtime, paths[i], arg)) {
-      xasprintf(
-          binary, "%s/%s/%s/%s", tfd_path_runtime(), runtime, paths[i], arg);
-      dprint("binary: %s", *binary);
-      last_used_runtime = strdup(runtime);
-      last_used_arg = strdup(arg);
-      last_used_runtime_binary = strdup(*binary);
-      return 0;
-    }
+  if (rlm_run(tf->realm) < 0 || tf->pid_ <= 0) {
+    goto error;
   }
 
-  set_errno(ENOENT);
+  tf->seed.primary = stf;
+  tf->seed.idle_since = tf_now_ms();
+  stf->seed.replicas[stf->seed.nr_replicas++] = tf;
+  m_seed_stat.spawned++;
+  m_seed_stat.replicas++;
+  tf_watch_exit(tf);
+
+  info("seed %s: replica %d spawned", stf->name_, tf->pid_);
+  oci_spec_free(spec);
+  return 0;
+
+error:
+  pwarn("spawn replica of seed %s failed", stf->name_);
+  if (tf) {
+    if (tf->pid_ > 0) {
+      rlm_kill(tf->realm, SIGKILL);
+    }
+    tf_free(tf);
+  }
+  if (spec) {
+    oci_spec_free(spec);
+  }
   return -1;
 }
 
-// send seed msg
-static int tf_seed_fork_req(struct turf_t* tf, struct rlm_t* r) {
-  char buf[4096];
+// the least loaded seed of the group, a replica is spawned if all busy.
+static struct turf_t* tf_seed_pick(struct turf_t* stf) {
+  struct turf_t* best = tf_seed_ready(stf) ? stf : NULL;
+  bool starting = 0;
+  uint32_t i;
 
-  int len = tipc_enc_fork_req(buf, 4096, r);
-  dprint("tipc msg size: %d", len);
+  for (i = 0; i < stf->seed.nr_replicas; i++) {
+    struct turf_t* r = stf->seed.replicas[i];
+    if (r->seed.retired) {
+      continue;
+    }
+    if (!tf_seed_ready(r)) {
+      starting = 1;
+    } else if (!best || r->seed.inflight < best->seed.inflight) {
+      best = r;
+    }
+  }
 
-  int l = write(tf->realm->cfg.sv[0], buf, len);
-  if (l != len) {
-    error("send fork_req failed");
-    return -1;
+  // one at a time, the new one takes the next requests.
+  if (!starting && (!best || best->seed.inflight > 0) &&
+      stf->seed.nr_replicas + 1 < m_seed_max) {
+    tf_seed_spawn(stf);
   }
 
-  return 0;
+  // queued in the seed sandbox until it is ready
+  return best ? best : stf;
 }
 
-// received seed msg
-static int tf_seed_msg(int type, char* buff, size_t size, void* data) {
-  dprint("%s: %s", __func__, tipc_msg_type(type));
-  switch (type) {
-    case TIPC_MSG_SEED_READY: {
-      struct turf_t* tf = (struct turf_t*)data;
-      char dest[TURF_MAX_PATH_LEN];
-      shl_path3(
-          dest, sizeof(dest), tfd_path_sandbox(), tf->realm->cfg.name, "state");
-      struct oci_state* state = oci_state_load(dest);
-      tf->realm->st.state = RLM_STATE_FORKWAIT;
-      state->state = tf->realm->st.state;  // forkwait
-      oci_state_save(state, dest);
-      oci_state_free(state);
-      state = NULL;
-    } break;
+// a replica exited, respawned unless retired or died in starting.
+static void tf_seed_lost(struct turf_t* tf) {
+  struct turf_t* stf = tf->seed.primary;
+  uint32_t i;
 
-    case TIPC_MSG_FORK_RSP: {
-      struct rlm_t r = {0};
-      tipc_dec_fork_rsp(&r, buff, size);
+  bool respawn = !tf->seed.retired && stf->pid_ > 0 &&
+                 tf->realm->st.state == RLM_STATE_FORKWAIT;
+  warn("seed %s: replica %d exited", stf->name_, tf->pid_);
 
-      struct turf_t* tf = tf_find_realm(r.cfg.name);
-      if (!tf) {
-        error("tf %s not found.", r.cfg.name);
-        break;
-      }
-      dprint("%s: rlm %p %d running", __func__, tf, r.st.child_pid);
-      tf->realm->st.child_pid = r.st.child_pid;
-      tf->realm->st.state = RLM_STATE_RUNNING;
+  for (i = 0; i < stf->seed.nr_replicas; i++) {
+    if (stf->seed.replicas[i] == tf) {
+      stf->seed.replicas[i] = stf->seed.replicas[--stf->seed.nr_replicas];
+      break;
+    }
+  }
 
-      char dest[TURF_MAX_PATH_LEN];
-      shl_path3(
-          dest, sizeof(dest), tfd_path_sandbox(), tf->realm->cfg.name, "state");
-      struct oci_state* state = oci_state_load(dest);
-      state->pid = tf->realm->st.child_pid;  // forkwait
-      state->state = tf->realm->st.state;    // forkwait
-      oci_state_save(state, dest);
-      oci_state_free(state);
-      state = NULL;
-    } break;
+  if (respawn && tf_seed_spawn(stf) == 0) {
+    m_seed_stat.respawned++;
   }
-  return 0;
+
+  // the queued clones go to the rest of the group
+  tf_seed_drop(tf, stf->pid_ > 0 ? stf : NULL);
+  tf_free(tf);
 }
 
-static void tf_seed_on_read(struct sck_loop* loop,
-                            int fd,
-                            void* clientData,
-                            int mask) {
-  int rc = tipc_read(fd, tf_seed_msg, clientData);
-  info("%s rc=%d", __func__, rc);
+// retire the replicas idle for long, one in a check
+static void tf_seed_scale(struct turf_t* stf) {
+  uint64_t now = tf_now_ms();
+  uint32_t i;
+
+  for (i = 0; i < stf->seed.nr_replicas; i++) {
+    struct turf_t* r = stf->seed.replicas[i];
+    if (!r->seed.retired && r->seed.inflight == 0 && tf_seed_ready(r) &&
+        now - r->seed.idle_since > TF_SEED_IDLE_MS) {
+      info("seed %s: replica %d retired", stf->name_, r->pid_);
+      r->seed.retired = 1;
+      rlm_kill(r->realm, SIGKILL);
+      m_seed_stat.retired++;
+      break;
+    }
+  }
+}
+
+// memory of the processes sampled, in KBs
+struct tf_seed_mem {
+  uint32_t procs;
+  unsigned long pss;
+  unsigned long shared;  // shared_clean and shared_dirty
+  unsigned long dirty;   // private_dirty
+};
+
+static void tf_seed_mem_add(struct tf_seed_mem* m, pid_t pid) {
+  tf_stat st;
+
+  if (pid <= 0 || pid_smaps(pid, &st) < 0) {
+    return;
+  }
+  m->procs++;
+  m->pss += st.pss;
+  m->shared += st.shared_clean + st.shared_dirty;
+  m->dirty += st.private_dirty;
+}
+
+// the seed sandbox, not a replica
+static bool tf_is_seed(struct turf_t* tf) {
+  return tf->realm && tf->realm->cfg.flags.socketpair && !tf->seed.primary;
+}
+
+/* sample the seed group of stf in seeds, and the clones forked by it in
+ *  clones. the shared of clones is what the fork still saves, the dirty
+ *  of seeds grows as a seed drifts from its clones.
+ */
+static void tf_seed_mem(struct turf_t* stf,
+                        struct tf_seed_mem* seeds,
+                        struct tf_seed_mem* clones) {
+  pid_t pids[TF_SEED_MAX_GROUP];
+  struct turf_t* tf;
+  uint32_t i, n = 0;
+
+  memset(seeds, 0, sizeof(struct tf_seed_mem));
+  memset(clones, 0, sizeof(struct tf_seed_mem));
+  pids[n++] = stf->pid_;
+  for (i = 0; i < stf->seed.nr_replicas; i++) {
+    pids[n++] = stf->seed.replicas[i]->pid_;
+  }
+  for (i = 0; i < n; i++) {
+    tf_seed_mem_add(seeds, pids[i]);
+  }
+
+  LIST_FOREACH(tf, &m_pids, in_list) {
+    for (i = 0; tf->seed.forked_by > 0 && i < n; i++) {
+      if (tf->seed.forked_by == pids[i]) {
+        tf_seed_mem_add(clones, tf->pid_);
+        break;
+      }
+    }
+  }
 }
 
 /* APIs for runc-mode func.
@@ -373,6 +1752,9 @@ static int tf_do_init(struct tf_cli* cfg) {
   shl_mkdir2(tfd_path(), "sandbox");
   shl_mkdir2(tfd_path(), "runtime");
   shl_mkdir2(tfd_path(), "overlay");
+  shl_mkdir2(tfd_path(), "farm");
+  shl_mkdir2(tfd_path(), "cache");
+  shl_mkdir2(tfd_path(), "trash");
   return 0;
 }
 
@@ -412,10 +1794,51 @@ exit:
   return rc;
 }
 
+void _API tf_set_output(struct msg_buf* out) {
+  m_out = out;
+}
+
+// command output, goes back to the client in C/S mode.
+static void tf_printf(const char* fmt, ...) {
+  va_list ap;
+
+  va_start(ap, fmt);
+  if (m_out) {
+    msg_buf_vprintf(m_out, fmt, ap);
+  } else {
+    vprintf(fmt, ap);
+  }
+  va_end(ap);
+}
+
 // api for list all turf realm
 static int tf_do_list(struct tf_cli* cfg) {
   DIR* dir;
   struct dirent* ino;
+
+  // turfd answers from memory
+  if (m_daemon) {
+    struct turf_t* tf;
+    LIST_FOREACH(tf, &m_pids, in_list) {
+      tf_printf("%s\n", tf->name_);
+    }
+    return 0;
+  }
+
+  // or from turfd's state table
+  struct stb_table* t = stb_open(tfd_path_stbl());
+  if (t) {
+    uint32_t i;
+    struct oci_state_rec rec;
+    for (i = 0; i < t->nslots; i++) {
+      if (stb_read(t, i, &rec) == 0) {
+        tf_printf("%s\n", rec.id);
+      }
+    }
+    stb_close(t);
+    return 0;
+  }
+
   dir = opendir(tfd_path_sandbox());
   if (!dir) {
     die("opendir");
@@ -423,33 +1846,60 @@ static int tf_do_list(struct tf_cli* cfg) {
   while ((ino = readdir(dir)) != NULL) {
     if (ino->d_type & DT_DIR && strcmp(ino->d_name, ".") &&
         strcmp(ino->d_name, "..")) {
-      printf("%s\n", ino->d_name);
+      tf_printf("%s\n", ino->d_name);
     }
   }
   closedir(dir);
   return 0;
 }
 
+// extract code.zip as the tree of the cache
+static int tf_unzip(const char* src, const char* dest) {
+  struct zip_stat st;
+  if (zip_extract(src, dest, &st) < 0) {
+    return -1;
+  }
+  dprint("unzipped %s: %" PRIu64 " files, %" PRIu64 " bytes from %" PRIu64,
+         src,
+         st.files,
+         st.bytes,
+         st.packed);
+  return 0;
+}
+
+// link the code of the sandbox to the cached tree of src
+static int tf_link_code(const char* name, const char* src, cch_fill_fn fill) {
+  char key[CCH_KEY_SIZE];
+  char dest[TURF_MAX_PATH_LEN];
+  char ref[TURF_MAX_PATH_LEN];
+
+  shl_path3(dest, sizeof(dest), tfd_path_overlay(), name, "code");
+  shl_path3(ref, sizeof(ref), tfd_path_overlay(), name, "cache.ref");
+  if (cch_key(src, key) < 0 ||
+      cch_link(tfd_path_cache(), key, src, fill, dest, ref) < 0) {
+    return -1;
+  }
+  dprint("cached %s: %s", name, key);
+  return 0;
+}
+
 // api for create a turf realm
 static int tf_internal_do_create(struct tf_cli* cfg,
                                  struct oci_spec** out_spec) {
   const char* name = cfg->sandbox_name;
   bool success = 0;
 
-  char bundle_config_path[TURF_MAX_PATH_LEN];
-  char bundle_code_path[TURF_MAX_PATH_LEN];
-  if (cfg->bundle_path) {
-    shl_path2(bundle_config_path,
-              sizeof(bundle_config_path),
-              cfg->bundle_path,
-              "config.json");
-    shl_path2(
-        bundle_code_path, sizeof(bundle_code_path), cfg->bundle_path, "code");
-  } else {
-    shl_path2(
-        bundle_config_path, sizeof(bundle_config_path), "./", "config.json");
-    shl_path2(bundle_code_path, sizeof(bundle_code_path), "./", "code");
-  }
+  char bundle_config_path[TURF_MAX_PATH_LEN];
+  char bundle_code_path[TURF_MAX_PATH_LEN];
+  char bundle_zip_path[TURF_MAX_PATH_LEN];
+  const char* bundle = cfg->bundle_path ? cfg->bundle_path : "./";
+  shl_path2(
+      bundle_config_path, sizeof(bundle_config_path), bundle, "config.json");
+  shl_path2(bundle_code_path, sizeof(bundle_code_path), bundle, "code");
+  shl_path2(bundle_zip_path, sizeof(bundle_zip_path), bundle, "code.zip");
+
+  // a bundle ships a code dir, or code.zip
+  bool zipped = shl_notexist2(bundle, "code") && shl_exist2(bundle, "code.zip");
 
   struct oci_spec* spec;
   if (cfg->config_json) {
@@ -466,11 +1916,13 @@ static int tf_internal_do_create(struct tf_cli* cfg,
   // check if exists
   if (!shl_notexist2(tfd_path_sandbox(), name)) {
     error("sandbox exists");
+    set_errno(EEXIST);
     goto exit;
   }
 
   if (!shl_notexist2(tfd_path_overlay(), name)) {
     error("overlay exists");
+    set_errno(EEXIST);
     goto exit;
   }
 
@@ -485,14 +1937,18 @@ static int tf_internal_do_create(struct tf_cli* cfg,
     goto exit;
   }
 
-  // makeup dirs
-  shl_mkdir2(tfd_path_sandbox(), name);
-  shl_mkdir2(tfd_path_overlay(), name);
-  shl_mkdir3(tfd_path_overlay(), name, "work");
-  shl_mkdir3(tfd_path_overlay(), name, "data");
-
   char dest[TURF_MAX_PATH_LEN];
+  char overlay[TURF_MAX_PATH_LEN];
   shl_path2(dest, sizeof(dest), tfd_path_sandbox(), name);
+  shl_path2(overlay, sizeof(overlay), tfd_path_overlay(), name);
+
+  // makeup dirs, turfd takes the spare made ahead.
+  if (!m_daemon || spr_take(spec->turf.runtime, dest, overlay) < 0) {
+    shl_mkdir2(tfd_path_sandbox(), name);
+    shl_mkdir2(tfd_path_overlay(), name);
+    shl_mkdir3(tfd_path_overlay(), name, "work");
+    shl_mkdir3(tfd_path_overlay(), name, "data");
+  }
 
   // copy config
   if (cfg->config_json) {
@@ -505,7 +1961,38 @@ static int tf_internal_do_create(struct tf_cli* cfg,
 
   // copy code
   shl_path2(dest, sizeof(dest), tfd_path_overlay(), name);
-  shl_cp(bundle_code_path, dest, "code");
+  if (zipped) {
+    // extracted once into the cache, then linked
+    if (tf_link_code(name, bundle_zip_path, tf_unzip) < 0) {
+      error("extract code failed");
+      goto exit;
+    }
+  } else if (cfg->has.cache) {
+    if (tf_link_code(name, bundle_code_path, NULL) < 0) {
+      error("link cached code failed");
+      goto exit;
+    }
+  } else if (cfg->has.dedup) {
+    struct cpy_stat st;
+    shl_path3(dest, sizeof(dest), tfd_path_overlay(), name, "code");
+    if (cpy_stage(bundle_code_path,
+                  dest,
+                  CPY_F_CLONE | CPY_F_LINK,
+                  tfd_path_farm(),
+                  &st) < 0) {
+      error("stage code failed");
+      goto exit;
+    }
+    dprint("staged %s: %" PRIu64 " files, %" PRIu64 " cloned, %" PRIu64
+           " linked, %" PRIu64 " new",
+           name,
+           st.files,
+           st.clones,
+           st.linked,
+           st.farmed);
+  } else {
+    shl_cp(bundle_code_path, dest, "code");
+  }
 
   success = 1;
   if (out_spec) {
@@ -513,51 +2000,157 @@ static int tf_internal_do_create(struct tf_cli* cfg,
   }
 
 exit:
-  if (spec && !out_spec) {
+  if (spec && (!success || !out_spec)) {
     oci_spec_free(spec);
   }
   return success ? 0 : -1;
 }
 
+// the spec parsed is kept for turfd
+static int tf_create_dirs(struct tf_cli* cfg, struct oci_spec** spec) {
+  return tf_internal_do_create(cfg, m_daemon ? spec : NULL);
+}
+
+/* hold the spec and the realm of it, a start of the sandbox binds the
+ *  options and forks only. a seed makes its socket at start.
+ */
+static void tf_prepare(struct turf_t* tf, struct oci_spec* spec) {
+  tf->i_spec = spec;
+  if (spec->turf.has.is_seed && spec->turf.is_seed) {
+    return;
+  }
+
+  if (tf_realm_prepare(tf, spec) == 0) {
+    tf->prepared = 1;
+    return;
+  }
+
+  // set up at start again
+  struct rlm_t* r = rlm_new(tf->name_);
+  if (r) {
+    rlm_free(tf->realm);
+    tf->realm = r;
+  }
+}
+
+// turfd knows the sandbox from now on, spec is taken.
+static void tf_created(const char* name, struct oci_spec* spec) {
+  if (m_daemon && !tf_find_realm(name)) {
+    struct turf_t* tf = tf_new(name);
+    if (!tf || tf_reg_add(tf) < 0) {
+      tf_free(tf);
+    } else {
+      if (spec) {
+        tf_prepare(tf, spec);
+        spec = NULL;
+      }
+      tf_slot_update(tf);
+    }
+  }
+  if (spec) {
+    oci_spec_free(spec);
+  }
+}
+
 static int tf_do_create(struct tf_cli* cfg) {
-  return tf_internal_do_create(cfg, NULL);
+  struct oci_spec* spec = NULL;
+
+  int rc = tf_create_dirs(cfg, &spec);
+  if (rc == 0) {
+    tf_created(cfg->sandbox_name, spec);
+  }
+  return rc;
 }
 
-// delete a sandbox
-static int tf_do_delete(struct tf_cli* cfg) {
-  int rc = -1;
-  char dest[TURF_MAX_PATH_LEN];
-  const char* name = cfg->sandbox_name;
+// check the sandbox could be deleted
+static int tf_delete_check(const char* name) {
+  int rc = 0;
 
-  shl_path3(dest, sizeof(dest), tfd_path_sandbox(), name, "state");
-  struct oci_state* state = oci_state_load(dest);
+  struct oci_state* state = tf_state_load(name);
   if (state) {
     // TBD: support force flag,
     // stop will send to daemon, and delete sandbox afterwardss
-    if (state->state != RLM_STATE_STOPPED) {
-      rc = kill(state->pid, 0);
-
+    if (state->state != RLM_STATE_STOPPED && kill(state->pid, 0) == 0) {
       // is running
-      if (rc == 0) {
-        error("sandbox is running");
-        set_errno(EBUSY);
-        rc = -1;
-        goto exit;
-      }
+      error("sandbox is running");
+      set_errno(EBUSY);
+      rc = -1;
     }
+    tf_state_free(state);
+  }
+  return rc;
+}
+
+// move the dirs into the trash, removed by the reaper later.
+static int tf_trash_dirs(const char* name) {
+  const char* trash = tfd_path_trash();
+
+  if (mkdir(trash, 0700) < 0 && errno != EEXIST) {
+    return -1;
+  }
+  if ((trs_put(trash, tfd_path_sandbox(), name) < 0 && errno != ENOENT) ||
+      (trs_put(trash, tfd_path_overlay(), name) < 0 && errno != ENOENT)) {
+    return -1;
+  }
+
+  // turfd has the reaper thread
+  if (!trs_running() && trs_spawn(trash, tf_gc_code) < 0) {
+    pwarn("spawn reaper failed, %s is left in trash", name);
+  }
+  return 0;
+}
+
+// drop the pending write of the state, or it lands in a re-created one.
+static void tf_state_cancel(const char* name) {
+  char dest[TURF_MAX_PATH_LEN];
+
+  shl_path3(dest, sizeof(dest), tfd_path_sandbox(), name, "state");
+  wrt_cancel(dest);
+}
+
+// rm dirs, no spec
+static int tf_delete_dirs(struct tf_cli* cfg, struct oci_spec** spec) {
+  const char* name = cfg->sandbox_name;
+
+  tf_state_cancel(name);
+  if (cfg->has.async && tf_trash_dirs(name) == 0) {
+    return 0;
   }
 
-  // rm dirs
+  // the rest if not all trashed
   shl_rmdir2(tfd_path_sandbox(), name);
   shl_rmdir2(tfd_path_overlay(), name);
 
-  rc = 0;
+  // not on the delete, collecting costs by the whole farm and cache
+  if (m_daemon) {
+    __atomic_store_n(&m_gc_due, 1, __ATOMIC_RELAXED);
+  } else if (trs_spawn(tfd_path_trash(), tf_gc_code) < 0) {
+    pwarn("spawn reaper failed, the shared code is left");
+  }
+  return 0;
+}
 
-exit:
-  if (state) {
-    oci_state_free(state);
+// drop the one in memory
+static void tf_deleted(const char* name, struct oci_spec* spec) {
+  struct turf_t* tf = m_daemon ? tf_find_realm(name) : NULL;
+  if (tf) {
+    tf_reg_del(tf);
+    tf_free(tf);
   }
-  return rc;
+
+  // flushed while the dirs were removed on a worker
+  tf_state_cancel(name);
+}
+
+// delete a sandbox
+static int tf_do_delete(struct tf_cli* cfg) {
+  if (tf_delete_check(cfg->sandbox_name) < 0) {
+    return -1;
+  }
+
+  tf_delete_dirs(cfg, NULL);
+  tf_deleted(cfg->sandbox_name, NULL);
+  return 0;
 }
 
 static int tf_internal_do_start(struct tf_cli* cfg, struct oci_spec* spec) {
@@ -584,8 +2177,7 @@ static int tf_internal_do_start(struct tf_cli* cfg, struct oci_spec* spec) {
 
   // exists
   bool is_running = false;
-  shl_path3(dest, sizeof(dest), tfd_path_sandbox(), name, "state");
-  state = oci_state_load(dest);
+  state = tf_state_load(name);
   if (state && state->pid &&
       (state->state != RLM_STATE_STOPPED || state->state != RLM_STATE_INIT)) {
     rc = kill(state->pid, 0);
@@ -596,7 +2188,7 @@ static int tf_internal_do_start(struct tf_cli* cfg, struct oci_spec* spec) {
   }
 
   if (state) {
-    oci_state_free(state);
+    tf_state_free(state);
     state = NULL;
   }
 
@@ -605,87 +2197,36 @@ static int tf_internal_do_start(struct tf_cli* cfg, struct oci_spec* spec) {
     goto exit;
   }
 
-  // new turf_t
-  struct turf_t* tf = tf_new(name);
+  // new turf_t, turfd reuses the one holds the state, or made at create.
+  struct turf_t* tf = m_daemon ? tf_find_realm(name) : NULL;
+  if (tf && !tf->prepared) {
+    rc = tf_renew(tf);
+    if (rc < 0) {
+      goto exit;
+    }
+  } else if (!tf) {
+    tf = tf_new(name);
+  }
   dprint("%s: new rlm %s %p", __func__, name, tf);
   struct rlm_t* rlm = tf->realm;
-
-  shl_path3(dest, sizeof(dest), tfd_path_overlay(), name, code);
-  rlm_chroot(rlm, dest);
-
-  rlm_arg(rlm, spec->process.arg->argc, spec->process.arg->argv);
-
-  // warm-fork seed process
-  if (spec->turf.has.is_seed && spec->turf.is_seed) {
-    // makeup socket pair for the seed sandbox
-    int sv[2];
-    rc = sck_pair_unix_socket(sv);
-    rlm_socketpair(rlm, sv);
-    dprint("seed %s sv[%d,%d]\n", cfg->sandbox_name, sv[0], sv[1]);
-
-    struct sck_loop* loop = sck_default_loop();
-    sck_create_event(loop, sv[0], SCK_READ, tf_seed_on_read, tf);
-
-    // env
-    char sz[16];
-    snprintf(sz, 16, "%d", sv[1]);
-    env_set(spec->process.env, "LD_PRELOAD", tfd_path_libturf());
-    env_set(spec->process.env, "TURFPHD_FD", sz);
-  }
-
-  // environ
-  char** env = spec->process.env->environ;
-  rlm_env(rlm, env);
-
-  char* bin = NULL;
-  rc = tf_find_binary(&bin, spec->turf.runtime, spec->process.arg->argv[0]);
-  if (rc < 0) {
-    error("binary not found");
+  if (tf_realm_setup(tf, cfg, spec) < 0) {
     goto exit;
   }
-  rlm->cfg.binary = bin;  // spec->process.argv[0];
-
-  // mem limit
-  if (spec->linuxs.resources.has.mem_limit) {
-    rlm_limit_mem(rlm, spec->linuxs.resources.mem_limit / 1024);
-  }
-
-  // cpu limit
-  if (spec->linuxs.resources.has.cpu_quota &&
-      spec->linuxs.resources.has.cpu_period &&
-      spec->linuxs.resources.cpu_period > 0) {
-    uint32_t ms = spec->linuxs.resources.cpu_quota /
-                  (spec->linuxs.resources.cpu_period / 1000);
-    rlm_limit_cpu(rlm, ms);
-  }
-
-  if (spec->process.has.terminal && spec->process.terminal) {
-    rlm->cfg.flags.terminal = 1;
-  }
-
-  if (cfg->file_stdout) {
-    dprint("stdout: %s", cfg->file_stdout);
-    rlm->cfg.fd_stdout = strdup(cfg->file_stdout);
-    rlm->cfg.flags.fd_stdout = 1;
-  }
-
-  if (cfg->file_stderr) {
-    dprint("stderr: %s", cfg->file_stderr);
-    rlm->cfg.fd_stderr = strdup(cfg->file_stderr);
-    rlm->cfg.flags.fd_stderr = 1;
-  }
 
   if (cfg->has.seed) {
     // request fork
     dprint("request %s for clone.", cfg->seed_sandbox_name);
 
     struct turf_t* stf = tf_find_realm(cfg->seed_sandbox_name);
-    if (!stf) {
+    if (!stf || stf->pid_ <= 0) {
       error("request seed sandbox `%s` is not found.", cfg->seed_sandbox_name);
       return -1;
     }
 
-    tf_seed_fork_req(stf, tf->realm);
+    if (tf_seed_fork_req(tf_seed_pick(stf), tf->realm) < 0) {
+      error("request fork of %s failed", name);
+      goto exit;
+    }
 
   } else {
     // go sandbox local
@@ -704,7 +2245,9 @@ static int tf_internal_do_start(struct tf_cli* cfg, struct oci_spec* spec) {
   // running state
   state->pid = rlm->st.child_pid;
 
-  if (cfg->has.seed) {
+  if (cfg->has.seed && rlm->st.state == RLM_STATE_STOPPED) {
+    state->state = RLM_STATE_STOPPED;  // not sent to the seed
+  } else if (cfg->has.seed) {
     state->state = RLM_STATE_CLONING;  // cloning
   } else {
     state->state = RLM_STATE_RUNNING;  // running
@@ -712,10 +2255,11 @@ static int tf_internal_do_start(struct tf_cli* cfg, struct oci_spec* spec) {
 
   // TBD: start time
   get_current_time(&state->created);
-  oci_state_save(state, dest);
 
   // waits until sandbox exits
   if (!cfg->has.remote) {  // runc mode
+    oci_state_save(state, dest);
+
     int exit_code;
     struct rusage ru;
     rlm_wait(rlm, &exit_code, &ru);
@@ -739,7 +2283,20 @@ static int tf_internal_do_start(struct tf_cli* cfg, struct oci_spec* spec) {
 
   } else {  // C/S mode
     // insert to pid_list
-    LIST_INSERT_HEAD(&m_pids, tf, in_list);
+    if (tf_find_realm(name) == tf) {
+      tf_reg_set_pid(tf, rlm->st.child_pid);
+    } else {
+      tf_reg_add(tf);
+    }
+
+    // tf holds the state
+    tf_state_attach(tf, state);
+    state = NULL;
+
+    // the clone is watched after FORK_RSP
+    if (!cfg->has.seed) {
+      tf_watch_exit(tf);
+    }
   }
 
   success = 1;
@@ -758,6 +2315,16 @@ static int tf_do_start(struct tf_cli* cfg) {
   const char* name = cfg->sandbox_name;
   bool success = 0;
 
+  // turfd holds the one parsed at create
+  struct turf_t* tf = m_daemon ? tf_find_realm(name) : NULL;
+  if (tf && tf->i_spec) {
+    if (tf_internal_do_start(cfg, tf->i_spec) < 0) {
+      error("tf_internal_do_start failed");
+      return -1;
+    }
+    return 0;
+  }
+
   // load spec from sanbox name
   shl_path3(dest, sizeof(dest), tfd_path_sandbox(), name, "config.json");
   spec = oci_spec_load(dest);
@@ -787,12 +2354,10 @@ exit:
 // api for stop(kill -15) turf realm
 static int tf_do_stop(struct tf_cli* cfg) {
   int rc = -1;
-  char dest[TURF_MAX_PATH_LEN];
   const char* name = cfg->sandbox_name;
   bool success = 0;
 
-  shl_path3(dest, sizeof(dest), tfd_path_sandbox(), name, "state");
-  struct oci_state* state = oci_state_load(dest);
+  struct oci_state* state = tf_state_load(name);
   if (!state) {
     error("state for sandbox not found.");
     set_errno(ENOENT);
@@ -841,20 +2406,14 @@ static int tf_do_stop(struct tf_cli* cfg) {
   }
 
   // exited
-  struct turf_t* tf = tf_get_realm(state->pid);
-  if (tf) {
-    LIST_REMOVE(tf, in_list);
-    tf_free(tf);
-  }
-
   state->state = RLM_STATE_STOPPED;  // stop
-  oci_state_save(state, dest);
+  tf_state_save(name, state);
 
   success = 1;
 
 exit:
   if (state) {
-    oci_state_free(state);
+    tf_state_free(state);
   }
 
   return success ? 0 : -1;
@@ -864,15 +2423,13 @@ exit:
  */
 static int tf_do_state(struct tf_cli* cfg) {
   int rc = -1;
-  char dest[TURF_MAX_PATH_LEN];
   const char* name = cfg->sandbox_name;
   tf_stat st;
   bool success = 0;
 
   // load spec from sanbox name
   struct oci_state* state = NULL;
-  shl_path3(dest, sizeof(dest), tfd_path_sandbox(), name, "state");
-  state = oci_state_load(dest);
+  state = tf_state_peek(name);
   if (!state) {
     error("sandbox %s not found.", name);
     set_errno(ENOENT);
@@ -880,133 +2437,199 @@ static int tf_do_state(struct tf_cli* cfg) {
   }
 
   int has_pid = 0;
+  uint32_t st_state = state->state;
   if (state->pid &&
       (state->state != RLM_STATE_INIT && state->state != RLM_STATE_STOPPED)) {
     rc = pid_stat(state->pid, &st);
     if (rc < 0) {
-      state->state = RLM_STATE_STOPPED;
+      st_state = RLM_STATE_STOPPED;
     } else {
       has_pid = 1;
     }
   }
 
-  printf("name: %s\n"
-         "pid: %d\n"
-         "state: %s\n",
-         name,
-         state->pid,
-         rlm_state_str(state->state));
+  // OCI compatible output
+  if (cfg->has.json) {
+    char* json = NULL;
+    struct oci_state out = *state;
+    out.state = st_state;
+    if (oci_state_saves(&out, &json) < 0) {
+      goto exit;
+    }
+    tf_printf("%s\n", json);
+    free(json);
+    success = 1;
+    goto exit;
+  }
+
+  tf_printf("name: %s\n"
+            "pid: %d\n"
+            "state: %s\n",
+            name,
+            state->pid,
+            rlm_state_str(st_state));
 
   if (state->status) {
     if (state->status & RLM_STATUS_CPU_OVL) {
-      printf("status.cpu_overload: 1\n");
+      tf_printf("status.cpu_overload: 1\n");
     }
     if (state->status & RLM_STATUS_MEM_OVL) {
-      printf("status.mem_overload: 1\n");
+      tf_printf("status.mem_overload: 1\n");
     }
     if (state->status & RLM_STATUS_KILL) {
-      printf("status.killed: 1\n");
+      tf_printf("status.killed: 1\n");
     }
   } else {
-    printf("status: 0\n");
+    tf_printf("status: 0\n");
   }
 
   if (has_pid) {
-    printf("stat.utime: %lu\n"
-           "stat.stime: %lu\n"
-           "stat.cutime: %lu\n"
-           "stat.cstime: %lu\n"
-           "stat.vsize: %lu\n"
-           "stat.rss: %lu\n"
-           "stat.minflt: %lu\n"
-           "stat.majflt: %lu\n"
-           "stat.cminflt: %lu\n"
-           "stat.cmajflt: %lu\n"
-           "stat.num_threads: %u\n",
-           st.utime,
-           st.stime,
-           st.cutime,
-           st.cstime,
-           st.vsize,
-           st.rss,
-           st.min_flt,
-           st.maj_flt,
-           st.cmin_flt,
-           st.cmaj_flt,
-           st.num_threads);
+    tf_printf("stat.utime: %lu\n"
+              "stat.stime: %lu\n"
+              "stat.cutime: %lu\n"
+              "stat.cstime: %lu\n"
+              "stat.vsize: %lu\n"
+              "stat.rss: %lu\n"
+              "stat.minflt: %lu\n"
+              "stat.majflt: %lu\n"
+              "stat.cminflt: %lu\n"
+              "stat.cmajflt: %lu\n"
+              "stat.num_threads: %u\n"
+              "stat.pss: %lu\n"
+              "stat.shared_clean: %lu\n"
+              "stat.shared_dirty: %lu\n"
+              "stat.private_dirty: %lu\n",
+              st.utime,
+              st.stime,
+              st.cutime,
+              st.cstime,
+              st.vsize,
+              st.rss,
+              st.min_flt,
+              st.maj_flt,
+              st.cmin_flt,
+              st.cmaj_flt,
+              st.num_threads,
+              st.pss,
+              st.shared_clean,
+              st.shared_dirty,
+              st.private_dirty);
+
+    // the sharing with the clones, turfd knows them.
+    struct turf_t* tf = m_daemon ? tf_find_realm(name) : NULL;
+    if (tf && tf_is_seed(tf)) {
+      struct tf_seed_mem seeds, clones;
+      tf_seed_mem(tf, &seeds, &clones);
+      tf_printf("seed.procs: %u\n"
+                "seed.pss: %lu\n"
+                "seed.shared: %lu\n"
+                "seed.dirty: %lu\n"
+                "seed.clones: %u\n"
+                "seed.clones.pss: %lu\n"
+                "seed.clones.shared: %lu\n"
+                "seed.clones.dirty: %lu\n",
+                seeds.procs,
+                seeds.pss,
+                seeds.shared,
+                seeds.dirty,
+                clones.procs,
+                clones.pss,
+                clones.shared,
+                clones.dirty);
+    }
   } else {
     // exit_code
     if (state->has.exit_code) {
       // printf("exitcode: %u\n", state->exit_code);
       if (WIFEXITED(state->exit_code)) {
-        printf("exitcode: %d\n", WEXITSTATUS(state->exit_code));
+        tf_printf("exitcode: %d\n", WEXITSTATUS(state->exit_code));
       } else if (WIFSIGNALED(state->exit_code)) {
-        printf("killed.signal: %d\n", WTERMSIG(state->exit_code));
+        tf_printf("killed.signal: %d\n", WTERMSIG(state->exit_code));
       }
     }
 
     if (state->has.rusage) {
       // rusage_dump(&state->rusage);
-      printf("rusage.utime: %lu\n"
-             "rusage.stime: %lu\n"
-             "rusage.masrss: %lu\n",
-             timeval2ms(&state->rusage.ru_utime),
-             timeval2ms(&state->rusage.ru_stime),
-             state->rusage.ru_maxrss);
+      tf_printf("rusage.utime: %lu\n"
+                "rusage.stime: %lu\n"
+                "rusage.masrss: %lu\n",
+                timeval2ms(&state->rusage.ru_utime),
+                timeval2ms(&state->rusage.ru_stime),
+                state->rusage.ru_maxrss);
     }
   }
 
   success = 1;
 exit:
   if (state) {
-    oci_state_free(state);
+    tf_state_free(state);
     state = NULL;
   }
   return success ? 0 : -1;
 }
 
+// print a line of ps
+static void tf_ps_line(const char* name, int pid, int st, bool alive) {
+  if (!pid) {
+    st = RLM_STATE_INIT;
+  } else if (!alive && st != RLM_STATE_INIT && st != RLM_STATE_STOPPED) {
+    if (kill(pid, 0) < 0) {  // check pid
+      st = RLM_STATE_STOPPED;
+    }
+  }
+  tf_printf("%-30s %5d %s\n", name, pid, rlm_state_str(st));
+}
+
 // api for list all realm states
 static int tf_do_ps(struct tf_cli* cfg) {
-  int rc = -1;
   DIR* dir;
   struct dirent* ino;
+
+  // turfd answers from memory, the watched pids are alive.
+  if (m_daemon) {
+    struct turf_t* tf;
+    LIST_FOREACH(tf, &m_pids, in_list) {
+      struct oci_state* state = tf->o_state;
+      tf_ps_line(tf->name_,
+                 state ? state->pid : 0,
+                 state ? state->state : RLM_STATE_INIT,
+                 tf->pid_ > 0);
+    }
+    return 0;
+  }
+
+  // turfd keeps the table up to date, no pid to check.
+  struct stb_table* t = stb_open(tfd_path_stbl());
+  if (t) {
+    uint32_t i;
+    struct oci_state_rec rec;
+    for (i = 0; i < t->nslots; i++) {
+      if (stb_read(t, i, &rec) == 0) {
+        tf_ps_line(rec.id, rec.pid, rec.state, 1);
+      }
+    }
+    stb_close(t);
+    return 0;
+  }
+
   dir = opendir(tfd_path_sandbox());
   if (!dir) {
     die("opendir");
   }
 
-  struct pss {
-    char* name;
-    int pid;
-    int state;
-  } st;
-
   char dest[TURF_MAX_PATH_LEN];
   while ((ino = readdir(dir)) != NULL) {
     if ((ino->d_type & DT_DIR) && strcmp(ino->d_name, ".") &&
         strcmp(ino->d_name, "..")) {
-      memset(&st, 0, sizeof(st));
-
       char* name = ino->d_name;
-      st.name = name;
       shl_path3(dest, sizeof(dest), tfd_path_sandbox(), name, "state");
       struct oci_state* state = oci_state_load(dest);
-      if (state && state->pid) {
-        st.pid = state->pid;
-
-        st.state = state->state;
-        if (st.state != RLM_STATE_INIT && st.state != RLM_STATE_STOPPED) {
-          rc = kill(st.pid, 0);  // check pid
-          if (rc < 0) {
-            st.state = RLM_STATE_STOPPED;
-          }
-        }
+      if (state) {
+        tf_ps_line(name, state->pid, state->state, 0);
         oci_state_free(state);
       } else {
-        st.pid = 0;
-        st.state = RLM_STATE_INIT;
+        tf_ps_line(name, 0, RLM_STATE_INIT, 0);
       }
-      printf("%-30s %5d %s\n", st.name, st.pid, rlm_state_str(st.state));
     }
   }
   closedir(dir);
@@ -1044,7 +2667,99 @@ exit:
 
 // show turf information
 static int tf_do_info(struct tf_cli* cfg) {
-  printf("WORKDIR: %s\n", tfd_path());
+  tf_printf("WORKDIR: %s\n", tfd_path());
+
+  if (m_daemon) {
+    struct wrt_stat st;
+    wrt_get_stat(&st);
+
+    uint64_t done = st.written + st.failed;
+    tf_printf("FLUSH_WINDOW: %u ms\n", m_flush_ms);
+    tf_printf("FLUSH_SUBMITTED: %" PRIu64 "\n", st.submitted);
+    tf_printf("FLUSH_COALESCED: %" PRIu64 "\n", st.coalesced);
+    tf_printf("FLUSH_WRITTEN: %" PRIu64 "\n", st.written);
+    tf_printf("FLUSH_SKIPPED: %" PRIu64 "\n", st.skipped);
+    tf_printf("FLUSH_FAILED: %" PRIu64 "\n", st.failed);
+    tf_printf("FLUSH_QUEUE_DEPTH: %u (max %u)\n", st.depth, st.max_depth);
+    tf_printf("FLUSH_LATENCY: last %" PRIu64 "us, avg %" PRIu64
+              "us, max %" PRIu64 "us\n",
+              st.last_us,
+              done ? st.total_us / done : 0,
+              st.max_us);
+
+    struct wkp_stat wst;
+    wkp_get_stat(&wst);
+    tf_printf("WORKER_THREADS: %u\n", wst.threads);
+    tf_printf("WORKER_SUBMITTED: %" PRIu64 "\n", wst.submitted);
+    tf_printf("WORKER_COMPLETED: %" PRIu64 "\n", wst.completed);
+    tf_printf("WORKER_RUNNING: %u\n", wst.running);
+    tf_printf("WORKER_QUEUE_DEPTH: %u (max %u)\n", wst.queued, wst.max_queued);
+    tf_printf("WORKER_LATENCY: last %" PRIu64 "us, max %" PRIu64 "us\n",
+              wst.last_us,
+              wst.max_us);
+
+    struct cch_stat cst;
+    cch_get_stat(tfd_path_cache(), &cst);
+    tf_printf("CACHE_HITS: %" PRIu64 "\n", cst.hits);
+    tf_printf("CACHE_MISSES: %" PRIu64 "\n", cst.misses);
+    tf_printf("CACHE_EVICTED: %" PRIu64 "\n", cst.evicted);
+    tf_printf("CACHE_ENTRIES: %" PRIu64 "\n", cst.entries);
+    tf_printf("CACHE_SIZE: %" PRIu64 " (budget %" PRIu64 ")\n",
+              cst.bytes,
+              cst.budget);
+
+    struct trs_stat tst;
+    trs_get_stat(&tst);
+    tf_printf("TRASH_TRASHED: %" PRIu64 "\n", tst.trashed);
+    tf_printf("TRASH_REAPED: %" PRIu64 "\n", tst.reaped);
+    tf_printf("TRASH_FAILED: %" PRIu64 "\n", tst.failed);
+    tf_printf("TRASH_PENDING: %u\n", tst.pending);
+    tf_printf("TRASH_LATENCY: last %" PRIu64 "us, max %" PRIu64 "us\n",
+              tst.last_us,
+              tst.max_us);
+
+    tf_printf("SEED_MAX: %u\n", m_seed_max);
+    tf_printf("SEED_FORKS: %" PRIu64 "\n", m_seed_stat.forks);
+    tf_printf("SEED_FORK_MSGS: %" PRIu64 "\n", m_seed_stat.msgs);
+    tf_printf("SEED_SHM_MSGS: %" PRIu64 "\n", m_seed_stat.shm_msgs);
+    tf_printf("SEED_TEMPLATES: %" PRIu64 "\n", m_seed_stat.tmpls);
+    tf_printf("SEED_REPLICAS: %u\n", m_seed_stat.replicas);
+    tf_printf("SEED_SPAWNED: %" PRIu64 "\n", m_seed_stat.spawned);
+    tf_printf("SEED_RESPAWNED: %" PRIu64 "\n", m_seed_stat.respawned);
+    tf_printf("SEED_RETIRED: %" PRIu64 "\n", m_seed_stat.retired);
+
+    // the sharing of each seed group, in KBs
+    struct turf_t* tf;
+    LIST_FOREACH(tf, &m_pids, in_list) {
+      if (tf->pid_ <= 0 || !tf_is_seed(tf)) {
+        continue;
+      }
+      struct tf_seed_mem seeds, clones;
+      tf_seed_mem(tf, &seeds, &clones);
+      tf_printf("SEED_MEM: %s, seeds %u pss %lu dirty %lu, clones %u pss %lu"
+                " shared %lu dirty %lu\n",
+                tf->name_,
+                seeds.procs,
+                seeds.pss,
+                seeds.dirty,
+                clones.procs,
+                clones.pss,
+                clones.shared,
+                clones.dirty);
+    }
+
+    struct spr_stat sst;
+    spr_get_stat(&sst);
+    tf_printf("SPARE_SIZE: %u (%u runtimes)\n", sst.size, sst.runtimes);
+    tf_printf("SPARE_READY: %u (refilling %u)\n", sst.ready, sst.refilling);
+    tf_printf("SPARE_HITS: %" PRIu64 "\n", sst.hits);
+    tf_printf("SPARE_MISSES: %" PRIu64 "\n", sst.misses);
+    tf_printf("SPARE_FAILED: %" PRIu64 "\n", sst.failed);
+    tf_printf("SPARE_REFILL_LATENCY: last %" PRIu64 "us, max %" PRIu64
+              "us\n",
+              sst.last_us,
+              sst.max_us);
+  }
   return 0;
 }
 
@@ -1061,7 +2776,7 @@ static int tf_do_runtime(struct tf_cli* cfg) {
   while ((ino = readdir(dir)) != NULL) {
     if ((ino->d_type & DT_DIR) && strcmp(ino->d_name, ".") &&
         strcmp(ino->d_name, "..")) {
-      printf("%-20s \n", ino->d_name);
+      tf_printf("%-20s \n", ino->d_name);
     }
   }
   closedir(dir);
@@ -1139,3 +2854,139 @@ int tf_action(struct tf_cli* cfg) {
 
   return rc;
 }
+
+// a create or delete on the workers
+struct tf_job {
+  struct tf_cli cfg;      // own copy of the request
+  struct oci_spec* spec;  // parsed by work, taken by finish
+  int (*work)(struct tf_cli* cfg, struct oci_spec** spec);  // on a worker
+  void (*finish)(const char* name, struct oci_spec* spec);  // on the loop
+  tf_done_fn done;
+  void* data;
+  uint32_t seq;
+};
+
+static void tf_job_free(struct tf_job* job) {
+  if (job->spec) {
+    oci_spec_free(job->spec);
+  }
+  cli_free(&job->cfg);
+  free(job);
+}
+
+static int tf_job_work(void* arg) {
+  struct tf_job* job = (struct tf_job*)arg;
+  return job->work(&job->cfg, &job->spec);
+}
+
+// finish if work succeeded
+static void tf_job_done(void* arg, int rc, int err) {
+  struct tf_job* job = (struct tf_job*)arg;
+
+  if (rc == 0 && job->finish) {
+    job->finish(job->cfg.sandbox_name, job->spec);
+    job->spec = NULL;
+  }
+  hmap_sdel(m_busy, job->cfg.sandbox_name);
+
+  if (job->done) {
+    job->done(job->data, job->seq, rc == 0 ? 0 : -(err ? err : EIO));
+  }
+  tf_job_free(job);
+}
+
+static int tf_job_submit(struct tf_cli* cfg,
+                         int (*work)(struct tf_cli* cfg,
+                                     struct oci_spec** spec),
+                         void (*finish)(const char* name,
+                                        struct oci_spec* spec),
+                         tf_done_fn done,
+                         void* data,
+                         uint32_t seq) {
+  struct tf_job* job = (struct tf_job*)calloc(1, sizeof(struct tf_job));
+  if (!job) {
+    set_errno(ENOMEM);
+    return -1;
+  }
+
+  // the request is gone after return, strings are copied.
+  job->cfg.cmd = cfg->cmd;
+  job->cfg.has = cfg->has;
+  job->cfg.memlimit = cfg->memlimit;
+  job->cfg.cpulimit = cfg->cpulimit;
+  job->cfg.sandbox_name = strdup(cfg->sandbox_name);
+  if (cfg->bundle_path) {
+    job->cfg.bundle_path = strdup(cfg->bundle_path);
+  }
+  if (cfg->config_json) {
+    job->cfg.config_json = strdup(cfg->config_json);
+  }
+  if (!job->cfg.sandbox_name || (cfg->bundle_path && !job->cfg.bundle_path) ||
+      (cfg->config_json && !job->cfg.config_json)) {
+    set_errno(ENOMEM);
+    goto error;
+  }
+  job->work = work;
+  job->finish = finish;
+  job->done = done;
+  job->data = data;
+  job->seq = seq;
+
+  if (!m_busy) {
+    m_busy = hmap_new(0);
+    if (!m_busy) {
+      set_errno(ENOMEM);
+      goto error;
+    }
+  }
+  if (hmap_sput(m_busy, job->cfg.sandbox_name, job) < 0) {
+    goto error;
+  }
+
+  if (wkp_submit(tf_job_work, tf_job_done, job) < 0) {
+    hmap_sdel(m_busy, job->cfg.sandbox_name);
+    goto error;
+  }
+  return 1;
+
+error:
+  tf_job_free(job);
+  return -1;
+}
+
+bool _API tf_busy(const char* name) {
+  return name && m_busy && hmap_sget(m_busy, name);
+}
+
+// entry for turfd, the blocking create and delete go to the workers.
+int _API tf_action_async(struct tf_cli* cfg,
+                         tf_done_fn done,
+                         void* data,
+                         uint32_t seq) {
+  const char* name = cfg->sandbox_name;
+
+  // one job at a time for a sandbox
+  if (tf_busy(name)) {
+    error("sandbox %s is busy", name);
+    set_errno(EBUSY);
+    return -1;
+  }
+
+  if (!name || wkp_fd() < 0) {
+    return tf_action(cfg);
+  }
+
+  switch (cfg->cmd) {
+    case TURF_CLI_CREATE:
+      return tf_job_submit(cfg, tf_create_dirs, tf_created, done, data, seq);
+
+    case TURF_CLI_REMOVE:
+      if (tf_delete_check(name) < 0) {
+        return -1;
+      }
+      return tf_job_submit(cfg, tf_delete_dirs, tf_deleted, done, data, seq);
+
+    default:
+      return tf_action(cfg);
+  }
+}
@@ -6,6 +6,12 @@
 #include "stat.h"
 #include "warmfork.h"  // struct tf_seed
 
+// turfd flushes the dirty states in batch, default window in milliseconds.
+#define TF_STATE_FLUSH_MS (100)
+
+// turfd collects the shared code left by deletes, at most once in ms.
+#define TF_GC_INTERVAL_MS (60 * 1000)
+
 // represent a running turf sandbox
 struct turf_t {
   struct rlm_t* realm;            // the realm core
@@ -16,11 +22,16 @@ struct turf_t {
   uint32_t status;  // OOM, COL, KLL ...
 
   // oci intf
-  struct oci_spec* i_spec;    // holds oci_spec
+  struct oci_spec* i_spec;    // holds oci_spec, parsed at create in turfd
   struct oci_state* o_state;  // holds oci_state
+  bool prepared;              // realm set up from i_spec, not started yet
 
   // global list
-  LIST_ENTRY(turf_t) in_list;  // in global sandbox list
+  LIST_ENTRY(turf_t) in_list;    // in global sandbox list
+  TAILQ_ENTRY(turf_t) in_dirty;  // in state flush queue
+  TAILQ_ENTRY(turf_t) in_forkq;  // in seed fork queue, see tf_seed_fork_req()
+  bool dirty;                    // o_state needs to be flushed
+  int slot;                      // slot in state table, -1 if none
 
   // stat
   struct tf_stat stat;           // stat: io, cpu, mem ...
@@ -36,8 +47,36 @@ struct turf_t {
 // turf entry function
 int _API tf_action(struct tf_cli* cfg);
 
+// the deferred tf_action() is done, rc is 0 or -errno.
+typedef void (*tf_done_fn)(void* data, uint32_t seq, int rc);
+
+// a job of the sandbox is on the workers
+bool _API tf_busy(const char* name);
+
+// like tf_action(), but create and delete run on the worker pool in turfd,
+// return 1 if deferred, done is called on the loop thread later.
+int _API tf_action_async(struct tf_cli* cfg, tf_done_fn done, void* data,
+                         uint32_t seq);
+
+// capture the output of tf_action() into out, NULL for stdout.
+struct msg_buf;
+void _API tf_set_output(struct msg_buf* out);
+
 int _API tf_health_check(void);
 int _API tf_child_exit(pid_t child, struct rusage* ru, int exit_code);
 int _API tf_exit_all(void);
 
+// turfd holds all sandbox states in memory
+int _API tf_daemon_init(struct tf_cli* cfg);
+int _API tf_daemon_start(void);
+int _API tf_state_flush(bool sync);
+void _API tf_state_report(void);
+
+// sandbox registry, indexed by pid and name
+int _API tf_reg_add(struct turf_t* tf);
+void _API tf_reg_del(struct turf_t* tf);
+int _API tf_reg_set_pid(struct turf_t* tf, pid_t pid);
+struct turf_t _API* tf_get_realm(pid_t pid);
+struct turf_t _API* tf_find_realm(const char* name);
+
 #endif  // _TURF_TURF_H_
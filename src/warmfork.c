@@ -7,6 +7,7 @@
 #define _GNU_SOURCE
 #include "warmfork.h"
 #include <link.h>    // ElfW(x)
+#include <poll.h>    // poll()
 #include <string.h>  // strdup()
 #include "sock.h"
 
@@ -17,9 +18,20 @@ static int _stop = 0;
 static struct tf_phd_slot m_phds[MAX_PHD_SLOTS];
 static int m_phd_cnt = 0;
 static int m_fd = -1;
+static struct tipc_ep m_ep;     // reads m_fd
+static struct shq_pair m_shq;   // shared memory queues, if has_shq
+static bool m_has_shq = false;  // turfd passed SHQ_ENV
 static struct rlm_t m_rlm = {0};
+static struct arena m_arena;  // the realms of a fork msg, reset after it
 static char* _elf_entry = 0;
 
+// templates registered by turfd, decoded once, see TIPC_MSG_FORK_TMPL
+static struct {
+  uint32_t id;  // 0 if none
+  struct rlm_t rlm;
+  struct arena arena;  // of rlm
+} m_tmpls[TIPC_FORK_TMPL_MAX];
+
 // read elf offset
 static size_t elf_read(int fd, size_t offset, void* buf, size_t size) {
   size_t l;
@@ -206,9 +218,41 @@ static int twf_inform_seed_ready() {
   return 0;
 }
 
+// in place of the shared memory, 0 if sent, or -1 for the socket.
+static int twf_shq_fork_rsp(struct rlm_t* realms, int count) {
+  if (!m_has_shq) {
+    return -1;
+  }
+
+  char* msg = shq_reserve(&m_shq.rsp, TIPC_MSG_MAX_SIZE);
+  if (!msg) {
+    return -1;
+  }
+
+  int len;
+  if (count == 1) {
+    len = tipc_enc_fork_rsp(msg, TIPC_MSG_MAX_SIZE, realms);
+  } else {
+    len = tipc_enc_fork_rsp_batch(msg, TIPC_MSG_MAX_SIZE, realms, count);
+  }
+  if (len < 0) {
+    return -1;
+  }
+
+  // published even if the ring failed
+  if (shq_commit(&m_shq.rsp, len) < 0) {
+    error("ring turfd failed");
+  }
+  return 0;
+}
+
 static int twf_inform_fork_rsp() {
   char buf[4096];
 
+  if (twf_shq_fork_rsp(&m_rlm, 1) == 0) {
+    return 0;
+  }
+
   int len = tipc_enc_fork_rsp(buf, 4096, &m_rlm);
   dprint("tipc msg size: %d", len);
 
@@ -221,6 +265,144 @@ static int twf_inform_fork_rsp() {
   return 0;
 }
 
+// one msg for the batch, in the order of the request.
+static int twf_inform_fork_rsp_batch(struct rlm_t* realms, int count) {
+  char buf[TIPC_MSG_MAX_SIZE];
+
+  if (twf_shq_fork_rsp(realms, count) == 0) {
+    return 0;
+  }
+
+  int len = tipc_enc_fork_rsp_batch(buf, sizeof(buf), realms, count);
+  dprint("tipc msg size: %d", len);
+  if (len < 0) {
+    error("encode fork_rsp_batch failed");
+    return -1;
+  }
+
+  int l = write(m_fd, buf, len);
+  if (l != len) {
+    error("send fork_rsp_batch failed");
+    return -1;
+  }
+
+  return 0;
+}
+
+// the realms of a msg, decoded into m_arena
+static void twf_prep_rlms(struct rlm_t* rlms, int n) {
+  memset(rlms, 0, n * sizeof(struct rlm_t));
+  for (int i = 0; i < n; i++) {
+    rlms[i].cfg.arena = &m_arena;
+  }
+}
+
+static void twf_free_rlms(struct rlm_t* rlms, int n) {
+  for (int i = 0; i < n; i++) {
+    rlm_free_inner(&rlms[i]);
+  }
+  arn_reset(&m_arena);
+}
+
+/* fork the realms back-to-back, the child keeps its own realm only,
+ *  and m_arena it is in.
+ */
+static int twf_fork_rlms(struct rlm_t* rlms, int n) {
+  int i;
+
+  for (i = 0; i < n; i++) {
+    pid_t child = rlm_fork(&rlms[i]);
+    dprint("rlm_fork = %d %s", child, rlms[i].cfg.name);
+    if (child == 0) {
+      m_rlm = rlms[i];
+
+      // the rc breaks the loop
+      return -999;
+    }
+    rlms[i].st.child_pid = child;
+  }
+
+  twf_inform_fork_rsp_batch(rlms, n);
+  twf_free_rlms(rlms, n);
+  return 0;
+}
+
+static int twf_fork_batch(char* buff, size_t size) {
+  struct rlm_t rlms[TIPC_FORK_BATCH_MAX];
+  int n = TIPC_FORK_BATCH_MAX;
+
+  twf_prep_rlms(rlms, TIPC_FORK_BATCH_MAX);
+  int rc = tipc_dec_fork_req_batch(rlms, &n, buff, size);
+  if (rc < 0) {
+    twf_free_rlms(rlms, TIPC_FORK_BATCH_MAX);
+    return rc;
+  }
+  return twf_fork_rlms(rlms, n);
+}
+
+// keep the template decoded, in place of the one in its slot.
+static int twf_register_tmpl(char* buff, size_t size) {
+  struct arena a = {0};
+  struct rlm_t r = {0};
+  uint32_t id = 0;
+
+  r.cfg.arena = &a;
+  int rc = tipc_dec_fork_tmpl(&r, &id, buff, size);
+  if (rc < 0 || id == 0) {
+    arn_free(&a);
+    return rc < 0 ? rc : -1;
+  }
+
+  int slot = id % TIPC_FORK_TMPL_MAX;
+  arn_free(&m_tmpls[slot].arena);
+  m_tmpls[slot].id = id;
+  m_tmpls[slot].rlm = r;
+  m_tmpls[slot].arena = a;
+  m_tmpls[slot].rlm.cfg.arena = &m_tmpls[slot].arena;
+  dprint("template %u registered", id);
+  return 0;
+}
+
+// fork the realms of a template, only the delta is decoded.
+static int twf_fork_delta(char* buff, size_t size) {
+  struct rlm_t rlms[TIPC_FORK_BATCH_MAX];
+  int i, n = TIPC_FORK_BATCH_MAX;
+  uint32_t id = 0;
+
+  twf_prep_rlms(rlms, TIPC_FORK_BATCH_MAX);
+  int rc = tipc_dec_fork_delta(rlms, &n, &id, buff, size);
+  if (rc < 0) {
+    twf_free_rlms(rlms, TIPC_FORK_BATCH_MAX);
+    return rc;
+  }
+
+  // unknown, the clones are answered as failed
+  struct rlm_t* t = &m_tmpls[id % TIPC_FORK_TMPL_MAX].rlm;
+  if (id == 0 || m_tmpls[id % TIPC_FORK_TMPL_MAX].id != id) {
+    error("template %u not found", id);
+    for (i = 0; i < n; i++) {
+      rlms[i].st.child_pid = -1;
+    }
+    twf_inform_fork_rsp_batch(rlms, n);
+    twf_free_rlms(rlms, n);
+    return 0;
+  }
+
+  // the template is shared, not freed with the realms in m_arena.
+  for (i = 0; i < n; i++) {
+    struct rlm_cfg* c = &rlms[i].cfg;
+    c->flags = t->cfg.flags;
+    c->mode = t->cfg.mode;
+    c->argc = t->cfg.argc;
+    c->argv = t->cfg.argv;
+    c->env = t->cfg.env;
+    c->binary = t->cfg.binary;
+    c->uid = t->cfg.uid;
+    c->gid = t->cfg.gid;
+  }
+  return twf_fork_rlms(rlms, n);
+}
+
 static void dummy_warmfork_wait(int* prc, int* pargc, char*** pargv) {
   static char* av[] = {"test", "hello", "world"};
 
@@ -243,10 +425,15 @@ static void dummy_warmfork_wait(int* prc, int* pargc, char*** pargv) {
 
 int twf_msg(int type, char* buff, size_t size, void* data) {
   int rc = 0;
+
+  // answer by the checksum of turfd
+  tipc_set_csum(((struct tipc_hdr*)buff)->csum);
   switch (type) {
     case TIPC_MSG_FORK_REQ: {  // fork req
+      twf_prep_rlms(&m_rlm, 1);
       rc = tipc_dec_fork_req(&m_rlm, buff, size);
       if (rc < 0) {
+        twf_free_rlms(&m_rlm, 1);
         return rc;
       }
 
@@ -254,31 +441,118 @@ int twf_msg(int type, char* buff, size_t size, void* data) {
       dprint("rlm_fork = %d %s", child, m_rlm.cfg.name);
       if (child) {  // parent
         twf_inform_fork_rsp();
-        rlm_free_inner(&m_rlm);
+        twf_free_rlms(&m_rlm, 1);
       } else {
         // the rc breaks the loop
         return -999;
       }
+    } break;
+
+    case TIPC_MSG_FORK_REQ_BATCH:
+      return twf_fork_batch(buff, size);
+
+    case TIPC_MSG_FORK_TMPL:
+      return twf_register_tmpl(buff, size);
+
+    case TIPC_MSG_FORK_DELTA:
+      return twf_fork_delta(buff, size);
+  }
+
+  return 0;
+}
+
+/* the requests in the shared memory,
+ *  the child leaves the queue as it is, it's the seed's.
+ */
+static int twf_read_shq(void) {
+  uint32_t len;
+  char* msg;
+  int rc = 0;
+
+  shq_clear(&m_shq.req);
+  while ((msg = shq_peek(&m_shq.req, &len)) != NULL) {
+    rc = tipc_decode(msg, len, twf_msg, NULL);
+    if (rc == -999) {
+      return rc;
     }
+    shq_consume(&m_shq.req);
+    if (rc < 0) {
+      return rc;
+    }
+  }
+  return errno == EBADMSG ? -1 : 0;
+}
+
+// wait for the requests from the socket, and the shared memory.
+static int twf_read(void) {
+  if (!m_has_shq) {
+    return tipc_ep_read(&m_ep, twf_msg, NULL);
   }
 
+  struct pollfd fds[2] = {{.fd = m_fd, .events = POLLIN},
+                          {.fd = m_shq.req.efd, .events = POLLIN}};
+  if (poll(fds, 2, -1) < 0) {
+    return -1;
+  }
+  if (fds[1].revents & POLLIN) {
+    int rc = twf_read_shq();
+    if (rc < 0) {
+      return rc;  // forked, or broken
+    }
+  }
+  if (fds[0].revents) {
+    return tipc_ep_read(&m_ep, twf_msg, NULL);
+  }
   return 0;
 }
 
-static void turf_warmfork_wait(int* prc, int* pargc, char*** pargv) {
-  // inform turfd we're ready for fork.
-  twf_inform_seed_ready();
+int twf_serve(int fd) {
+  int rc, err;
 
-  // the loop
+  m_fd = fd;
+  tipc_ep_init(&m_ep, m_fd);
+  const char* spec = getenv(SHQ_ENV);
+  if (spec && shq_pair_open(&m_shq, spec) == 0) {
+    m_has_shq = true;
+  }
   while (1) {
-    int rc = tipc_read(m_fd, twf_msg, NULL);
+    rc = twf_read();
+    err = errno;
     info("%s rc=%d", __func__, rc);
 
     // break in child process
     if (rc == -999) {
       dprint("in child break");
+      rc = 1;
       break;
     }
+
+    /* turfd is gone, or the stream is broken, no more forks.
+     *  the bad bytes are never consumed, reading on would spin.
+     */
+    if (rc < 0 && err != EAGAIN && err != EINTR) {
+      error("turfd closed or ipc broken (%d), warmfork stopped", err);
+      rc = -1;
+      break;
+    }
+  }
+
+  tipc_ep_free(&m_ep);
+  if (m_has_shq) {
+    shq_pair_close(&m_shq);  // the clone has no access to turfd
+    m_has_shq = false;
+  }
+  set_errno(err);
+  return rc;
+}
+
+static void turf_warmfork_wait(int* prc, int* pargc, char*** pargv) {
+  // inform turfd we're ready for fork.
+  twf_inform_seed_ready();
+
+  if (twf_serve(m_fd) < 0) {
+    *prc = -1;
+    return;
   }
 
   *prc = 0;
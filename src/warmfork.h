@@ -6,11 +6,61 @@
 #include <unistd.h>  // read() ...
 #include "ipc.h"     // ipc
 #include "misc.h"
+#include "msg.h"       // msg_buf
 #include "realm.h"     // rlm_t
+#include "shmq.h"      // shq_pair
 #include "turf_phd.h"  // turf place holder defines
 
+// seeds of a group, the seed sandbox and the replicas spawned by turfd
+#define TF_SEED_MAX_GROUP (16)
+
+// a replica idle for this long is retired, in milliseconds
+#define TF_SEED_IDLE_MS (30 * 1000)
+
+// channels a template was registered through
+#define TF_SEED_VIA_SOCK (1 << 0)
+#define TF_SEED_VIA_SHQ (1 << 1)
+
+// a template registered in the seed, matched by the tmpl_key of clones
+struct tf_seed_tmpl {
+  uint32_t id;   // 0 if unused
+  uint64_t key;  // tmpl_key of the clones
+  uint32_t via;  // TF_SEED_VIA_XXX, sent before the deltas on each
+};
+
+struct turf_t;
 struct tf_seed {
   struct tipc_ep endpoint;  // socket endpoint
+  struct msg_buf out;       // the rest of msgs the socket was full for
+  bool writing;             // SCK_WRITE registered
+
+  // seed group, forks go to the least loaded seed
+  struct turf_t* primary;                          // of a replica
+  struct turf_t* replicas[TF_SEED_MAX_GROUP - 1];  // of the seed sandbox
+  uint32_t nr_replicas;                            // replicas alive
+  uint32_t inflight;                               // fork requests sent
+  uint64_t idle_since;                             // ms, none inflight
+  bool retired;                                    // killed, not respawned
+
+  // fork requests coalesced in a loop round, sent in a batch
+  char* queued[TIPC_FORK_BATCH_MAX];  // names of the clones
+  uint32_t nr_queued;
+
+  // fork requests sent, not answered yet
+  char** sent;  // names of the clones
+  uint32_t nr_sent;
+  uint32_t cap_sent;
+
+  struct shq_pair* shq;  // shared memory queues, NULL if not used
+
+  // templates of the clones, the fork requests carry the delta only
+  struct tf_seed_tmpl tmpls[TIPC_FORK_TMPL_MAX];
+  uint32_t tmpl_seq;  // id of the last template
+
+  int csum;  // TIPC_CSUM_XXX of the requests, the best the seed supports
+
+  pid_t forked_by;    // of a clone, the seed process forked it
+  uint64_t tmpl_key;  // of a clone, the spec its template is made of
 };
 
 // hold a phd slot
@@ -22,4 +72,10 @@ struct tf_phd_slot {
 // export API
 int _API load_turfphd(void);
 
+/* serve the fork requests of turfd on fd, in the seed process.
+ *  return 1 in a clone forked, or -1 if turfd is gone (EPIPE) or the
+ *  stream is broken (EBADMSG).
+ */
+int twf_serve(int fd);
+
 #endif  // _TURF_WORMFORK_H_
@@ -0,0 +1,287 @@
+/* write-behind file writer
+ */
+
+#include "writer.h"
+#include "hmap.h"
+
+#include <pthread.h>
+
+// a pending write
+struct wrt_entry {
+  TAILQ_ENTRY(wrt_entry) in_queue;
+  char* path;
+  char* buf;
+  size_t size;
+  uint64_t since;  // first submitted, in us
+};
+TAILQ_HEAD(wrt_queue, wrt_entry);
+
+static pthread_t m_thread;
+static pthread_mutex_t m_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t m_cond = PTHREAD_COND_INITIALIZER;  // queued or stop
+static pthread_cond_t m_idle = PTHREAD_COND_INITIALIZER;  // all written
+static pthread_cond_t m_done = PTHREAD_COND_INITIALIZER;  // one written
+
+static struct wrt_queue m_queue = TAILQ_HEAD_INITIALIZER(m_queue);
+static struct wrt_queue m_batch = TAILQ_HEAD_INITIALIZER(m_batch);
+static struct wrt_entry* m_current;  // in writing, out of m_batch
+static tf_hmap* m_pending;           // path to pending wrt_entry in m_queue
+static bool m_running;               // thread is running
+static bool m_stopping;              // thread should exit
+static bool m_busy;                  // thread is writing a batch
+static struct wrt_stat m_stat;
+
+static uint64_t wrt_now_us(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static void wrt_entry_free(struct wrt_entry* e) {
+  free(e->path);
+  free(e->buf);
+  free(e);
+}
+
+// the dir of path is gone
+static bool wrt_orphan(const char* path) {
+  char dir[TURF_MAX_PATH_LEN];
+
+  const char* slash = strrchr(path, '/');
+  if (!slash || slash == path || slash - path >= (int)sizeof(dir)) {
+    return 0;
+  }
+  memcpy(dir, path, slash - path);
+  dir[slash - path] = 0;
+  return access(dir, F_OK) < 0 && errno == ENOENT;
+}
+
+// write one file, and count it
+static void wrt_write(struct wrt_entry* e) {
+  int rc = write_file_atomic(e->path, e->buf, e->size);
+  uint64_t lat = wrt_now_us() - e->since;
+  bool gone = rc < 0 && errno == ENOENT && wrt_orphan(e->path);
+
+  pthread_mutex_lock(&m_lock);
+  if (gone) {
+    m_stat.skipped++;
+    pthread_mutex_unlock(&m_lock);
+    return;
+  }
+  if (rc < 0) {
+    m_stat.failed++;
+  } else {
+    m_stat.written++;
+  }
+  m_stat.last_us = lat;
+  m_stat.total_us += lat;
+  if (lat > m_stat.max_us) {
+    m_stat.max_us = lat;
+  }
+  pthread_mutex_unlock(&m_lock);
+
+  if (rc < 0) {
+    pwarn("write %s failed", e->path);
+  }
+}
+
+static void* wrt_thread(void* arg) {
+  struct wrt_entry* e;
+
+  pthread_mutex_lock(&m_lock);
+  while (1) {
+    while (TAILQ_EMPTY(&m_queue) && !m_stopping) {
+      pthread_cond_wait(&m_cond, &m_lock);
+    }
+    if (TAILQ_EMPTY(&m_queue)) {
+      break;  // stopping
+    }
+
+    // take the whole queue, newer writes go to a new batch
+    TAILQ_CONCAT(&m_batch, &m_queue, in_queue);
+    TAILQ_FOREACH(e, &m_batch, in_queue) {
+      hmap_sdel(m_pending, e->path);
+    }
+    m_stat.depth = 0;
+    m_busy = 1;
+
+    // one by one, a cancel takes the rest out of the batch
+    while ((e = TAILQ_FIRST(&m_batch)) != NULL) {
+      TAILQ_REMOVE(&m_batch, e, in_queue);
+      m_current = e;
+      pthread_mutex_unlock(&m_lock);
+
+      wrt_write(e);
+      wrt_entry_free(e);
+
+      pthread_mutex_lock(&m_lock);
+      m_current = NULL;
+      pthread_cond_broadcast(&m_done);
+    }
+    m_busy = 0;
+    if (TAILQ_EMPTY(&m_queue)) {
+      pthread_cond_broadcast(&m_idle);
+    }
+  }
+  pthread_mutex_unlock(&m_lock);
+  return NULL;
+}
+
+int _API wrt_start(void) {
+  int rc;
+
+  if (m_running) {
+    return 0;
+  }
+
+  if (!m_pending) {
+    m_pending = hmap_new(0);
+    if (!m_pending) {
+      return -1;
+    }
+  }
+
+  m_stopping = 0;
+  rc = pthread_create(&m_thread, NULL, wrt_thread, NULL);
+  if (rc != 0) {
+    set_errno(rc);
+    return -1;
+  }
+
+  m_running = 1;
+  return 0;
+}
+
+void _API wrt_stop(void) {
+  if (!m_running) {
+    return;
+  }
+
+  pthread_mutex_lock(&m_lock);
+  m_stopping = 1;
+  pthread_cond_signal(&m_cond);
+  pthread_mutex_unlock(&m_lock);
+
+  pthread_join(m_thread, NULL);
+  m_running = 0;
+}
+
+int _API wrt_submit(const char* path, char* buf, size_t size) {
+  struct wrt_entry* e;
+
+  if (!path || !buf) {
+    set_errno(EINVAL);
+    return -1;
+  }
+
+  // no writer thread, write it now.
+  if (!m_running) {
+    struct wrt_entry tmp = {.path = (char*)path, .buf = buf, .size = size};
+    tmp.since = wrt_now_us();
+    m_stat.submitted++;
+    wrt_write(&tmp);
+    free(buf);
+    return 0;
+  }
+
+  pthread_mutex_lock(&m_lock);
+  m_stat.submitted++;
+
+  // coalesce into the pending one
+  e = (struct wrt_entry*)hmap_sget(m_pending, path);
+  if (e) {
+    free(e->buf);
+    e->buf = buf;
+    e->size = size;
+    m_stat.coalesced++;
+    pthread_mutex_unlock(&m_lock);
+    return 0;
+  }
+
+  e = (struct wrt_entry*)calloc(1, sizeof(struct wrt_entry));
+  if (!e || !(e->path = strdup(path))) {
+    pthread_mutex_unlock(&m_lock);
+    free(e);
+    free(buf);
+    set_errno(ENOMEM);
+    return -1;
+  }
+  e->buf = buf;
+  e->size = size;
+  e->since = wrt_now_us();
+
+  if (hmap_sput(m_pending, e->path, e) < 0) {
+    pthread_mutex_unlock(&m_lock);
+    wrt_entry_free(e);
+    return -1;
+  }
+  TAILQ_INSERT_TAIL(&m_queue, e, in_queue);
+
+  m_stat.depth++;
+  if (m_stat.depth > m_stat.max_depth) {
+    m_stat.max_depth = m_stat.depth;
+  }
+
+  pthread_cond_signal(&m_cond);
+  pthread_mutex_unlock(&m_lock);
+  return 0;
+}
+
+int _API wrt_cancel(const char* path) {
+  struct wrt_entry* e;
+  int rc = 0;
+
+  if (!path) {
+    set_errno(EINVAL);
+    return -1;
+  }
+  if (!m_running) {
+    return 0;  // written at submit
+  }
+
+  pthread_mutex_lock(&m_lock);
+  e = (struct wrt_entry*)hmap_sget(m_pending, path);
+  if (e) {
+    hmap_sdel(m_pending, path);
+    TAILQ_REMOVE(&m_queue, e, in_queue);
+    m_stat.depth--;
+    m_stat.skipped++;
+    wrt_entry_free(e);
+    rc = 1;
+  }
+
+  // taken by the thread, not written yet, or in writing
+  TAILQ_FOREACH(e, &m_batch, in_queue) {
+    if (strcmp(e->path, path) == 0) {
+      TAILQ_REMOVE(&m_batch, e, in_queue);
+      m_stat.skipped++;
+      wrt_entry_free(e);
+      rc = 1;
+      break;
+    }
+  }
+  while (m_current && strcmp(m_current->path, path) == 0) {
+    pthread_cond_wait(&m_done, &m_lock);
+  }
+  pthread_mutex_unlock(&m_lock);
+  return rc;
+}
+
+int _API wrt_sync(void) {
+  if (!m_running) {
+    return 0;
+  }
+
+  pthread_mutex_lock(&m_lock);
+  while (!TAILQ_EMPTY(&m_queue) || m_busy) {
+    pthread_cond_wait(&m_idle, &m_lock);
+  }
+  pthread_mutex_unlock(&m_lock);
+  return 0;
+}
+
+void _API wrt_get_stat(struct wrt_stat* st) {
+  pthread_mutex_lock(&m_lock);
+  *st = m_stat;
+  pthread_mutex_unlock(&m_lock);
+}
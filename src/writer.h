@@ -0,0 +1,46 @@
+#ifndef _TURF_WRITER_H_
+#define _TURF_WRITER_H_
+
+#include "misc.h"
+
+/* write-behind file writer,
+ *  a background thread writes the files with atomic replace,
+ *  the pending writes to the same path are coalesced into the newest one.
+ *  a file whose dir is gone is skipped, its owner was deleted.
+ */
+
+// writer statistics
+struct wrt_stat {
+  uint64_t submitted;  // writes submitted
+  uint64_t coalesced;  // writes replaced by a newer one before written
+  uint64_t written;    // files written
+  uint64_t failed;     // files failed to write
+  uint64_t skipped;    // files not written, cancelled or the dir is gone
+  uint32_t depth;      // pending writes in queue
+  uint32_t max_depth;  // the max queue depth seen
+  uint64_t last_us;    // flush latency of the last write, from submit to disk
+  uint64_t max_us;     // the max flush latency
+  uint64_t total_us;   // total flush latency, for average
+};
+
+// start the writer thread
+int _API wrt_start(void);
+
+// flush all and stop the writer thread
+void _API wrt_stop(void);
+
+// submit buf to be written to path, buf is taken and freed by writer.
+int _API wrt_submit(const char* path, char* buf, size_t size);
+
+/* drop the pending write of path, no write of it lands after the return.
+ *  return 1 if one is dropped, or 0.
+ */
+int _API wrt_cancel(const char* path);
+
+// wait until all the submitted writes are done
+int _API wrt_sync(void);
+
+// read the statistics
+void _API wrt_get_stat(struct wrt_stat* st);
+
+#endif  // _TURF_WRITER_H_
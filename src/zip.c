@@ -0,0 +1,621 @@
+/* native zip extraction
+ */
+
+#include "zip.h"
+#include "crc32.h"
+#include "inflate.h"
+
+#include <pthread.h>
+#include <sys/mman.h>  // mmap()
+
+#define ZIP_EOCD_SIG 0x06054b50    // end of central directory
+#define ZIP_EOCD64_SIG 0x06064b50  // zip64 end of central directory
+#define ZIP_LOC64_SIG 0x07064b50   // zip64 end of central directory locator
+#define ZIP_CDH_SIG 0x02014b50     // central directory header
+#define ZIP_LFH_SIG 0x04034b50     // local file header
+#define ZIP_EOCD_SIZE 22
+#define ZIP_EOCD64_SIZE 56
+#define ZIP_LOC64_SIZE 20
+#define ZIP_CDH_SIZE 46
+#define ZIP_LFH_SIZE 30
+#define ZIP_MAX_COMMENT 0xffff
+#define ZIP_EXTRA64 0x0001  // zip64 extra field
+#define ZIP_MAX32 0xffffffff
+
+#define ZIP_STORED 0
+#define ZIP_DEFLATED 8
+#define ZIP_FLAG_ENCRYPTED (1 << 0)
+#define ZIP_HOST_UNIX 3  // version made by, the high byte
+
+// an entry of the central directory
+struct zip_ent {
+  char* path;       // relative to dest, without the trailing '/'
+  mode_t mode;      // S_IFXXX and the permissions
+  bool has_mode;    // made on unix
+  uint16_t method;  // ZIP_STORED or ZIP_DEFLATED
+  uint32_t crc;
+  uint64_t csize;   // in the archive
+  uint64_t usize;   // extracted
+  uint64_t offset;  // of the local header
+};
+
+// an archive in extracting
+struct zip_archive {
+  const uint8_t* data;  // mapped
+  size_t size;
+  int dfd;  // dest root
+  struct zip_ent* ents;
+  size_t n;
+  struct zip_stat st;
+  uint64_t total;                  // bytes of the files
+  char parent[TURF_MAX_PATH_LEN];  // the dir made last
+
+  // shared by the threads
+  pthread_mutex_t lock;
+  size_t next;  // next entry to extract
+  int err;      // the first errno
+};
+
+// output of an entry
+struct zip_out {
+  int fd;         // the file, or -1 for a symlink
+  char* buf;      // symlink target
+  uint64_t left;  // bytes expected
+  uint32_t crc;
+};
+
+static inline uint16_t zip_u16(const uint8_t* p) {
+  return p[0] | p[1] << 8;
+}
+
+static inline uint32_t zip_u32(const uint8_t* p) {
+  return zip_u16(p) | (uint32_t)zip_u16(p + 2) << 16;
+}
+
+static inline uint64_t zip_u64(const uint8_t* p) {
+  return zip_u32(p) | (uint64_t)zip_u32(p + 4) << 32;
+}
+
+// find the central directory by the end record, zip64 is followed.
+static int zip_find_cd(struct zip_archive* z,
+                       uint64_t* off,
+                       uint64_t* size,
+                       uint64_t* n) {
+  size_t i;
+  const uint8_t* p = NULL;
+
+  if (z->size < ZIP_EOCD_SIZE) {
+    goto bad;
+  }
+
+  // the comment is at most 64K
+  size_t stop = z->size - ZIP_EOCD_SIZE;
+  stop = stop > ZIP_MAX_COMMENT ? stop - ZIP_MAX_COMMENT : 0;
+  for (i = z->size - ZIP_EOCD_SIZE;; i--) {
+    if (zip_u32(z->data + i) == ZIP_EOCD_SIG) {
+      p = z->data + i;
+      break;
+    }
+    if (i == stop) {
+      goto bad;
+    }
+  }
+
+  *n = zip_u16(p + 10);
+  *size = zip_u32(p + 12);
+  *off = zip_u32(p + 16);
+
+  // zip64, the locator is right before the end record
+  if ((*n == 0xffff || *size == ZIP_MAX32 || *off == ZIP_MAX32) &&
+      i >= ZIP_LOC64_SIZE && zip_u32(p - ZIP_LOC64_SIZE) == ZIP_LOC64_SIG) {
+    uint64_t e = zip_u64(p - ZIP_LOC64_SIZE + 8);
+    if (z->size < ZIP_EOCD64_SIZE || e > z->size - ZIP_EOCD64_SIZE) {
+      goto bad;
+    }
+    const uint8_t* q = z->data + e;
+    if (zip_u32(q) != ZIP_EOCD64_SIG) {
+      goto bad;
+    }
+    *n = zip_u64(q + 32);
+    *size = zip_u64(q + 40);
+    *off = zip_u64(q + 48);
+  }
+
+  if (*off > z->size || *size > z->size - *off) {
+    goto bad;
+  }
+  return 0;
+
+bad:
+  set_errno(EBADMSG);
+  return -1;
+}
+
+// the sizes and offset over 32 bits are in the zip64 extra field.
+static int zip_extra64(struct zip_ent* e, const uint8_t* x, size_t len) {
+  while (len >= 4) {
+    uint16_t tag = zip_u16(x);
+    size_t n = zip_u16(x + 2);
+    if (n > len - 4) {
+      break;
+    }
+
+    if (tag == ZIP_EXTRA64) {
+      const uint8_t* v = x + 4;
+      const uint8_t* end = v + n;
+      if (e->usize == ZIP_MAX32) {
+        if (end - v < 8) {
+          goto bad;
+        }
+        e->usize = zip_u64(v);
+        v += 8;
+      }
+      if (e->csize == ZIP_MAX32) {
+        if (end - v < 8) {
+          goto bad;
+        }
+        e->csize = zip_u64(v);
+        v += 8;
+      }
+      if (e->offset == ZIP_MAX32) {
+        if (end - v < 8) {
+          goto bad;
+        }
+        e->offset = zip_u64(v);
+      }
+      return 0;
+    }
+    x += 4 + n;
+    len -= 4 + n;
+  }
+  return 0;
+
+bad:
+  set_errno(EBADMSG);
+  return -1;
+}
+
+// a relative path in dest, no empty, "." or ".." components.
+static char* zip_path(const uint8_t* name, size_t len, bool* is_dir) {
+  *is_dir = len > 0 && name[len - 1] == '/';
+  if (*is_dir) {
+    len--;
+  }
+  if (len == 0 || len >= TURF_MAX_PATH_LEN || name[0] == '/' ||
+      memchr(name, '\0', len)) {
+    return NULL;
+  }
+
+  char* path = strndup((const char*)name, len);
+  if (!path) {
+    return NULL;
+  }
+
+  const char* c = path;
+  while (c) {
+    const char* e = strchr(c, '/');
+    size_t n = e ? (size_t)(e - c) : strlen(c);
+    if (n == 0 || (n == 1 && c[0] == '.') ||
+        (n == 2 && c[0] == '.' && c[1] == '.')) {
+      free(path);
+      return NULL;
+    }
+    c = e ? e + 1 : NULL;
+  }
+  return path;
+}
+
+// read the entries of the central directory
+static int zip_read_cd(struct zip_archive* z) {
+  uint64_t i, off, size, n;
+
+  if (zip_find_cd(z, &off, &size, &n) < 0) {
+    return -1;
+  }
+  if (n > size / ZIP_CDH_SIZE) {
+    goto bad;
+  }
+
+  z->ents = (struct zip_ent*)calloc(n ? n : 1, sizeof(struct zip_ent));
+  if (!z->ents) {
+    set_errno(ENOMEM);
+    return -1;
+  }
+
+  const uint8_t* p = z->data + off;
+  const uint8_t* end = p + size;
+  for (i = 0; i < n; i++) {
+    if (end - p < ZIP_CDH_SIZE || zip_u32(p) != ZIP_CDH_SIG) {
+      goto bad;
+    }
+    uint16_t made = zip_u16(p + 4);
+    uint16_t flags = zip_u16(p + 8);
+    size_t nlen = zip_u16(p + 28);
+    size_t xlen = zip_u16(p + 30);
+    size_t clen = zip_u16(p + 32);
+    uint32_t attr = zip_u32(p + 38);
+    if ((size_t)(end - p) < ZIP_CDH_SIZE + nlen + xlen + clen) {
+      goto bad;
+    }
+
+    struct zip_ent* e = &z->ents[z->n];
+    e->method = zip_u16(p + 10);
+    e->crc = zip_u32(p + 16);
+    e->csize = zip_u32(p + 20);
+    e->usize = zip_u32(p + 24);
+    e->offset = zip_u32(p + 42);
+    if (zip_extra64(e, p + ZIP_CDH_SIZE + nlen, xlen) < 0) {
+      return -1;
+    }
+
+    bool is_dir;
+    e->path = zip_path(p + ZIP_CDH_SIZE, nlen, &is_dir);
+    if (!e->path) {
+      goto bad;
+    }
+    z->n++;
+
+    // the unix mode is in the high 16 bits of the external attributes
+    mode_t mode = attr >> 16;
+    e->has_mode = (made >> 8) == ZIP_HOST_UNIX && mode != 0;
+    if (is_dir || (e->has_mode && S_ISDIR(mode))) {
+      e->mode = S_IFDIR | (mode & ACCESSPERMS);
+    } else if (e->has_mode && S_ISLNK(mode)) {
+      e->mode = S_IFLNK | (mode & ACCESSPERMS);
+    } else {
+      e->mode = S_IFREG | (mode & ACCESSPERMS);
+    }
+
+    if (!S_ISDIR(e->mode)) {
+      if (flags & ZIP_FLAG_ENCRYPTED ||
+          (e->method != ZIP_STORED && e->method != ZIP_DEFLATED)) {
+        set_errno(ENOTSUP);
+        return -1;
+      }
+      z->total += e->usize;
+    }
+    p += ZIP_CDH_SIZE + nlen + xlen + clen;
+  }
+  return 0;
+
+bad:
+  set_errno(EBADMSG);
+  return -1;
+}
+
+// make a dir, 1 if exists already.
+static int zip_mkdir(int dfd, const char* path) {
+  struct stat st;
+
+  if (mkdirat(dfd, path, 0755) == 0) {
+    return 0;
+  }
+  if (errno != EEXIST) {
+    return -1;
+  }
+  if (fstatat(dfd, path, &st, AT_SYMLINK_NOFOLLOW) < 0) {
+    return -1;
+  }
+  if (!S_ISDIR(st.st_mode)) {
+    set_errno(ENOTDIR);
+    return -1;
+  }
+  return 1;
+}
+
+// make the dirs of the entry, the entry itself too if a dir.
+static int zip_mkdirs(struct zip_archive* z, struct zip_ent* e) {
+  char* p;
+  char* path = e->path;
+  bool is_dir = S_ISDIR(e->mode);
+
+  // the files in a dir come together mostly
+  char* last = strrchr(path, '/');
+  if (!is_dir && last) {
+    size_t n = last - path;
+    if (strncmp(z->parent, path, n) == 0 && z->parent[n] == '\0') {
+      return 0;
+    }
+  }
+
+  for (p = strchr(path, '/');; p = strchr(p + 1, '/')) {
+    if (!p && !is_dir) {
+      break;
+    }
+
+    if (p) {
+      *p = '\0';
+    }
+    int made = zip_mkdir(z->dfd, path);
+    if (made == 0) {
+      z->st.dirs++;
+    }
+    if (made >= 0 && p) {
+      snprintf(z->parent, sizeof(z->parent), "%s", path);
+    }
+    if (p) {
+      *p = '/';
+    }
+    if (made < 0) {
+      return -1;
+    }
+    if (!p) {
+      break;
+    }
+  }
+  return 0;
+}
+
+// the data of the entry, checked in the archive
+static const uint8_t* zip_data(struct zip_archive* z, struct zip_ent* e) {
+  if (z->size < ZIP_LFH_SIZE || e->offset > z->size - ZIP_LFH_SIZE) {
+    goto bad;
+  }
+
+  const uint8_t* h = z->data + e->offset;
+  if (zip_u32(h) != ZIP_LFH_SIG) {
+    goto bad;
+  }
+  uint64_t start = e->offset + ZIP_LFH_SIZE;
+  start += zip_u16(h + 26) + zip_u16(h + 28);  // name and extra field
+  if (start > z->size || e->csize > z->size - start) {
+    goto bad;
+  }
+  return z->data + start;
+
+bad:
+  set_errno(EBADMSG);
+  return NULL;
+}
+
+static int zip_write(int fd, const void* buf, size_t size) {
+  size_t done = 0;
+  while (done < size) {
+    ssize_t n = write(fd, (const char*)buf + done, size - done);
+    if (n < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return -1;
+    }
+    done += n;
+  }
+  return 0;
+}
+
+// the output of an entry, not more than the size in the directory.
+static int zip_sink(void* arg, const void* buf, size_t size) {
+  struct zip_out* o = (struct zip_out*)arg;
+
+  if (size > o->left) {
+    set_errno(EBADMSG);
+    return -1;
+  }
+
+  if (o->fd >= 0) {
+    if (zip_write(o->fd, buf, size) < 0) {
+      return -1;
+    }
+  } else {
+    memcpy(o->buf, buf, size);
+    o->buf += size;
+  }
+  o->left -= size;
+  o->crc = crc32_update(o->crc, buf, size);
+  return 0;
+}
+
+// inflate the entry to o, checked by the size and crc.
+static int zip_inflate(struct zip_archive* z,
+                       struct zip_ent* e,
+                       struct zip_out* o) {
+  const uint8_t* data = zip_data(z, e);
+  if (!data) {
+    return -1;
+  }
+
+  o->left = e->usize;
+  o->crc = 0;
+  if (e->method == ZIP_STORED) {
+    if (zip_sink(o, data, e->csize) < 0) {
+      return -1;
+    }
+  } else if (ifl_inflate(data, e->csize, zip_sink, o) < 0) {
+    return -1;
+  }
+
+  if (o->left != 0 || o->crc != e->crc) {
+    set_errno(EBADMSG);
+    return -1;
+  }
+  return 0;
+}
+
+static int zip_file(struct zip_archive* z, struct zip_ent* e) {
+  int flags = O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC | O_NOFOLLOW;
+  mode_t mode = e->has_mode ? e->mode & ACCESSPERMS : 0644;
+
+  struct zip_out o = {.fd = openat(z->dfd, e->path, flags, 0600)};
+  if (o.fd < 0) {
+    return -1;
+  }
+
+  int rc = zip_inflate(z, e, &o);
+  // after the data, the file could be read only
+  if (rc == 0) {
+    rc = fchmod(o.fd, mode);
+  }
+
+  int err = errno;
+  close(o.fd);
+  errno = err;
+  return rc;
+}
+
+static int zip_symlink(struct zip_archive* z, struct zip_ent* e) {
+  char target[TURF_MAX_PATH_LEN];
+
+  if (e->usize >= sizeof(target)) {
+    set_errno(ENAMETOOLONG);
+    return -1;
+  }
+
+  struct zip_out o = {.fd = -1, .buf = target};
+  if (zip_inflate(z, e, &o) < 0) {
+    return -1;
+  }
+  target[e->usize] = '\0';
+  return symlinkat(target, z->dfd, e->path);
+}
+
+// take the files one by one, on the caller and the threads.
+static void* zip_thread(void* arg) {
+  struct zip_archive* z = (struct zip_archive*)arg;
+  struct zip_stat st = {0};
+
+  while (1) {
+    pthread_mutex_lock(&z->lock);
+    if (z->err || z->next >= z->n) {
+      pthread_mutex_unlock(&z->lock);
+      break;
+    }
+    struct zip_ent* e = &z->ents[z->next++];
+    pthread_mutex_unlock(&z->lock);
+
+    if (!S_ISREG(e->mode)) {
+      continue;
+    }
+
+    if (zip_file(z, e) < 0) {
+      pthread_mutex_lock(&z->lock);
+      if (!z->err) {
+        z->err = errno ? errno : EIO;
+      }
+      pthread_mutex_unlock(&z->lock);
+      break;
+    }
+    st.files++;
+    st.bytes += e->usize;
+    st.packed += e->csize;
+  }
+
+  pthread_mutex_lock(&z->lock);
+  z->st.files += st.files;
+  z->st.bytes += st.bytes;
+  z->st.packed += st.packed;
+  pthread_mutex_unlock(&z->lock);
+  return NULL;
+}
+
+int _API zip_extract(const char* zip, const char* dest, struct zip_stat* st) {
+  int fd = -1;
+  int rc = -1;
+  int i, nthr = 0;
+  size_t k;
+  struct stat zst;
+  pthread_t thr[ZIP_THREADS];
+  struct zip_archive z = {.data = MAP_FAILED, .dfd = -1};
+
+  if (!zip || !dest) {
+    set_errno(EINVAL);
+    return -1;
+  }
+
+  pthread_mutex_init(&z.lock, NULL);
+
+  fd = open(zip, O_RDONLY | O_CLOEXEC);
+  if (fd < 0 || fstat(fd, &zst) < 0) {
+    goto exit;
+  }
+  if (!S_ISREG(zst.st_mode) || zst.st_size == 0) {
+    set_errno(EBADMSG);
+    goto exit;
+  }
+  z.size = zst.st_size;
+  z.data = (const uint8_t*)mmap(NULL, z.size, PROT_READ, MAP_PRIVATE, fd, 0);
+  if (z.data == MAP_FAILED) {
+    goto exit;
+  }
+
+  if (zip_read_cd(&z) < 0) {
+    goto exit;
+  }
+
+  int made = zip_mkdir(AT_FDCWD, dest);
+  if (made < 0) {
+    goto exit;
+  }
+  z.st.dirs += made == 0;
+  z.dfd = open(dest, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+  if (z.dfd < 0) {
+    goto exit;
+  }
+
+  // the dirs first, the files could be written in any order then.
+  for (k = 0; k < z.n; k++) {
+    if (zip_mkdirs(&z, &z.ents[k]) < 0) {
+      goto exit;
+    }
+  }
+
+  // a big archive is inflated by threads, the caller is one of them.
+  if (z.total >= ZIP_PARALLEL_BYTES) {
+    madvise((void*)z.data, z.size, MADV_WILLNEED);
+    for (i = 0; i < ZIP_THREADS - 1 && i + 1 < (int)z.n; i++) {
+      if (pthread_create(&thr[nthr], NULL, zip_thread, &z) != 0) {
+        break;
+      }
+      nthr++;
+    }
+  }
+  zip_thread(&z);
+  for (i = 0; i < nthr; i++) {
+    pthread_join(thr[i], NULL);
+  }
+  if (z.err) {
+    set_errno(z.err);
+    goto exit;
+  }
+
+  // the symlinks at last, the files are never written through them.
+  for (k = 0; k < z.n; k++) {
+    if (S_ISLNK(z.ents[k].mode)) {
+      if (zip_symlink(&z, &z.ents[k]) < 0) {
+        goto exit;
+      }
+      z.st.links++;
+    }
+  }
+
+  // inner dirs first
+  for (k = z.n; k > 0; k--) {
+    struct zip_ent* e = &z.ents[k - 1];
+    if (S_ISDIR(e->mode) && e->has_mode &&
+        fchmodat(z.dfd, e->path, e->mode & ACCESSPERMS, 0) < 0) {
+      goto exit;
+    }
+  }
+  rc = 0;
+
+exit:;
+  int err = errno;
+  if (z.dfd >= 0) {
+    close(z.dfd);
+  }
+  if (z.data != MAP_FAILED) {
+    munmap((void*)z.data, z.size);
+  }
+  if (fd >= 0) {
+    close(fd);
+  }
+  for (k = 0; k < z.n; k++) {
+    free(z.ents[k].path);
+  }
+  free(z.ents);
+  pthread_mutex_destroy(&z.lock);
+  if (st) {
+    *st = z.st;
+  }
+  errno = err;
+  return rc;
+}
@@ -0,0 +1,28 @@
+#ifndef _TURF_ZIP_H_
+#define _TURF_ZIP_H_
+
+#include "misc.h"
+
+/* native zip extraction, the archive is mapped and the entries are inflated
+ *  straight into the files, in parallel for a big one, no temp files.
+ */
+
+#define ZIP_THREADS (4)                       // threads of a big archive
+#define ZIP_PARALLEL_BYTES (1 * 1024 * 1024)  // an archive is big above it
+
+// what was extracted
+struct zip_stat {
+  uint64_t files;   // regular files
+  uint64_t dirs;    // directories made, the top one included
+  uint64_t links;   // symlinks
+  uint64_t bytes;   // file data, inflated
+  uint64_t packed;  // file data in the archive
+};
+
+/* extract the zip file to dest, dest is made if not exist. stored and
+ *  deflated entries are supported, the unix modes and symlinks are kept,
+ *  an entry out of dest fails the whole. st is optional.
+ */
+int _API zip_extract(const char* zip, const char* dest, struct zip_stat* st);
+
+#endif  // _TURF_ZIP_H_
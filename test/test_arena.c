@@ -0,0 +1,77 @@
+#include "arena.h"
+#include "bdd-for-c.h"
+
+#define ALIGNED(p) (((uintptr_t)(p) & (ARN_ALIGN - 1)) == 0)
+
+spec("turf.arena") {
+  static char mem[256];
+
+  it("arena.stack") {
+    struct arena a;
+    char *p, *q;
+    int i;
+
+    // unaligned buf
+    arn_init(&a, mem + 1, sizeof(mem) - 1);
+    p = (char*)arn_alloc(&a, 3);
+    q = (char*)arn_alloc(&a, 5);
+    check(p >= mem && q < mem + sizeof(mem));
+    check(ALIGNED(p) && ALIGNED(q) && q - p == ARN_ALIGN);
+    check(a.blocks == NULL);
+
+    // full, in malloc'd blocks
+    for (i = 0; i < 32; i++) {
+      p = arn_strdup(&a, "hello");
+      check(p && strcmp(p, "hello") == 0 && ALIGNED(p));
+    }
+    check(a.blocks != NULL);
+    p = (char*)arn_alloc(&a, ARN_BLOCK_SIZE * 2);
+    check(p != NULL);
+    memset(p, 'x', ARN_BLOCK_SIZE * 2);
+
+    // back to the buf
+    arn_reset(&a);
+    check(a.blocks == NULL);
+    p = (char*)arn_alloc(&a, 3);
+    check(p >= mem && p < mem + sizeof(mem));
+    arn_free(&a);
+  }
+
+  it("arena.reset") {
+    struct arena a = {0};
+    char* p;
+
+    // zeroed, the newest block is kept
+    p = (char*)arn_calloc(&a, 10, 100);
+    check(p && p[999] == 0);
+    check(arn_alloc(&a, ARN_BLOCK_SIZE * 3) != NULL);
+    arn_reset(&a);
+    check(a.blocks != NULL);
+    check((size_t)(a.end - a.cur) >= ARN_BLOCK_SIZE * 3);
+    p = (char*)arn_alloc(&a, 10);
+    check(p && (void*)a.blocks < (void*)p);
+    check(arn_strdup(&a, NULL) == NULL);
+    arn_free(&a);
+    check(a.blocks == NULL && a.cur == NULL);
+
+    // no arena, the heap
+    p = arn_strdup(NULL, "heap");
+    check(p && strcmp(p, "heap") == 0);
+    free(p);
+  }
+
+  it("arena.new") {
+    struct arena* a = arn_new(ARN_SIZE(sizeof(int)) + ARN_SIZE(6));
+    int* n = (int*)arn_alloc(a, sizeof(int));
+    char* s = arn_strdup(a, "turf!");
+
+    // in the same malloc
+    check(a && n && s);
+    check((char*)n > (char*)a && s < a->end && a->blocks == NULL);
+    check(a->cur == a->end);
+    check(arn_alloc(a, 1) != NULL && a->blocks != NULL);
+
+    arn_free(a);
+    arn_free(NULL);
+  }
+}
@@ -0,0 +1,179 @@
+#include "bdd-for-c.h"
+#include "cache.h"
+#include "shell.h"
+#include "test_util.h"
+
+static char m_src[1024];
+static char m_cache[1024];
+static char m_dst[1024];
+
+// link src to dest n, keyed by the tree
+static int link_one(const char* src, int n, char key[CCH_KEY_SIZE]) {
+  char dest[1100], ref[1100];
+
+  snprintf(dest, sizeof(dest), "%s/code%d", m_dst, n);
+  snprintf(ref, sizeof(ref), "%s/ref%d", m_dst, n);
+  if (cch_key(src, key) < 0) {
+    return -1;
+  }
+  return cch_link(m_cache, key, src, NULL, dest, ref);
+}
+
+// drop the user n of the cache
+static void unlink_one(int n) {
+  char path[1100];
+
+  snprintf(path, sizeof(path), "%s/code%d", m_dst, n);
+  unlink(path);
+  snprintf(path, sizeof(path), "%s/ref%d", m_dst, n);
+  unlink(path);
+}
+
+spec("turf.cache") {
+  static int rc;
+  static char cmd[3200];
+
+  before() {
+    shl_path2(m_src, sizeof(m_src), getenv("TURF_WORKDIR"), "cch_src");
+    shl_path2(m_cache, sizeof(m_cache), getenv("TURF_WORKDIR"), "cch_cache");
+    shl_path2(m_dst, sizeof(m_dst), getenv("TURF_WORKDIR"), "cch_dst");
+  }
+
+  before_each() {
+    snprintf(cmd, sizeof(cmd), "rm -rf '%s' '%s' '%s'", m_src, m_cache, m_dst);
+    system(cmd);
+    mkdir(m_src, 0755);
+    mkdir(m_dst, 0755);
+    cch_set_budget(CCH_DEFAULT_BUDGET);
+  }
+
+  after() {
+    snprintf(cmd, sizeof(cmd), "rm -rf '%s' '%s' '%s'", m_src, m_cache, m_dst);
+    system(cmd);
+  }
+
+  it("cache.key") {
+    char k1[CCH_KEY_SIZE], k2[CCH_KEY_SIZE], k3[CCH_KEY_SIZE];
+
+    put_file(m_src, "index.js", 100, 0644);
+    shl_mkdir2(m_src, "lib");
+    put_file(m_src, "lib/a.js", 10, 0644);
+
+    check(cch_key(m_src, k1) == 0);
+    check(strlen(k1) == CCH_KEY_SIZE - 1);
+    check(cch_key(m_src, k2) == 0);
+    check(strcmp(k1, k2) == 0);
+
+    // changed in a sub dir
+    put_file(m_src, "lib/a.js", 11, 0644);
+    check(cch_key(m_src, k3) == 0);
+    check(strcmp(k1, k3) != 0);
+
+    // a file by the content
+    char path[1100];
+    shl_path2(path, sizeof(path), m_src, "index.js");
+    check(cch_key(path, k1) == 0);
+    check(strcmp(k1, k3) != 0);
+    check(cch_key(path, k2) == 0);
+    check(strcmp(k1, k2) == 0);
+    put_file(m_src, "index.js", 101, 0644);
+    check(cch_key(path, k2) == 0);
+    check(strcmp(k1, k2) != 0);
+
+    // the same names, modes, sizes and mtimes, but not the content
+    struct timespec ts[2] = {{1000, 0}, {1000, 0}};
+    shl_path2(path, sizeof(path), m_src, "lib/a.js");
+    write_file(path, "aaaaaaaaaaa", 11);
+    utimensat(AT_FDCWD, path, ts, 0);
+    check(cch_key(m_src, k1) == 0);
+    write_file(path, "bbbbbbbbbbb", 11);
+    utimensat(AT_FDCWD, path, ts, 0);
+    check(cch_key(m_src, k2) == 0);
+    check(strcmp(k1, k2) != 0);
+
+    // the same content, any mtime
+    write_file(path, "aaaaaaaaaaa", 11);
+    check(cch_key(m_src, k2) == 0);
+    check(strcmp(k1, k2) == 0);
+
+    rc = cch_key("/not/exist", k1);
+    check(rc < 0 && errno == ENOENT);
+    rc = cch_key(NULL, k1);
+    check(rc < 0 && errno == EINVAL);
+  }
+
+  it("cache.link") {
+    char k1[CCH_KEY_SIZE], k2[CCH_KEY_SIZE];
+    char path[1100];
+    struct cch_stat st0, st;
+    struct stat s;
+
+    put_file(m_src, "index.js", 100, 0644);
+    cch_get_stat(m_cache, &st0);
+
+    // missed, then hit
+    rc = link_one(m_src, 1, k1);
+    check(rc == 0);
+    rc = link_one(m_src, 2, k2);
+    check(rc == 0);
+    check(strcmp(k1, k2) == 0);
+
+    cch_get_stat(m_cache, &st);
+    check(st.misses == st0.misses + 1);
+    check(st.hits == st0.hits + 1);
+    check(st.entries == 1);
+    check(st.bytes == 100);
+
+    // the same tree, read only
+    snprintf(path, sizeof(path), "%s/code1/index.js", m_dst);
+    check(stat(path, &s) == 0 && s.st_size == 100);
+    check((s.st_mode & 0222) == 0);
+    ino_t ino = s.st_ino;
+    snprintf(path, sizeof(path), "%s/code2/index.js", m_dst);
+    check(stat(path, &s) == 0 && s.st_ino == ino);
+
+    // dest is taken
+    rc = link_one(m_src, 1, k1);
+    check(rc < 0 && errno == EEXIST);
+    rc = cch_link(m_cache, "bad", m_src, NULL, path, path);
+    check(rc < 0 && errno == EINVAL);
+  }
+
+  it("cache.evict") {
+    char k1[CCH_KEY_SIZE], k2[CCH_KEY_SIZE];
+    struct cch_stat st0, st;
+    char path[1100];
+
+    put_file(m_src, "index.js", 1000, 0644);
+    check(link_one(m_src, 1, k1) == 0);
+    put_file(m_src, "index.js", 2000, 0644);
+    check(link_one(m_src, 2, k2) == 0);
+    check(strcmp(k1, k2) != 0);
+
+    // both are busy
+    cch_get_stat(m_cache, &st0);
+    cch_set_budget(2500);
+    check(cch_evict(m_cache) == 0);
+    cch_get_stat(m_cache, &st);
+    check(st.entries == 2 && st.bytes == 3000 && st.budget == 2500);
+
+    // the least recently used goes first
+    unlink_one(1);
+    unlink_one(2);
+    check(cch_evict(m_cache) == 1);
+    shl_path2(path, sizeof(path), m_cache, k1);
+    check(access(path, F_OK) < 0);
+    shl_path2(path, sizeof(path), m_cache, k2);
+    check(access(path, F_OK) == 0);
+
+    cch_get_stat(m_cache, &st);
+    check(st.entries == 1 && st.bytes == 2000);
+    check(st.evicted == st0.evicted + 1);
+
+    // the rest is over the budget alone
+    cch_set_budget(0);
+    check(cch_evict(m_cache) == 1);
+    cch_get_stat(m_cache, &st);
+    check(st.entries == 0 && st.bytes == 0);
+  }
+}
@@ -112,6 +112,30 @@ spec("turf.cli") {
     check(cli->cmd == TURF_CLI_CREATE);
     check(strcmp(cli->bundle_path, "/path/to/bundle") == 0);
     check(strcmp(cli->sandbox_name, "sandbox_name1") == 0);
+    check(!cli->has.dedup);
+
+    cli_free(cli);
+    ssfree(v);
+
+    cmd = "turf create --dedup -b /path/to/bundle sandbox_name1";
+    rc = cmd2args(cmd, &c, &v);
+    check(rc == 0);
+
+    rc = cli_parse(cli, c, v);
+    check(rc == 0);
+    check(cli->has.dedup);
+    check(!cli->has.cache);
+
+    cli_free(cli);
+    ssfree(v);
+
+    cmd = "turf create --cache -b /path/to/bundle sandbox_name1";
+    rc = cmd2args(cmd, &c, &v);
+    check(rc == 0);
+
+    rc = cli_parse(cli, c, v);
+    check(rc == 0);
+    check(cli->has.cache);
 
     cli_free(cli);
     ssfree(v);
@@ -126,6 +150,19 @@ spec("turf.cli") {
     check(rc == 0);
     check(cli->cmd == TURF_CLI_REMOVE);
     check(strcmp(cli->sandbox_name, "sandbox_name2") == 0);
+    check(!cli->has.async);
+
+    cli_free(cli);
+    ssfree(v);
+
+    cmd = "turf delete --async -f sandbox_name2";
+    rc = cmd2args(cmd, &c, &v);
+    check(rc == 0);
+
+    rc = cli_parse(cli, c, v);
+    check(rc == 0);
+    check(cli->has.async && cli->has.force);
+    check(strcmp(cli->sandbox_name, "sandbox_name2") == 0);
 
     cli_free(cli);
     ssfree(v);
@@ -176,6 +213,22 @@ spec("turf.cli") {
     ssfree(v);
   }
 
+  it("cli.state.json") {
+    cmd = "turf state --json sandbox_name5";
+    rc = cmd2args(cmd, &c, &v);
+    check(rc == 0);
+
+    memset(cli, 0, sizeof(tf_cli));
+    rc = cli_parse(cli, c, v);
+    check(rc == 0);
+    check(cli->cmd == TURF_CLI_STATE);
+    check(cli->has.json);
+    check(strcmp(cli->sandbox_name, "sandbox_name5") == 0);
+
+    cli_free(cli);
+    ssfree(v);
+  }
+
   it("cli.list") {
     cmd = "turf list";
     rc = cmd2args(cmd, &c, &v);
@@ -244,4 +297,56 @@ spec("turf.cli") {
     cli_free(cli);
     ssfree(v);
   }
+
+  it("cli.remote") {
+    cmd = "turf -H create -b /path/to/bundle -m 64 sandbox_name9";
+    rc = cmd2args(cmd, &c, &v);
+    check(rc == 0);
+
+    // options are parsed on the client side
+    memset(cli, 0, sizeof(tf_cli));
+    rc = cli_parse(cli, c, v);
+    check(rc == 0);
+    check(cli->has.remote);
+    check(cli->cmd == TURF_CLI_CREATE);
+    check(strcmp(cli->bundle_path, "/path/to/bundle") == 0);
+    check(strcmp(cli->sandbox_name, "sandbox_name9") == 0);
+    check(cli->has.memlimit && cli->memlimit == 64);
+
+    cli_free(cli);
+    ssfree(v);
+  }
+
+  it("cli.batch") {
+    char line[] = "start -e 'K=a b' --stdout \"/path to/out\" sandbox_name10";
+
+    memset(cli, 0, sizeof(tf_cli));
+    rc = cli_parse_batch(cli, line);
+    check(rc == 0);
+    check(cli->cmd == TURF_CLI_START);
+    check(cli->env_cnt == 1 && strcmp(cli->envs[0], "K=a b") == 0);
+    check(strcmp(cli->file_stdout, "/path to/out") == 0);
+    check(strcmp(cli->sandbox_name, "sandbox_name10") == 0);
+    cli_free(cli);
+
+    // unpaired quote, or not a C/S command
+    char bad1[] = "start 'sandbox_name10";
+    char bad2[] = "run sandbox_name10";
+    memset(cli, 0, sizeof(tf_cli));
+    check(cli_parse_batch(cli, bad1) < 0);
+    check(cli_parse_batch(cli, bad2) < 0);
+    cli_free(cli);
+
+    // the long-lived connection
+    cmd = "turf -H batch -s";
+    rc = cmd2args(cmd, &c, &v);
+    check(rc == 0);
+    memset(cli, 0, sizeof(tf_cli));
+    rc = cli_parse(cli, c, v);
+    check(rc == 0);
+    check(cli->cmd == TURF_CLI_BATCH);
+    check(cli->has.stream && !cli->batch_path);
+    cli_free(cli);
+    ssfree(v);
+  }
 }
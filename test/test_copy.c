@@ -0,0 +1,227 @@
+#include "bdd-for-c.h"
+#include "copy.h"
+#include "sha256.h"
+#include "shell.h"
+#include "test_util.h"
+
+static char m_src[1024];
+static char m_dst[1024];
+static char m_farm[1024];
+
+// the same content and mode
+static bool same_file(const char* name) {
+  char a[1100], b[1100];
+  char *ba = NULL, *bb = NULL;
+  size_t sa = 0, sb = 0;
+  struct stat st_a, st_b;
+
+  snprintf(a, sizeof(a), "%s/%s", m_src, name);
+  snprintf(b, sizeof(b), "%s/%s", m_dst, name);
+  if (stat(a, &st_a) < 0 || stat(b, &st_b) < 0) {
+    return 0;
+  }
+  if (read_file(a, &ba, &sa) < 0 || read_file(b, &bb, &sb) < 0) {
+    free(ba);
+    return 0;
+  }
+
+  bool same = sa == sb && memcmp(ba, bb, sa) == 0 &&
+              (st_a.st_mode & 0777) == (st_b.st_mode & 0777);
+  free(ba);
+  free(bb);
+  return same;
+}
+
+spec("turf.copy") {
+  static int rc;
+  static char cmd[3200];
+
+  before() {
+    shl_path2(m_src, sizeof(m_src), getenv("TURF_WORKDIR"), "cpy_src");
+    shl_path2(m_dst, sizeof(m_dst), getenv("TURF_WORKDIR"), "cpy_dst");
+    shl_path2(m_farm, sizeof(m_farm), getenv("TURF_WORKDIR"), "cpy_farm");
+  }
+
+  before_each() {
+    snprintf(cmd, sizeof(cmd), "rm -rf '%s' '%s' '%s'", m_src, m_dst, m_farm);
+    system(cmd);
+    mkdir(m_src, 0750);
+  }
+
+  after() {
+    snprintf(cmd, sizeof(cmd), "rm -rf '%s' '%s' '%s'", m_src, m_dst, m_farm);
+    system(cmd);
+  }
+
+  it("copy.file") {
+    struct cpy_stat st;
+    char src[1100], dst[1100];
+
+    put_file(m_src, "a.js", 1000, 0755);
+    snprintf(src, sizeof(src), "%s/a.js", m_src);
+    snprintf(dst, sizeof(dst), "%s.a.js", m_dst);
+
+    rc = cpy_path(src, dst, &st);
+    check(rc == 0);
+    check(st.files == 1 && st.bytes == 1000);
+
+    // replaced, even read only
+    chmod(dst, 0400);
+    rc = cpy_path(src, dst, NULL);
+    check(rc == 0);
+    unlink(dst);
+
+    rc = cpy_path("/not/exist", dst, NULL);
+    check(rc < 0 && errno == ENOENT);
+    rc = cpy_path(NULL, dst, NULL);
+    check(rc < 0 && errno == EINVAL);
+  }
+
+  it("copy.tree") {
+    struct cpy_stat st;
+    char path[1100];
+    struct stat s;
+
+    put_file(m_src, "index.js", 100, 0644);
+    put_file(m_src, "empty", 0, 0600);
+    shl_mkdir2(m_src, "lib");
+    put_file(m_src, "lib/run.sh", 4000, 0755);
+    shl_mkdir2(m_src, "lib/ro");
+    put_file(m_src, "lib/ro/data", 10, 0444);
+    shl_path2(path, sizeof(path), m_src, "lib/ro");
+    chmod(path, 0555);
+    shl_path2(path, sizeof(path), m_src, "link");
+    symlink("lib/run.sh", path);
+
+    rc = cpy_path(m_src, m_dst, &st);
+    check(rc == 0);
+    check(st.files == 4);
+    check(st.dirs == 3);
+    check(st.links == 1);
+    check(st.bytes == 4110);
+
+    check(same_file("index.js"));
+    check(same_file("empty"));
+    check(same_file("lib/run.sh"));
+    check(same_file("lib/ro/data"));
+
+    // modes of dirs, the symlink itself
+    check(stat(m_dst, &s) == 0 && (s.st_mode & 0777) == 0750);
+    shl_path2(path, sizeof(path), m_dst, "lib/ro");
+    check(stat(path, &s) == 0 && (s.st_mode & 0777) == 0555);
+    shl_path2(path, sizeof(path), m_dst, "link");
+    char target[64] = {0};
+    check(readlink(path, target, sizeof(target)) > 0);
+    check(strcmp(target, "lib/run.sh") == 0);
+
+    // merged into the existing one
+    put_file(m_src, "index.js", 200, 0644);
+    rc = cpy_path(m_src, m_dst, &st);
+    check(rc == 0);
+    check(same_file("index.js"));
+  }
+
+  it("copy.parallel") {
+    int i;
+    char name[32];
+    struct cpy_stat st;
+
+    // above CPY_PARALLEL_BYTES
+    for (i = 0; i < 12; i++) {
+      snprintf(name, sizeof(name), "f%d", i);
+      put_file(m_src, name, 1024 * 1024 + i, 0644);
+    }
+
+    rc = cpy_path(m_src, m_dst, &st);
+    check(rc == 0);
+    check(st.files == 12);
+    for (i = 0; i < 12; i++) {
+      snprintf(name, sizeof(name), "f%d", i);
+      check(same_file(name));
+    }
+  }
+
+  it("copy.sha256") {
+    int i;
+    uint8_t d[SHA256_SIZE];
+    char hex[SHA256_HEX_SIZE];
+    struct sha256_ctx c;
+
+    sha256_init(&c);
+    sha256_final(&c, d);
+    sha256_hex(d, hex);
+    check(strcmp(hex,
+                 "e3b0c44298fc1c149afbf4c8996fb924"
+                 "27ae41e4649b934ca495991b7852b855") == 0);
+
+    sha256_init(&c);
+    sha256_update(&c, "abc", 3);
+    sha256_final(&c, d);
+    sha256_hex(d, hex);
+    check(strcmp(hex,
+                 "ba7816bf8f01cfea414140de5dae2223"
+                 "b00361a396177a9cb410ff61f20015ad") == 0);
+
+    // across the blocks, in pieces
+    const char* s = "abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq";
+    int len = strlen(s);
+    sha256_init(&c);
+    for (i = 0; i < len; i += 5) {
+      sha256_update(&c, s + i, len - i < 5 ? len - i : 5);
+    }
+    sha256_final(&c, d);
+    sha256_hex(d, hex);
+    check(strcmp(hex,
+                 "248d6a61d20638b8e5c026930c3e6039"
+                 "a33ce45964ff2167f6ecedd419db06c1") == 0);
+  }
+
+  it("copy.stage") {
+    struct cpy_stat st;
+    char a[1100], b[1100];
+    struct stat sa, sb;
+
+    put_file(m_src, "index.js", 100, 0644);
+    put_file(m_src, "dup.file", 100, 0644);  // the same content
+    shl_mkdir2(m_src, "lib");
+    put_file(m_src, "lib/run.sh", 4000, 0755);
+
+    rc = cpy_stage(m_src, m_dst, CPY_F_LINK, m_farm, &st);
+    check(rc == 0);
+    check(st.files == 3);
+    check(st.linked == 3);
+    check(st.farmed == 2);
+
+    // another sandbox of the same code
+    snprintf(b, sizeof(b), "%s.2", m_dst);
+    rc = cpy_stage(m_src, b, CPY_F_CLONE | CPY_F_LINK, m_farm, &st);
+    check(rc == 0);
+    check(st.files == 3);
+    check(st.clones + st.linked == 3);
+    check(st.farmed == 0);
+
+    // shared, and read only
+    shl_path2(a, sizeof(a), m_dst, "lib/run.sh");
+    check(stat(a, &sa) == 0);
+    check((sa.st_mode & 0777) == 0555);
+    shl_path2(a, sizeof(a), b, "lib/run.sh");
+    check(stat(a, &sb) == 0);
+    check(st.clones || sa.st_ino == sb.st_ino);
+    check(same_file("index.js") == 0);  // mode differs
+    // nothing to collect until the links are gone
+    check(cpy_farm_gc(m_farm) == 0);
+    snprintf(cmd, sizeof(cmd), "rm -rf '%s' '%s.2'", m_dst, m_dst);
+    system(cmd);
+    check(cpy_farm_gc(m_farm) == 2);
+
+    // the memos of the sources are gone with them
+    DIR* dir = opendir(m_farm);
+    struct dirent* ino;
+    int left = 0;
+    while ((ino = readdir(dir)) != NULL) {
+      left += ino->d_name[0] != '.';
+    }
+    closedir(dir);
+    check(left == 0);
+  }
+}
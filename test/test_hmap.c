@@ -0,0 +1,88 @@
+#include "bdd-for-c.h"
+#include "hmap.h"
+
+spec("turf.hmap") {
+  static int rc;
+
+  it("hmap.int") {
+    int i;
+    tf_hmap* m = hmap_new(0);
+    check(m);
+
+    for (i = 0; i < 1000; i++) {
+      rc = hmap_put(m, i, (void*)(long)(i + 1));
+      check(rc == 0);
+    }
+    check(m->size == 1000);
+
+    for (i = 0; i < 1000; i++) {
+      check(hmap_get(m, i) == (void*)(long)(i + 1));
+    }
+    check(hmap_get(m, 1000) == NULL);
+    check(errno == ENOENT);
+
+    // replace
+    rc = hmap_put(m, 10, (void*)100);
+    check(rc == 0);
+    check(m->size == 1000);
+    check(hmap_get(m, 10) == (void*)100);
+
+    // NULL value is not allowed
+    rc = hmap_put(m, 10, NULL);
+    check(rc < 0 && errno == EINVAL);
+
+    for (i = 0; i < 1000; i += 2) {
+      rc = hmap_del(m, i);
+      check(rc == 0);
+    }
+    check(m->size == 500);
+    rc = hmap_del(m, 0);
+    check(rc < 0 && errno == ENOENT);
+
+    for (i = 1; i < 1000; i += 2) {
+      check(hmap_get(m, i) == (void*)(long)(i + 1));
+    }
+
+    hmap_free(m);
+  }
+
+  it("hmap.tombstone") {
+    int i;
+    tf_hmap* m = hmap_new(16);
+    check(m);
+
+    // churn on a small table should not grow without bound
+    for (i = 0; i < 100000; i++) {
+      rc = hmap_put(m, i, (void*)1);
+      check(rc == 0);
+      rc = hmap_del(m, i);
+      check(rc == 0);
+    }
+    check(m->size == 0);
+    check(m->_setsize <= 64);
+
+    hmap_free(m);
+  }
+
+  it("hmap.str") {
+    tf_hmap* m = hmap_new(0);
+    check(m);
+
+    rc = hmap_sput(m, "pi", (void*)1);
+    check(rc == 0);
+    rc = hmap_sput(m, "pi2", (void*)2);
+    check(rc == 0);
+
+    char key[] = "pi";
+    check(hmap_sget(m, key) == (void*)1);
+    check(hmap_sget(m, "pi2") == (void*)2);
+    check(hmap_sget(m, "p") == NULL);
+
+    rc = hmap_sdel(m, "pi");
+    check(rc == 0);
+    check(hmap_sget(m, "pi") == NULL);
+    check(m->size == 1);
+
+    hmap_free(m);
+  }
+}
@@ -1,6 +1,72 @@
 #include "bdd-for-c.h"
 #include "ipc.h"
 
+#include <sys/socket.h>
+
+// counts the msgs decoded, the names of fork_req are checked
+struct ep_count {
+  int msgs;
+  int bytes;
+  int bad;
+};
+
+static int ep_count_cb(int type, char* buff, size_t nsize, void* data) {
+  struct ep_count* c = (struct ep_count*)data;
+  struct rlm_t r = {0};
+  char name[32];
+
+  if (type == TIPC_MSG_FORK_REQ) {
+    snprintf(name, sizeof(name), "clone%d", c->msgs);
+    if (tipc_dec_fork_req(&r, buff, nsize) < 0 ||
+        strcmp(r.cfg.name, name) != 0) {
+      c->bad++;
+    }
+    rlm_free_inner(&r);
+  }
+  c->msgs++;
+  c->bytes += nsize;
+  return 0;
+}
+
+// a fork_req of about size bytes, named clone<i>
+static int ep_make_req(char* buf, size_t nsize, int i, size_t size) {
+  static char big[TIPC_MSG_MAX_SIZE];
+  struct rlm_t r = {0};
+  char name[32];
+  char* env[] = {big, NULL};
+
+  snprintf(name, sizeof(name), "clone%d", i);
+  memset(big, 'e', size);
+  big[size] = 0;
+  r.cfg.name = name;
+  r.cfg.env = env;
+  return tipc_enc_fork_req(buf, nsize, &r);
+}
+
+// crc32c bit by bit, the reference of the table and the cpu
+static uint32_t crc32c_ref(const uint8_t* p, size_t size) {
+  uint32_t crc = ~0U;
+
+  while (size--) {
+    crc ^= *p++;
+    for (int k = 0; k < 8; k++) {
+      crc = (crc >> 1) ^ (0x82f63b78 & -(crc & 1));
+    }
+  }
+  return ~crc;
+}
+
+// the bytes of v in a row
+static size_t iov_flat(struct tipc_iov* v, char* out) {
+  size_t len = 0;
+
+  for (int i = 0; i < v->cnt; i++) {
+    memcpy(out + len, v->iov[i].iov_base, v->iov[i].iov_len);
+    len += v->iov[i].iov_len;
+  }
+  return len;
+}
+
 spec("turf.ipc") {
   static int rc;
 #define MAX_BUF 4096
@@ -15,8 +81,62 @@ spec("turf.ipc") {
   it("ipc.seed_ready") {
     rc = tipc_enc_seed_ready(buf, MAX_BUF);
     check(rc > 0);
-    rc = tipc_dec_seed_ready(buf, MAX_BUF);
-    check(rc > 0);
+    uint32_t csums = 0;
+    rc = tipc_dec_seed_ready(buf, MAX_BUF, &csums);
+    check(rc > 0 && (csums & (1 << TIPC_CSUM_CRC32C)));
+
+    // an old seed, the header only
+    struct tipc_hdr* hdr = (struct tipc_hdr*)buf;
+    hdr->length = sizeof(struct tipc_hdr);
+    rc = tipc_dec_seed_ready(buf, MAX_BUF, &csums);
+    check(rc > 0 && csums == (1 << TIPC_CSUM_CRC32));
+    check(tipc_dec_seed_ready(buf, MAX_BUF, NULL) > 0);
+  }
+
+  it("ipc.csum") {
+    static uint8_t data[1024];
+    struct tipc_hdr* hdr = (struct tipc_hdr*)buf;
+    struct ep_count cnt = {0};
+    size_t lens[] = {0, 1, 7, 8, 9, 63, 64, 1000};
+
+    for (int i = 0; i < (int)sizeof(data); i++) {
+      data[i] = i * 7 + 3;
+    }
+    check(crc32c("123456789", 9) == 0xe3069283);
+    for (int i = 0; i < 8; i++) {
+      for (int off = 0; off < 8; off++) {
+        check(crc32c(data + off, lens[i]) == crc32c_ref(data + off, lens[i]));
+      }
+    }
+    check(crc32c_update(crc32c(data, 100), data + 100, 900) ==
+          crc32c(data, 1000));
+
+    // a msg by crc32c
+    check(tipc_set_csum(TIPC_CSUM_CRC32C) == TIPC_CSUM_CRC32);
+    rc = ep_make_req(buf, MAX_BUF, 0, 100);
+    check(rc > 0 && hdr->csum == TIPC_CSUM_CRC32C);
+    check(hdr->checksum == crc32c(&hdr->type, rc - 12));
+    check(tipc_decode(buf, rc, ep_count_cb, &cnt) == 0);
+    check(cnt.msgs == 1 && cnt.bad == 0);
+
+    // corrupted, or unknown
+    buf[40] ^= 1;
+    check(tipc_decode(buf, rc, ep_count_cb, &cnt) == -1 && errno == EBADMSG);
+    buf[40] ^= 1;
+    hdr->csum = TIPC_CSUM_MAX;
+    check(tipc_decode(buf, rc, ep_count_cb, &cnt) == -1 && errno == EBADMSG);
+    hdr->csum = TIPC_CSUM_CRC32C;
+    rc--;  // short of the length in the header
+    check(tipc_decode(buf, rc, ep_count_cb, &cnt) == -1 && errno == EBADMSG);
+    rc++;
+    check(tipc_decode(buf, 8, ep_count_cb, &cnt) == -1 && errno == EBADMSG);
+    hdr->length = 8;
+    check(tipc_decode(buf, 8, ep_count_cb, &cnt) == -1 && errno == EBADMSG);
+    hdr->length = rc;
+    check(tipc_decode(buf, rc, ep_count_cb, &cnt) == 0);
+
+    check(tipc_set_csum(TIPC_CSUM_MAX) == -1 && errno == EINVAL);
+    check(tipc_set_csum(TIPC_CSUM_CRC32) == TIPC_CSUM_CRC32C);
   }
 
   it("ipc.fork") {
@@ -36,7 +156,7 @@ spec("turf.ipc") {
     printf("msg size == %d\n", rc);
     check(rc > 0);
 
-    struct rlm_t rlm2;
+    struct rlm_t rlm2 = {0};
     rc = tipc_dec_fork_req(&rlm2, buf, MAX_BUF);
     check(rc > 0);
     check(rlm1.cfg.flags.terminal == rlm2.cfg.flags.terminal);
@@ -63,6 +183,327 @@ spec("turf.ipc") {
     check(errno == EMSGSIZE);
   }
 
+  it("ipc.fork_batch") {
+    struct rlm_t rlm[3] = {0};
+    struct rlm_t* realms[3] = {&rlm[0], &rlm[1], &rlm[2]};
+    char* argv[] = {"arg1", "arg2"};
+    char* names[] = {"clone0", "clone1", "clone2"};
+    for (int i = 0; i < 3; i++) {
+      rlm[i].cfg.name = names[i];
+      rlm[i].cfg.binary = "test_binary";
+      rlm[i].cfg.argc = 2;
+      rlm[i].cfg.argv = argv;
+      rlm[i].cfg.uid = 1000 + i;
+    }
+    rc = tipc_enc_fork_req_batch(buf, MAX_BUF, realms, 3);
+    check(rc > 0);
+
+    static struct rlm_t out[TIPC_FORK_BATCH_MAX];
+    int n = TIPC_FORK_BATCH_MAX;
+    memset(out, 0, sizeof(out));
+    rc = tipc_dec_fork_req_batch(out, &n, buf, MAX_BUF);
+    check(rc > 0);
+    check(n == 3);
+    for (int i = 0; i < 3; i++) {
+      check(strcmp(out[i].cfg.name, names[i]) == 0);
+      check(strcmp(out[i].cfg.binary, "test_binary") == 0);
+      check(out[i].cfg.argc == 2);
+      check(strcmp(out[i].cfg.argv[1], "arg2") == 0);
+      check(out[i].cfg.uid == 1000 + i);
+      rlm_free_inner(&out[i]);
+    }
+
+    // into an arena, released at once
+    struct arena a = {0};
+    n = TIPC_FORK_BATCH_MAX;
+    memset(out, 0, sizeof(out));
+    for (int i = 0; i < 3; i++) {
+      out[i].cfg.arena = &a;
+    }
+    rc = tipc_dec_fork_req_batch(out, &n, buf, MAX_BUF);
+    check(rc > 0 && n == 3);
+    check(a.blocks != NULL);
+    check(strcmp(out[2].cfg.name, "clone2") == 0);
+    check(strcmp(out[2].cfg.argv[1], "arg2") == 0 && !out[2].cfg.argv[2]);
+    for (int i = 0; i < 3; i++) {
+      rlm_free_inner(&out[i]);
+      check(out[i].cfg.name == NULL && out[i].cfg.arena == NULL);
+    }
+    arn_free(&a);
+
+    // not enough room for the realms
+    n = 2;
+    rc = tipc_dec_fork_req_batch(out, &n, buf, MAX_BUF);
+    check(rc == -1 && errno == EBADMSG);
+    check(n == 0);
+
+    // a single one is not a batch
+    rc = tipc_dec_fork_req(&out[0], buf, MAX_BUF);
+    check(rc == -1 && errno == ENOMSG);
+
+    rc = tipc_enc_fork_req_batch(buf, 60, realms, 3);
+    check(rc == -1 && errno == EMSGSIZE);
+    rc = tipc_enc_fork_req_batch(buf, MAX_BUF, realms, 0);
+    check(rc == -1 && errno == EINVAL);
+
+    // results
+    for (int i = 0; i < 3; i++) {
+      rlm[i].st.child_pid = 100 + i;
+    }
+    rc = tipc_enc_fork_rsp_batch(buf, MAX_BUF, rlm, 3);
+    check(rc > 0);
+    n = TIPC_FORK_BATCH_MAX;
+    memset(out, 0, sizeof(out));
+    rc = tipc_dec_fork_rsp_batch(out, &n, buf, MAX_BUF);
+    check(rc > 0);
+    check(n == 3);
+    for (int i = 0; i < 3; i++) {
+      check(out[i].st.child_pid == 100 + i);
+      check(strcmp(out[i].cfg.name, names[i]) == 0);
+      rlm_free_inner(&out[i]);
+    }
+  }
+
+  it("ipc.fork_tmpl") {
+    struct rlm_t rlm[2] = {0};
+    struct rlm_t* realms[2] = {&rlm[0], &rlm[1]};
+    char* argv[] = {"arg1", "arg2"};
+    char* env[] = {"env1=1", NULL};
+    char* names[] = {"clone0", "clone1"};
+    for (int i = 0; i < 2; i++) {
+      rlm[i].cfg.name = names[i];
+      rlm[i].cfg.chroot_dir = "/path/to/chroot";
+      rlm[i].cfg.binary = "test_binary";
+      rlm[i].cfg.argc = 2;
+      rlm[i].cfg.argv = argv;
+      rlm[i].cfg.env = env;
+      rlm[i].cfg.uid = 1000;
+    }
+    rlm[1].cfg.fd_stdout = "/path/to/stdout";
+
+    // the template, names are not in
+    struct rlm_t t = {0};
+    uint32_t id = 0;
+    rc = tipc_enc_fork_tmpl(buf, MAX_BUF, 7, &rlm[0]);
+    check(rc > 0);
+    rc = tipc_dec_fork_tmpl(&t, &id, buf, MAX_BUF);
+    check(rc > 0 && id == 7);
+    check(t.cfg.name == NULL && t.cfg.chroot_dir == NULL);
+    check(strcmp(t.cfg.binary, "test_binary") == 0);
+    check(t.cfg.argc == 2 && strcmp(t.cfg.argv[1], "arg2") == 0);
+    check(strcmp(t.cfg.env[0], "env1=1") == 0 && t.cfg.env[1] == NULL);
+    check(t.cfg.uid == 1000);
+    rlm_free_inner(&t);
+
+    // the delta only
+    rc = tipc_enc_fork_delta(buf, MAX_BUF, 7, realms, 2);
+    check(rc > 0);
+    static struct rlm_t out[TIPC_FORK_BATCH_MAX];
+    int n = TIPC_FORK_BATCH_MAX;
+    memset(out, 0, sizeof(out));
+    id = 0;
+    rc = tipc_dec_fork_delta(out, &n, &id, buf, MAX_BUF);
+    check(rc > 0 && n == 2 && id == 7);
+    for (int i = 0; i < 2; i++) {
+      check(strcmp(out[i].cfg.name, names[i]) == 0);
+      check(strcmp(out[i].cfg.chroot_dir, "/path/to/chroot") == 0);
+      check(out[i].cfg.binary == NULL && out[i].cfg.argv == NULL);
+    }
+    check(out[0].cfg.fd_stdout == NULL);
+    check(strcmp(out[1].cfg.fd_stdout, "/path/to/stdout") == 0);
+    for (int i = 0; i < 2; i++) {
+      rlm_free_inner(&out[i]);
+    }
+
+    n = 1;
+    rc = tipc_dec_fork_delta(out, &n, &id, buf, MAX_BUF);
+    check(rc == -1 && errno == EBADMSG && n == 0);
+    rc = tipc_dec_fork_tmpl(&t, &id, buf, MAX_BUF);
+    check(rc == -1 && errno == ENOMSG);
+    rc = tipc_enc_fork_delta(buf, MAX_BUF, 7, realms, 0);
+    check(rc == -1 && errno == EINVAL);
+    rc = tipc_enc_fork_tmpl(buf, 30, 7, &rlm[0]);
+    check(rc == -1 && errno == EMSGSIZE);
+  }
+
+  it("ipc.ep_read") {
+    static char msgs[TIPC_MSG_MAX_SIZE * 4];
+    struct ep_count cnt = {0};
+    struct tipc_ep ep;
+    int sv[2], i, len = 0;
+
+    check(socketpair(AF_UNIX, SOCK_STREAM, 0, sv) == 0);
+    fcntl(sv[0], F_SETFL, O_NONBLOCK);
+    tipc_ep_init(&ep, sv[0]);
+
+    rc = tipc_ep_read(&ep, ep_count_cb, &cnt);
+    check(rc == -1 && errno == EAGAIN);
+
+    // coalesced, and a partial one
+    for (i = 0; i < 3; i++) {
+      len += ep_make_req(msgs + len, MAX_BUF, i, 100);
+    }
+    int last = ep_make_req(msgs + len, MAX_BUF, 3, 100);
+    check(write(sv[1], msgs, len + 10) == len + 10);
+    rc = tipc_ep_read(&ep, ep_count_cb, &cnt);
+    check(rc == 3);
+    check(cnt.msgs == 3 && cnt.bad == 0);
+    rc = tipc_ep_read(&ep, ep_count_cb, &cnt);
+    check(rc == -1 && errno == EAGAIN);
+
+    // more of the partial one, still not whole
+    check(write(sv[1], msgs + len + 10, 10) == 10);
+    rc = tipc_ep_read(&ep, ep_count_cb, &cnt);
+    check(rc == 0);
+
+    check(write(sv[1], msgs + len + 20, last - 20) == last - 20);
+    rc = tipc_ep_read(&ep, ep_count_cb, &cnt);
+    check(rc == 1);
+    check(cnt.msgs == 4 && cnt.bad == 0);
+
+    // larger than 4K, and wrapped around the ring
+    memset(&cnt, 0, sizeof(cnt));
+    ep.rd = ep.wr = 0;
+    for (i = 0; i < 40; i++) {
+      len = ep_make_req(msgs, sizeof(msgs), cnt.msgs, 9000 + i * 100);
+      check(len > 9000);
+      check(write(sv[1], msgs, len) == len);
+      rc = tipc_ep_read(&ep, ep_count_cb, &cnt);
+      check(rc == 1);
+    }
+    check(cnt.msgs == 40 && cnt.bad == 0);
+    check(ep.wr > TIPC_EP_RING_SIZE);
+
+    // broken stream
+    memset(msgs, 0xab, sizeof(struct tipc_hdr));
+    check(write(sv[1], msgs, sizeof(struct tipc_hdr)) == sizeof(struct tipc_hdr));
+    rc = tipc_ep_read(&ep, ep_count_cb, &cnt);
+    check(rc == -1 && errno == EBADMSG);
+    ep.rd = ep.wr;
+
+    // peer closed
+    close(sv[1]);
+    rc = tipc_ep_read(&ep, ep_count_cb, &cnt);
+    check(rc == -1 && errno == EPIPE);
+
+    tipc_ep_free(&ep);
+    check(ep.ring == NULL && ep.fd == -1);
+    close(sv[0]);
+  }
+
+  it("ipc.iov") {
+    static struct tipc_iov v;
+    static char out[TIPC_MSG_MAX_SIZE];
+    struct rlm_t rlm[3] = {0};
+    struct rlm_t* realms[3] = {&rlm[0], &rlm[1], &rlm[2]};
+    struct ep_count cnt = {0};
+    struct tipc_ep ep;
+    char big[200];
+    int sv[2], len, n = 0;
+
+    memset(big, 'c', sizeof(big));
+    big[sizeof(big) - 1] = 0;
+    rlm[0].cfg.name = "clone0";
+    rlm[0].cfg.chroot_dir = big;  // referred, not copied
+    rlm[1].cfg.name = "clone1";
+    rlm[1].cfg.fd_stdout = "/path/to/stdout";
+    rlm[2].cfg.name = big;
+
+    // worth it for the long strings only
+    check(tipc_iov_worth(realms, 3));
+    check(!tipc_iov_worth(&realms[1], 1));
+    big[TIPC_IOV_COPY_MAX] = 0;
+    check(tipc_iov_worth(&realms[2], 1));
+    big[TIPC_IOV_COPY_MAX - 1] = 0;
+    check(!tipc_iov_worth(&realms[2], 1));
+    big[TIPC_IOV_COPY_MAX - 1] = big[TIPC_IOV_COPY_MAX] = 'c';
+
+    // the same bytes as the buffer
+    for (int csum = 0; csum < TIPC_CSUM_MAX; csum++) {
+      tipc_set_csum(csum);
+      tipc_iov_init(&v);
+      len = tipc_enc_fork_delta(buf, MAX_BUF, 3, realms, 3);
+      check(len > 0);
+      check(tipc_iov_fork_delta(&v, 3, realms, 3) == len);
+      check(v.cnt > 1 && v.len == (size_t)len);
+      check(iov_flat(&v, out) == (size_t)len && memcmp(out, buf, len) == 0);
+    }
+
+    // after a template, the second header joins the scratch
+    check(socketpair(AF_UNIX, SOCK_STREAM, 0, sv) == 0);
+    tipc_ep_init(&ep, sv[0]);
+    tipc_iov_init(&v);
+    len = tipc_enc_fork_tmpl(buf, MAX_BUF, 3, &rlm[0]);
+    check(tipc_iov_add(&v, buf, len) == 0);
+    len += tipc_iov_fork_delta(&v, 3, realms, 3);
+    len += tipc_iov_fork_delta(&v, 3, realms, 2);
+    check(v.len == (size_t)len);
+    check(tipc_iov_write(&v, sv[1]) == 0);
+    rc = tipc_ep_read(&ep, ep_count_cb, &cnt);
+    check(rc == 3 && cnt.bytes == len);
+
+    // full, left as before
+    tipc_iov_init(&v);
+    while (tipc_iov_fork_delta(&v, 3, realms, 3) > 0) {
+      n++;
+    }
+    check(errno == EMSGSIZE && n > 1);
+    size_t l = v.len;
+    check(tipc_iov_fork_delta(&v, 3, realms, 3) == -1 && v.len == l);
+    memset(&cnt, 0, sizeof(cnt));
+    check(tipc_iov_write(&v, sv[1]) == 0);
+    while (cnt.msgs < n && tipc_ep_read(&ep, ep_count_cb, &cnt) > 0) {
+    }
+    check(cnt.msgs == n && cnt.bytes == (int)l);
+    check(tipc_iov_fork_delta(&v, 3, realms, 0) == -1 && errno == EINVAL);
+
+    tipc_set_csum(TIPC_CSUM_CRC32);
+    tipc_ep_free(&ep);
+    close(sv[0]);
+    close(sv[1]);
+  }
+
+  it("ipc.iov_again") {
+    static struct tipc_iov v;
+    static char all[TIPC_IOV_MAX * 256];
+    static char got[TIPC_IOV_MAX * 256];
+    struct rlm_t rlm[2] = {0};
+    struct rlm_t* realms[2] = {&rlm[0], &rlm[1]};
+    char big[200];
+    int sv[2], sndbuf = 4096;
+    size_t len, n = 0;
+    ssize_t l;
+
+    memset(big, 'c', sizeof(big));
+    big[sizeof(big) - 1] = 0;
+    rlm[0].cfg.name = "clone0";
+    rlm[0].cfg.chroot_dir = big;
+    rlm[1].cfg.name = "clone1";
+
+    tipc_iov_init(&v);
+    while (tipc_iov_fork_delta(&v, 3, realms, 2) > 0) {
+    }
+    len = iov_flat(&v, all);
+    check(len > (size_t)sndbuf * 2);
+
+    // a full socket takes a part, the rest is left in v
+    check(socketpair(AF_UNIX, SOCK_STREAM, 0, sv) == 0);
+    setsockopt(sv[1], SOL_SOCKET, SO_SNDBUF, &sndbuf, sizeof(sndbuf));
+    fcntl(sv[1], F_SETFL, O_NONBLOCK);
+    check(tipc_iov_write(&v, sv[1]) == -1 && errno == EAGAIN);
+    check(v.len > 0 && v.len < len);
+
+    fcntl(sv[0], F_SETFL, O_NONBLOCK);
+    while ((l = read(sv[0], got + n, sizeof(got) - n)) > 0) {
+      n += l;
+    }
+    check(n + v.len == len);
+    tipc_iov_gather(&v, got + n);
+    check(memcmp(got, all, len) == 0);
+    close(sv[0]);
+    close(sv[1]);
+  }
+
   it("ipc.clone") {
     rc = 1;
     printf("%p, %d\n", &rc, rc);
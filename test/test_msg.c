@@ -0,0 +1,196 @@
+#include "bdd-for-c.h"
+#include "msg.h"
+#include "sock.h"
+
+static int vprintf_buf(struct msg_buf* b, const char* fmt, ...) {
+  va_list ap;
+  va_start(ap, fmt);
+  int rc = msg_buf_vprintf(b, fmt, ap);
+  va_end(ap);
+  return rc;
+}
+
+static void fill_cli(tf_cli* cli, char* config) {
+  memset(cli, 0, sizeof(tf_cli));
+  cli->cmd = TURF_CLI_CREATE;
+  cli->sandbox_name = "sandbox_msg";
+  cli->bundle_path = "/path/to/bundle";
+  cli->config_json = config;
+  cli->envs[cli->env_cnt++] = "A=1";
+  cli->envs[cli->env_cnt++] = "B=2";
+  cli->memlimit = 64;
+  cli->has.memlimit = 1;
+  cli->has.force = 1;
+  cli->has.dedup = 1;
+  cli->has.cache = 1;
+  cli->has.async = 1;
+}
+
+spec("turf.msg") {
+  static int rc;
+  static struct msg_hdr hdr;
+
+  it("msg.roundtrip") {
+    tf_cli cli, out = {0};
+    struct msg_buf b = {0};
+
+    fill_cli(&cli, "{}");
+    rc = msg_enc_cli(&b, 7, &cli);
+    check(rc == 0);
+
+    rc = msg_peek(&b, &hdr);
+    check(rc == 1);
+    check(hdr.msg_type == T_MSG_CLI_REQ);
+    check(hdr.msg_seq == 7);
+    check(b.len == sizeof(hdr) + hdr.msg_size);
+
+    rc = msg_dec_cli(b.data + sizeof(hdr), hdr.msg_size, &out);
+    check(rc == 0);
+    check(out.cmd == TURF_CLI_CREATE);
+    check(out.has.remote && out.has.force && !out.has.all);
+    check(out.has.dedup && out.has.cache && out.has.async);
+    check(out.has.memlimit && out.memlimit == 64);
+    check(!out.has.cpulimit);
+    check(strcmp(out.sandbox_name, "sandbox_msg") == 0);
+    check(strcmp(out.bundle_path, "/path/to/bundle") == 0);
+    check(strcmp(out.config_json, "{}") == 0);
+    check(out.env_cnt == 2 && strcmp(out.envs[1], "B=2") == 0);
+    check(out.spec_path == NULL);
+
+    // zero-copy, strings point into the frame
+    check(out.sandbox_name > b.data && out.sandbox_name < b.data + b.len);
+
+    // truncated body
+    memset(&out, 0, sizeof(out));
+    rc = msg_dec_cli(b.data + sizeof(hdr), hdr.msg_size - 1, &out);
+    check(rc < 0 && errno == EBADMSG);
+
+    msg_buf_free(&b);
+  }
+
+  it("msg.partial.pipeline") {
+    int i;
+    tf_cli cli;
+    struct msg_buf b = {0}, r = {0};
+
+    fill_cli(&cli, NULL);
+    for (i = 0; i < 3; i++) {
+      rc = msg_enc_cli(&b, i, &cli);
+      check(rc == 0);
+    }
+
+    // feed byte by byte, frames come out in order
+    int seq = 0;
+    for (i = 0; i < b.len; i++) {
+      msg_buf_reserve(&r, 1);
+      r.data[r.len++] = b.data[i];
+      while ((rc = msg_peek(&r, &hdr)) > 0) {
+        check(hdr.msg_seq == seq);
+        r.off += sizeof(hdr) + hdr.msg_size;
+        seq++;
+      }
+      check(rc == 0);
+      msg_buf_compact(&r);
+    }
+    check(seq == 3);
+    check(r.len == 0);
+
+    // bad magic
+    rc = msg_enc_rsp(&r, 1, -EINVAL);
+    check(rc == 0);
+    rc = msg_peek(&r, &hdr);
+    check(rc == 1 && hdr.msg_code == -EINVAL);
+    r.data[0] ^= 0xff;
+    rc = msg_peek(&r, &hdr);
+    check(rc < 0 && errno == EBADMSG);
+
+    msg_buf_free(&b);
+    msg_buf_free(&r);
+  }
+
+  it("msg.large") {
+    int sv[2];
+    tf_cli cli, out = {0};
+    struct msg_buf w = {0}, r = {0};
+    size_t size = 1024 * 1024;
+
+    char* config = (char*)malloc(size + 1);
+    memset(config, 'x', size);
+    config[size] = 0;
+
+    fill_cli(&cli, config);
+    rc = msg_enc_cli(&w, 1, &cli);
+    check(rc == 0);
+
+    // both sides non-block, pumped in turns
+    rc = sck_pair_unix_socket(sv);
+    check(rc == 0);
+    fcntl(sv[1], F_SETFL, fcntl(sv[1], F_GETFL) | O_NONBLOCK);
+
+    rc = 1;
+    while (rc == 1 || msg_peek(&r, &hdr) == 0) {
+      if (rc == 1) {
+        rc = msg_flush(sv[1], &w);
+        check(rc >= 0);
+      }
+      ssize_t n = msg_fill(sv[0], &r);
+      check(n > 0 || errno == EAGAIN);
+    }
+
+    rc = msg_peek(&r, &hdr);
+    check(rc == 1);
+    rc = msg_dec_cli(r.data + r.off + sizeof(hdr), hdr.msg_size, &out);
+    check(rc == 0);
+    check(strlen(out.config_json) == size);
+
+    // peer closed
+    close(sv[1]);
+    check(msg_fill(sv[0], &r) == 0);
+    close(sv[0]);
+
+    // over the max size
+    free(config);
+    config = (char*)malloc(MSG_MAX_SIZE + 1);
+    memset(config, 'x', MSG_MAX_SIZE);
+    config[MSG_MAX_SIZE] = 0;
+    cli.config_json = config;
+    rc = msg_enc_cli(&w, 2, &cli);
+    check(rc < 0 && errno == E2BIG);
+    check(w.len == 0);
+
+    free(config);
+    msg_buf_free(&w);
+    msg_buf_free(&r);
+  }
+
+  it("msg.response") {
+    int i;
+    struct msg_buf b = {0};
+
+    // a partially sent one ahead, moved by compact
+    rc = msg_enc_rsp(&b, 1, 0);
+    check(rc == 0);
+    b.off = 4;
+
+    ssize_t start = msg_rsp_begin(&b, 2);
+    check(start == sizeof(hdr) - 4);
+    for (i = 0; i < 10000; i++) {
+      rc = vprintf_buf(&b, "line %d\n", i);
+      check(rc > 0);
+    }
+    msg_rsp_end(&b, start, -ENOENT);
+
+    b.off += sizeof(hdr) - 4;
+    rc = msg_peek(&b, &hdr);
+    check(rc == 1);
+    check(hdr.msg_type == T_MSG_CLI_RSP);
+    check(hdr.msg_seq == 2 && hdr.msg_code == -ENOENT);
+    check(hdr.msg_size == b.len - b.off - sizeof(hdr));
+
+    char* body = b.data + b.off + sizeof(hdr);
+    check(strncmp(body, "line 0\nline 1\n", 14) == 0);
+    check(strncmp(body + hdr.msg_size - 10, "line 9999\n", 10) == 0);
+
+    msg_buf_free(&b);
+  }
+}
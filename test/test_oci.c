@@ -41,6 +41,8 @@ spec("turf.oci") {
 
     // the json generate twice should be same.
     check(strcmp(json1, json2) == 0);
+    check(cfg2->crc == cfg3->crc && cfg2->size == strlen(json1));
+    check(cfg1->crc != cfg2->crc || cfg1->size != cfg2->size);
 
     // free all resources
     oci_spec_free(cfg1);
@@ -122,6 +124,82 @@ spec("turf.oci") {
     free(file_name);
   }
 
+  it("oci.state.binary") {
+    int rc;
+    char* file_name;
+    struct oci_state_rec rec;
+    xasprintf(&file_name, "/tmp/test_oci.%d.state", getpid());
+
+    struct oci_state* state =
+        oci_state_create("oci.state.test", "/tmp/oci.state.test.dir/");
+    check(state != NULL);
+    state->pid = 555;
+    state->state = RLM_STATE_STOPPED;
+    state->exit_code = 9;
+    state->has.exit_code = 1;
+    state->rusage.ru_maxrss = 2048;
+    state->rusage.ru_utime.tv_usec = 300;
+    state->has.rusage = 1;
+    state->stat.rss = 1024;
+    state->stat.num_threads = 3;
+    state->has.stat = 1;
+    get_current_time(&state->created);
+
+    // pack and unpack
+    rc = oci_state_pack(state, &rec);
+    check(rc == 0);
+    check(rec.magic == OCI_STATE_REC_MAGIC);
+
+    struct oci_state* state2 = oci_state_unpack(&rec, sizeof(rec));
+    check(state2 != NULL);
+    check(strcmp(state2->id, "oci.state.test") == 0);
+    check(strcmp(state2->bundle, "/tmp/oci.state.test.dir/") == 0);
+    check(state2->pid == 555);
+    check(state2->state == RLM_STATE_STOPPED);
+    check(state2->has.exit_code && state2->exit_code == 9);
+    check(state2->has.rusage && state2->rusage.ru_maxrss == 2048);
+    check(state2->rusage.ru_utime.tv_usec == 300);
+    check(state2->has.stat && state2->stat.rss == 1024);
+    check(state2->stat.num_threads == 3);
+    check(timeval_cmp(state2->created, state->created));
+    oci_state_free(state2);
+
+    // corrupted or truncated record
+    rec.bundle[1] ^= 1;
+    check(oci_state_unpack(&rec, sizeof(rec)) == NULL);
+    check(errno == EBADMSG);
+    rec.bundle[1] ^= 1;
+    check(oci_state_unpack(&rec, sizeof(rec) - 1) == NULL);
+
+    // file in binary
+    rc = oci_state_save(state, file_name);
+    check(rc == 0);
+    state2 = oci_state_load(file_name);
+    check(state2 != NULL);
+    check(state2->pid == 555);
+    oci_state_free(state2);
+
+    // json exported, and still loadable
+    char* json = NULL;
+    rc = oci_state_saves(state, &json);
+    check(rc == 0);
+    check(json[0] == '{');
+    FILE* fp = fopen(file_name, "w");
+    fputs(json, fp);
+    fclose(fp);
+    free(json);
+
+    state2 = oci_state_load(file_name);
+    check(state2 != NULL);
+    check(state2->pid == 555);
+    check(state2->state == RLM_STATE_STOPPED);
+    oci_state_free(state2);
+
+    oci_state_free(state);
+    unlink(file_name);
+    free(file_name);
+  }
+
   it("oci.blank_args") {
     struct oci_spec* cfg1 = oci_spec_load("./test/bad_spec_blank.json");
     check(cfg1 != NULL);
@@ -0,0 +1,138 @@
+#include <poll.h>
+#include <pthread.h>
+
+#include "bdd-for-c.h"
+#include "pool.h"
+
+struct job {
+  int rc;
+  int done;       // times done called
+  int err;        // errno passed to done
+  pthread_t tid;  // thread runs done
+};
+
+static int work_ok(void* arg) {
+  return 0;
+}
+
+static int work_fail(void* arg) {
+  errno = ENOENT;
+  return -1;
+}
+
+static int work_sleep(void* arg) {
+  usleep(100 * 1000);
+  return 0;
+}
+
+static void on_done(void* arg, int rc, int err) {
+  struct job* j = (struct job*)arg;
+  j->rc = rc;
+  j->err = err;
+  j->done++;
+  j->tid = pthread_self();
+}
+
+static uint64_t now_ms(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+// wait on the fd like the loop does, until n works done.
+static int wait_done(int n) {
+  int total = 0;
+  struct pollfd pfd = {.fd = wkp_fd(), .events = POLLIN};
+
+  while (total < n) {
+    if (poll(&pfd, 1, 2000) <= 0) {
+      break;
+    }
+    total += wkp_complete();
+  }
+  return total;
+}
+
+spec("turf.pool") {
+  static int rc;
+
+  it("pool.inline") {
+    struct job j = {0};
+    struct wkp_stat st;
+
+    // without workers, done before return
+    check(wkp_fd() < 0);
+    rc = wkp_submit(work_fail, on_done, &j);
+    check(rc == 0);
+    check(j.done == 1);
+    check(j.rc == -1 && j.err == ENOENT);
+
+    wkp_get_stat(&st);
+    check(st.submitted == 1);
+    check(st.completed == 1);
+
+    rc = wkp_submit(NULL, on_done, &j);
+    check(rc < 0 && errno == EINVAL);
+  }
+
+  it("pool.thread") {
+    int i;
+    struct job j[8] = {0};
+    struct wkp_stat st;
+
+    rc = wkp_start(4);
+    check(rc == 0);
+    check(wkp_fd() >= 0);
+
+    wkp_get_stat(&st);
+    check(st.threads == 4);
+
+    for (i = 0; i < 8; i++) {
+      rc = wkp_submit(i % 2 ? work_fail : work_ok, on_done, &j[i]);
+      check(rc == 0);
+    }
+    check(wait_done(8) == 8);
+
+    // done runs on the caller thread, once
+    for (i = 0; i < 8; i++) {
+      check(j[i].done == 1);
+      check(pthread_equal(j[i].tid, pthread_self()));
+      check(i % 2 ? (j[i].rc == -1 && j[i].err == ENOENT) : j[i].rc == 0);
+    }
+
+    wkp_stop();
+    check(wkp_fd() < 0);
+  }
+
+  it("pool.parallel") {
+    int i;
+    struct job j[4] = {0};
+    struct wkp_stat st;
+
+    rc = wkp_start(4);
+    check(rc == 0);
+
+    // blocking works don't wait for each other
+    uint64_t t0 = now_ms();
+    for (i = 0; i < 4; i++) {
+      wkp_submit(work_sleep, on_done, &j[i]);
+    }
+    check(wait_done(4) == 4);
+    check(now_ms() - t0 < 300);
+
+    // the queued works are done on stop
+    for (i = 0; i < 4; i++) {
+      wkp_submit(work_sleep, on_done, &j[i]);
+    }
+    wkp_stop();
+    for (i = 0; i < 4; i++) {
+      check(j[i].done == 2);
+    }
+
+    wkp_get_stat(&st);
+    check(st.threads == 0);
+    check(st.running == 0 && st.queued == 0);
+    check(st.completed == st.submitted);
+    check(st.max_us >= 100 * 1000);
+  }
+}
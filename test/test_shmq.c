@@ -0,0 +1,195 @@
+#include "bdd-for-c.h"
+#include "shmq.h"
+
+#include <poll.h>
+#include <sys/mman.h>
+
+// doorbell rung
+static bool rung(struct shq* q) {
+  struct pollfd pfd = {.fd = q->efd, .events = POLLIN};
+  return poll(&pfd, 1, 0) == 1;
+}
+
+// a record of len bytes filled with c
+static int put(struct shq* q, uint32_t len, char c) {
+  char* p = shq_reserve(q, len);
+  if (!p) {
+    return -1;
+  }
+  memset(p, c, len);
+  return shq_commit(q, len);
+}
+
+spec("turf.shmq") {
+  static int rc;
+  static struct shq_pair p1;
+  static struct shq_pair p2;
+  static char spec[64];
+
+  before_each() {
+    check(shq_pair_create(&p1) == 0);
+    check(shq_pair_spec(&p1, spec, sizeof(spec)) > 0);
+    check(shq_pair_open(&p2, spec) == 0);
+  }
+
+  after_each() {
+    // the fds are the same ones
+    munmap(p2.base, 2 * (sizeof(struct shq_ctl) + SHQ_SIZE));
+    shq_pair_close(&p1);
+  }
+
+  it("shmq.pair") {
+    uint32_t len;
+    char* msg;
+
+    // both ways, through different mappings
+    check(put(&p1.req, 16, 'a') == 0);
+    check(rung(&p2.req));
+    msg = shq_peek(&p2.req, &len);
+    check(msg && len == 16 && memcmp(msg, "aaaaa", 5) == 0);
+    shq_consume(&p2.req);
+    check(shq_peek(&p2.req, &len) == NULL);
+    check(shq_peek(&p1.rsp, &len) == NULL);
+
+    check(put(&p2.rsp, 20, 'b') == 0);
+    msg = shq_peek(&p1.rsp, &len);
+    check(msg && len == 20 && msg[19] == 'b');
+    shq_consume(&p1.rsp);
+
+    check(shq_pair_open(&p2, "1,2") < 0 && errno == EINVAL);
+    check(shq_pair_open(&p2, spec) == 0);
+  }
+
+  it("shmq.doorbell") {
+    uint32_t len;
+
+    // rung once while the consumer is behind
+    check(put(&p1.req, 16, 'a') == 0);
+    check(put(&p1.req, 16, 'b') == 0);
+    shq_clear(&p2.req);
+    check(!rung(&p2.req));
+
+    check(shq_peek(&p2.req, &len) != NULL);
+    shq_consume(&p2.req);
+    check(put(&p1.req, 16, 'c') == 0);
+    check(!rung(&p2.req));
+
+    // drained, rung again
+    check(shq_peek(&p2.req, &len) != NULL);
+    shq_consume(&p2.req);
+    check(shq_peek(&p2.req, &len) != NULL);
+    shq_consume(&p2.req);
+    check(shq_peek(&p2.req, &len) == NULL);
+    check(put(&p1.req, 16, 'd') == 0);
+    check(rung(&p2.req));
+  }
+
+  it("shmq.wrap") {
+    uint32_t len, i;
+    char* msg;
+
+    // full
+    for (i = 0; put(&p1.req, 10000, 'a' + i % 26) == 0; i++) {
+    }
+    check(errno == EAGAIN);
+    check(i == SHQ_SIZE / 10008);
+
+    // records never wrap, the rest of the end is skipped
+    for (i = 0; i < 100; i++) {
+      msg = shq_peek(&p2.req, &len);
+      check(msg && len == 10000 && msg[len - 1] == 'a' + i % 26);
+      shq_consume(&p2.req);
+      check(put(&p1.req, 10000, 'a' + (i + 26) % 26) == 0);
+    }
+
+    rc = put(&p1.req, SHQ_SIZE, 'x');
+    check(rc < 0 && errno == EMSGSIZE);
+  }
+
+  it("shmq.corrupt") {
+    uint32_t* rec = (uint32_t*)p1.req.data;
+    uint32_t len;
+    char* msg;
+
+    // the head and the records are the peer's, checked before use
+    check(shq_peek(&p2.req, &len) == NULL && errno == EAGAIN);
+    check(put(&p1.req, 16, 'a') == 0);
+    *rec = 4;  // shorter than a msg hdr
+    check(shq_peek(&p2.req, &len) == NULL && errno == EBADMSG);
+    *rec = 64;  // beyond the head
+    check(shq_peek(&p2.req, &len) == NULL && errno == EBADMSG);
+    *rec = SHQ_SIZE;  // beyond the queue
+    check(shq_peek(&p2.req, &len) == NULL && errno == EBADMSG);
+    *rec = 0xfffffff0U;  // overflows
+    check(shq_peek(&p2.req, &len) == NULL && errno == EBADMSG);
+    *rec = 0xffffffffU;  // a wrap in the middle
+    check(shq_peek(&p2.req, &len) == NULL && errno == EBADMSG);
+    p1.req.ctl->head += 2 * SHQ_SIZE;
+    *rec = 16;
+    check(shq_peek(&p2.req, &len) == NULL && errno == EBADMSG);
+    p1.req.ctl->head -= 2 * SHQ_SIZE;
+
+    // consumed by the size checked, a rewrite later is ignored
+    msg = shq_peek(&p2.req, &len);
+    check(msg && len == 16);
+    *rec = 4096;
+    shq_consume(&p2.req);
+    check(p2.req.ctl->tail == p1.req.ctl->head);
+    check(shq_peek(&p2.req, &len) == NULL && errno == EAGAIN);
+  }
+
+  it("shmq.fork") {
+    uint32_t len;
+    int status, i;
+
+    pid_t pid = fork();
+    if (pid == 0) {
+      // echo the requests
+      struct pollfd pfd = {.fd = p2.req.efd, .events = POLLIN};
+      for (i = 0; i < 1000;) {
+        char* msg;
+        poll(&pfd, 1, 1000);
+        shq_clear(&p2.req);
+        while ((msg = shq_peek(&p2.req, &len)) != NULL) {
+          char* out;
+          while ((out = shq_reserve(&p2.rsp, len)) == NULL) {
+            sched_yield();
+          }
+          memcpy(out, msg, len);
+          shq_commit(&p2.rsp, len);
+          shq_consume(&p2.req);
+          i++;
+        }
+      }
+      _exit(0);
+    }
+
+    int sent = 0, got = 0;
+    struct pollfd pfd = {.fd = p1.rsp.efd, .events = POLLIN};
+    while (got < 1000) {
+      while (sent < 1000 && sent - got < 64) {
+        char* out = shq_reserve(&p1.req, 16);
+        if (!out) {
+          break;
+        }
+        memcpy(out, &sent, sizeof(int));
+        shq_commit(&p1.req, 16);
+        sent++;
+      }
+
+      char* msg;
+      poll(&pfd, 1, 1000);
+      shq_clear(&p1.rsp);
+      while ((msg = shq_peek(&p1.rsp, &len)) != NULL) {
+        int v;
+        memcpy(&v, msg, sizeof(int));
+        check(len == 16 && v == got);
+        shq_consume(&p1.rsp);
+        got++;
+      }
+    }
+
+    waitpid(pid, &status, 0);
+    check(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+  }
+}
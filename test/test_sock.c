@@ -0,0 +1,127 @@
+#include "bdd-for-c.h"
+#include "sock.h"
+
+static int m_fired[8];
+static int m_seq;
+
+static int timer_once(struct sck_loop* loop, sck_timer_id id, void* data) {
+  m_fired[(long)data] = ++m_seq;
+  return -1;
+}
+
+static int timer_period(struct sck_loop* loop, sck_timer_id id, void* data) {
+  m_fired[(long)data]++;
+  return m_fired[(long)data] < 3 ? 0 : -1;
+}
+
+static sck_timer_id m_victim;
+static int timer_killer(struct sck_loop* loop, sck_timer_id id, void* data) {
+  sck_delete_timer(loop, m_victim);
+  m_fired[(long)data]++;
+  return -1;
+}
+
+static int timer_self(struct sck_loop* loop, sck_timer_id id, void* data) {
+  sck_delete_timer(loop, id);
+  m_fired[(long)data]++;
+  return 0;
+}
+
+static int timer_nop(struct sck_loop* loop, sck_timer_id id, void* data) {
+  return -1;
+}
+
+static void run_loop(struct sck_loop* loop) {
+  while (sck_loop_alive(loop)) {
+    sck_process_events(loop);
+  }
+}
+
+// benchmark create/delete/pop of n timers in random order
+static void timer_bench(struct sck_loop* loop, int n) {
+  int i;
+  sck_timer_id* ids = (sck_timer_id*)malloc(n * sizeof(sck_timer_id));
+
+  sck_tick t0 = get_tick_us();
+  for (i = 0; i < n; i++) {
+    ids[i] = sck_create_timer(loop, (i * 7919) % 10, timer_nop, NULL);
+  }
+  sck_tick t1 = get_tick_us();
+  for (i = 0; i < n; i += 2) {
+    sck_delete_timer(loop, ids[i]);
+  }
+  sck_tick t2 = get_tick_us();
+
+  // all expired, popped in one pass
+  usleep(10 * 1000);
+  sck_tick t3 = get_tick_us();
+  sck_process_events(loop);
+  sck_tick t4 = get_tick_us();
+
+  printf("timers %6d: create %4.0f ns/op, delete %4.0f ns/op, "
+         "pop %4.0f ns/op\n",
+         n, (t1 - t0) * 1000.0 / n, (t2 - t1) * 1000.0 / (n / 2),
+         (t4 - t3) * 1000.0 / (n / 2));
+  free(ids);
+}
+
+spec("turf.sock") {
+  static struct sck_loop* loop;
+
+  before() {
+    loop = sck_loop_create(64);
+  }
+
+  it("sock.timer.order") {
+    check(loop);
+    memset(m_fired, 0, sizeof(m_fired));
+    m_seq = 0;
+
+    sck_create_timer(loop, 30, timer_once, (void*)2);
+    sck_create_timer(loop, 10, timer_once, (void*)0);
+    sck_create_timer(loop, 20, timer_once, (void*)1);
+    run_loop(loop);
+
+    check(m_fired[0] == 1);
+    check(m_fired[1] == 2);
+    check(m_fired[2] == 3);
+  }
+
+  it("sock.timer.period") {
+    memset(m_fired, 0, sizeof(m_fired));
+
+    sck_create_timer(loop, 0, timer_period, (void*)0);
+    run_loop(loop);
+    check(m_fired[0] == 3);
+  }
+
+  it("sock.timer.delete") {
+    memset(m_fired, 0, sizeof(m_fired));
+    m_seq = 0;
+
+    sck_timer_id id = sck_create_timer(loop, 10, timer_once, (void*)0);
+    check(sck_delete_timer(loop, id) == 0);
+    check(sck_delete_timer(loop, id) < 0 && errno == ENOENT);
+
+    // delete a pending expired timer from another timer
+    sck_create_timer(loop, 0, timer_killer, (void*)1);
+    m_victim = sck_create_timer(loop, 0, timer_once, (void*)2);
+
+    // delete itself while running
+    sck_create_timer(loop, 0, timer_self, (void*)3);
+    run_loop(loop);
+
+    check(m_fired[0] == 0);
+    check(m_fired[1] == 1);
+    check(m_fired[2] == 0);
+    check(m_fired[3] == 1);
+    check(!sck_loop_alive(loop));
+  }
+
+  it("sock.timer.bench") {
+    timer_bench(loop, 1000);
+    timer_bench(loop, 10000);
+    timer_bench(loop, 100000);
+    check(!sck_loop_alive(loop));
+  }
+}
@@ -0,0 +1,108 @@
+#include "bdd-for-c.h"
+#include "shell.h"
+#include "spare.h"
+
+static char m_root[1024];
+static char m_dst[1024];
+
+spec("turf.spare") {
+  static int rc;
+  static char cmd[3200];
+  static char sbx[1100];
+  static char ovl[1100];
+  static struct spr_stat st;
+
+  before() {
+    shl_path2(m_root, sizeof(m_root), getenv("TURF_WORKDIR"), "spr_root");
+    shl_path2(m_dst, sizeof(m_dst), getenv("TURF_WORKDIR"), "spr_dst");
+    shl_path2(sbx, sizeof(sbx), m_dst, "sandbox");
+    shl_path2(ovl, sizeof(ovl), m_dst, "overlay");
+  }
+
+  before_each() {
+    snprintf(cmd, sizeof(cmd), "rm -rf '%s' '%s'", m_root, m_dst);
+    system(cmd);
+    mkdir(m_dst, 0755);
+  }
+
+  after() {
+    spr_free();
+    snprintf(cmd, sizeof(cmd), "rm -rf '%s' '%s'", m_root, m_dst);
+    system(cmd);
+  }
+
+  it("spare.fill") {
+    // leftovers of an earlier turfd
+    mkdir(m_root, 0755);
+    shl_mkdir2(m_root, "old");
+
+    // no workers, made inline
+    rc = spr_init(m_root, 2);
+    check(rc == 0);
+    check(!shl_exist2(m_root, "old"));
+
+    rc = spr_fill("node");
+    check(rc == 0);
+    spr_get_stat(&st);
+    check(st.size == 2 && st.runtimes == 1);
+    check(st.ready == 2 && st.refilling == 0);
+    check(st.refilled == 2);
+    check(shl_exist2(m_root, "node/0/overlay/work"));
+    check(shl_exist2(m_root, "node/1/sandbox"));
+
+    // full already
+    rc = spr_fill("node");
+    check(rc == 0);
+    spr_get_stat(&st);
+    check(st.refilled == 2);
+
+    spr_free();
+    check(!shl_exist2(m_root, "node/0"));
+  }
+
+  it("spare.take") {
+    check(spr_init(m_root, 2) == 0);
+    check(spr_fill("node") == 0);
+
+    rc = spr_take("node", sbx, ovl);
+    check(rc == 0);
+    check(shl_exist2(m_dst, "sandbox"));
+    check(shl_exist2(m_dst, "overlay/work"));
+    check(shl_exist2(m_dst, "overlay/data"));
+
+    // refilled after the take
+    spr_get_stat(&st);
+    check(st.hits == 1 && st.misses == 0);
+    check(st.ready == 2);
+
+    // the first of a runtime misses, and fills it
+    rc = spr_take("python", sbx, ovl);
+    check(rc < 0 && errno == ENOENT);
+    spr_get_stat(&st);
+    check(st.misses == 1);
+    check(st.runtimes == 2 && st.ready == 4);
+
+    // the dest is there, the spare is dropped
+    rc = spr_take("node", sbx, ovl);
+    check(rc < 0);
+    spr_get_stat(&st);
+    check(st.failed == 1);
+    check(st.ready == 4);
+
+    rc = spr_take(NULL, sbx, ovl);
+    check(rc < 0 && errno == EINVAL);
+  }
+
+  it("spare.disabled") {
+    check(spr_init(m_root, 0) == 0);
+    check(access(m_root, F_OK) < 0);
+
+    check(spr_fill("node") == 0);
+    rc = spr_take("node", sbx, ovl);
+    check(rc < 0 && errno == ENOENT);
+
+    spr_get_stat(&st);
+    check(st.size == 0 && st.runtimes == 0);
+    check(st.hits == 0 && st.misses == 0);
+  }
+}
@@ -25,6 +25,47 @@ spec("turf.stat") {
     check(stat.vsize > 0);
   }
 
+  it("pid_smaps") {
+    tf_stat stat = {0};
+    size_t size = 8 << 20;
+    char* mem = malloc(size);
+    int req[2], rsp[2];
+    char c = 0;
+
+    if (pid_smaps(getpid(), &stat) < 0 && errno == ENOENT) {
+      return;  // before linux 4.14
+    }
+    memset(mem, 1, size);
+    check(pid_smaps(getpid(), &stat) == 0);
+    check(stat.pss > 0 && stat.private_dirty >= size / 1024);
+
+    // the child shares the pages until it writes them
+    check(pipe(req) == 0 && pipe(rsp) == 0);
+    pid_t pid = fork();
+    if (pid == 0) {
+      close(req[1]);  // gone with the parent's
+      read(req[0], &c, 1);
+      memset(mem, 2, size);
+      write(rsp[1], &c, 1);
+      read(req[0], &c, 1);
+      _exit(0);
+    }
+    close(req[0]);
+    close(rsp[1]);
+
+    check(pid_smaps(pid, &stat) == 0);
+    check(stat.shared_dirty >= size / 1024);
+    check(stat.private_dirty < size / 1024);
+    check(write(req[1], &c, 1) == 1 && read(rsp[0], &c, 1) == 1);
+    check(pid_smaps(pid, &stat) == 0);
+    check(stat.private_dirty >= size / 1024);
+
+    close(req[1]);
+    waitpid(pid, NULL, 0);
+    close(rsp[0]);
+    free(mem);
+  }
+
 #else
 #warning "test_stat is disabled due to platform."
 #endif
@@ -0,0 +1,118 @@
+#include "bdd-for-c.h"
+#include "shell.h"
+#include "stbl.h"
+
+#include <pthread.h>
+
+static void make_rec(struct oci_state_rec* rec, const char* name, int pid) {
+  struct oci_state* state = oci_state_create(name, "/tmp/bundle");
+  state->pid = pid;
+  state->exit_code = pid;
+  state->has.exit_code = 1;
+  oci_state_pack(state, rec);
+  oci_state_free(state);
+}
+
+// reader thread, checks no torn record is seen.
+static volatile bool m_stop;
+static struct stb_table* m_reader;
+
+static void* reader_proc(void* arg) {
+  long torn = 0;
+  struct oci_state_rec rec;
+  while (!m_stop) {
+    if (stb_read(m_reader, 0, &rec) == 0 && rec.pid != rec.exit_code) {
+      torn++;
+    }
+  }
+  return (void*)torn;
+}
+
+spec("turf.stbl") {
+  static int rc;
+  static char path[1024];
+  static struct stb_table* w;
+
+  before() {
+    shl_path2(path, sizeof(path), getenv("TURF_WORKDIR"), "utest.tbl");
+  }
+
+  it("stbl.rw") {
+    int i;
+    struct oci_state_rec rec;
+
+    w = stb_create(path);
+    check(w);
+    check(w->nslots == STB_INIT_SLOTS);
+
+    rc = stb_alloc(w);
+    check(rc == 0);
+    make_rec(&rec, "sbx-0", 100);
+    rc = stb_update(w, 0, &rec);
+    check(rc == 0);
+
+    // reader maps it read-only
+    struct stb_table* r = stb_open(path);
+    check(r);
+    rc = stb_read(r, 0, &rec);
+    check(rc == 0);
+    check(rec.pid == 100);
+    check(strcmp(rec.id, "sbx-0") == 0);
+
+    rc = stb_read(r, 1, &rec);
+    check(rc < 0 && errno == ENOENT);
+
+    // grows when full
+    for (i = 1; i <= STB_INIT_SLOTS; i++) {
+      char name[32];
+      snprintf(name, sizeof(name), "sbx-%d", i);
+      rc = stb_alloc(w);
+      check(rc == i);
+      make_rec(&rec, name, 100 + i);
+      stb_update(w, rc, &rec);
+    }
+    check(w->nslots == STB_INIT_SLOTS * 2);
+    stb_close(r);
+
+    r = stb_open(path);
+    check(r);
+    rc = stb_find(r, "sbx-1024", &rec);
+    check(rc == 1024);
+    check(rec.pid == 1124);
+    check(stb_find(r, "sbx-none", &rec) < 0);
+
+    // released slot is reused
+    stb_release(w, 5);
+    check(stb_find(r, "sbx-5", &rec) < 0);
+    check(stb_alloc(w) == 5);
+    stb_close(r);
+
+    // a bad file
+    check(stb_open("/not/exist/state.tbl") == NULL);
+  }
+
+  it("stbl.seqlock") {
+    int i;
+    pthread_t th;
+    void* torn = NULL;
+    struct oci_state_rec rec;
+
+    m_reader = stb_open(path);
+    check(m_reader);
+    m_stop = 0;
+    pthread_create(&th, NULL, reader_proc, NULL);
+
+    for (i = 0; i < 100000; i++) {
+      make_rec(&rec, "sbx-0", i);
+      stb_update(w, 0, &rec);
+    }
+
+    m_stop = 1;
+    pthread_join(th, &torn);
+    check(torn == NULL);
+    stb_close(m_reader);
+
+    stb_close(w);
+    unlink(path);
+  }
+}
@@ -0,0 +1,220 @@
+#include "bdd-for-c.h"
+#include "shell.h"
+#include "trash.h"
+
+static char m_trash[1024];
+static char m_src[1024];
+
+// a tree of depth levels, a file and a read-only dir in each
+static int make_tree(const char* top, int depth) {
+  char path[1100];
+  char dir[1100];
+  int i;
+
+  snprintf(dir, sizeof(dir), "%s", top);
+  if (mkdir(dir, 0755) < 0 && errno != EEXIST) {
+    return -1;
+  }
+  for (i = 0; i < depth; i++) {
+    shl_path2(path, sizeof(path), dir, "file");
+    write_file(path, "data", 4);
+    shl_path2(path, sizeof(path), dir, "ro");
+    mkdir(path, 0755);
+    shl_path2(path, sizeof(path), dir, "ro/file");
+    write_file(path, "data", 4);
+    shl_path2(path, sizeof(path), dir, "ro");
+    chmod(path, 0555);
+
+    shl_path2(path, sizeof(path), dir, "d");
+    if (mkdir(path, 0755) < 0) {
+      return -1;
+    }
+    memcpy(dir, path, sizeof(dir));
+  }
+  return 0;
+}
+
+// entries in a dir
+static int count_dir(const char* path) {
+  struct dirent* ino;
+  int n = 0;
+
+  DIR* dir = opendir(path);
+  while (dir && (ino = readdir(dir)) != NULL) {
+    n += ino->d_name[0] != '.';
+  }
+  if (dir) {
+    closedir(dir);
+  }
+  return n;
+}
+
+spec("turf.trash") {
+  static int rc;
+  static char cmd[3200];
+  static char path[1100];
+
+  before() {
+    shl_path2(m_trash, sizeof(m_trash), getenv("TURF_WORKDIR"), "trs_trash");
+    shl_path2(m_src, sizeof(m_src), getenv("TURF_WORKDIR"), "trs_src");
+  }
+
+  before_each() {
+    snprintf(cmd, sizeof(cmd), "rm -rf '%s' '%s'", m_trash, m_src);
+    system(cmd);
+    mkdir(m_trash, 0700);
+    mkdir(m_src, 0755);
+  }
+
+  after() {
+    snprintf(cmd, sizeof(cmd), "rm -rf '%s' '%s'", m_trash, m_src);
+    system(cmd);
+  }
+
+  it("trash.rmtree") {
+    struct stat s;
+    char outside[1100];
+
+    // deep and read-only
+    shl_path2(path, sizeof(path), m_src, "deep");
+    check(make_tree(path, 100) == 0);
+    rc = shl_rmtree(path);
+    check(rc == 0);
+    check(stat(path, &s) < 0 && errno == ENOENT);
+
+    // a symlink is removed, not followed
+    shl_path2(outside, sizeof(outside), m_src, "outside");
+    check(make_tree(outside, 2) == 0);
+    shl_path2(path, sizeof(path), m_src, "top");
+    mkdir(path, 0755);
+    shl_path2(path, sizeof(path), m_src, "top/link");
+    symlink(outside, path);
+    shl_path2(path, sizeof(path), m_src, "top");
+    rc = shl_rmtree(path);
+    check(rc == 0);
+    check(stat(path, &s) < 0);
+    shl_path2(path, sizeof(path), m_src, "outside/file");
+    check(stat(path, &s) == 0);
+
+    // the top being a symlink, only the link is removed
+    shl_path2(path, sizeof(path), m_src, "toplink");
+    symlink(outside, path);
+    rc = shl_rmtree(path);
+    check(rc == 0);
+    check(lstat(path, &s) < 0);
+    check(shl_exist2(m_src, "outside"));
+
+    // missing is fine, like 'rm -rf'
+    rc = shl_rmtree("/not/exist/dir");
+    check(rc == 0);
+    rc = shl_rmtree(NULL);
+    check(rc < 0 && errno == EINVAL);
+  }
+
+  it("trash.put") {
+    struct stat s;
+    struct trs_stat st;
+
+    shl_path2(path, sizeof(path), m_src, "sbx1");
+    check(make_tree(path, 3) == 0);
+    rc = trs_put(m_trash, m_src, "sbx1");
+    check(rc == 0);
+    check(stat(path, &s) < 0 && errno == ENOENT);
+    check(count_dir(m_trash) == 1);
+
+    // the same name again
+    check(make_tree(path, 3) == 0);
+    rc = trs_put(m_trash, m_src, "sbx1");
+    check(rc == 0);
+    check(count_dir(m_trash) == 2);
+
+    rc = trs_put(m_trash, m_src, "sbx1");
+    check(rc < 0 && errno == ENOENT);
+
+    // reaped inline
+    rc = trs_reap(m_trash);
+    check(rc == 2);
+    check(count_dir(m_trash) == 0);
+
+    trs_get_stat(&st);
+    check(st.trashed >= 2);
+    check(st.reaped >= 2);
+  }
+
+  it("trash.thread") {
+    struct trs_stat st;
+    char name[32];
+    int i;
+
+    // leftovers of an earlier turfd
+    shl_path2(path, sizeof(path), m_trash, "old.1.0");
+    check(make_tree(path, 3) == 0);
+
+    rc = trs_start(m_trash, NULL);
+    check(rc == 0);
+    check(trs_running());
+
+    for (i = 0; i < 8; i++) {
+      snprintf(name, sizeof(name), "sbx%d", i);
+      shl_path2(path, sizeof(path), m_src, name);
+      check(make_tree(path, 5) == 0);
+      check(trs_put(m_trash, m_src, name) == 0);
+    }
+
+    trs_sync();
+    check(count_dir(m_trash) == 0);
+    check(count_dir(m_src) == 0);
+
+    trs_get_stat(&st);
+    check(st.pending == 0);
+    check(st.failed == 0);
+    check(st.max_us >= st.last_us);
+
+    trs_stop();
+    check(!trs_running());
+  }
+
+  it("trash.claim") {
+    char name[64];
+    char claimed[1100];
+
+    // claimed by a live reaper, left to it
+    shl_path2(claimed, sizeof(claimed), m_trash, ".claimed");
+    check(shl_mkdir(claimed) == 0);
+    snprintf(name, sizeof(name), "%d-live.1.0", (int)getppid());
+    shl_path2(path, sizeof(path), claimed, name);
+    check(make_tree(path, 2) == 0);
+
+    // claimed by a dead one, taken over
+    shl_path2(path, sizeof(path), claimed, "999999999-dead.1.0");
+    check(make_tree(path, 2) == 0);
+
+    // a sandbox named like a claim is not one
+    shl_path2(path, sizeof(path), m_src, "reap-1-x");
+    check(make_tree(path, 2) == 0);
+    check(trs_put(m_trash, m_src, "reap-1-x") == 0);
+
+    rc = trs_reap(m_trash);
+    check(rc == 2);
+    check(count_dir(m_trash) == 0);
+    check(count_dir(claimed) == 1);
+    check(shl_exist2(claimed, name));
+  }
+
+  it("trash.spawn") {
+    int i;
+
+    shl_path2(path, sizeof(path), m_src, "sbx");
+    check(make_tree(path, 3) == 0);
+    check(trs_put(m_trash, m_src, "sbx") == 0);
+
+    rc = trs_spawn(m_trash, NULL);
+    check(rc == 0);
+
+    // the detached reaper, no wait
+    for (i = 0; i < 100 && count_dir(m_trash) > 0; i++) {
+      usleep(10000);
+    }
+    check(count_dir(m_trash) == 0);
+  }
+}
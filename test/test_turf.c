@@ -1,6 +1,33 @@
 #include "bdd-for-c.h"
+#include "oci.h"
+#include "pool.h"
 #include "shell.h"
+#include "sock.h"
+#include "stbl.h"
 #include "turf.h"
+#include "writer.h"
+
+static int m_done_rc;
+
+static void on_done(void* data, uint32_t seq, int rc) {
+  m_done_rc = rc;
+}
+
+// run the action on the workers as turfd does, and wait for it
+static int run_async(struct tf_cli* cfg) {
+  int i, rc;
+
+  m_done_rc = 1;
+  rc = tf_action_async(cfg, on_done, NULL, 0);
+  if (rc <= 0) {
+    return rc;  // done inline
+  }
+  for (i = 0; i < 1000 && m_done_rc == 1; i++) {
+    usleep(10000);
+    wkp_complete();
+  }
+  return m_done_rc;
+}
 
 spec("turf") {
   it("turf.create") {
@@ -117,4 +144,136 @@ spec("turf") {
     rc = tf_action(&cfg);
     check(rc == 0);
   }
+
+  it("turf.registry") {
+    struct turf_t tf1 = {0}, tf2 = {0};
+    tf1.realm = rlm_new("reg-a");
+    tf2.realm = rlm_new("reg-a");
+
+    check(tf_reg_add(&tf1) == 0);
+    check(tf_find_realm("reg-a") == &tf1);
+    check(tf_get_realm(100) == NULL);
+
+    // pid is known later, like a clone
+    check(tf_reg_set_pid(&tf1, 100) == 0);
+    check(tf_get_realm(100) == &tf1);
+
+    // newer one takes the name
+    check(tf_reg_add(&tf2) == 0);
+    check(tf_find_realm("reg-a") == &tf2);
+    tf_reg_del(&tf1);
+    check(tf_find_realm("reg-a") == &tf2);
+    check(tf_get_realm(100) == NULL);
+
+    tf_reg_del(&tf2);
+    check(tf_find_realm("reg-a") == NULL);
+    rlm_free(tf1.realm);
+    rlm_free(tf2.realm);
+  }
+
+  // keep it last, the process turns into turfd mode.
+  it("turf.daemon.state") {
+    int rc, i;
+    struct tf_cli cfg = {0};
+    char dest[1024];
+
+    shl_path3(dest, 1024, getenv("TURF_WORKDIR"), "/bundle", "pi");
+    chdir(dest);
+    cfg.sandbox_name = "utest-cache";
+    cfg.cmd = TURF_CLI_REMOVE;
+    rc = tf_action(&cfg);
+
+    rc = tf_daemon_init(NULL);
+    check(rc == 0);
+    rc = tf_daemon_start();
+    check(rc == 0);
+
+    cfg.cmd = TURF_CLI_CREATE;
+    rc = tf_action(&cfg);
+    check(rc == 0);
+
+    // the spec and realm are made at create
+    struct turf_t* tf = tf_find_realm("utest-cache");
+    check(tf && tf->i_spec && tf->prepared);
+    check(tf->realm->cfg.binary && tf->realm->cfg.chroot_dir);
+
+    cfg.has.remote = 1;
+    cfg.cmd = TURF_CLI_START;
+    rc = tf_action(&cfg);
+    check(rc == 0);
+    check(tf_find_realm("utest-cache") == tf && !tf->prepared);
+
+    // state is in memory, the file comes after flush
+    shl_path3(dest, 1024, tfd_path_sandbox(), "utest-cache", "state");
+    check(access(dest, F_OK) != 0);
+
+    // exit through pidfd, and flush timer
+    struct sck_loop* loop = sck_default_loop();
+    for (i = 0; i < 50; i++) {
+      sck_process_events(loop);
+      if (access(dest, F_OK) == 0 && tf_find_realm("utest-cache")->pid_ == 0) {
+        break;
+      }
+    }
+    check(tf_find_realm("utest-cache"));
+    tf_state_flush(1);
+
+    struct oci_state* state = oci_state_load(dest);
+    check(state);
+    check(state->state == RLM_STATE_STOPPED);
+    check(state->has.exit_code);
+    oci_state_free(state);
+
+    // readers see it in the state table
+    struct oci_state_rec rec;
+    struct stb_table* t = stb_open(tfd_path_stbl());
+    check(t);
+    rc = stb_find(t, "utest-cache", &rec);
+    check(rc >= 0);
+    check(rec.state == RLM_STATE_STOPPED);
+    stb_close(t);
+
+    // started again from the spec held
+    cfg.cmd = TURF_CLI_START;
+    rc = tf_action(&cfg);
+    check(rc == 0);
+    for (i = 0; i < 50 && tf_find_realm("utest-cache")->pid_ != 0; i++) {
+      sck_process_events(loop);
+    }
+    check(tf_find_realm("utest-cache")->pid_ == 0);
+
+    // a state write queued behind others, dropped by the delete on workers
+    char path[1100];
+    char* buf = NULL;
+    size_t size = 0;
+    shl_path2(path, sizeof(path), getenv("TURF_WORKDIR"), "utest-writes");
+    mkdir(path, 0755);
+    for (i = 0; i < 2000; i++) {
+      snprintf(path + strlen(path), 16, "/%d", i);
+      wrt_submit(path, strdup("x"), 1);
+      *strrchr(path, '/') = 0;
+    }
+    check(wrt_submit(dest, strdup("stale"), 5) == 0);
+    cfg.cmd = TURF_CLI_REMOVE;
+    check(run_async(&cfg) == 0);
+    check(tf_find_realm("utest-cache") == NULL);
+    cfg.cmd = TURF_CLI_CREATE;
+    check(run_async(&cfg) == 0);
+    wrt_sync();
+    if (read_file(dest, &buf, &size) == 0) {
+      check(size != 5 || memcmp(buf, "stale", 5) != 0);
+      free(buf);
+    }
+    shl_rmdir2(getenv("TURF_WORKDIR"), "utest-writes");
+
+    cfg.cmd = TURF_CLI_REMOVE;
+    rc = tf_action(&cfg);
+    check(rc == 0);
+    check(tf_find_realm("utest-cache") == NULL);
+
+    t = stb_open(tfd_path_stbl());
+    check(t);
+    check(stb_find(t, "utest-cache", &rec) < 0);
+    stb_close(t);
+  }
 }
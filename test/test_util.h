@@ -0,0 +1,39 @@
+#ifndef _TURF_TEST_UTIL_H_
+#define _TURF_TEST_UTIL_H_
+
+#include "misc.h"  // write_file()
+
+/* helpers shared by the test cases, in a header as every test_xxx.c is
+ *  linked into a binary of its own.
+ */
+
+/* write size bytes to dir/name and chmod it to mode, the content is made of
+ *  the length of name and size, compressible with some noise. the files of
+ *  the same name length and size are the same.
+ */
+static inline int put_file(const char* dir,
+                           const char* name,
+                           size_t size,
+                           int mode) {
+  char path[1100];
+  size_t i, len = strlen(name);
+
+  snprintf(path, sizeof(path), "%s/%s", dir, name);
+
+  char* buf = malloc(size + 1);
+  if (!buf) {
+    return -1;
+  }
+  for (i = 0; i < size; i++) {
+    buf[i] = (i % 61 == 60) ? (char)(((i + len) * 2654435761u) >> 24)
+                            : 'a' + (i * 7 + len) % 26;
+  }
+  int rc = write_file(path, buf, size);
+  free(buf);
+  if (rc == 0) {
+    rc = chmod(path, mode);
+  }
+  return rc;
+}
+
+#endif  // _TURF_TEST_UTIL_H_
@@ -1,4 +1,7 @@
 #include "bdd-for-c.h"
+#include "warmfork.h"
+
+#include <sys/socket.h>
 
 /**
  * warm container fork().
@@ -18,4 +21,36 @@ int test_fork() {
 
 spec("turf.warm_fork") {
   // test cli
+
+  it("warm_fork.broken") {
+    char buf[256];
+    int sv[2], rc;
+
+    // bytes not a msg, the loop stops instead of spinning on them
+    check(socketpair(AF_UNIX, SOCK_STREAM, 0, sv) == 0);
+    fcntl(sv[0], F_SETFL, O_NONBLOCK);
+    memset(buf, 0xab, sizeof(struct tipc_hdr));
+    check(write(sv[1], buf, sizeof(struct tipc_hdr)) > 0);
+    rc = twf_serve(sv[0]);
+    check(rc == -1 && errno == EBADMSG);
+    close(sv[0]);
+    close(sv[1]);
+
+    // a whole msg of bad checksum
+    check(socketpair(AF_UNIX, SOCK_STREAM, 0, sv) == 0);
+    rc = tipc_enc_seed_ready(buf, sizeof(buf));
+    buf[rc - 1] ^= 1;
+    check(write(sv[1], buf, rc) == rc);
+    rc = twf_serve(sv[0]);
+    check(rc == -1 && errno == EBADMSG);
+    close(sv[0]);
+    close(sv[1]);
+
+    // turfd closed
+    check(socketpair(AF_UNIX, SOCK_STREAM, 0, sv) == 0);
+    close(sv[1]);
+    rc = twf_serve(sv[0]);
+    check(rc == -1 && errno == EPIPE);
+    close(sv[0]);
+  }
 }
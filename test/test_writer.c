@@ -0,0 +1,123 @@
+#include "bdd-for-c.h"
+#include "shell.h"
+#include "writer.h"
+
+static char* dup_str(const char* s) {
+  return strdup(s);
+}
+
+static char* read_str(const char* path) {
+  static char buf[64];
+  int fd = open(path, O_RDONLY);
+  if (fd < 0) {
+    return NULL;
+  }
+  ssize_t n = read(fd, buf, sizeof(buf) - 1);
+  close(fd);
+  buf[n < 0 ? 0 : n] = 0;
+  return buf;
+}
+
+spec("turf.writer") {
+  static int rc;
+  static char path[1024];
+
+  before() {
+    shl_path2(path, sizeof(path), getenv("TURF_WORKDIR"), "wrt_state");
+    unlink(path);
+  }
+
+  it("write_file_atomic") {
+    rc = write_file_atomic(path, "hello", 5);
+    check(rc == 0);
+    check(strcmp(read_str(path), "hello") == 0);
+
+    // replaced, no temp file left
+    rc = write_file_atomic(path, "hi", 2);
+    check(rc == 0);
+    check(strcmp(read_str(path), "hi") == 0);
+
+    char tmp[1100];
+    snprintf(tmp, sizeof(tmp), "%s.%d.tmp", path, getpid());
+    check(access(tmp, F_OK) != 0);
+
+    rc = write_file_atomic("/not/exist/state", "hi", 2);
+    check(rc < 0);
+  }
+
+  it("writer.inline") {
+    struct wrt_stat st;
+
+    // without thread, written before return
+    rc = wrt_submit(path, dup_str("inline"), 6);
+    check(rc == 0);
+    check(strcmp(read_str(path), "inline") == 0);
+
+    wrt_get_stat(&st);
+    check(st.submitted == 1);
+    check(st.written == 1);
+
+    rc = wrt_submit(NULL, NULL, 0);
+    check(rc < 0 && errno == EINVAL);
+  }
+
+  it("writer.thread") {
+    int i;
+    char buf[32];
+    struct wrt_stat st0, st;
+
+    rc = wrt_start();
+    check(rc == 0);
+    wrt_get_stat(&st0);
+
+    // the writes to the same file are coalesced
+    for (i = 0; i < 1000; i++) {
+      snprintf(buf, sizeof(buf), "v%d", i);
+      rc = wrt_submit(path, dup_str(buf), strlen(buf));
+      check(rc == 0);
+    }
+    wrt_sync();
+
+    check(strcmp(read_str(path), "v999") == 0);
+
+    wrt_get_stat(&st);
+    check(st.submitted - st0.submitted == 1000);
+    check((st.written - st0.written) + (st.coalesced - st0.coalesced) == 1000);
+    check(st.failed == st0.failed);
+    check(st.depth == 0);
+    check(st.max_depth >= 1);
+
+    // the write to a gone dir is skipped, a failed write is counted
+    rc = wrt_submit("/not/exist/state", dup_str("x"), 1);
+    check(rc == 0);
+    rc = wrt_submit("/dev/null/state", dup_str("x"), 1);
+    check(rc == 0);
+    wrt_sync();
+    wrt_get_stat(&st);
+    check(st.skipped == st0.skipped + 1);
+    check(st.failed == st0.failed + 1);
+
+    // nothing lands after cancel, as a deleted sandbox
+    for (i = 0; i < 100; i++) {
+      snprintf(buf, sizeof(buf), "c%d", i);
+      rc = wrt_submit(path, dup_str(buf), strlen(buf));
+      check(rc == 0);
+    }
+    rc = wrt_cancel(path);
+    check(rc == 0 || rc == 1);
+    unlink(path);
+    wrt_sync();
+    check(access(path, F_OK) != 0);
+
+    rc = wrt_cancel(NULL);
+    check(rc < 0 && errno == EINVAL);
+
+    // pending writes are flushed on stop
+    rc = wrt_submit(path, dup_str("last"), 4);
+    check(rc == 0);
+    wrt_stop();
+    check(strcmp(read_str(path), "last") == 0);
+
+    unlink(path);
+  }
+}
@@ -0,0 +1,325 @@
+#include "bdd-for-c.h"
+#include "crc32.h"
+#include "inflate.h"
+#include "shell.h"
+#include "test_util.h"
+#include "zip.h"
+
+static char m_src[1024];
+static char m_dst[1024];
+static char m_zip[1024];
+
+// the archives of the source are made by zip(1), if installed.
+static bool has_zip(void) {
+  static int found = -1;
+  if (found < 0) {
+    found = system("command -v zip >/dev/null 2>&1") == 0;
+  }
+  if (!found) {
+    puts("  zip(1) not found, skipped");
+  }
+  return found;
+}
+
+// zip the source by zip(1), opts like "-0" for stored
+static int make_zip(const char* opts) {
+  char cmd[3200];
+  unlink(m_zip);
+  snprintf(cmd,
+           sizeof(cmd),
+           "cd '%s' && zip -q -r -y %s '%s' . >/dev/null",
+           m_src,
+           opts,
+           m_zip);
+  return system(cmd);
+}
+
+// the extracted is the same as the source
+static int same_tree() {
+  char cmd[3200];
+  snprintf(
+      cmd, sizeof(cmd), "diff -r --no-dereference '%s' '%s'", m_src, m_dst);
+  return system(cmd) == 0;
+}
+
+// an entry of a crafted archive, stored
+struct zip_fix {
+  const char* name;  // as is, not checked
+  mode_t mode;       // S_IFREG, S_IFDIR or S_IFLNK, with the perms
+  const char* data;  // the content, or the target of a symlink
+};
+
+static uint8_t* put16(uint8_t* p, uint16_t v) {
+  p[0] = v & 0xff;
+  p[1] = v >> 8;
+  return p + 2;
+}
+
+static uint8_t* put32(uint8_t* p, uint32_t v) {
+  p = put16(p, v & 0xffff);
+  return put16(p, v >> 16);
+}
+
+/* write the entries to m_zip, a local header and data each, then the
+ *  central directory and the end record, made by unix.
+ */
+static int craft_zip(const struct zip_fix* ents, int n) {
+  static uint8_t buf[64 * 1024];
+  uint32_t offs[16];
+  uint8_t* p = buf;
+  int i;
+
+  if (n > 16) {
+    return -1;
+  }
+  for (i = 0; i < n; i++) {
+    const struct zip_fix* f = &ents[i];
+    uint32_t size = f->data ? strlen(f->data) : 0;
+
+    offs[i] = p - buf;
+    p = put32(p, 0x04034b50);
+    p = put16(p, 20);  // version needed
+    p = put16(p, 0);   // flags
+    p = put16(p, 0);   // stored
+    p = put32(p, 0);   // time and date
+    p = put32(p, crc32(f->data, size));
+    p = put32(p, size);
+    p = put32(p, size);
+    p = put16(p, strlen(f->name));
+    p = put16(p, 0);  // extra
+    memcpy(p, f->name, strlen(f->name));
+    p += strlen(f->name);
+    memcpy(p, f->data, size);
+    p += size;
+  }
+
+  uint8_t* cd = p;
+  for (i = 0; i < n; i++) {
+    const struct zip_fix* f = &ents[i];
+    uint32_t size = f->data ? strlen(f->data) : 0;
+
+    p = put32(p, 0x02014b50);
+    p = put16(p, (3 << 8) | 20);  // made by unix
+    p = put16(p, 20);
+    p = put16(p, 0);
+    p = put16(p, 0);
+    p = put32(p, 0);
+    p = put32(p, crc32(f->data, size));
+    p = put32(p, size);
+    p = put32(p, size);
+    p = put16(p, strlen(f->name));
+    p = put16(p, 0);  // extra
+    p = put16(p, 0);  // comment
+    p = put16(p, 0);  // disk
+    p = put16(p, 0);  // internal attributes
+    p = put32(p, (uint32_t)f->mode << 16);
+    p = put32(p, offs[i]);
+    memcpy(p, f->name, strlen(f->name));
+    p += strlen(f->name);
+  }
+
+  uint8_t* end = p;
+  p = put32(p, 0x06054b50);
+  p = put32(p, 0);  // disks
+  p = put16(p, n);
+  p = put16(p, n);
+  p = put32(p, end - cd);
+  p = put32(p, cd - buf);
+  p = put16(p, 0);  // comment
+  return write_file(m_zip, (char*)buf, p - buf);
+}
+
+// collect the output in a small buffer
+struct out_buf {
+  char data[64];
+  size_t len;
+};
+
+static int out_sink(void* arg, const void* buf, size_t size) {
+  struct out_buf* o = (struct out_buf*)arg;
+  if (o->len + size > sizeof(o->data)) {
+    return -1;
+  }
+  memcpy(o->data + o->len, buf, size);
+  o->len += size;
+  return 0;
+}
+
+spec("turf.zip") {
+  static int rc;
+  static char cmd[3200];
+
+  before() {
+    shl_path2(m_src, sizeof(m_src), getenv("TURF_WORKDIR"), "zip_src");
+    shl_path2(m_dst, sizeof(m_dst), getenv("TURF_WORKDIR"), "zip_dst");
+    shl_path2(m_zip, sizeof(m_zip), getenv("TURF_WORKDIR"), "zip_src.zip");
+  }
+
+  before_each() {
+    snprintf(cmd, sizeof(cmd), "rm -rf '%s' '%s' '%s'", m_src, m_dst, m_zip);
+    system(cmd);
+    mkdir(m_src, 0755);
+  }
+
+  after() {
+    snprintf(cmd, sizeof(cmd), "rm -rf '%s' '%s' '%s'", m_src, m_dst, m_zip);
+    system(cmd);
+  }
+
+  it("zip.inflate") {
+    struct out_buf o = {{0}};
+
+    // fixed huffman of "hello hello hello", by zlib, a literal and a match
+    const uint8_t fixed[] = {
+        0xcb, 0x48, 0xcd, 0xc9, 0xc9, 0x57, 0xc8, 0x40, 0x90, 0x00};
+    check(ifl_inflate(fixed, sizeof(fixed), out_sink, &o) == 17);
+    check(o.len == 17 && memcmp(o.data, "hello hello hello", 17) == 0);
+
+    // stored, "abc"
+    const uint8_t stored[] = {0x01, 0x03, 0x00, 0xfc, 0xff, 'a', 'b', 'c'};
+    o.len = 0;
+    check(ifl_inflate(stored, sizeof(stored), out_sink, &o) == 3);
+    check(memcmp(o.data, "abc", 3) == 0);
+
+    // truncated, bad block type
+    rc = ifl_inflate(fixed, 4, out_sink, &o);
+    check(rc < 0 && errno == EBADMSG);
+    const uint8_t bad[] = {0x07};
+    rc = ifl_inflate(bad, sizeof(bad), out_sink, &o);
+    check(rc < 0 && errno == EBADMSG);
+  }
+
+  it("zip.extract") {
+    if (!has_zip()) {
+      continue;  // out of the it(), which is a for
+    }
+    struct zip_stat st;
+    char path[1100];
+    struct stat s;
+
+    put_file(m_src, "index.js", 5000, 0644);
+    put_file(m_src, "empty", 0, 0600);
+    shl_mkdir2(m_src, "lib");
+    put_file(m_src, "lib/run.sh", 100000, 0755);
+    shl_mkdir2(m_src, "lib/deep");
+    put_file(m_src, "lib/deep/data", 10, 0444);
+    shl_path2(path, sizeof(path), m_src, "link");
+    symlink("lib/run.sh", path);
+
+    // deflated
+    check(make_zip("-6") == 0);
+    rc = zip_extract(m_zip, m_dst, &st);
+    check(rc == 0);
+    check(st.files == 4);
+    check(st.links == 1);
+    check(st.bytes == 105010);
+    check(st.packed < st.bytes);
+    check(same_tree());
+
+    shl_path2(path, sizeof(path), m_dst, "lib/run.sh");
+    check(stat(path, &s) == 0 && (s.st_mode & 0777) == 0755);
+    shl_path2(path, sizeof(path), m_dst, "link");
+    check(lstat(path, &s) == 0 && S_ISLNK(s.st_mode));
+
+    // stored
+    snprintf(cmd, sizeof(cmd), "rm -rf '%s'", m_dst);
+    system(cmd);
+    check(make_zip("-0") == 0);
+    rc = zip_extract(m_zip, m_dst, &st);
+    check(rc == 0);
+    check(st.packed == st.bytes);
+    check(same_tree());
+  }
+
+  it("zip.parallel") {
+    if (!has_zip()) {
+      continue;  // out of the it(), which is a for
+    }
+    int i;
+    char name[32];
+    struct zip_stat st;
+
+    // above ZIP_PARALLEL_BYTES
+    for (i = 0; i < 16; i++) {
+      snprintf(name, sizeof(name), "f%d", i);
+      put_file(m_src, name, 256 * 1024 + i, 0644);
+    }
+
+    check(make_zip("-6") == 0);
+    rc = zip_extract(m_zip, m_dst, &st);
+    check(rc == 0);
+    check(st.files == 16);
+    check(same_tree());
+  }
+
+  it("zip.corrupt") {
+    if (!has_zip()) {
+      continue;  // out of the it(), which is a for
+    }
+    char* buf = NULL;
+    size_t size = 0;
+
+    put_file(m_src, "index.js", 50000, 0644);
+    check(make_zip("-6") == 0);
+    check(read_file(m_zip, &buf, &size) == 0);
+
+    // a flipped byte in the data, caught by the crc or the decoder
+    buf[100] ^= 0x55;
+    write_file(m_zip, buf, size);
+    rc = zip_extract(m_zip, m_dst, NULL);
+    check(rc < 0 && errno == EBADMSG);
+
+    // not a zip
+    write_file(m_zip, "not a zip file, not at all", 26);
+    rc = zip_extract(m_zip, m_dst, NULL);
+    check(rc < 0 && errno == EBADMSG);
+    free(buf);
+
+    rc = zip_extract("/not/exist.zip", m_dst, NULL);
+    check(rc < 0 && errno == ENOENT);
+    rc = zip_extract(NULL, m_dst, NULL);
+    check(rc < 0 && errno == EINVAL);
+  }
+
+  it("zip.crafted") {
+    char path[1100];
+    struct stat s;
+    struct zip_stat st;
+
+    // a good one, to be sure of the crafting
+    struct zip_fix good[] = {{"lib/", S_IFDIR | 0755, NULL},
+                             {"lib/a.js", S_IFREG | 0644, "hello"},
+                             {"a", S_IFLNK | 0777, "lib/a.js"}};
+    check(craft_zip(good, 3) == 0);
+    rc = zip_extract(m_zip, m_dst, &st);
+    check(rc == 0 && st.files == 1 && st.links == 1);
+    shl_path2(path, sizeof(path), m_dst, "a");
+    check(stat(path, &s) == 0 && s.st_size == 5);
+
+    // out of the dest, or not normalized, the whole archive is refused
+    const char* bad[] = {"../x", "/abs", "a/./b", "a/../../x", "a//b"};
+    for (int i = 0; i < (int)(sizeof(bad) / sizeof(bad[0])); i++) {
+      struct zip_fix f = {bad[i], S_IFREG | 0644, "bad"};
+
+      snprintf(cmd, sizeof(cmd), "rm -rf '%s'", m_dst);
+      system(cmd);
+      check(craft_zip(&f, 1) == 0);
+      rc = zip_extract(m_zip, m_dst, NULL);
+      check(rc < 0 && errno == EBADMSG, "%s", bad[i]);
+    }
+    shl_path2(path, sizeof(path), getenv("TURF_WORKDIR"), "x");
+    check(access(path, F_OK) != 0);
+    check(access("/abs", F_OK) != 0);
+
+    // a symlink to the outside, then a file through it
+    struct zip_fix link[] = {{"d", S_IFLNK | 0777, m_src},
+                             {"d/f", S_IFREG | 0644, "escaped"}};
+    snprintf(cmd, sizeof(cmd), "rm -rf '%s'", m_dst);
+    system(cmd);
+    check(craft_zip(link, 2) == 0);
+    rc = zip_extract(m_zip, m_dst, NULL);
+    check(rc < 0);
+    shl_path2(path, sizeof(path), m_src, "f");
+    check(access(path, F_OK) != 0);
+  }
+}